@@ -0,0 +1,65 @@
+project "ATMega328-Emulator-Bench"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++20"
+	staticruntime "off"
+
+	targetdir ("%{wks.location}/bin/" .. outputdir .. "/%{prj.name}")
+    objdir ("%{wks.location}/bin-int/" .. outputdir .. "/%{prj.name}")
+
+	files {
+        "src/**.h",
+        "src/**.cpp",
+
+		"vendor/benchmark/include/**.h",
+		"vendor/benchmark/src/**.h",
+		"vendor/benchmark/src/**.cc",
+    }
+
+	removefiles {
+		"vendor/benchmark/src/benchmark_main.cc",
+	}
+
+	includedirs {
+		"%{IncludeDir.ATMega328EmulatorCore}",
+
+		"vendor/benchmark/include",
+    }
+
+	-- What the library's own CMake build would detect
+	defines {
+		"BENCHMARK_STATIC_DEFINE",
+		"HAVE_STD_REGEX",
+		"HAVE_STEADY_CLOCK",
+	}
+
+	-- Firmware images WorkloadBenchmarks.cpp loads
+	defines {
+		"KOM_WORKLOADS_DIR=\"%{wks.location}/workloads/\"",
+	}
+
+	links {
+        "ATMega328-Emulator-Core"
+    }
+
+	filter "system:windows"
+		systemversion "latest"
+		links { "Shlwapi" }
+
+	filter "system:linux"
+		links { "pthread" }
+
+	filter "configurations:Debug"
+		defines "KOM_DEBUG"
+		runtime "Debug"
+		symbols "on"
+
+	filter "configurations:Release"
+		defines "KOM_RELEASE"
+		runtime "Release"
+		optimize "on"
+
+	filter "configurations:Dist"
+		defines "KOM_DIST"
+		runtime "Release"
+		optimize "on"
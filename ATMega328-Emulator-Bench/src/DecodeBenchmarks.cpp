@@ -0,0 +1,59 @@
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "ATMega328Emulator/Timing.h"
+
+using namespace ATMega328Emulator;
+
+namespace {
+
+	// Every 16-bit word once, in order
+	void BM_Decode(benchmark::State& state)
+	{
+		for (auto _ : state) {
+			for (uint32_t instruction = 0; instruction <= 0xFFFF; ++instruction) {
+				benchmark::DoNotOptimize(Timing::Decode((Word)instruction));
+			}
+		}
+		state.SetItemsProcessed(state.iterations() * 0x10000);
+	}
+
+	// The same words in a shuffled order, so the branches in the decoder can't learn the sequence
+	void BM_DecodeShuffled(benchmark::State& state)
+	{
+		std::vector<Word> instructions(0x10000);
+		uint32_t x = 1;
+		for (uint32_t i = 0; i < instructions.size(); ++i) {
+			instructions[i] = (Word)i;
+		}
+		for (uint32_t i = (uint32_t)instructions.size() - 1; i > 0; --i) {
+			x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+			std::swap(instructions[i], instructions[x % (i + 1)]);
+		}
+
+		for (auto _ : state) {
+			for (Word instruction : instructions) {
+				benchmark::DoNotOptimize(Timing::Decode(instruction));
+			}
+		}
+		state.SetItemsProcessed(state.iterations() * 0x10000);
+	}
+
+	// Decode and the timing table lookup Run does for every instruction
+	void BM_DecodeAndTime(benchmark::State& state)
+	{
+		for (auto _ : state) {
+			for (uint32_t instruction = 0; instruction <= 0xFFFF; ++instruction) {
+				benchmark::DoNotOptimize(Timing::GetCycles(Timing::Decode((Word)instruction), false));
+			}
+		}
+		state.SetItemsProcessed(state.iterations() * 0x10000);
+	}
+
+}
+
+BENCHMARK(BM_Decode);
+BENCHMARK(BM_DecodeShuffled);
+BENCHMARK(BM_DecodeAndTime);
@@ -0,0 +1,137 @@
+#include <type_traits>
+
+#include <benchmark/benchmark.h>
+
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Instructions.h"
+#include "ATMega328Emulator/Memory.h"
+
+using namespace ATMega328Emulator;
+
+namespace {
+
+	constexpr Word START_PC = 0x100;
+
+	constexpr Word Rd(Byte d) { return d << 4; }
+	constexpr Word Rr(Byte r) { return (r & 0xF) | ((r & 0x10) << 5); }
+	constexpr Word K8(Byte k) { return (k & 0xF) | ((k & 0xF0) << 4); }
+
+	// One handler called with the same encoding over and over, without fetch, decode or timing.
+	// Handlers that move the PC or SP have them put back every iteration, the others pay for it too.
+	template<auto Handler>
+	void BM_Handler(benchmark::State& state, Word instruction)
+	{
+		Memory memory;
+		CPU cpu;
+		cpu.Reset(memory);
+		for (Byte* r = &cpu.R00; r <= &cpu.R31; ++r) {
+			*r = (Byte)(r - &cpu.R00) * 7 + 1;
+		}
+		cpu.X = cpu.Y = cpu.Z = 0x200; // LD, ST and the like stay in the SRAM
+
+		for (auto _ : state) {
+			cpu.PC = START_PC;
+			cpu.IO.SP = CPU::RAMEND;
+
+			if constexpr (std::is_invocable_v<decltype(Handler), Word, CPU*, Memory&>) {
+				if constexpr (std::is_void_v<std::invoke_result_t<decltype(Handler), Word, CPU*, Memory&>>) {
+					Handler(instruction, &cpu, memory);
+				}
+				else {
+					benchmark::DoNotOptimize(Handler(instruction, &cpu, memory));
+				}
+			}
+			else if constexpr (std::is_void_v<std::invoke_result_t<decltype(Handler), Word, CPU*>>) {
+				Handler(instruction, &cpu);
+			}
+			else {
+				benchmark::DoNotOptimize(Handler(instruction, &cpu));
+			}
+			benchmark::ClobberMemory();
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	#define KOM_HANDLER_BENCHMARK(name, instruction) \
+		benchmark::RegisterBenchmark("BM_Handle_" #name, BM_Handler<&Instruction::Handle_##name>, (Word)(instruction))
+
+	bool RegisterHandlerBenchmarks()
+	{
+		using namespace Instruction;
+
+		KOM_HANDLER_BENCHMARK(ADC, ADC | Rd(16) | Rr(17));
+		KOM_HANDLER_BENCHMARK(ADD, ADD | Rd(16) | Rr(17));
+		KOM_HANDLER_BENCHMARK(ADIW, ADIW | (1 << 4) | 1);        // adiw r26, 1
+		KOM_HANDLER_BENCHMARK(AND, AND | Rd(16) | Rr(17));
+		KOM_HANDLER_BENCHMARK(ANDI, ANDI | Rd(1) | K8(0x5A));    // andi r17, 0x5A
+		KOM_HANDLER_BENCHMARK(ASR, ASR | Rd(16));
+		KOM_HANDLER_BENCHMARK(BCLR, BCLR | (2 << 4));            // cln
+		KOM_HANDLER_BENCHMARK(BLD, BLD | Rd(16) | 3);
+		KOM_HANDLER_BENCHMARK(BRBC, BRBC | (1 << 3) | 1);        // brne .+2
+		KOM_HANDLER_BENCHMARK(BRBS, BRBS | (1 << 3) | 1);        // breq .+2
+		KOM_HANDLER_BENCHMARK(BSET, BSET | (2 << 4));            // sen
+		KOM_HANDLER_BENCHMARK(BST, BST | Rd(16) | 3);
+		KOM_HANDLER_BENCHMARK(CALL, CALL);
+		KOM_HANDLER_BENCHMARK(CBI, CBI | (5 << 3) | 1);          // cbi PORTB, 1
+		KOM_HANDLER_BENCHMARK(COM, COM | Rd(16));
+		KOM_HANDLER_BENCHMARK(CP, CP | Rd(16) | Rr(17));
+		KOM_HANDLER_BENCHMARK(CPC, CPC | Rd(16) | Rr(17));
+		KOM_HANDLER_BENCHMARK(CPI, CPI | Rd(1) | K8(0x5A));
+		KOM_HANDLER_BENCHMARK(CPSE, CPSE | Rd(16) | Rr(17));
+		KOM_HANDLER_BENCHMARK(DEC, DEC | Rd(16));
+		KOM_HANDLER_BENCHMARK(EOR, EOR | Rd(16) | Rr(17));
+		KOM_HANDLER_BENCHMARK(FMUL, FMUL | (1 << 4) | 2);        // fmul r17, r18
+		KOM_HANDLER_BENCHMARK(FMULS, FMULS | (1 << 4) | 2);
+		KOM_HANDLER_BENCHMARK(FMULSU, FMULSU | (1 << 4) | 2);
+		KOM_HANDLER_BENCHMARK(ICALL, ICALL);
+		KOM_HANDLER_BENCHMARK(IJMP, IJMP);
+		KOM_HANDLER_BENCHMARK(IN, IN | Rd(16) | 5);              // in r16, PORTB
+		KOM_HANDLER_BENCHMARK(INC, INC | Rd(16));
+		KOM_HANDLER_BENCHMARK(JMP, JMP);
+		KOM_HANDLER_BENCHMARK(LAC, LAC | Rd(16));
+		KOM_HANDLER_BENCHMARK(LAS, LAS | Rd(16));
+		KOM_HANDLER_BENCHMARK(LAT, LAT | Rd(16));
+		KOM_HANDLER_BENCHMARK(LD, LD_X | Rd(16));
+		KOM_HANDLER_BENCHMARK(LDD, LDD_Y | Rd(16) | 1);          // ldd r16, Y+1
+		KOM_HANDLER_BENCHMARK(LDI, LDI | Rd(1) | K8(0x5A));
+		KOM_HANDLER_BENCHMARK(LDS, LDS | Rd(16));
+		KOM_HANDLER_BENCHMARK(LPM, LPM_Z | Rd(16));
+		KOM_HANDLER_BENCHMARK(LSR, LSR | Rd(16));
+		KOM_HANDLER_BENCHMARK(MOV, MOV | Rd(16) | Rr(17));
+		KOM_HANDLER_BENCHMARK(MOVW, MOVW | (8 << 4) | 9);        // movw r16, r18
+		KOM_HANDLER_BENCHMARK(MUL, MUL | Rd(16) | Rr(17));
+		KOM_HANDLER_BENCHMARK(MULS, MULS | (1 << 4) | 2);        // muls r17, r18
+		KOM_HANDLER_BENCHMARK(MULSU, MULSU | (1 << 4) | 2);
+		KOM_HANDLER_BENCHMARK(NEG, NEG | Rd(16));
+		KOM_HANDLER_BENCHMARK(OR, OR | Rd(16) | Rr(17));
+		KOM_HANDLER_BENCHMARK(ORI, ORI | Rd(1) | K8(0x5A));
+		KOM_HANDLER_BENCHMARK(OUT, OUT | Rd(1) | 5);             // out PORTB, r1
+		KOM_HANDLER_BENCHMARK(POP, POP | Rd(16));
+		KOM_HANDLER_BENCHMARK(PUSH, PUSH | Rd(16));
+		KOM_HANDLER_BENCHMARK(RCALL, RCALL | 1);
+		KOM_HANDLER_BENCHMARK(RET, RET);
+		KOM_HANDLER_BENCHMARK(RETI, RETI);
+		KOM_HANDLER_BENCHMARK(RJMP, RJMP | 1);
+		KOM_HANDLER_BENCHMARK(ROR, ROR | Rd(16));
+		KOM_HANDLER_BENCHMARK(SBC, SBC | Rd(16) | Rr(17));
+		KOM_HANDLER_BENCHMARK(SBCI, SBCI | Rd(1) | K8(0x5A));
+		KOM_HANDLER_BENCHMARK(SBI, SBI | (5 << 3) | 1);          // sbi PORTB, 1
+		KOM_HANDLER_BENCHMARK(SBIC, SBIC | (5 << 3) | 1);        // sbic PORTB, 1
+		KOM_HANDLER_BENCHMARK(SBIS, SBIS | (5 << 3) | 1);
+		KOM_HANDLER_BENCHMARK(SBIW, SBIW | (1 << 4) | 1);        // sbiw r26, 1
+		KOM_HANDLER_BENCHMARK(SBRC, SBRC | Rd(16) | 3);
+		KOM_HANDLER_BENCHMARK(SBRS, SBRS | Rd(16) | 3);
+		KOM_HANDLER_BENCHMARK(ST, ST_X | Rd(16));
+		KOM_HANDLER_BENCHMARK(STD, STD_Y | Rd(16) | 1);          // std Y+1, r16
+		KOM_HANDLER_BENCHMARK(STS, STS | Rd(16));
+		KOM_HANDLER_BENCHMARK(SUB, SUB | Rd(16) | Rr(17));
+		KOM_HANDLER_BENCHMARK(SUBI, SUBI | Rd(1) | K8(0x5A));
+		KOM_HANDLER_BENCHMARK(SWAP, SWAP | Rd(16));
+		return true;
+	}
+
+	#undef KOM_HANDLER_BENCHMARK
+
+	[[maybe_unused]] const bool s_HandlerBenchmarks = RegisterHandlerBenchmarks();
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include "ATMega328Emulator/HostCounters.h"
+
+namespace ATMega328Emulator {
+
+	// Adds the host's hardware counters, per emulated instruction, to a benchmark's counters.
+	// Hosts without perf events, or VMs without a PMU, just don't get them.
+	inline void ReportHostCounters(benchmark::State& state, const HostCounters::Reading& reading)
+	{
+		if (reading.GetIPC() > 0.0) {
+			state.counters["HostIPC"] = reading.GetIPC();
+		}
+
+		const std::pair<HostEvent, const char*> counters[] = {
+			{ HostEvent::Cycles, "HostCyclesPerInsn" },
+			{ HostEvent::BranchMisses, "BranchMissesPerInsn" },
+			{ HostEvent::L1DReadMisses, "L1DMissesPerInsn" },
+			{ HostEvent::LLCMisses, "LLCMissesPerInsn" },
+		};
+		for (const auto& [event, name] : counters) {
+			if (reading.IsAvailable(event)) {
+				state.counters[name] = reading.PerInstruction(event);
+			}
+		}
+	}
+
+}
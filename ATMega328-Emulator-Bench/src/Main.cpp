@@ -0,0 +1,52 @@
+#include <cstring>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "ATMega328Emulator/HostCounters.h"
+
+#ifdef KOM_DEBUG
+	#define KOM_CONFIGURATION "Debug"
+#elif defined(KOM_RELEASE)
+	#define KOM_CONFIGURATION "Release"
+#else
+	#define KOM_CONFIGURATION "Dist"
+#endif
+
+// Measures the interpreter: decoding, every instruction handler and whole programs, see the other files here.
+// Debug builds check every access, compare Release or Dist numbers.
+// Results go to the console and, unless --benchmark_out is given, to ATMega328-Emulator-Bench.json
+// for comparing against earlier runs with the library's tools/compare.py.
+int main(int argc, char** argv)
+{
+	std::vector<char*> args(argv, argv + argc);
+
+	bool hasOut = false;
+	for (char* arg : args) {
+		hasOut |= std::strncmp(arg, "--benchmark_out=", 16) == 0;
+	}
+
+	char out[] = "--benchmark_out=ATMega328-Emulator-Bench.json";
+	char format[] = "--benchmark_out_format=json";
+	if (!hasOut) {
+		args.push_back(out);
+		args.push_back(format);
+	}
+
+	int count = (int)args.size();
+	benchmark::Initialize(&count, args.data());
+	if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+		return 1;
+	}
+
+	benchmark::AddCustomContext("configuration", KOM_CONFIGURATION);
+
+	// The mix and workload benchmarks add host IPC and misses per emulated instruction when there are counters
+	ATMega328Emulator::HostCounters hostCounters;
+	benchmark::AddCustomContext("host_counters", hostCounters.Open() ? "perf_event" : "unavailable");
+	hostCounters.Close();
+
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
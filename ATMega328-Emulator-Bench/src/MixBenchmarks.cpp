@@ -0,0 +1,134 @@
+#include <array>
+
+#include <benchmark/benchmark.h>
+
+#include "ATMega328Emulator/Assembler.h"
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Memory.h"
+
+#include "HostCounterReport.h"
+
+using namespace ATMega328Emulator;
+using namespace ATMega328Emulator::asm_;
+
+namespace {
+
+	// Cycles a benchmark iteration runs for, long enough that Run's setup doesn't count
+	constexpr uint64_t CYCLES_PER_ITERATION = 100'000;
+
+	// Runs a looping program from address 0 and reports the emulated clock rate and instructions per second.
+	template<size_t N>
+	void RunMix(benchmark::State& state, const std::array<Word, N>& program)
+	{
+		Memory memory;
+		CPU cpu;
+		cpu.Reset(memory);
+		for (Byte* r = &cpu.R00; r <= &cpu.R31; ++r) {
+			*r = (Byte)(r - &cpu.R00) * 7 + 1;
+		}
+		cpu.Z = 0x200;
+
+		asm_::Load(program, memory);
+
+		HostCounters hostCounters;
+		hostCounters.Open();
+
+		uint64_t cycles = 0;
+		uint64_t instructions = 0;
+		hostCounters.Start();
+		for (auto _ : state) {
+			RunResult result = cpu.Run(CYCLES_PER_ITERATION, StopConditions(), memory);
+			cycles += result.Cycles;
+			instructions += result.Instructions;
+		}
+		hostCounters.Stop(instructions, cycles);
+
+		state.SetItemsProcessed(instructions);
+		state.counters["EmulatedHz"] = benchmark::Counter((double)cycles, benchmark::Counter::kIsRate);
+		state.counters["CPI"] = instructions ? (double)cycles / instructions : 0.0;
+		ReportHostCounters(state, hostCounters.GetReading());
+	}
+
+	// Single cycle arithmetic and logic, no branches but the loop
+	void BM_MixALU(benchmark::State& state)
+	{
+		constexpr auto program = Assemble(
+			label("loop"),
+			add(r16, r17),
+			adc(r18, r19),
+			sub(r20, r16),
+			eor(r21, r18),
+			and_(r22, r20),
+			or_(r23, r21),
+			inc(r24),
+			dec(r25),
+			lsr(r26),
+			com(r27),
+			subi(r28, 3),
+			andi(r29, 0x7F),
+			mov(r2, r16),
+			rjmp("loop"));
+		RunMix(state, program);
+	}
+
+	// Taken and not taken branches and skips, about every third instruction
+	void BM_MixBranchy(benchmark::State& state)
+	{
+		constexpr auto program = Assemble(
+			label("loop"),
+			inc(r16),
+			mov(r17, r16),
+			andi(r17, 1),
+			brne("odd"),
+			inc(r18),
+			label("odd"),
+			cpse(r16, r19),
+			dec(r20),
+			cpi(r16, 0xC0),
+			brcs("loop"),
+			rjmp("loop"));
+		RunMix(state, program);
+	}
+
+	// Stack, data space and I/O accesses
+	void BM_MixMemory(benchmark::State& state)
+	{
+		constexpr auto program = Assemble(
+			label("loop"),
+			push(r16),
+			push(r17),
+			pop(r18),
+			pop(r19),
+			lds(r20, 0x0110),
+			out(5, r1),       // PORTB
+			sbi(5, 1),
+			cbi(5, 1),
+			lac(r21),
+			inc(r16),
+			rjmp("loop"));
+		RunMix(state, program);
+	}
+
+	// Every multiply, with the product fed back in
+	void BM_MixMultiply(benchmark::State& state)
+	{
+		constexpr auto program = Assemble(
+			label("loop"),
+			mul(r16, r17),
+			muls(r18, r19),
+			mulsu(r20, r21),
+			fmul(r22, r23),
+			fmuls(r16, r17),
+			fmulsu(r18, r19),
+			add(r16, r0),
+			inc(r17),
+			rjmp("loop"));
+		RunMix(state, program);
+	}
+
+}
+
+BENCHMARK(BM_MixALU);
+BENCHMARK(BM_MixBranchy);
+BENCHMARK(BM_MixMemory);
+BENCHMARK(BM_MixMultiply);
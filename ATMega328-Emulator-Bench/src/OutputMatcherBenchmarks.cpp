@@ -0,0 +1,48 @@
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "ATMega328Emulator/OutputMatcher.h"
+
+using namespace ATMega328Emulator;
+
+namespace {
+
+	// Test log lines that never match, so every byte goes through every pattern
+	std::string MakeLog(size_t size)
+	{
+		const std::string line = "test 17: checksum 0x3F2A ok, 1024 bytes in 2113 cycles\n";
+		std::string log;
+		while (log.size() < size) {
+			log += line;
+		}
+		log.resize(size);
+		return log;
+	}
+
+	// Literals only with range(0) 0, literals and two regexes with 1
+	void BM_OutputMatcherFeed(benchmark::State& state)
+	{
+		OutputMatcher matcher;
+		matcher.AddLiteral("PASS");
+		matcher.AddLiteral("FAIL");
+		matcher.AddLiteral("panic", false);
+		if (state.range(0)) {
+			matcher.AddRegex("ERROR \\d+");
+			matcher.AddRegex("assert.*line \\d+");
+		}
+
+		const std::string log = MakeLog(64 * 1024);
+		for (auto _ : state) {
+			for (char c : log) {
+				benchmark::DoNotOptimize(matcher.Feed((Byte)c, 0));
+			}
+		}
+
+		state.SetBytesProcessed((int64_t)(state.iterations() * log.size()));
+		state.counters["NsPerByte"] = benchmark::Counter((double)state.iterations() * log.size(), benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+	}
+
+}
+
+BENCHMARK(BM_OutputMatcherFeed)->Arg(0)->Arg(1);
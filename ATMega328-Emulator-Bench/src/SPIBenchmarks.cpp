@@ -0,0 +1,100 @@
+#include <chrono>
+
+#include <benchmark/benchmark.h>
+
+#include "ATMega328Emulator/Assembler.h"
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Memory.h"
+#include "ATMega328Emulator/Scheduler.h"
+#include "ATMega328Emulator/SPI.h"
+
+using namespace ATMega328Emulator;
+using namespace ATMega328Emulator::asm_;
+
+namespace {
+
+	constexpr uint64_t CYCLES_PER_ITERATION = 1'000'000;
+
+	constexpr int SPCR = SPI::SPCR_ADDRESS - CPU::IO_START;
+	constexpr int SPSR = SPI::SPSR_ADDRESS - CPU::IO_START;
+	constexpr int SPDR = SPI::SPDR_ADDRESS - CPU::IO_START;
+	constexpr int DDRB = SPI::PORTB_ADDRESS - 1 - CPU::IO_START;
+	constexpr int PORTB = SPI::PORTB_ADDRESS - CPU::IO_START;
+
+	// Pushes a 1KB frame buffer from the SRAM to a display on PB2 over and over, at a quarter of the clock
+	constexpr auto DISPLAY = Assemble(
+		ldi(r16, SPI::SPE | SPI::MSTR),
+		out(SPCR, r16),
+		sbi(DDRB, 2),
+		label("frame"),
+		cbi(PORTB, 2),
+		ldi(r26, CPU::SRAM_START & 0xFF),
+		ldi(r27, CPU::SRAM_START >> 8),
+		ldi(r24, 0),
+		ldi(r25, 4),
+		label("next"),
+		ld(r18, X_INC),
+		out(SPDR, r18),
+		label("wait"),
+		in(r17, SPSR),
+		sbrs(r17, 7),
+		rjmp("wait"),
+		sbiw(r24, 1),
+		brne("next"),
+		sbi(PORTB, 2),
+		rjmp("frame"));
+
+	// Only adds up what it is sent, so the cost is the SPI's
+	class Display : public SPIDevice
+	{
+	public:
+		void Transfer(std::span<const Byte> mosi, std::span<Byte>) override
+		{
+			for (Byte value : mosi) {
+				Sum += value;
+			}
+		}
+
+	public:
+		uint64_t Sum = 0;
+	};
+
+	// range(0) 1 skips the polling loops, 0 hides them by giving the SPI an empty flash to look at
+	void BM_SPIBlockWrite(benchmark::State& state)
+	{
+		Memory memory;
+		CPU cpu;
+		cpu.Reset(memory);
+		asm_::Load(DISPLAY, memory);
+
+		Memory blank;
+		blank.Initialize();
+
+		RegisterHooks hooks;
+		Display display;
+		SPI spi;
+		Scheduler scheduler;
+		cpu.AttachedRegisterHooks = &hooks;
+		spi.AddDevice(&display, SPI::PORTB_ADDRESS, 2);
+		spi.Attach(hooks, state.range(0) ? memory : blank);
+		scheduler.Add(&spi);
+		spi.Reset(cpu);
+
+		const uint64_t startCycle = cpu.CycleCount;
+		const auto start = std::chrono::steady_clock::now();
+		for (auto _ : state) {
+			scheduler.Execute(cpu, memory, CYCLES_PER_ITERATION);
+		}
+		const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		benchmark::DoNotOptimize(display.Sum);
+
+		const uint64_t cycles = cpu.CycleCount - startCycle;
+		const uint64_t bytes = spi.GetStats().Bytes;
+		state.counters["EmulatedMHz"] = ns > 0 ? cycles * 1e3 / ns : 0.0;
+		state.counters["NsPerByte"] = bytes ? ns / bytes : 0.0;
+		state.counters["TransfersPerFrame"] = bytes ? spi.GetStats().Transfers * 1024.0 / bytes : 0.0;
+	}
+
+}
+
+BENCHMARK(BM_SPIBlockWrite)->Arg(0)->Arg(1);
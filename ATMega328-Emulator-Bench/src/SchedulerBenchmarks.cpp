@@ -0,0 +1,74 @@
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/HexFile.h"
+#include "ATMega328Emulator/Memory.h"
+#include "ATMega328Emulator/Scheduler.h"
+
+using namespace ATMega328Emulator;
+
+namespace {
+
+	constexpr uint64_t CYCLES_PER_ITERATION = 1'000'000;
+
+	// A peripheral with an event every PERIOD cycles, like a timer at a prescaler of 64
+	class TickSource : public EventSource
+	{
+	public:
+		static constexpr uint64_t PERIOD = 64;
+
+	public:
+		uint64_t GetNextEventCycle() const override { return m_Next; }
+
+		void HandleEvents(CPU& cpu, Memory&) override
+		{
+			while (m_Next <= cpu.CycleCount) {
+				++cpu.IO.GPIOR2;
+				m_Next += PERIOD;
+			}
+		}
+
+		std::vector<RegisterRange> GetRegisters() const override
+		{
+			return { { (Word)(CPU::IO_START + 0x2B), 1 } }; // GPIOR2, the workload doesn't touch it
+		}
+
+	private:
+		uint64_t m_Next = PERIOD;
+	};
+
+	// A workload run through the scheduler with a dense event source, exact or with range(0) as the quantum
+	void BM_SchedulerQuantum(benchmark::State& state)
+	{
+		Memory memory;
+		CPU cpu;
+		cpu.Reset(memory);
+		if (!HexFile::Load(std::string(KOM_WORKLOADS_DIR) + "coremark.hex", memory)) {
+			state.SkipWithError("Couldn't load coremark.hex");
+			return;
+		}
+
+		TickSource source;
+		Scheduler scheduler;
+		scheduler.Add(&source);
+		scheduler.SetQuantum((uint64_t)state.range(0));
+
+		const uint64_t startCycle = cpu.CycleCount;
+		const auto start = std::chrono::steady_clock::now();
+		for (auto _ : state) {
+			scheduler.Execute(cpu, memory, CYCLES_PER_ITERATION);
+		}
+		const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+		const uint64_t cycles = cpu.CycleCount - startCycle;
+		state.counters["EmulatedMHz"] = ns > 0 ? cycles * 1e3 / ns : 0.0;
+		state.counters["HostNsPerCycle"] = cycles ? ns / cycles : 0.0;
+	}
+
+}
+
+BENCHMARK(BM_SchedulerQuantum)->Arg(0)->Arg(100)->Arg(1'000)->Arg(10'000);
@@ -0,0 +1,75 @@
+#include <chrono>
+
+#include <benchmark/benchmark.h>
+
+#include "ATMega328Emulator/Assembler.h"
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Memory.h"
+#include "ATMega328Emulator/Scheduler.h"
+#include "ATMega328Emulator/USART.h"
+
+using namespace ATMega328Emulator;
+using namespace ATMega328Emulator::asm_;
+
+namespace {
+
+	constexpr uint64_t CYCLES_PER_ITERATION = 1'000'000;
+
+	// Logs as fast as the line takes it, 1.25Mbaud with UBRR0 0, with some work between bytes
+	constexpr auto LOGGER = Assemble(
+		ldi(r16, 0),
+		sts(USART::UBRR0_ADDRESS, r16),
+		ldi(r16, USART::TXEN0),
+		sts(USART::UCSR0B_ADDRESS, r16),
+		label("work"),
+		ldi(r20, 20),
+		label("spin"),
+		add(r21, r20),
+		dec(r20),
+		brne("spin"),
+		label("wait"),
+		lds(r17, USART::UCSR0A_ADDRESS),
+		sbrs(r17, 5),
+		rjmp("wait"),
+		sts(USART::UDR0_ADDRESS, r21),
+		rjmp("work"));
+
+	// The logger with the USART attached, range(0) 1, or without, 0, where UDR0 is a plain register
+	void BM_USARTLogging(benchmark::State& state)
+	{
+		Memory memory;
+		CPU cpu;
+		cpu.Reset(memory);
+		asm_::Load(LOGGER, memory);
+
+		RegisterHooks hooks;
+		USART usart;
+		Scheduler scheduler;
+		usart.Reset(cpu);
+		if (state.range(0)) {
+			cpu.AttachedRegisterHooks = &hooks;
+			usart.Attach(hooks);
+			scheduler.Add(&usart);
+		}
+
+		// The host drains in bulk, once per iteration
+		Byte sink[64 * 1024];
+		uint64_t drained = 0;
+
+		const uint64_t startCycle = cpu.CycleCount;
+		const auto start = std::chrono::steady_clock::now();
+		for (auto _ : state) {
+			scheduler.Execute(cpu, memory, CYCLES_PER_ITERATION);
+			drained += usart.GetTransmitted().Read(sink, sizeof(sink));
+		}
+		const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+		const uint64_t cycles = cpu.CycleCount - startCycle;
+		state.counters["EmulatedMHz"] = ns > 0 ? cycles * 1e3 / ns : 0.0;
+		state.counters["BytesPerEmulatedSecond"] = cycles ? drained * (double)CPU::FREQUENCY / cycles : 0.0;
+		state.counters["Dropped"] = (double)usart.GetStats().Dropped;
+	}
+
+}
+
+BENCHMARK(BM_USARTLogging)->Arg(0)->Arg(1);
@@ -0,0 +1,90 @@
+#include <chrono>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "ATMega328Emulator/Config.h"
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/HexFile.h"
+#include "ATMega328Emulator/InstructionMix.h"
+#include "ATMega328Emulator/Memory.h"
+
+#include "HostCounterReport.h"
+
+using namespace ATMega328Emulator;
+
+namespace {
+
+	// Several passes through every workload, see workloads/README.md
+	constexpr uint64_t CYCLES_PER_ITERATION = 1'000'000;
+
+	// The loops Run picks between
+	enum class Backend
+	{
+		Run,      // No PC to stop at, nothing attached
+		StopOnPC, // Compares the PC after every instruction, it never matches here
+		Profiled, // An InstructionMix attached, counting every instruction
+	};
+
+	// Runs a firmware image from workloads/ and reports the emulated MIPS and host time per emulated cycle.
+	// Without StopOnBreak the BREAK at the end of every pass is a NOP and the workload loops forever.
+	void BM_Workload(benchmark::State& state, const std::string& name, Backend backend)
+	{
+		Memory memory;
+		CPU cpu;
+		cpu.Reset(memory);
+		if (!HexFile::Load(KOM_WORKLOADS_DIR + name + ".hex", memory)) {
+			state.SkipWithError(("Couldn't load " + name + ".hex").c_str());
+			return;
+		}
+
+		StopConditions conditions;
+		if (backend == Backend::StopOnPC) {
+			conditions.StopOnPC = true;
+			conditions.PC = CPU::PROGRAM_MEMORY_SIZE / 2 - 1;
+		}
+
+		InstructionMix mix;
+		if (backend == Backend::Profiled) {
+			cpu.AttachedInstructionMix = &mix;
+		}
+
+		HostCounters hostCounters;
+		hostCounters.Open();
+
+		uint64_t cycles = 0;
+		uint64_t instructions = 0;
+		const auto start = std::chrono::steady_clock::now();
+		hostCounters.Start();
+		for (auto _ : state) {
+			RunResult result = cpu.Run(CYCLES_PER_ITERATION, conditions, memory);
+			cycles += result.Cycles;
+			instructions += result.Instructions;
+		}
+		hostCounters.Stop(instructions, cycles);
+		// Plain numbers rather than rate counters, which would print them with a unit of /s
+		const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+		state.SetItemsProcessed(instructions);
+		state.counters["MIPS"] = ns > 0 ? instructions * 1e3 / ns : 0.0;
+		state.counters["HostNsPerCycle"] = cycles ? ns / cycles : 0.0;
+		ReportHostCounters(state, hostCounters.GetReading());
+	}
+
+	bool RegisterWorkloadBenchmarks()
+	{
+		for (const char* name : { "crc16", "crc32", "aes128", "fir", "softuart", "dispatch", "coremark" }) {
+			const std::string workload = name;
+			benchmark::RegisterBenchmark(("BM_Workload_" + workload + "/Run").c_str(), BM_Workload, workload, Backend::Run);
+			benchmark::RegisterBenchmark(("BM_Workload_" + workload + "/StopOnPC").c_str(), BM_Workload, workload, Backend::StopOnPC);
+#ifdef ATMEGA328_PROFILING
+			// Dist builds ignore the InstructionMix and never take the profiled loop
+			benchmark::RegisterBenchmark(("BM_Workload_" + workload + "/Profiled").c_str(), BM_Workload, workload, Backend::Profiled);
+#endif
+		}
+		return true;
+	}
+
+	[[maybe_unused]] const bool s_WorkloadBenchmarks = RegisterWorkloadBenchmarks();
+
+}
@@ -0,0 +1,460 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+
+#include "ATMega328Emulator/Instructions.h"
+#include "ATMega328Emulator/Memory.h"
+
+namespace ATMega328Emulator {
+
+	// A constexpr assembler for test and benchmark programs, instead of ORing opcodes together by hand.
+	//
+	//     using namespace asm_;
+	//     constexpr auto program = Assemble(
+	//         ldi(r16, 10),
+	//         label("loop"),
+	//         dec(r16),
+	//         brne("loop"),
+	//         break_());
+	//     asm_::Load(program, memory);
+	//
+	// Assemble returns a std::array<Word, N>. In a constant expression a bad operand, an out of range branch
+	// or an unknown label throws, which doesn't compile, so mistakes show up at compile time.
+	// Branches and jumps take a label or a number: the offset in words from the next instruction for the
+	// relative ones, a word address for JMP and CALL. Labels are word addresses from the start of the
+	// program, so JMP and CALL to a label expect it to be loaded at address 0.
+	// Mnemonics that are C++ keywords or clash with std get a trailing underscore: and_, or_, break_, std_.
+	namespace asm_ {
+
+		enum Register : Byte { r0, r1, r2, r3, r4, r5, r6, r7, r8, r9, r10, r11, r12, r13, r14, r15, r16, r17, r18, r19, r20, r21, r22, r23, r24, r25, r26, r27, r28, r29, r30, r31 };
+
+		// LD and ST addressing, X+ is X_INC and -X is X_DEC. LDD, STD and LPM take Y, Z or Z_INC.
+		enum Pointer : Byte { X, X_INC, X_DEC, Y, Y_INC, Y_DEC, Z, Z_INC, Z_DEC };
+
+		enum class Fixup : Byte
+		{
+			None,
+			Branch,   // 7-bit offset, BRBS and BRBC
+			Relative, // 12-bit offset, RJMP and RCALL
+			Absolute, // 22-bit word address, JMP and CALL
+		};
+
+		// An instruction Size words long, or a label when Size is 0
+		template<size_t Size>
+		struct Op
+		{
+			static constexpr size_t SIZE = Size;
+
+			Word Words[2] = {};
+			Fixup Kind = Fixup::None;
+			std::string_view Label = {}; // The label a fixup refers to, or the one a label defines
+		};
+
+		// Where a branch or jump goes, a label or a number
+		struct Target
+		{
+			constexpr Target(const char* label) : Label(label) {}
+			constexpr Target(std::string_view label) : Label(label) {}
+			constexpr Target(int value) : Value(value) {}
+
+			std::string_view Label;
+			int Value = 0;
+		};
+
+		namespace Encoding {
+
+			constexpr void Check(bool valid, const char* message)
+			{
+				if (!valid) {
+					throw std::invalid_argument(message);
+				}
+			}
+
+			constexpr Word Rd(int d) { return (Word)(d << 4); }
+			constexpr Word Rr(int r) { return (Word)((r & 0xF) | ((r & 0x10) << 5)); }
+
+			// 0001'11rd'dddd'rrrr
+			constexpr Op<1> TwoRegisters(Word opcode, Register d, Register r)
+			{
+				return { { (Word)(opcode | Rd(d) | Rr(r)) } };
+			}
+
+			// 1001'010d'dddd'xxxx
+			constexpr Op<1> OneRegister(Word opcode, Register d)
+			{
+				return { { (Word)(opcode | Rd(d)) } };
+			}
+
+			// xxxx'KKKK'dddd'KKKK, r16 to r31, K can be negative
+			constexpr Op<1> Immediate(Word opcode, Register d, int K)
+			{
+				Check(d >= r16, "Immediate instructions only take r16 to r31");
+				Check(K >= -128 && K <= 255, "Immediate doesn't fit in 8 bits");
+				return { { (Word)(opcode | Rd(d - 16) | (K & 0xF) | ((K & 0xF0) << 4)) } };
+			}
+
+			// xxxx'xxxx'KKdd'KKKK, r24, r26, r28 or r30
+			constexpr Op<1> WordImmediate(Word opcode, Register d, int K)
+			{
+				Check(d >= r24 && d % 2 == 0, "ADIW and SBIW only take r24, r26, r28 and r30");
+				Check(K >= 0 && K <= 63, "ADIW and SBIW take 0 to 63");
+				return { { (Word)(opcode | ((d - 24) / 2 << 4) | (K & 0xF) | ((K & 0x30) << 2)) } };
+			}
+
+			// xxxx'xxxd'dddd'xbbb
+			constexpr Op<1> RegisterBit(Word opcode, Register d, int b)
+			{
+				Check(b >= 0 && b <= 7, "Bit has to be 0 to 7");
+				return { { (Word)(opcode | Rd(d) | b) } };
+			}
+
+			// xxxx'xxxx'AAAA'Abbb
+			constexpr Op<1> IOBit(Word opcode, int A, int b)
+			{
+				Check(A >= 0 && A <= 31, "Bit instructions only reach I/O addresses 0 to 31");
+				Check(b >= 0 && b <= 7, "Bit has to be 0 to 7");
+				return { { (Word)(opcode | (A << 3) | b) } };
+			}
+
+			// xxxx'xxxx'xsss'xxxx
+			constexpr Op<1> StatusBit(Word opcode, int s)
+			{
+				Check(s >= 0 && s <= 7, "SREG bit has to be 0 to 7");
+				return { { (Word)(opcode | (s << 4)) } };
+			}
+
+			// 0000'0011'xddd'xrrr, r16 to r23
+			constexpr Op<1> Fractional(Word opcode, Register d, Register r)
+			{
+				Check(d >= r16 && d <= r23 && r >= r16 && r <= r23, "Only r16 to r23");
+				return { { (Word)(opcode | ((d - 16) << 4) | (r - 16)) } };
+			}
+
+			constexpr Op<1> Branch(Word opcode, int s, Target k)
+			{
+				Check(s >= 0 && s <= 7, "SREG bit has to be 0 to 7");
+				if (!k.Label.empty()) {
+					return { { (Word)(opcode | s) }, Fixup::Branch, k.Label };
+				}
+				Check(k.Value >= -64 && k.Value <= 63, "Branch offset out of range");
+				return { { (Word)(opcode | ((k.Value & 0x7F) << 3) | s) } };
+			}
+
+			constexpr Op<1> Relative(Word opcode, Target k)
+			{
+				if (!k.Label.empty()) {
+					return { { opcode }, Fixup::Relative, k.Label };
+				}
+				Check(k.Value >= -2048 && k.Value <= 2047, "Relative jump out of range");
+				return { { (Word)(opcode | (k.Value & 0xFFF)) } };
+			}
+
+			constexpr void SetAbsolute(Word* encoding, int k)
+			{
+				Check(k >= 0 && k <= 0x3FFFFF, "Jump address out of range");
+				encoding[0] |= ((k >> 16) & 1) | (((k >> 17) & 0x1F) << 4);
+				encoding[1] = (Word)(k & 0xFFFF);
+			}
+
+			constexpr Op<2> Absolute(Word opcode, Target k)
+			{
+				Op<2> op = { { opcode, 0 } };
+				if (!k.Label.empty()) {
+					op.Kind = Fixup::Absolute;
+					op.Label = k.Label;
+				}
+				else {
+					SetAbsolute(op.Words, k.Value);
+				}
+				return op;
+			}
+
+			// Y and Z with a displacement of 0 to 63
+			constexpr Op<1> Displaced(Word opcodeY, Word opcodeZ, Register d, Pointer p, int q)
+			{
+				Check(p == Y || p == Z, "Displacements only work with Y and Z");
+				Check(q >= 0 && q <= 63, "Displacement has to be 0 to 63");
+				return { { (Word)((p == Y ? opcodeY : opcodeZ) | Rd(d) | (q & 0x7) | ((q & 0x18) << 7) | ((q & 0x20) << 8)) } };
+			}
+
+		}
+
+		// Labels
+
+		constexpr Op<0> label(std::string_view name) { return { {}, Fixup::None, name }; }
+
+		// A data word, for tables or opcodes the assembler doesn't know
+		constexpr Op<1> word(Word value) { return { { value } }; }
+
+		// Arithmetic and logic
+
+		constexpr Op<1> adc(Register d, Register r) { return Encoding::TwoRegisters(Instruction::ADC, d, r); }
+		constexpr Op<1> add(Register d, Register r) { return Encoding::TwoRegisters(Instruction::ADD, d, r); }
+		constexpr Op<1> and_(Register d, Register r) { return Encoding::TwoRegisters(Instruction::AND, d, r); }
+		constexpr Op<1> cp(Register d, Register r) { return Encoding::TwoRegisters(Instruction::CP, d, r); }
+		constexpr Op<1> cpc(Register d, Register r) { return Encoding::TwoRegisters(Instruction::CPC, d, r); }
+		constexpr Op<1> eor(Register d, Register r) { return Encoding::TwoRegisters(Instruction::EOR, d, r); }
+		constexpr Op<1> mov(Register d, Register r) { return Encoding::TwoRegisters(Instruction::MOV, d, r); }
+		constexpr Op<1> mul(Register d, Register r) { return Encoding::TwoRegisters(Instruction::MUL, d, r); }
+		constexpr Op<1> or_(Register d, Register r) { return Encoding::TwoRegisters(Instruction::OR, d, r); }
+		constexpr Op<1> sbc(Register d, Register r) { return Encoding::TwoRegisters(Instruction::SBC, d, r); }
+		constexpr Op<1> sub(Register d, Register r) { return Encoding::TwoRegisters(Instruction::SUB, d, r); }
+
+		constexpr Op<1> clr(Register d) { return eor(d, d); }
+		constexpr Op<1> lsl(Register d) { return add(d, d); }
+		constexpr Op<1> rol(Register d) { return adc(d, d); }
+		constexpr Op<1> tst(Register d) { return and_(d, d); }
+
+		constexpr Op<1> andi(Register d, int K) { return Encoding::Immediate(Instruction::ANDI, d, K); }
+		constexpr Op<1> cpi(Register d, int K) { return Encoding::Immediate(Instruction::CPI, d, K); }
+		constexpr Op<1> ldi(Register d, int K) { return Encoding::Immediate(Instruction::LDI, d, K); }
+		constexpr Op<1> ori(Register d, int K) { return Encoding::Immediate(Instruction::ORI, d, K); }
+		constexpr Op<1> sbci(Register d, int K) { return Encoding::Immediate(Instruction::SBCI, d, K); }
+		constexpr Op<1> subi(Register d, int K) { return Encoding::Immediate(Instruction::SUBI, d, K); }
+
+		constexpr Op<1> cbr(Register d, int K) { return andi(d, ~K & 0xFF); }
+		constexpr Op<1> sbr(Register d, int K) { return ori(d, K); }
+		constexpr Op<1> ser(Register d) { return ldi(d, 0xFF); }
+
+		constexpr Op<1> asr(Register d) { return Encoding::OneRegister(Instruction::ASR, d); }
+		constexpr Op<1> com(Register d) { return Encoding::OneRegister(Instruction::COM, d); }
+		constexpr Op<1> dec(Register d) { return Encoding::OneRegister(Instruction::DEC, d); }
+		constexpr Op<1> inc(Register d) { return Encoding::OneRegister(Instruction::INC, d); }
+		constexpr Op<1> lsr(Register d) { return Encoding::OneRegister(Instruction::LSR, d); }
+		constexpr Op<1> neg(Register d) { return Encoding::OneRegister(Instruction::NEG, d); }
+		constexpr Op<1> ror(Register d) { return Encoding::OneRegister(Instruction::ROR, d); }
+		constexpr Op<1> swap(Register d) { return Encoding::OneRegister(Instruction::SWAP, d); }
+
+		constexpr Op<1> adiw(Register d, int K) { return Encoding::WordImmediate(Instruction::ADIW, d, K); }
+		constexpr Op<1> sbiw(Register d, int K) { return Encoding::WordImmediate(Instruction::SBIW, d, K); }
+
+		constexpr Op<1> movw(Register d, Register r)
+		{
+			Encoding::Check(d % 2 == 0 && r % 2 == 0, "MOVW only takes even registers");
+			return { { (Word)(Instruction::MOVW | (d / 2 << 4) | (r / 2)) } };
+		}
+
+		constexpr Op<1> muls(Register d, Register r)
+		{
+			Encoding::Check(d >= r16 && r >= r16, "MULS only takes r16 to r31");
+			return { { (Word)(Instruction::MULS | ((d - 16) << 4) | (r - 16)) } };
+		}
+
+		constexpr Op<1> mulsu(Register d, Register r) { return Encoding::Fractional(Instruction::MULSU, d, r); }
+		constexpr Op<1> fmul(Register d, Register r) { return Encoding::Fractional(Instruction::FMUL, d, r); }
+		constexpr Op<1> fmuls(Register d, Register r) { return Encoding::Fractional(Instruction::FMULS, d, r); }
+		constexpr Op<1> fmulsu(Register d, Register r) { return Encoding::Fractional(Instruction::FMULSU, d, r); }
+
+		// Bits and flags
+
+		constexpr Op<1> bld(Register d, int b) { return Encoding::RegisterBit(Instruction::BLD, d, b); }
+		constexpr Op<1> bst(Register d, int b) { return Encoding::RegisterBit(Instruction::BST, d, b); }
+		constexpr Op<1> sbrc(Register r, int b) { return Encoding::RegisterBit(Instruction::SBRC, r, b); }
+		constexpr Op<1> sbrs(Register r, int b) { return Encoding::RegisterBit(Instruction::SBRS, r, b); }
+
+		constexpr Op<1> cbi(int A, int b) { return Encoding::IOBit(Instruction::CBI, A, b); }
+		constexpr Op<1> sbi(int A, int b) { return Encoding::IOBit(Instruction::SBI, A, b); }
+		constexpr Op<1> sbic(int A, int b) { return Encoding::IOBit(Instruction::SBIC, A, b); }
+		constexpr Op<1> sbis(int A, int b) { return Encoding::IOBit(Instruction::SBIS, A, b); }
+
+		constexpr Op<1> bclr(int s) { return Encoding::StatusBit(Instruction::BCLR, s); }
+		constexpr Op<1> bset(int s) { return Encoding::StatusBit(Instruction::BSET, s); }
+		constexpr Op<1> sec() { return bset(0); }
+		constexpr Op<1> clc() { return bclr(0); }
+		constexpr Op<1> sez() { return bset(1); }
+		constexpr Op<1> clz() { return bclr(1); }
+		constexpr Op<1> sen() { return bset(2); }
+		constexpr Op<1> cln() { return bclr(2); }
+		constexpr Op<1> sev() { return bset(3); }
+		constexpr Op<1> clv() { return bclr(3); }
+		constexpr Op<1> ses() { return bset(4); }
+		constexpr Op<1> cls() { return bclr(4); }
+		constexpr Op<1> seh() { return bset(5); }
+		constexpr Op<1> clh() { return bclr(5); }
+		constexpr Op<1> set() { return bset(6); }
+		constexpr Op<1> clt() { return bclr(6); }
+		constexpr Op<1> sei() { return bset(7); }
+		constexpr Op<1> cli() { return bclr(7); }
+		// Branches and jumps
+
+		constexpr Op<1> brbc(int s, Target k) { return Encoding::Branch(Instruction::BRBC, s, k); }
+		constexpr Op<1> brbs(int s, Target k) { return Encoding::Branch(Instruction::BRBS, s, k); }
+		constexpr Op<1> brcs(Target k) { return brbs(0, k); }
+		constexpr Op<1> brlo(Target k) { return brbs(0, k); }
+		constexpr Op<1> breq(Target k) { return brbs(1, k); }
+		constexpr Op<1> brmi(Target k) { return brbs(2, k); }
+		constexpr Op<1> brvs(Target k) { return brbs(3, k); }
+		constexpr Op<1> brlt(Target k) { return brbs(4, k); }
+		constexpr Op<1> brhs(Target k) { return brbs(5, k); }
+		constexpr Op<1> brts(Target k) { return brbs(6, k); }
+		constexpr Op<1> brie(Target k) { return brbs(7, k); }
+		constexpr Op<1> brcc(Target k) { return brbc(0, k); }
+		constexpr Op<1> brsh(Target k) { return brbc(0, k); }
+		constexpr Op<1> brne(Target k) { return brbc(1, k); }
+		constexpr Op<1> brpl(Target k) { return brbc(2, k); }
+		constexpr Op<1> brvc(Target k) { return brbc(3, k); }
+		constexpr Op<1> brge(Target k) { return brbc(4, k); }
+		constexpr Op<1> brhc(Target k) { return brbc(5, k); }
+		constexpr Op<1> brtc(Target k) { return brbc(6, k); }
+		constexpr Op<1> brid(Target k) { return brbc(7, k); }
+		constexpr Op<1> rjmp(Target k) { return Encoding::Relative(Instruction::RJMP, k); }
+		constexpr Op<1> rcall(Target k) { return Encoding::Relative(Instruction::RCALL, k); }
+		constexpr Op<2> jmp(Target k) { return Encoding::Absolute(Instruction::JMP, k); }
+		constexpr Op<2> call(Target k) { return Encoding::Absolute(Instruction::CALL, k); }
+
+		constexpr Op<1> cpse(Register d, Register r) { return Encoding::TwoRegisters(Instruction::CPSE, d, r); }
+		constexpr Op<1> icall() { return { { Instruction::ICALL } }; }
+		constexpr Op<1> ijmp() { return { { Instruction::IJMP } }; }
+		constexpr Op<1> ret() { return { { Instruction::RET } }; }
+		constexpr Op<1> reti() { return { { Instruction::RETI } }; }
+
+		// Data transfer
+
+		constexpr Op<1> ld(Register d, Pointer p)
+		{
+			constexpr Word OPCODES[] = {
+				Instruction::LD_X, Instruction::LD_X_INC, Instruction::LD_X_DEC,
+				Instruction::LDD_Y, Instruction::LD_Y_INC, Instruction::LD_Y_DEC,
+				Instruction::LDD_Z, Instruction::LD_Z_INC, Instruction::LD_Z_DEC,
+			};
+			return Encoding::OneRegister(OPCODES[p], d);
+		}
+
+		constexpr Op<1> st(Pointer p, Register r)
+		{
+			constexpr Word OPCODES[] = {
+				Instruction::ST_X, Instruction::ST_X_INC, Instruction::ST_X_DEC,
+				Instruction::STD_Y, Instruction::ST_Y_INC, Instruction::ST_Y_DEC,
+				Instruction::STD_Z, Instruction::ST_Z_INC, Instruction::ST_Z_DEC,
+			};
+			return Encoding::OneRegister(OPCODES[p], r);
+		}
+
+		constexpr Op<1> ldd(Register d, Pointer p, int q) { return Encoding::Displaced(Instruction::LDD_Y, Instruction::LDD_Z, d, p, q); }
+		constexpr Op<1> std_(Pointer p, int q, Register r) { return Encoding::Displaced(Instruction::STD_Y, Instruction::STD_Z, r, p, q); }
+
+		constexpr Op<2> lds(Register d, Word k) { return { { (Word)(Instruction::LDS | Encoding::Rd(d)), k } }; }
+		constexpr Op<2> sts(Word k, Register r) { return { { (Word)(Instruction::STS | Encoding::Rd(r)), k } }; }
+
+		constexpr Op<1> in(Register d, int A)
+		{
+			Encoding::Check(A >= 0 && A <= 63, "IN only reaches I/O addresses 0 to 63");
+			return { { (Word)(Instruction::IN | Encoding::Rd(d) | (A & 0xF) | ((A & 0x30) << 5)) } };
+		}
+
+		constexpr Op<1> out(int A, Register r)
+		{
+			Encoding::Check(A >= 0 && A <= 63, "OUT only reaches I/O addresses 0 to 63");
+			return { { (Word)(Instruction::OUT | Encoding::Rd(r) | (A & 0xF) | ((A & 0x30) << 5)) } };
+		}
+
+		constexpr Op<1> push(Register r) { return Encoding::OneRegister(Instruction::PUSH, r); }
+		constexpr Op<1> pop(Register d) { return Encoding::OneRegister(Instruction::POP, d); }
+
+		constexpr Op<1> lpm() { return { { Instruction::LPM } }; }
+		constexpr Op<1> lpm(Register d, Pointer p)
+		{
+			Encoding::Check(p == Z || p == Z_INC, "LPM only takes Z and Z+");
+			return Encoding::OneRegister(p == Z ? Instruction::LPM_Z : Instruction::LPM_Z_INC, d);
+		}
+
+		// Read-modify-write on (Z)
+		constexpr Op<1> lac(Register r) { return Encoding::OneRegister(Instruction::LAC, r); }
+		constexpr Op<1> las(Register r) { return Encoding::OneRegister(Instruction::LAS, r); }
+		constexpr Op<1> lat(Register r) { return Encoding::OneRegister(Instruction::LAT, r); }
+
+		// MCU control
+
+		constexpr Op<1> break_() { return { { Instruction::BREAK } }; }
+		constexpr Op<1> nop() { return { { Instruction::NOP } }; }
+		constexpr Op<1> sleep() { return { { Instruction::SLEEP } }; }
+		constexpr Op<1> wdr() { return { { Instruction::WDR } }; }
+
+		// Lays the instructions out from word 0 and resolves the labels.
+		template<size_t... Sizes>
+		constexpr std::array<Word, (Sizes + ... + 0)> Assemble(const Op<Sizes>&... ops)
+		{
+			std::array<Word, (Sizes + ... + 0)> program = {};
+
+			struct Definition
+			{
+				std::string_view Name;
+				int Address = 0;
+			};
+			std::array<Definition, sizeof...(Sizes) + 1> labels = {};
+			size_t labelCount = 0;
+
+			auto find = [&](std::string_view name) {
+				for (size_t i = 0; i < labelCount; ++i) {
+					if (labels[i].Name == name) {
+						return labels[i].Address;
+					}
+				}
+				Encoding::Check(false, "Undefined label");
+				return 0;
+			};
+
+			// First pass, where the labels are
+			int address = 0;
+			auto define = [&]<size_t Size>(const Op<Size>& op) {
+				if constexpr (Size == 0) {
+					for (size_t i = 0; i < labelCount; ++i) {
+						Encoding::Check(labels[i].Name != op.Label, "Label defined twice");
+					}
+					labels[labelCount++] = { op.Label, address };
+				}
+				address += (int)Size;
+			};
+			(define(ops), ...);
+
+			// Second pass, the words with their fixups
+			address = 0;
+			auto emit = [&]<size_t Size>(const Op<Size>& op) {
+				if constexpr (Size > 0) {
+					Word encoding[2] = { op.Words[0], op.Words[1] };
+					switch (op.Kind)
+					{
+						case Fixup::None:
+							break;
+						case Fixup::Branch:
+						{
+							const int k = find(op.Label) - (address + 1);
+							Encoding::Check(k >= -64 && k <= 63, "Branch target out of range");
+							encoding[0] |= (k & 0x7F) << 3;
+							break;
+						}
+						case Fixup::Relative:
+						{
+							const int k = find(op.Label) - (address + 1);
+							Encoding::Check(k >= -2048 && k <= 2047, "Relative jump target out of range");
+							encoding[0] |= k & 0xFFF;
+							break;
+						}
+						case Fixup::Absolute:
+							Encoding::SetAbsolute(encoding, find(op.Label));
+							break;
+					}
+					for (size_t i = 0; i < Size; ++i) {
+						program[address + i] = encoding[i];
+					}
+				}
+				address += (int)Size;
+			};
+			(emit(ops), ...);
+
+			return program;
+		}
+
+		// Copies an assembled program into the flash, address is in bytes like Memory::WriteWord.
+		template<size_t N>
+		inline void Load(const std::array<Word, N>& program, Memory& memory, uint32_t address = 0)
+		{
+			memory.Load(program.data(), N, address);
+		}
+
+	}
+
+}
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 
 #include "ATMega328Emulator/Types.h"
 #include "ATMega328Emulator/Memory.h"
+#include "ATMega328Emulator/DirtyPages.h"
+#include "ATMega328Emulator/Fault.h"
+#include "ATMega328Emulator/RegisterHooks.h"
+#include "ATMega328Emulator/Watchpoints.h"
 
 // Rd - Destination (and source) register in the Register File
 // Rr - Source register in the Register File
@@ -29,6 +34,58 @@
 // SU - Signed * Unsigned operands
 
 namespace ATMega328Emulator {
+
+	enum class OpcodeClass : Byte;
+
+	class Profiler;
+	class CallProfiler;
+	class InstructionMix;
+	class TraceRecorder;
+	class TraceArchiveWriter;
+	class SamplingProfiler;
+	struct MetricsCounters;
+
+	enum class StopReason : Byte
+	{
+		None = 0,
+		CycleBudget,   // maxCycles were executed
+		CycleTarget,   // CycleCount reached StopConditions::CycleTarget
+		PCMatch,       // PC reached StopConditions::PC
+		Break,         // BREAK, PC points at it
+		IllegalOpcode, // Unknown instruction, PC points at it
+		Sleep,         // SLEEP with interrupts disabled, nothing could wake the CPU up
+		SelfLoop,      // RJMP to itself, the firmware has parked
+		Watchpoint,    // A watchpoint callback asked to stop, PC points past the accessing instruction
+		RegisterHook,  // A register hook asked to stop, PC points past the accessing instruction
+	};
+
+	// What CPU::Run stops on besides its cycle budget.
+	// Conditions that aren't armed cost nothing: the PC match selects a separate loop,
+	// the cycle target shortens the budget and the rest are only looked at by the
+	// instructions that can trigger them.
+	struct StopConditions
+	{
+		bool StopOnPC = false;
+		Word PC = 0;                       // Checked after every instruction
+		uint64_t CycleTarget = UINT64_MAX; // Absolute CycleCount
+		bool StopOnBreak = false;
+		bool StopOnIllegalOpcode = false;
+		bool StopOnSleep = false;
+		bool StopOnSelfLoop = false;
+
+		// Throw an EmulatorFault instead of skipping illegal opcodes and writes outside the data space.
+		// Illegal opcodes are reported on the instruction. Stray writes are reported at the end of
+		// the Run slice they happened in, except in debug builds where they are reported on the write.
+		// Without it every build masks stray accesses the same way, and a PC past the end of flash wraps.
+		bool TrapFaults = false;
+	};
+
+	struct RunResult
+	{
+		StopReason Reason = StopReason::None;
+		uint64_t Cycles = 0;       // Cycles consumed
+		uint64_t Instructions = 0; // Instructions retired
+	};
 	
 	class CPU
 	{
@@ -38,29 +95,137 @@ namespace ATMega328Emulator {
 		static constexpr uint16_t FLASH_SIZE = 32 * 1024; // 32KB
 		static constexpr uint16_t SRAM_SIZE = 2 * 1024; // 2KB
 		static constexpr uint16_t EEPROM_SIZE = 1024; // 1KB
+
+		static constexpr uint16_t IO_START = 0x20;    // I/O address 0, IN, OUT, SBI and CBI address from here
+		static constexpr uint16_t SRAM_START = 0x100; // Registers and I/O live below this
+		static constexpr uint16_t DATA_SPACE_SIZE = SRAM_START + SRAM_SIZE;
+		static constexpr uint16_t RAMEND = DATA_SPACE_SIZE - 1; // Where the stack starts
+
+		// Data space and flash addresses are masked to these instead of being bounds checked.
+		// Data space addresses past the SRAM land in DataGuard, flash has no gaps to guard.
+		static constexpr uint16_t DATA_SPACE_MASK = 0x1000 - 1;
+		static constexpr uint16_t FLASH_MASK = FLASH_SIZE - 1;
 		
 	public:
 		void Reset(Memory& memory);
 
 		// Fetches a Word from memory.
-		// Takes 1 cycles.
 		// Increments the program counter by 1.
-		inline Word FetchWord(int& cycles, Memory& memory)
+		// Cycles are charged per instruction from the timing table, see Timing.h.
+		inline Word FetchWord(Memory& memory)
+		{
+			Word word = PeekWord(memory);
+			++PC;
+			return word;
+		}
+
+		// Reads the Word at the program counter without moving it.
+		inline Word PeekWord(Memory& memory) const
 		{
 			// 6502 is little endian
+			// Memory masks the address, so a PC past the end of flash wraps like it does on the chip
 			Word address = PC * 2;
 
 			Byte lo = memory[address];
 			Byte hi = memory[address + 1];
-		
-			++PC;
-			--cycles;
-			
+
 			return lo | (hi << 8);
 		}
 		
+		// Runs for at least the given number of cycles.
+		// Unknown instructions are skipped. Register hooks asking to stop don't end it early.
 		void Execute(int cycles, Memory& memory);
 
+		// Runs until maxCycles have been consumed or one of the armed conditions is met.
+		RunResult Run(uint64_t maxCycles, const StopConditions& conditions, Memory& memory);
+
+		// Writes a Byte to the data space and marks its page as dirty.
+		// Instructions and peripherals should both store through here.
+		inline void WriteData(Word address, Byte value)
+		{
+#ifdef ATMEGA328_CHECK_ACCESSES
+			checkDataWrite(address);
+#endif
+			if (AttachedWatchpoints && AttachedWatchpoints->IsDataPageWatched(address)) [[unlikely]] {
+				onWatchedAccess(WatchSpace::Data, WatchAccess::Write, address & DATA_SPACE_MASK, getDataSpace()[address & DATA_SPACE_MASK], value);
+			}
+			if (AttachedRegisterHooks && AttachedRegisterHooks->IsHooked(address) && (RunStopFlags & IN_RUN)) [[unlikely]] {
+				value = onHookedWrite(address, value);
+			}
+			getDataSpace()[address & DATA_SPACE_MASK] = value;
+			DirtyData.Mark(address);
+		}
+
+		inline Byte ReadData(Word address) const
+		{
+			if (AttachedRegisterHooks && AttachedRegisterHooks->IsHooked(address) && (RunStopFlags & IN_RUN)) [[unlikely]] {
+				const Byte value = onHookedRead(address);
+				if (AttachedWatchpoints && AttachedWatchpoints->IsDataPageWatched(address)) {
+					onWatchedAccess(WatchSpace::Data, WatchAccess::Read, address & DATA_SPACE_MASK, value, value);
+				}
+				return value;
+			}
+			if (AttachedWatchpoints && AttachedWatchpoints->IsDataPageWatched(address)) [[unlikely]] {
+				onWatchedAccess(WatchSpace::Data, WatchAccess::Read, address & DATA_SPACE_MASK, getDataSpace()[address & DATA_SPACE_MASK], getDataSpace()[address & DATA_SPACE_MASK]);
+			}
+			return getDataSpace()[address & DATA_SPACE_MASK];
+		}
+
+		// The stack grows down from RAMEND, SP points at the next free byte.
+		inline void Push(Byte value)
+		{
+			WriteData(IO.SP, value);
+			--IO.SP;
+		}
+
+		inline Byte Pop()
+		{
+			++IO.SP;
+			return ReadData(IO.SP);
+		}
+
+		// Return addresses are pushed low byte first, so they read big endian in memory
+		inline void PushWord(Word value)
+		{
+			Push(value & 0xFF);
+			Push(value >> 8);
+		}
+
+		inline Word PopWord()
+		{
+			Word hi = Pop();
+			Word lo = Pop();
+			return (hi << 8) | lo;
+		}
+
+		// Takes the interrupt with the given vector number, if interrupts are enabled.
+		// Pushes the PC, clears I and jumps to the vector, which takes 4 cycles.
+		// Checking the peripheral's enable and flag bits is up to the caller. Call it between Runs.
+		bool EnterInterrupt(Byte vector);
+
+		// For register hooks, the accessing instruction takes this many cycles longer, e.g. because the
+		// peripheral skipped the iterations of a polling loop that would only have waited. Only inside Run.
+		// Hooks mustn't skip over RunStopPC while the Run stops on it, see STOP_ON_PC.
+		inline void Stall(int cycles) { RunStallCycles += cycles; }
+
+		// The vector of the innermost interrupt handler that is running, 0 in the main program.
+		inline Byte GetInterruptVector() const
+		{
+			return InterruptDepth ? InterruptVectors[std::min<Byte>(InterruptDepth, MAX_INTERRUPT_NESTING) - 1] : 0;
+		}
+
+		// Writes a Byte to the EEPROM and marks its page as dirty.
+		// The address is masked like EEAR is on the chip, so any address is safe to write.
+		inline void WriteEEPROM(Word address, Byte value)
+		{
+			address &= EEPROM_SIZE - 1;
+			if (AttachedWatchpoints && AttachedWatchpoints->IsEEPROMPageWatched(address)) [[unlikely]] {
+				onWatchedAccess(WatchSpace::EEPROM, WatchAccess::Write, address, EEPROM[address], value);
+			}
+			EEPROM[address] = value;
+			DirtyEEPROM.Mark(address);
+		}
+
 	public:
 		// General purpose registers
 		Byte R00, R01;
@@ -371,6 +536,10 @@ namespace ATMega328Emulator {
 		} EXIO;
 		
 		Byte SRAM[SRAM_SIZE]; // Internal SRAM (Should be at an offset of 0x100)
+
+		// Where masked data space accesses past the SRAM end up, see DATA_SPACE_MASK.
+		// Nothing on the chip is mapped here; a write shows up as a dirty page in DirtyData.
+		Byte DataGuard[DATA_SPACE_MASK + 1 - DATA_SPACE_SIZE];
 		
 		Byte EEPROM[EEPROM_SIZE]; // Should be elsewhere?
 
@@ -380,8 +549,114 @@ namespace ATMega328Emulator {
 			Word PC;
 		};
 
+		// Cycles executed since reset
+		uint64_t CycleCount = 0;
+
+		// Interrupt handlers entered through EnterInterrupt and not left with a RETI yet.
+		// Handlers nested deeper than MAX_INTERRUPT_NESTING share the last slot.
+		static constexpr Byte MAX_INTERRUPT_NESTING = 8;
+		Byte InterruptDepth = 0;
+		Byte InterruptVectors[MAX_INTERRUPT_NESTING] = {};
+
+		// Pages written since the dirty bits were last cleared, see Snapshot.h.
+		// The register file and I/O space change on nearly every instruction,
+		// so snapshots always capture them and they are not tracked here.
+		DirtyPages<0x1000> DirtyData; // Indexed by data space address
+		DirtyPages<EEPROM_SIZE> DirtyEEPROM;
+
+		// Run bookkeeping, only meaningful while it executes.
+		// Kept public, like everything else here, so the CPU stays standard layout.
+		enum RunStopFlag : Byte
+		{
+			STOP_ON_BREAK = 1 << 0,
+			STOP_ON_ILLEGAL_OPCODE = 1 << 1,
+			STOP_ON_SLEEP = 1 << 2,
+			STOP_ON_SELF_LOOP = 1 << 3,
+			TRAP_FAULTS = 1 << 4,
+			IN_RUN = 1 << 5, // Accesses without it happened between Runs
+			STOP_ON_PC = 1 << 6,
+		};
+
+		Byte RunStopFlags = 0;
+		StopReason RunStop = StopReason::None;
+		int RunStopCycles = 0;
+		Word RunStopPC = 0;            // StopConditions::PC, only meaningful with STOP_ON_PC
+		Word RunInstructionPC = 0;     // Only kept up to date when accesses are checked or watched
+		int RunInstructionCycles = 0;  // Cycles left in the slice when it started, only kept up to date when watched or hooked
+		int RunSlice = 0;          // Cycles the current executeLoop started with
+		int RunStallCycles = 0;    // Added to the current instruction by a register hook, see Stall
+
+		// Set to profile Run, see Profiler.h, CallProfiler.h and InstructionMix.h. Ignored in Dist builds.
+		Profiler* AttachedProfiler = nullptr;
+		CallProfiler* AttachedCallProfiler = nullptr;
+		InstructionMix* AttachedInstructionMix = nullptr;
+
+		// Set to trace every instruction Run retires, see Trace.h and TraceArchive.h. Ignored in Dist builds.
+		TraceRecorder* AttachedTracer = nullptr;
+		TraceArchiveWriter* AttachedTraceArchive = nullptr;
+
+		// Set to sample Run, see SamplingProfiler.h. Works in every build.
+		SamplingProfiler* AttachedSampler = nullptr;
+
+		// Set to watch data space and EEPROM accesses, see Watchpoints.h. Works in every build.
+		Watchpoints* AttachedWatchpoints = nullptr;
+
+		// Set to count Runs and interrupts for dashboards, see Metrics.h. Works in every build.
+		MetricsCounters* AttachedMetrics = nullptr;
+
+		// Set to let peripherals act on register accesses, see RegisterHooks.h. Works in every build.
+		RegisterHooks* AttachedRegisterHooks = nullptr;
+
 	private:
-		bool handleInstruction(Word instruction, int& cycles, Memory& memory);
+		// The data space starts at R00, the CPU's first member.
+		// Indexing from the object keeps the compiler from bounding accesses to R00 itself.
+		inline Byte* getDataSpace() { return reinterpret_cast<Byte*>(this); }
+		inline const Byte* getDataSpace() const { return reinterpret_cast<const Byte*>(this); }
+
+		bool handleInstruction(Word instruction, OpcodeClass opcode, int& cycles, Memory& memory);
+
+		// Watched keeps track of the instruction for watchpoints, Profiled also feeds the profilers and tracers
+		template<bool StopOnPC, bool Watched, bool Profiled>
+		void executeLoop(int& cycles, uint64_t& instructions, Word stopPC, Memory& memory);
+
+		// Throws if a write landed in DataGuard since the fault was last looked for.
+		void checkDataGuard();
+
+#ifdef ATMEGA328_CHECK_ACCESSES
+		// Reports a stray write on the access itself, other builds find it in DataGuard at the end of the slice.
+		inline void checkDataWrite(Word address) const
+		{
+			// The same writes land in DataGuard, addresses that mask back into the data space don't fault in any build
+			if ((address & DATA_SPACE_MASK) >= DATA_SPACE_SIZE && (RunStopFlags & TRAP_FAULTS)) {
+				throw EmulatorFault(FaultType::DataOutOfBounds, address & DATA_SPACE_MASK);
+			}
+		}
+#endif
+
+		// CycleCount as of now, in the middle of an executeLoop.
+		inline uint64_t getRunCycle(int cycles) const
+		{
+			return CycleCount + (uint64_t)((int64_t)RunSlice - cycles);
+		}
+
+		// Hands an access to a watched page over to the watchpoints, with where and when it happened.
+		void onWatchedAccess(WatchSpace space, WatchAccess access, Word address, Byte oldValue, Byte newValue) const;
+
+		// Hands a firmware access to a hooked register over to its peripheral.
+		Byte onHookedRead(Word address) const;
+		Byte onHookedWrite(Word address, Byte value);
+
+		// Tells the call profiler, if there is one, about calls and returns.
+		void onCall(Word from, int cycles);
+		void onReturn(int cycles);
+
+		// Ends the current executeLoop by taking its remaining cycles, they are given back in Run.
+		inline void stop(StopReason reason, int& cycles)
+		{
+			RunStop = reason;
+			RunStopCycles = cycles;
+			cycles = 0;
+		}
 		
 	};
 	
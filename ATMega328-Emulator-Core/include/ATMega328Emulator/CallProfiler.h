@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/SymbolTable.h"
+
+namespace ATMega328Emulator {
+
+	// Follows the firmware's calls, returns and interrupts on a shadow call stack and
+	// attributes the cycles between them to functions.
+	// Attach it with CPU::AttachedCallProfiler; only CALL, RCALL, ICALL, RET, RETI and
+	// CPU::EnterInterrupt report to it, so it costs nothing per instruction.
+	class CallProfiler
+	{
+	public:
+		struct FunctionStats
+		{
+			std::string Name;
+			uint64_t Calls = 0;
+			uint64_t InclusiveCycles = 0; // Recursive calls are only counted once
+			uint64_t ExclusiveCycles = 0;
+		};
+
+	public:
+		// Names functions by address, without any they are named by their entry address.
+		inline SymbolTable& GetSymbols() { return m_Symbols; }
+
+		// Called by the CPU. Addresses are word addresses, sp is the stack pointer after the push or pop.
+		void OnCall(Word from, Word target, Word sp, uint64_t cycle);
+		void OnInterrupt(Word from, Byte vector, Word sp, uint64_t cycle);
+		void OnReturn(Word sp, uint64_t cycle);
+
+		// Closes every open frame at cycle, so they show up in the stats. Call it before reporting.
+		void Finish(uint64_t cycle);
+
+		inline size_t GetDepth() const { return m_Stack.size(); }
+
+		// Sorted by exclusive cycles, most first.
+		std::vector<FunctionStats> GetFunctionStats() const;
+
+		// One "root;caller;callee exclusive_cycles" line per call path, for flamegraph.pl and speedscope.
+		void WriteFolded(std::ostream& out) const;
+
+	private:
+		// Functions are keyed by byte entry address, interrupts by vector number above the flash
+		static constexpr uint32_t INTERRUPT_KEY = 0x10000;
+
+		struct Node
+		{
+			uint32_t Function;
+			uint32_t Parent;
+			uint64_t InclusiveCycles = 0;
+			uint64_t ExclusiveCycles = 0;
+			uint64_t Calls = 0;
+			std::map<uint32_t, uint32_t> Children; // Function to node
+		};
+
+		struct Frame
+		{
+			uint32_t Node;
+			Word SP;
+			uint64_t EntryCycle;
+			uint64_t ChildCycles = 0;
+		};
+
+		void begin(Word pc, uint64_t cycle);
+		void push(uint32_t function, Word sp, uint64_t cycle);
+		void pop(uint64_t cycle);
+
+		std::string getName(uint32_t function) const;
+
+	private:
+		SymbolTable m_Symbols;
+		std::vector<Node> m_Nodes;   // 0 is the root once anything happened
+		std::vector<Frame> m_Stack;
+	};
+
+}
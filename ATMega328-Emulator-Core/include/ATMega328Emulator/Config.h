@@ -0,0 +1,14 @@
+#pragma once
+
+// Every build masks data space and program memory addresses into guard backed storage, which is memory safe
+// and costs nothing extra. When a Run traps faults, debug builds check every data space write and fault on
+// the write itself; other builds catch out of bounds writes at the end of the Run slice.
+#if defined(KOM_DEBUG)
+	#define ATMEGA328_CHECK_ACCESSES
+#endif
+
+// Profilers can be attached to the CPU in every build but Dist.
+// Without a profiler attached Run uses the same loop either way, Dist just doesn't have the profiled ones.
+#if !defined(KOM_DIST)
+	#define ATMEGA328_PROFILING
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <bit>
+
+namespace ATMega328Emulator {
+
+	// Tracks which pages of a memory region have been written.
+	// Marking is a single OR into a bitmap so it can stay on in the store paths.
+	template<uint32_t Size, uint32_t PageSize = 64>
+	class DirtyPages
+	{
+	public:
+		static constexpr uint32_t SIZE = Size;
+		static constexpr uint32_t PAGE_SIZE = PageSize;
+		static constexpr uint32_t PAGE_COUNT = Size / PageSize;
+
+		static_assert(std::has_single_bit(PageSize), "Page size has to be a power of two");
+		static_assert(std::has_single_bit(PAGE_COUNT), "Page count has to be a power of two");
+
+	public:
+		// Marks the page containing address as dirty.
+		// Addresses outside of the region wrap around instead of writing past the bitmap.
+		inline void Mark(uint32_t address)
+		{
+			uint32_t page = (address / PAGE_SIZE) & (PAGE_COUNT - 1);
+			m_Bits[page / 64] |= 1ull << (page % 64);
+		}
+
+		inline void MarkRange(uint32_t address, uint32_t size)
+		{
+			for (uint32_t page = address / PAGE_SIZE; page <= (address + size - 1) / PAGE_SIZE; ++page) {
+				Mark(page * PAGE_SIZE);
+			}
+		}
+
+		inline void MarkAll()
+		{
+			m_Bits.fill(~0ull);
+		}
+
+		inline void Clear()
+		{
+			m_Bits.fill(0);
+		}
+
+		// Clears the pages overlapping [address, address + size).
+		inline void ClearRange(uint32_t address, uint32_t size)
+		{
+			for (uint32_t page = address / PAGE_SIZE; page <= (address + size - 1) / PAGE_SIZE; ++page) {
+				m_Bits[page / 64] &= ~(1ull << (page % 64));
+			}
+		}
+
+		inline bool IsDirty(uint32_t page) const
+		{
+			return (m_Bits[page / 64] >> (page % 64)) & 1;
+		}
+
+		inline uint32_t GetDirtyCount() const
+		{
+			uint32_t count = 0;
+			for (uint64_t bits : m_Bits) {
+				count += std::popcount(bits);
+			}
+			return count;
+		}
+
+		// Calls fn(page) for every dirty page, in ascending order.
+		template<typename Fn>
+		inline void ForEach(Fn&& fn) const
+		{
+			for (uint32_t i = 0; i < m_Bits.size(); ++i) {
+				uint64_t bits = m_Bits[i];
+				while (bits) {
+					fn(i * 64 + std::countr_zero(bits));
+					bits &= bits - 1;
+				}
+			}
+		}
+
+	private:
+		std::array<uint64_t, (PAGE_COUNT + 63) / 64> m_Bits = {};
+	};
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+#include "ATMega328Emulator/Types.h"
+
+namespace ATMega328Emulator {
+
+	namespace Disassembler {
+
+		// avr-objdump style text for an instruction, e.g. "ldi r16, 0x2A" or "rjmp .-4".
+		// operand is the word after the instruction, only 32-bit instructions (Timing::IsTwoWord) use it.
+		// Instructions the CPU doesn't implement come out as ".word 0x1234".
+		std::string Disassemble(Word instruction, Word operand = 0);
+
+	}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "ATMega328Emulator/Config.h"
+#include "ATMega328Emulator/Types.h"
+
+namespace ATMega328Emulator {
+
+	enum class FaultType : Byte
+	{
+		IllegalOpcode,
+		DataOutOfBounds,
+	};
+
+	// Something the firmware did that the chip can't, see StopConditions::TrapFaults.
+	class EmulatorFault : public std::runtime_error
+	{
+	public:
+		EmulatorFault(FaultType type, uint32_t address, Word pc = 0, uint64_t cycle = 0)
+			: std::runtime_error(describe(type, address)), Type(type), Address(address), PC(pc), Cycle(cycle)
+		{
+		}
+
+	public:
+		FaultType Type;
+		uint32_t Address; // Offending address, or the opcode for IllegalOpcode
+		Word PC;          // Word address of the faulting instruction
+		uint64_t Cycle;   // CycleCount when the fault was raised
+
+	private:
+		static std::string describe(FaultType type, uint32_t address)
+		{
+			char hex[16];
+			std::snprintf(hex, sizeof(hex), "0x%X", address);
+
+			switch (type)
+			{
+				case FaultType::IllegalOpcode: return std::string("Illegal opcode ") + hex;
+				case FaultType::DataOutOfBounds: return std::string("Data space access out of bounds at ") + hex;
+				default: return "Unknown fault";
+			}
+		}
+	};
+
+}
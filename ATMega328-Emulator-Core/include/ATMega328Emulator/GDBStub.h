@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+#include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Memory.h"
+#include "ATMega328Emulator/Watchpoints.h"
+
+namespace ATMega328Emulator {
+
+	// Splits the byte stream from GDB into packets and checks their checksums.
+	// Acknowledging them is up to the transport.
+	class GDBPacketReader
+	{
+	public:
+		enum class Event : Byte
+		{
+			None,
+			Packet,    // A packet is complete, see GetPacket
+			BadPacket, // A packet with a wrong checksum, GDB wants a '-' and sends it again
+			Interrupt, // Ctrl-C outside of a packet
+		};
+
+	public:
+		Event Feed(char c);
+
+		// The payload of the last packet, between the '$' and the '#'.
+		inline const std::string& GetPacket() const { return m_Packet; }
+
+	private:
+		enum class State : Byte
+		{
+			Idle,
+			Payload,
+			ChecksumHigh,
+			ChecksumLow,
+		};
+
+		State m_State = State::Idle;
+		std::string m_Packet;
+		Byte m_Sum = 0;
+		Byte m_Checksum = 0;
+		bool m_Valid = true;
+	};
+
+	// The target side of GDB's remote serial protocol, for avr-gdb's "target remote".
+	// It only deals in packet payloads; a transport (see ATMega328-Emulator-GDBServer) frames them with
+	// GDBPacketReader and EncodePacket.
+	//
+	// Software breakpoints swap the instruction in flash for a BREAK, which Run stops on, so between
+	// stops the CPU runs the same loop it runs without a debugger, however many breakpoints are set.
+	// Reads and writes of flash through the stub see the original instructions.
+	// watch, rwatch and awatch go through Watchpoints.h; the stub sets CPU::AttachedWatchpoints while it runs
+	// the CPU and only if any are set. While the host has its own Watchpoints attached, GDB can't set any.
+	class GDBStub
+	{
+	public:
+		// Where avr-gdb puts the data space and the EEPROM, the flash starts at 0
+		static constexpr uint32_t DATA_OFFSET = 0x800000;
+		static constexpr uint32_t EEPROM_OFFSET = 0x810000;
+
+		// Cycles continue runs between looking for an interrupt from GDB, about 50ms of host time
+		static constexpr uint64_t CONTINUE_SLICE = 1'000'000;
+
+	public:
+		GDBStub(CPU& cpu, Memory& memory);
+		~GDBStub(); // Takes the breakpoints back out of flash
+
+		// Handles the payload of one packet and returns the payload of the reply, empty if the packet isn't supported.
+		// Continue and step return once the CPU stopped.
+		std::string HandlePacket(std::string_view packet);
+
+		// Polled while continuing, returning true stops the CPU like Ctrl-C in GDB.
+		inline void SetInterruptCheck(std::function<bool()> check) { m_InterruptCheck = std::move(check); }
+
+		// Set by detach and kill, the transport should close the connection.
+		inline bool IsDetached() const { return m_Detached; }
+
+		// pc is a word address. Inserting the same one twice is fine.
+		bool InsertBreakpoint(Word pc);
+		bool RemoveBreakpoint(Word pc);
+		void RemoveAllBreakpoints();
+
+		inline size_t GetBreakpointCount() const { return m_Breakpoints.size(); }
+
+		// $payload#checksum
+		static std::string EncodePacket(std::string_view payload);
+
+	private:
+		std::string readRegisters() const;
+		bool writeRegisters(std::string_view hex);
+		std::string readRegister(uint32_t index) const;
+		bool writeRegister(uint32_t index, std::string_view hex);
+
+		std::string readMemory(uint32_t address, uint32_t length) const;
+		bool writeMemory(uint32_t address, std::string_view hex);
+
+		std::string setWatchpoint(bool insert, char type, uint32_t address, uint32_t length);
+
+		// Runs one instruction, or until something stops the CPU, and returns the stop reply.
+		std::string resume(bool step);
+
+		Byte readFlash(uint32_t address) const;
+		void writeFlash(uint32_t address, Byte value);
+
+	private:
+		CPU& m_CPU;
+		Memory& m_Memory;
+
+		std::map<Word, Word> m_Breakpoints; // PC to the instruction its BREAK replaced
+
+		Watchpoints m_Watchpoints;
+		std::map<std::tuple<char, uint32_t, uint32_t>, int> m_WatchIds; // Z packet type, address and length to id
+		std::map<int, char> m_WatchTypes;
+		bool m_WatchHit = false;
+		WatchEvent m_WatchEvent = {};
+
+		std::string m_LastStop = "S05";
+		std::function<bool()> m_InterruptCheck;
+		bool m_Detached = false;
+	};
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "ATMega328Emulator/Memory.h"
+
+namespace ATMega328Emulator {
+
+	namespace HexFile {
+
+		// Loads an Intel HEX image, like avr-objcopy -O ihex writes, into the flash. Addresses are in bytes.
+		// Returns false if the file can't be read, a record is malformed or fails its checksum, or data lands
+		// past the end of the flash. Records before the bad one are loaded.
+		bool Load(const std::string& filepath, Memory& memory);
+		bool Parse(std::string_view text, Memory& memory);
+
+	}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+#include "ATMega328Emulator/CPU.h"
+
+namespace ATMega328Emulator {
+
+	// Host hardware events HostCounters can count
+	enum class HostEvent : Byte
+	{
+		Cycles,
+		Instructions,
+		Branches,
+		BranchMisses,
+		L1DReadMisses,
+		LLCMisses, // Last level cache
+
+		Count
+	};
+
+	constexpr const char* HOST_EVENT_NAMES[] = {
+		"Cycles", "Instructions", "Branches", "BranchMisses", "L1DReadMisses", "LLCMisses",
+	};
+	static_assert(sizeof(HOST_EVENT_NAMES) / sizeof(HOST_EVENT_NAMES[0]) == (size_t)HostEvent::Count, "A host event is missing a name");
+
+	// The host's hardware performance counters around emulation, through Linux perf_event_open, to tell
+	// whether dispatch or data layout is what the interpreter is waiting on.
+	// Counts this thread in user space only. Open fails if no event can be opened: not Linux,
+	// perf_event_paranoid above 2, or a VM without a PMU. Events the host doesn't have read as unavailable.
+	// Every Start/Stop pair costs a few syscalls per event, so wrap whole Run calls or benchmark regions,
+	// not single instructions. The kernel multiplexes events that don't fit the PMU at once and the
+	// counts are scaled up for the time they weren't counted.
+	class HostCounters
+	{
+	public:
+		struct Reading
+		{
+			std::array<uint64_t, (size_t)HostEvent::Count> Values = {};
+			std::array<bool, (size_t)HostEvent::Count> Available = {};
+			uint64_t EmulatedInstructions = 0;
+			uint64_t EmulatedCycles = 0;
+
+			inline bool IsAvailable(HostEvent event) const { return Available[(size_t)event]; }
+			inline uint64_t Get(HostEvent event) const { return Values[(size_t)event]; }
+
+			// Host events per emulated instruction, 0 if the event isn't available or nothing was emulated.
+			double PerInstruction(HostEvent event) const;
+
+			// Host instructions per host cycle.
+			double GetIPC() const;
+
+			// Branch misses per host branch.
+			double GetBranchMissRate() const;
+
+			// One line per available event: the count and the count per emulated instruction.
+			void WriteReport(std::ostream& out) const;
+		};
+
+	public:
+		HostCounters();
+		~HostCounters();
+
+		HostCounters(const HostCounters&) = delete;
+		HostCounters& operator=(const HostCounters&) = delete;
+
+		// Returns true if at least one event could be opened.
+		bool Open();
+		void Close();
+		inline bool IsOpen() const { return m_Open; }
+
+		// Counts between Start and Stop add up until Reset. The emulated counts are for normalizing,
+		// pass what the measured code emulated.
+		void Start();
+		void Stop(uint64_t emulatedInstructions, uint64_t emulatedCycles);
+		inline void Stop(const RunResult& result) { Stop(result.Instructions, result.Cycles); }
+
+		void Reset();
+		inline const Reading& GetReading() const { return m_Reading; }
+
+		// CPU::Run or CPU::Execute with the counters around it.
+		RunResult Run(CPU& cpu, uint64_t maxCycles, const StopConditions& conditions, Memory& memory);
+		void Execute(CPU& cpu, int cycles, Memory& memory);
+
+	private:
+		std::array<int, (size_t)HostEvent::Count> m_Fds; // -1 where the event isn't open
+		bool m_Open = false;
+		Reading m_Reading;
+	};
+
+}
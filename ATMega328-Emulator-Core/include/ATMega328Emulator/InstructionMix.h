@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/Timing.h"
+
+namespace ATMega328Emulator {
+
+	// Counts executions and cycles per opcode class, the dynamic instruction mix of the firmware.
+	// Attach it with CPU::AttachedInstructionMix, Run then takes the profiled loop which indexes the
+	// counters with the opcode class it already decoded. Like the Profiler, Dist builds ignore it.
+	// Counters aren't shared: give every emulator thread its own mix and add them up afterwards.
+	class alignas(64) InstructionMix
+	{
+	public:
+		struct Counters
+		{
+			uint64_t Executions = 0;
+			uint64_t Cycles = 0;
+		};
+
+	public:
+		void Reset();
+
+		// Called by Run for every retired instruction.
+		inline void Record(OpcodeClass opcode, int cycles)
+		{
+			Counters& counters = m_Counters[(size_t)opcode];
+			++counters.Executions;
+			counters.Cycles += cycles;
+		}
+
+		inline const Counters& Get(OpcodeClass opcode) const { return m_Counters[(size_t)opcode]; }
+
+		uint64_t GetTotalExecutions() const;
+		uint64_t GetTotalCycles() const;
+
+		// Adds another mix, for merging the ones of several threads or runs.
+		InstructionMix& operator+=(const InstructionMix& other);
+
+		// One line per opcode class that ran, most cycles first:
+		// class, executions, cycles and the share of all cycles.
+		void WriteReport(std::ostream& out) const;
+
+		// Compares the cycle shares of two mixes, for example two firmware builds.
+		// One line per opcode class that ran in either, largest change first.
+		static void WriteDiff(std::ostream& out, const InstructionMix& base, const InstructionMix& other,
+			const std::string& baseName = "base", const std::string& otherName = "other");
+
+	private:
+		std::array<Counters, (size_t)OpcodeClass::Count> m_Counters = {};
+	};
+
+}
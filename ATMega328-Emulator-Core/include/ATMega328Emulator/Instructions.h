@@ -10,10 +10,10 @@
  * BLD
  * BRBC
  * BRBS
- * BREAK (Not sure how to implement)
+ * BREAK
  * BSET
  * BST
- * CALL (Not sure how to implement)
+ * CALL
  * CBI
  * CP
  * CPC
@@ -26,16 +26,18 @@
  * FMUL
  * FMULS
  * FMULSU
- * ICALL (Not implemented)
- * IN (Not implemented)
- * JMP (Not implemented)
+ * ICALL
+ * IN
+ * IJMP
+ * JMP
  * LAC
  * LAS
  * LAT
- * LD (Not sure how to implement) (This one is strange)
+ * LD
+ * LDD
  * LDI
  * LDS
- * LPM (Not sure how to implement) (This one is strange)
+ * LPM
  * LSL
  * LSR
  * MOV
@@ -45,26 +47,26 @@
  * MULSU
  * NOP
  * OUT
- * POP (Not implemented)
- * PUSH (Not implemented)
- * RCALL (Not implemented)
- * RET (Not implemented)
- * RETI (Not implemented)
- * RJMP (Not implemented)
+ * POP
+ * PUSH
+ * RCALL
+ * RET
+ * RETI
  * ROL (Not implemented)
- * ROR (Not implemented)
- * SBIC (Not implemented)
- * SBIS (Not implemented)
- * SBIW (Not implemented)
+ * ROR
+ * SBIC
+ * SBIS
+ * SBIW
  * SEI (Not implemented)
- * SBRC (Not implemented)
- * SBRS (Not implemented)
- * SLEEP (Not sure how to implement) (This one is strange)
+ * SBRC
+ * SBRS
+ * SLEEP
  * SPM (Not sure how to implement) (This one is strange)
  * SPM (Not sure how to implement) (This one is strange)
- * ST (Not sure how to implement) (This one is strange)
- * STS (Not sure how to implement) (This one is strange)
- * SWAP (Not implemented)
+ * ST
+ * STD
+ * STS
+ * SWAP
  * WDR (Not implemented)
  * XCH (Not implemented)
  */
@@ -135,7 +137,7 @@ namespace ATMega328Emulator {
 			DES    = 0b1001'0100'0000'1011, // DES    - Data Encryption Standard                 - 1001'0100'KKKK'1011
 			EICALL = 0b1001'0101'0001'1001, // EICALL - Extended Indirect Call to Subroutine     - 1001'0101'0001'1001
 			EIJMP  = 0b1001'0100'0001'1001, // EIJMP  - Extended Indirect Jump                   - 1001'0100'0001'1001
-			ELPM   = 0, // TODO             // ELPM   - Extended Load Program Memory             - 1001'0101'1101'1000
+			ELPM   = 0b1001'0101'1101'1000, // ELPM   - Extended Load Program Memory             - 1001'0101'1101'1000
 			EOR    = 0b0010'0100'0000'0000, // EOR    - Logical Exclusive OR                     - 0010'01rd'dddd'rrrr
 			FMUL   = 0b0000'0011'0000'1000, // FMUL   - Fractional Multiply (Unsigned)           - 0000'0011'0ddd'1rrr
 			FMULS  = 0b0000'0011'1000'0000, // FMULS  - Fractional Multiply (Signed)             - 0000'0011'1ddd'0rrr
@@ -148,10 +150,20 @@ namespace ATMega328Emulator {
 			LAC    = 0b1001'0010'0000'0110, // LAC    - Load and Clear                           - 1001'001r'rrrr'0110
 			LAS    = 0b1001'0010'0000'0101, // LAS    - Load and Set                             - 1001'001r'rrrr'0101
 			LAT    = 0b1001'0010'0000'0111, // LAT    - Load and Toggle                          - 1001'001r'rrrr'0111
-			LD     = 0, // TODO             // LD     - Load Indirect from Data Space to Register using X
+			LD_X     = 0b1001'0000'0000'1100, // LD   - Load Indirect using X                  - 1001'000d'dddd'1100
+			LD_X_INC = 0b1001'0000'0000'1101, // LD   - Load Indirect using X, Post-increment  - 1001'000d'dddd'1101
+			LD_X_DEC = 0b1001'0000'0000'1110, // LD   - Load Indirect using X, Pre-decrement   - 1001'000d'dddd'1110
+			LD_Y_INC = 0b1001'0000'0000'1001, // LD   - Load Indirect using Y, Post-increment  - 1001'000d'dddd'1001
+			LD_Y_DEC = 0b1001'0000'0000'1010, // LD   - Load Indirect using Y, Pre-decrement   - 1001'000d'dddd'1010
+			LD_Z_INC = 0b1001'0000'0000'0001, // LD   - Load Indirect using Z, Post-increment  - 1001'000d'dddd'0001
+			LD_Z_DEC = 0b1001'0000'0000'0010, // LD   - Load Indirect using Z, Pre-decrement   - 1001'000d'dddd'0010
+			LDD_Y  = 0b1000'0000'0000'1000, // LDD    - Load Indirect with Displacement using Y  - 10q0'qq0d'dddd'1qqq, LD Rd,Y is q = 0
+			LDD_Z  = 0b1000'0000'0000'0000, // LDD    - Load Indirect with Displacement using Z  - 10q0'qq0d'dddd'0qqq, LD Rd,Z is q = 0
 			LDI    = 0b1110'0000'0000'0000, // LDI    - Load Immediate                           - 1110'KKKK'dddd'KKKK
 			LDS    = 0b1001'0000'0000'0000, // LDS    - Load Direct from Data Space              - 1001'000d'dddd'0000'kkkk'kkkk'kkkk'kkkk
-			LPM    = 0, // TODO             // LPM    - Load Program Memory
+			LPM    = 0b1001'0101'1100'1000, // LPM    - Load Program Memory into R0              - 1001'0101'1100'1000
+			LPM_Z     = 0b1001'0000'0000'0100, // LPM - Load Program Memory                   - 1001'000d'dddd'0100
+			LPM_Z_INC = 0b1001'0000'0000'0101, // LPM - Load Program Memory, Post-increment   - 1001'000d'dddd'0101
 			LSL    = 0b0000'1100'0000'0000, // LSL    - Logical Shift Left                       - ADD Rd,Rd
 			LSR    = 0b1001'0100'0000'0110, // LSR    - Logical Shift Right                      - 1001'010d'dddd'0110
 			MOV    = 0b0010'1100'0000'0000, // MOV    - Copy Register                            - 0010'11rr'dddd'rrrr
@@ -192,8 +204,16 @@ namespace ATMega328Emulator {
 			                                // SEZ    - Set Zero Flag                            - BSET 1
 			SLEEP  = 0b1001'0101'1000'1000, // SLEEP  - Sleep                                    - 1001'0101'1000'1000
 			SPM    = 0b1001'0101'1110'1000, // SPM    - Store Program Memory                     - 1001'0101'1110'1000
-			ST     = 0, // TODO             // ST     - Store Indirect From Register To Data Space Using Index X
-			STS    = 0, // TODO             // STS    - Store Direct to Data Space
+			ST_X     = 0b1001'0010'0000'1100, // ST   - Store Indirect using X                 - 1001'001r'rrrr'1100
+			ST_X_INC = 0b1001'0010'0000'1101, // ST   - Store Indirect using X, Post-increment - 1001'001r'rrrr'1101
+			ST_X_DEC = 0b1001'0010'0000'1110, // ST   - Store Indirect using X, Pre-decrement  - 1001'001r'rrrr'1110
+			ST_Y_INC = 0b1001'0010'0000'1001, // ST   - Store Indirect using Y, Post-increment - 1001'001r'rrrr'1001
+			ST_Y_DEC = 0b1001'0010'0000'1010, // ST   - Store Indirect using Y, Pre-decrement  - 1001'001r'rrrr'1010
+			ST_Z_INC = 0b1001'0010'0000'0001, // ST   - Store Indirect using Z, Post-increment - 1001'001r'rrrr'0001
+			ST_Z_DEC = 0b1001'0010'0000'0010, // ST   - Store Indirect using Z, Pre-decrement  - 1001'001r'rrrr'0010
+			STD_Y  = 0b1000'0010'0000'1000, // STD    - Store Indirect with Displacement using Y - 10q0'qq1r'rrrr'1qqq, ST Y,Rr is q = 0
+			STD_Z  = 0b1000'0010'0000'0000, // STD    - Store Indirect with Displacement using Z - 10q0'qq1r'rrrr'0qqq, ST Z,Rr is q = 0
+			STS    = 0b1001'0010'0000'0000, // STS    - Store Direct to Data Space               - 1001'001r'rrrr'0000'kkkk'kkkk'kkkk'kkkk
 			SUB    = 0b0001'1000'0000'0000, // SBC    - Subtract without Carry                   - 0001'10rd'dddd'rrrr
 			SUBI   = 0b0101'0000'0000'0000, // SUBI   - Subtract Immediate                       - 0101'KKKK'dddd'KKKK
 			SWAP   = 0b1001'0100'0000'0010, // SWAP   - Swap Nibbles                             - 1001'010d'dddd'0010
@@ -201,6 +221,9 @@ namespace ATMega328Emulator {
 			WDR    = 0b1001'0101'1010'1000, // WDR    - Watchdog Reset                           - 1001'0101'1010'1000
 			XCH    = 0b1001'0010'0000'0100; // XCH    - Exchange                                 - 1001'001r'rrrr'0100
 
+		static constexpr Word
+			SELF_LOOP = RJMP | 0xFFF; // rjmp . ; Jump to itself, how firmware usually parks
+
 		// ADC - Add with Carry
 		void Handle_ADC(Word instruction, CPU* cpu);
 
@@ -208,7 +231,7 @@ namespace ATMega328Emulator {
 		void Handle_ADD(Word instruction, CPU* cpu);
 		
 		// ADIW - Add Immediate to Word
-		void Handle_ADIW(Word instruction, int& cycles, CPU* cpu);
+		void Handle_ADIW(Word instruction, CPU* cpu);
 
 		// AND - Logical AND
 		void Handle_AND(Word instruction, CPU* cpu);
@@ -226,10 +249,12 @@ namespace ATMega328Emulator {
 		void Handle_BLD(Word instruction, CPU* cpu);
 
 		// BRBC - Branch if Bit in SREG is Clear
-		void Handle_BRBC(Word instruction, int& cycles, CPU* cpu);
+		// Returns true if the branch was taken.
+		bool Handle_BRBC(Word instruction, CPU* cpu);
 
 		// BRBS - Branch if Bit in SREG is Set
-		void Handle_BRBS(Word instruction, int& cycles, CPU* cpu);
+		// Returns true if the branch was taken.
+		bool Handle_BRBS(Word instruction, CPU* cpu);
 
 		// BSET - Bit Set in SREG
 		void Handle_BSET(Word instruction, CPU* cpu);
@@ -237,6 +262,9 @@ namespace ATMega328Emulator {
 		// BST - Bit Store from Bit in Register to T Flag
 		void Handle_BST(Word instruction, CPU* cpu);
 
+		// CALL - Long Call to a Subroutine
+		void Handle_CALL(Word instruction, CPU* cpu, Memory& memory);
+
 		// CBI - Clear Bit in I/O Register
 		void Handle_CBI(Word instruction, CPU* cpu);
 
@@ -253,7 +281,8 @@ namespace ATMega328Emulator {
 		void Handle_CPI(Word instruction, CPU* cpu);
 
 		// CPSE - Compare Skip if Equal
-		void Handle_CPSE(Word instruction, int& cycles, CPU* cpu);
+		// Returns the number of words skipped.
+		Byte Handle_CPSE(Word instruction, CPU* cpu, Memory& memory);
 
 		// DEC - Decrement
 		void Handle_DEC(Word instruction, CPU* cpu);
@@ -262,31 +291,54 @@ namespace ATMega328Emulator {
 		void Handle_EOR(Word instruction, CPU* cpu);
 
 		// FMUL - Fractional Multiply Unsigned
-		void Handle_FMUL(Word instruction, int& cycles, CPU* cpu);
+		void Handle_FMUL(Word instruction, CPU* cpu);
 
 		// FMULS - Fractional Multiply Signed
-		void Handle_FMULS(Word instruction, int& cycles, CPU* cpu);
+		void Handle_FMULS(Word instruction, CPU* cpu);
 
 		// FMULSU - Fractional Multiply Signed with Unsigned
-		void Handle_FMULSU(Word instruction, int& cycles, CPU* cpu);
+		void Handle_FMULSU(Word instruction, CPU* cpu);
+
+		// ICALL - Indirect Call to Subroutine
+		void Handle_ICALL(Word instruction, CPU* cpu);
+
+		// IJMP - Indirect Jump
+		void Handle_IJMP(Word instruction, CPU* cpu);
+
+		// IN - Load an I/O Location to Register
+		void Handle_IN(Word instruction, CPU* cpu);
 
 		// INC - Increment
 		void Handle_INC(Word instruction, CPU* cpu);
 
+		// JMP - Jump
+		void Handle_JMP(Word instruction, CPU* cpu, Memory& memory);
+
 		// LAC - Load and Clear
-		void Handle_LAC(Word instruction, int& cycles, CPU* cpu);
+		void Handle_LAC(Word instruction, CPU* cpu);
 
 		// LAS - Load and Set
-		void Handle_LAS(Word instruction, int& cycles, CPU* cpu);
+		void Handle_LAS(Word instruction, CPU* cpu);
 
 		// LAT - Load and Toggle
-		void Handle_LAT(Word instruction, int& cycles, CPU* cpu);
+		void Handle_LAT(Word instruction, CPU* cpu);
+
+		// LD - Load Indirect from Data Space to Register using X, Y or Z
+		// Also does the post-increment and pre-decrement forms.
+		void Handle_LD(Word instruction, CPU* cpu);
+
+		// LDD - Load Indirect with Displacement using Y or Z
+		void Handle_LDD(Word instruction, CPU* cpu);
 
 		// LDI - Load Immediate
 		void Handle_LDI(Word instruction, CPU* cpu);
 
 		// LDS - Load Direct from Data Space
-		void Handle_LDS(Word instruction, int& cycles, CPU* cpu, Memory& memory);
+		void Handle_LDS(Word instruction, CPU* cpu, Memory& memory);
+
+		// LPM - Load Program Memory
+		// Also does the LPM Rd,Z and LPM Rd,Z+ forms.
+		void Handle_LPM(Word instruction, CPU* cpu, Memory& memory);
 
 		// LSR - Logical Shift Right
 		void Handle_LSR(Word instruction, CPU* cpu);
@@ -298,13 +350,13 @@ namespace ATMega328Emulator {
 		void Handle_MOVW(Word instruction, CPU* cpu);
 
 		// MUL - Multiply Unsigned
-		void Handle_MUL(Word instruction, int& cycles, CPU* cpu);
+		void Handle_MUL(Word instruction, CPU* cpu);
 
 		// MULS - Multiply Signed
-		void Handle_MULS(Word instruction, int& cycles, CPU* cpu);
+		void Handle_MULS(Word instruction, CPU* cpu);
 
 		// MULSU - Multiply Signed with Unsigned
-		void Handle_MULSU(Word instruction, int& cycles, CPU* cpu);
+		void Handle_MULSU(Word instruction, CPU* cpu);
 
 		// NEG - Two's Complement
 		void Handle_NEG(Word instruction, CPU* cpu);
@@ -318,6 +370,27 @@ namespace ATMega328Emulator {
 		// OUT - Store Register to I/O Location
 		void Handle_OUT(Word instruction, CPU* cpu);
 
+		// POP - Pop Register from Stack
+		void Handle_POP(Word instruction, CPU* cpu);
+
+		// PUSH - Push Register to Stack
+		void Handle_PUSH(Word instruction, CPU* cpu);
+
+		// RCALL - Relative Call to Subroutine
+		void Handle_RCALL(Word instruction, CPU* cpu);
+
+		// RET - Return from Subroutine
+		void Handle_RET(Word instruction, CPU* cpu);
+
+		// RETI - Return from Interrupt
+		void Handle_RETI(Word instruction, CPU* cpu);
+
+		// RJMP - Relative Jump
+		void Handle_RJMP(Word instruction, CPU* cpu);
+
+		// ROR - Rotate Right through Carry
+		void Handle_ROR(Word instruction, CPU* cpu);
+
 		// SBC - Subtract with Carry
 		void Handle_SBC(Word instruction, CPU* cpu);
 
@@ -327,11 +400,43 @@ namespace ATMega328Emulator {
 		// SBI - Set Bit in I/O Register
 		void Handle_SBI(Word instruction, CPU* cpu);
 
+		// SBIC - Skip if Bit in I/O Register is Cleared
+		// Returns the number of words skipped.
+		Byte Handle_SBIC(Word instruction, CPU* cpu, Memory& memory);
+
+		// SBIS - Skip if Bit in I/O Register is Set
+		// Returns the number of words skipped.
+		Byte Handle_SBIS(Word instruction, CPU* cpu, Memory& memory);
+
+		// SBIW - Subtract Immediate from Word
+		void Handle_SBIW(Word instruction, CPU* cpu);
+
+		// SBRC - Skip if Bit in Register is Cleared
+		// Returns the number of words skipped.
+		Byte Handle_SBRC(Word instruction, CPU* cpu, Memory& memory);
+
+		// SBRS - Skip if Bit in Register is Set
+		// Returns the number of words skipped.
+		Byte Handle_SBRS(Word instruction, CPU* cpu, Memory& memory);
+
+		// ST - Store Indirect From Register to Data Space using X, Y or Z
+		// Also does the post-increment and pre-decrement forms.
+		void Handle_ST(Word instruction, CPU* cpu);
+
+		// STD - Store Indirect with Displacement using Y or Z
+		void Handle_STD(Word instruction, CPU* cpu);
+
+		// STS - Store Direct to Data Space
+		void Handle_STS(Word instruction, CPU* cpu, Memory& memory);
+
 		// SUBI - Subtract Immediate
 		void Handle_SUBI(Word instruction, CPU* cpu);
 
 		// SUB - Subtract without Carry
 		void Handle_SUB(Word instruction, CPU* cpu);
+
+		// SWAP - Swap Nibbles
+		void Handle_SWAP(Word instruction, CPU* cpu);
 		
 	}
 }
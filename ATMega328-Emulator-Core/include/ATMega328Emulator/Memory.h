@@ -1,15 +1,22 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 #include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/DirtyPages.h"
 
 namespace ATMega328Emulator {
 	
 	class Memory
 	{
 	public:
-		static constexpr uint32_t MAX_MEM = 2048;
+		static constexpr uint32_t MAX_MEM = 32 * 1024; // All of the flash
+
+		// Addresses are masked rather than checked, so any address is safe to access.
+		// In every build, a PC past the end of flash wraps around like it does on the chip.
+		static constexpr uint32_t ADDRESS_MASK = MAX_MEM - 1;
+		static_assert((MAX_MEM & ADDRESS_MASK) == 0, "MAX_MEM has to be a power of two");
 	
 	public:
 		Memory();
@@ -19,21 +26,20 @@ namespace ATMega328Emulator {
 	public:
 		inline Byte operator[](uint32_t address) const
 		{
-			// TODO: Assert if address is greater than MAX_MEM
-			return Data[address];
+			return Data[address & ADDRESS_MASK];
 		}
 
 		inline Byte& operator[](uint32_t address)
 		{
-			// TODO: Assert if address is greater than MAX_MEM
-			return Data[address];
+			return Data[address & ADDRESS_MASK];
 		}
 
 		// Write a Byte to memory
 		// Takes 1 cycle
 		inline void Write(Byte value, Word address, int& cycles)
 		{
-			Data[address] = value;
+			Data[address & ADDRESS_MASK] = value;
+			Dirty.Mark(address);
 			cycles--;
 		}
 
@@ -45,9 +51,15 @@ namespace ATMega328Emulator {
 			Write((value >> 8) & 0xFF, address + 1, cycles);
 		}
 
+		// Copies count words to address and on, for loading whole programs at once. Doesn't take any cycles.
+		void Load(const Word* words, size_t count, uint32_t address = 0);
+
 	public:
 		Byte* Data = nullptr;
-	
+
+		// Pages written through Write since the dirty bits were last cleared.
+		DirtyPages<MAX_MEM> Dirty;
+
 	};
 
 }
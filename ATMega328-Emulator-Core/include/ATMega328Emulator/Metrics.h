@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/CPU.h"
+
+/*
+ * Shared metrics layout, host byte order, for a scraper mapping the file Metrics::Share created
+ *
+ * Header, 64 bytes
+ *   0x00  4  Magic "AVRM"
+ *   0x04  2  Version, currently 2
+ *   0x06  2  Size of a counter block, see MetricsCounters
+ *   0x08  4  Capacity, counter blocks in the file
+ *   0x0C  4  Count, counter blocks registered so far, only grows
+ *
+ * Counter blocks, back to back after the header
+ *   0x00  8  Instructions retired
+ *   0x08  8  Cycles
+ *   0x10  8  Runs
+ *   0x18  8  Interrupts taken
+ *   0x20  8  Host nanoseconds spent in Run
+ *   0x28  8  Runs that stopped, per StopReason
+ *   ...
+ *   0x78 48  Name, zero terminated
+ *   0xA8  4  Ready, 1 once the name is written
+ *
+ * Counters are 64-bit atomics that only grow. Read each one with a single aligned load;
+ * they are updated one by one, so counters of the same block may be a Run apart.
+ */
+
+namespace ATMega328Emulator {
+
+	namespace MetricsFormat {
+
+		static constexpr char MAGIC[4] = { 'A', 'V', 'R', 'M' };
+		static constexpr uint16_t VERSION = 2;
+		static constexpr size_t HEADER_SIZE = 64;
+		static constexpr size_t CACHE_LINE_SIZE = 64;
+		static constexpr size_t NAME_SIZE = 48;
+		static constexpr size_t STOP_REASON_COUNT = (size_t)StopReason::RegisterHook + 1;
+
+	}
+
+	// One worker's counters, updated by the thread running its CPU and read from any other.
+	// Blocks take whole cache lines so workers on different threads never share one.
+	// Attach to CPU::AttachedMetrics; Run adds to it once per call, not per instruction.
+	struct alignas(MetricsFormat::CACHE_LINE_SIZE) MetricsCounters
+	{
+		std::atomic<uint64_t> Instructions;
+		std::atomic<uint64_t> Cycles;
+		std::atomic<uint64_t> Runs;
+		std::atomic<uint64_t> Interrupts;
+		std::atomic<uint64_t> ExecuteNanoseconds; // Host time inside Run
+		std::atomic<uint64_t> Stops[MetricsFormat::STOP_REASON_COUNT]; // Why Runs returned, by StopReason
+
+		char Name[MetricsFormat::NAME_SIZE];
+		std::atomic<uint32_t> Ready;
+
+		// Only the owning thread writes, so a load and a store is enough and there is no locked instruction.
+		static inline void Add(std::atomic<uint64_t>& counter, uint64_t value)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		void OnRun(const RunResult& result, uint64_t nanoseconds);
+		inline void OnInterrupt() { Add(Interrupts, 1); }
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "Metrics are read from other threads and processes without locks");
+
+	// A copy of a counter block, taken without stopping its writer.
+	struct MetricsSample
+	{
+		std::string Name;
+		uint64_t Instructions = 0;
+		uint64_t Cycles = 0;
+		uint64_t Runs = 0;
+		uint64_t Interrupts = 0;
+		uint64_t ExecuteNanoseconds = 0;
+		uint64_t Stops[MetricsFormat::STOP_REASON_COUNT] = {};
+
+		// Emulated clock while inside Run, the device runs at CPU::FREQUENCY
+		inline double GetEmulatedMHz() const { return ExecuteNanoseconds ? Cycles * 1e3 / ExecuteNanoseconds : 0.0; }
+	};
+
+	// Live throughput counters for every emulator instance in a process, for dashboards.
+	// Register gives each worker a counter block of its own; readers on other threads
+	// sample them or export them without locks, as Prometheus text or through a shared file.
+	class Metrics
+	{
+	public:
+		static constexpr uint32_t DEFAULT_CAPACITY = 64;
+
+	public:
+		explicit Metrics(uint32_t capacity = DEFAULT_CAPACITY);
+		~Metrics();
+
+		Metrics(const Metrics&) = delete;
+		Metrics& operator=(const Metrics&) = delete;
+
+		// Moves the counters into a file mapped shared, e.g. under /dev/shm, for a scraper in
+		// another process to map read only. Only before anything is registered.
+		bool Share(const std::string& filepath);
+
+		// A counter block for one worker, nullptr when all are taken. Lives as long as the Metrics.
+		// Names longer than MetricsFormat::NAME_SIZE - 1 are cut.
+		MetricsCounters* Register(const std::string& name);
+
+		// Blocks registered so far, every one below this can be sampled.
+		inline uint32_t GetCount() const { return std::min(m_Header->Count.load(std::memory_order_acquire), m_Header->Capacity); }
+		inline uint32_t GetCapacity() const { return m_Header->Capacity; }
+
+		MetricsSample Sample(uint32_t index) const;
+
+		// Prometheus text exposition format, one series per registered worker
+		void WritePrometheus(std::ostream& out) const;
+
+		// Writes the Prometheus text next to the file and renames it over, so a textfile collector never reads half.
+		bool WritePrometheusFile(const std::string& filepath) const;
+
+	private:
+		struct Header
+		{
+			char Magic[4];
+			uint16_t Version;
+			uint16_t BlockSize;
+			uint32_t Capacity;
+			std::atomic<uint32_t> Count;
+		};
+
+		static size_t getStorageSize(uint32_t capacity);
+		void initialize(void* storage, uint32_t capacity);
+		void release();
+
+	private:
+		Header* m_Header = nullptr;
+		MetricsCounters* m_Counters = nullptr;
+		size_t m_Size = 0;
+		bool m_Shared = false;
+
+#ifdef _WIN32
+		void* m_FileHandle = nullptr;
+		void* m_MappingHandle = nullptr;
+#endif
+	};
+
+	static_assert(sizeof(MetricsCounters) % MetricsFormat::CACHE_LINE_SIZE == 0, "Counter blocks have to take whole cache lines");
+	static_assert(offsetof(MetricsCounters, Name) == 0x78, "The counter block layout is part of the shared format");
+
+}
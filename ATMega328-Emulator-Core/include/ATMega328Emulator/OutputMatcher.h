@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ATMega328Emulator/Types.h"
+
+namespace ATMega328Emulator {
+
+	struct OutputMatch
+	{
+		int Id = -1;         // What AddLiteral or AddRegex returned
+		uint64_t Cycle = 0;  // When the match's last byte was sent, for the USART the end of its frame
+		uint64_t Offset = 0; // Bytes in the stream up to and including the match's last byte
+	};
+
+	// Scans a byte stream for literal strings and simple regular expressions as it arrives, so a
+	// test can end the moment the firmware prints its verdict instead of running to a timeout.
+	// Nothing of the stream is kept: literals share one Aho-Corasick automaton that takes a table
+	// lookup per byte, each regex is a position automaton stepped with bit masks.
+	// Give it to USART::SetMatcher, or Feed it what the host drained.
+	//
+	// Regexes are a sequence of atoms, each optionally followed by ?, * or +:
+	//   c      a byte, escape .[]\?*+(){}|^$ with a backslash
+	//   .      any byte
+	//   [...]  a class, with ranges like a-z and [^...] for the complement
+	//   \d \w \s and \D \W \S, \n \r \t
+	// There is no alternation or grouping, add one pattern per alternative. A match is found at
+	// every byte it can end on, "a+" matches "aaa" three times. A regex can't match the empty string.
+	class OutputMatcher
+	{
+	public:
+		static constexpr size_t MAX_REGEX_ATOMS = 64;
+
+	public:
+		OutputMatcher();
+
+		// Returns the pattern's id, or -1 if it is empty or, for regexes, malformed or too long.
+		// A terminal pattern ends the scan, see GetTerminalMatch. Add patterns before feeding,
+		// adding a literal starts the literals over.
+		int AddLiteral(std::string_view text, bool terminal = true);
+		int AddRegex(std::string_view pattern, bool terminal = true);
+
+		// Scans one more byte. Returns true if it completed the first terminal match.
+		inline bool Feed(Byte value, uint64_t cycle)
+		{
+			++m_Offset;
+			m_State = m_Transitions[(m_State & STATE_MASK) * 256 + value];
+			bool terminal = false;
+			if (m_State & HAS_OUTPUT) [[unlikely]] {
+				terminal = onLiteralMatch(m_State & STATE_MASK, cycle);
+			}
+			for (Regex& regex : m_Regexes) {
+				terminal |= step(regex, value, cycle);
+			}
+			return terminal;
+		}
+
+		// The same for a run of bytes that all went out around the same cycle, e.g. drained from a ring buffer.
+		bool Feed(std::span<const Byte> data, uint64_t cycle);
+
+		// Starts over on a new stream, the patterns stay.
+		void Reset();
+
+		inline const std::optional<OutputMatch>& GetTerminalMatch() const { return m_Terminal; }
+		inline uint64_t GetMatchCount(int id) const { return m_Patterns[id].Count; }
+		inline const OutputMatch& GetFirstMatch(int id) const { return m_Patterns[id].First; }
+		inline size_t GetPatternCount() const { return m_Patterns.size(); }
+		inline uint64_t GetOffset() const { return m_Offset; }
+
+	private:
+		static constexpr uint32_t HAS_OUTPUT = 1u << 31; // The state ends at least one literal
+		static constexpr uint32_t STATE_MASK = HAS_OUTPUT - 1;
+
+		struct Pattern
+		{
+			bool Terminal;
+			uint64_t Count = 0;
+			OutputMatch First;
+		};
+
+		// Positions are atoms, bit i of a mask is atom i
+		struct Regex
+		{
+			int Id;
+			uint64_t State = 0; // Atoms the last byte may have matched
+			uint64_t First = 0; // Atoms a match can start with
+			uint64_t Final = 0; // Atoms a match can end with
+			std::vector<uint64_t> Follow; // Per atom, the atoms that can come next
+			std::array<uint64_t, 256> Accept = {}; // Per byte, the atoms it matches
+		};
+
+		bool onLiteralMatch(uint32_t state, uint64_t cycle);
+		bool onMatch(int id, uint64_t cycle);
+		void buildAutomaton();
+
+		inline bool step(Regex& regex, Byte value, uint64_t cycle)
+		{
+			uint64_t reach = regex.First;
+			for (uint64_t state = regex.State; state; state &= state - 1) {
+				reach |= regex.Follow[std::countr_zero(state)];
+			}
+			regex.State = reach & regex.Accept[value];
+			return (regex.State & regex.Final) && onMatch(regex.Id, cycle);
+		}
+
+	private:
+		std::vector<Pattern> m_Patterns;
+		std::vector<std::pair<int, std::string>> m_Literals; // Id and text
+
+		// 256 transitions per state, the Aho-Corasick failure links already folded in
+		std::vector<uint32_t> m_Transitions;
+		std::vector<std::vector<int>> m_Outputs; // Per state, the literals ending there
+		std::vector<Regex> m_Regexes;
+
+		uint32_t m_State = 0;
+		uint64_t m_Offset = 0;
+		std::optional<OutputMatch> m_Terminal;
+	};
+
+}
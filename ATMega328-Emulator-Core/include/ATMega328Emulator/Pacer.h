@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Memory.h"
+#include "ATMega328Emulator/Scheduler.h"
+
+namespace ATMega328Emulator {
+
+	struct PacingOptions
+	{
+		// How far emulated time may run ahead of or behind wall time, relative to CPU::FREQUENCY
+		uint64_t JitterBoundNanoseconds = 50'000;
+
+		// Quanta are sized from how much faster than real time the host runs, within these
+		uint64_t MinQuantumCycles = 100;
+		uint64_t MaxQuantumCycles = CPU::FREQUENCY / 100; // 10ms
+
+		// Sleeping wakes up late by the timer slack, so the last stretch before a deadline is spun
+		uint64_t SpinNanoseconds = 100'000;
+
+		// Falling behind by more than this gives up on catching up and pacing restarts from now,
+		// instead of running flat out until the lost time is made up
+		uint64_t ResyncNanoseconds = 10'000'000;
+	};
+
+	struct PacingStats
+	{
+		uint64_t Quanta = 0;
+		uint64_t Overruns = 0;          // Quanta that ended further behind wall time than the jitter bound
+		uint64_t Resyncs = 0;           // Times pacing restarted after falling behind by ResyncNanoseconds
+		uint64_t MaxLagNanoseconds = 0; // Furthest behind wall time at the end of a quantum
+		uint64_t MaxLateWakeNanoseconds = 0; // Furthest past a deadline when waiting for wall time ended
+		uint64_t WaitedNanoseconds = 0; // Sleeping and spinning
+		uint64_t QuantumCycles = 0;     // The current quantum
+	};
+
+	// Runs the CPU in step with wall time for hardware in the loop rigs, neither ahead nor behind.
+	// Execution goes in quanta, as fast as the host can, and waits after each one until
+	// CLOCK_MONOTONIC catches up with the emulated time. The quantum is as long as it can be
+	// while the lead within it stays inside the jitter bound, so a host twice as fast as the chip
+	// syncs every 2 bounds of emulated time and a slow host hardly syncs at all.
+	class Pacer
+	{
+	public:
+		// Cycle the overrun ended at and how far behind wall time it was
+		using OverrunCallback = std::function<void(uint64_t cycle, uint64_t lagNanoseconds)>;
+
+	public:
+		explicit Pacer(const PacingOptions& options = PacingOptions());
+
+		// Ties the CPU's current cycle to now. Execute starts pacing on its own if this wasn't called.
+		void Start(const CPU& cpu);
+		inline void Stop() { m_Started = false; }
+
+		// Runs for at least the given number of cycles and returns when wall time has caught up with them.
+		void Execute(CPU& cpu, Memory& memory, uint64_t cycles);
+
+		// The same with events, every quantum runs through the scheduler.
+		// Returns false if a source asked to stop, like Scheduler::Execute, without waiting for wall time.
+		bool Execute(Scheduler& scheduler, CPU& cpu, Memory& memory, uint64_t cycles);
+
+		inline void SetOverrunCallback(OverrunCallback callback) { m_OverrunCallback = std::move(callback); }
+
+		inline const PacingOptions& GetOptions() const { return m_Options; }
+		inline const PacingStats& GetStats() const { return m_Stats; }
+		inline void ResetStats() { m_Stats = PacingStats(); m_Stats.QuantumCycles = m_QuantumCycles; }
+
+		// CLOCK_MONOTONIC in nanoseconds
+		static uint64_t Now();
+
+		// Emulated nanoseconds for a number of cycles at CPU::FREQUENCY
+		static constexpr uint64_t CyclesToNanoseconds(uint64_t cycles)
+		{
+			return cycles / CPU::FREQUENCY * 1'000'000'000 + cycles % CPU::FREQUENCY * 1'000'000'000 / CPU::FREQUENCY;
+		}
+
+	private:
+		// RunQuantum returns false to stop
+		template<typename RunQuantum>
+		bool execute(CPU& cpu, uint64_t cycles, RunQuantum&& runQuantum);
+
+		// Sleeps, then spins, until Now() reaches the deadline.
+		void waitUntil(uint64_t deadline);
+
+		void adaptQuantum(uint64_t emulatedNanoseconds, uint64_t hostNanoseconds);
+
+	private:
+		PacingOptions m_Options;
+		PacingStats m_Stats;
+		OverrunCallback m_OverrunCallback;
+
+		bool m_Started = false;
+		uint64_t m_StartNanoseconds = 0;
+		uint64_t m_StartCycle = 0;
+		uint64_t m_QuantumCycles = 0;
+	};
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/CPU.h"
+
+namespace ATMega328Emulator {
+
+	// Counts executions and cycles for every word address of the flash.
+	// Attach it with CPU::AttachedProfiler, Run then switches to a loop that records every instruction
+	// into two flat arrays indexed by PC. Nothing else changes, so detached it costs nothing,
+	// and Dist builds don't have the profiled loop at all (see Config.h).
+	class Profiler
+	{
+	public:
+		static constexpr uint32_t FLASH_WORDS = CPU::FLASH_SIZE / 2;
+
+		struct Counters
+		{
+			uint64_t Executions;
+			uint64_t Cycles;
+		};
+
+	public:
+		Profiler();
+
+		void Reset();
+
+		// Called by Run for every retired instruction, pc is where it was fetched from.
+		inline void Record(Word pc, int cycles)
+		{
+			Counters& counters = m_Counters[pc & (FLASH_WORDS - 1)];
+			++counters.Executions;
+			counters.Cycles += cycles;
+		}
+
+		inline const Counters& Get(Word pc) const { return m_Counters[pc & (FLASH_WORDS - 1)]; }
+
+		uint64_t GetTotalExecutions() const;
+		uint64_t GetTotalCycles() const;
+
+		// Callgrind format, for kcachegrind and callgrind_annotate.
+		// Costs are per instruction address (positions: instr) under a single function.
+		void WriteCallgrind(std::ostream& out, const std::string& objectName = "firmware") const;
+
+		// Uncompressed pprof protobuf (profile.proto), which pprof reads as is.
+		// Every address that ran is a location with samples/count and cycles/count values.
+		void WritePprof(std::ostream& out) const;
+
+	private:
+		std::unique_ptr<Counters[]> m_Counters; // FLASH_WORDS entries, too big for the stack
+	};
+
+}
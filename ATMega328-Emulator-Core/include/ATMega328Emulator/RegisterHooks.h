@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "ATMega328Emulator/Types.h"
+
+namespace ATMega328Emulator {
+
+	class CPU;
+
+	// A peripheral that has a say in firmware accesses to its registers, e.g. reading UDR0 pops
+	// the receive buffer and writing it starts a transmission.
+	// Cycle is when the accessing instruction started.
+	class RegisterHook
+	{
+	public:
+		virtual ~RegisterHook() = default;
+
+		// Returns what the firmware reads, value is what the data space holds.
+		virtual Byte OnRead(CPU& cpu, Word address, Byte value, uint64_t cycle) = 0;
+
+		// Returns what the data space keeps, value is what the firmware wrote.
+		virtual Byte OnWrite(CPU& cpu, Word address, Byte value, uint64_t cycle) = 0;
+
+		// A stimulus from outside the chip for one of the hook's registers, e.g. a byte arriving
+		// for UDR0. Returns false if the hook doesn't take inputs at that address.
+		virtual bool OnInput(CPU&, Word, Byte) { return false; }
+
+		// For checkpoints, e.g. the ReverseDebugger's. SaveState appends what RestoreState needs to put
+		// the peripheral back where it was, its registers are saved with the data space. Returns false
+		// if the peripheral can't be checkpointed. Once saved, a peripheral that is restored and run
+		// again must not act on the outside world twice: what it sent isn't sent again and what it
+		// received arrives again at the same cycles.
+		virtual bool SaveState(std::vector<Byte>&) { return false; }
+
+		// Returns the first byte past the ones SaveState appended.
+		virtual const Byte* RestoreState(const Byte* in) { return in; }
+
+	protected:
+		template<typename T>
+		static void SaveValue(std::vector<Byte>& out, const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Saved state is copied byte for byte");
+			const Byte* bytes = reinterpret_cast<const Byte*>(&value);
+			out.insert(out.end(), bytes, bytes + sizeof(T));
+		}
+
+		template<typename T>
+		static const Byte* RestoreValue(const Byte* in, T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Saved state is copied byte for byte");
+			std::memcpy(&value, in, sizeof(T));
+			return in + sizeof(T);
+		}
+	};
+
+	// Routes firmware accesses to registers and I/O below SRAM to the peripherals that own them.
+	// Attach it with CPU::AttachedRegisterHooks. Like Watchpoints, hooked addresses are flagged in
+	// a bitmap, so other accesses cost a bit test. Only accesses made inside Run are hooked,
+	// debuggers, snapshots and peripherals reading or writing between Runs see the plain data space.
+	// Attaching hooks makes Run keep track of the accessing instruction, like watchpoints do.
+	class RegisterHooks
+	{
+	public:
+		static constexpr uint32_t ADDRESS_COUNT = 0x100; // See CPU::SRAM_START
+
+	public:
+		// Hooks [address, address + size), an address has at most one hook, the last one added.
+		// Returns false if the range is empty or runs into the SRAM.
+		bool Add(Word address, Word size, RegisterHook* hook);
+		void Remove(RegisterHook* hook);
+
+		inline bool IsHooked(Word address) const
+		{
+			// Masked the way the CPU masks data space addresses, see CPU::DATA_SPACE_MASK
+			const uint32_t masked = address & 0xFFF;
+			return masked < ADDRESS_COUNT && ((m_Hooked[masked / 64] >> (masked % 64)) & 1);
+		}
+
+		inline RegisterHook* Get(Word address) const { return IsHooked(address) ? m_Hooks[address & 0xFF] : nullptr; }
+
+		// Every hook once, in the order of the first address each has
+		std::vector<RegisterHook*> GetHooks() const;
+
+		// For hooks that scheduled an event earlier than the Scheduler's slice was going to end,
+		// Run stops after the accessing instruction with StopReason::RegisterHook.
+		inline void RequestStop() { m_StopRequested = true; }
+
+		// Whether a hook asked to stop since this was last called. Run takes it after every instruction.
+		inline bool TakeStopRequest()
+		{
+			// Nearly always false, so don't store every time
+			if (!m_StopRequested) {
+				return false;
+			}
+			m_StopRequested = false;
+			return true;
+		}
+
+	private:
+		std::array<RegisterHook*, ADDRESS_COUNT> m_Hooks = {};
+		std::array<uint64_t, ADDRESS_COUNT / 64> m_Hooked = {};
+		bool m_StopRequested = false;
+	};
+
+}
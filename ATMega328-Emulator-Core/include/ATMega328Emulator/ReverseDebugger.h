@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Memory.h"
+#include "ATMega328Emulator/RegisterHooks.h"
+#include "ATMega328Emulator/Snapshot.h"
+#include "ATMega328Emulator/Watchpoints.h"
+
+namespace ATMega328Emulator {
+
+	// Runs the CPU forward while taking periodic checkpoints, so execution can later be stepped backwards.
+	// Going back restores the nearest earlier checkpoint and re-executes forward to the target cycle,
+	// which relies on execution being deterministic between checkpoints.
+	//
+	// The checkpoint interval adapts: it doubles (dropping every other checkpoint) when the history
+	// grows past the memory budget, but never past what can be replayed within the step back time.
+	// Once it can't grow any further the oldest history is dropped instead.
+	//
+	// Checkpoints hold the CPU, memory and the state of the peripherals attached as register hooks,
+	// see RegisterHook::SaveState. Attaching or detaching hooks starts the history over. Peripheral
+	// events aren't driven, so it has to be run on its own rather than through a Scheduler.
+	// Replays run with everything attached to the CPU detached, so profilers, tracers, watchpoints
+	// and metrics only see execution once.
+	class ReverseDebugger
+	{
+	public:
+		struct Config
+		{
+			uint64_t InitialInterval = 100'000;        // Cycles between checkpoints
+			size_t MemoryBudget = 64 * 1024 * 1024;    // Bytes of history to keep
+			double MaxStepBackSeconds = 0.1;           // Host time a single step back may take
+			size_t KeyframeRatio = 4;                  // New full snapshot once a delta grows past 1/n of one
+		};
+
+	public:
+		// Throws std::invalid_argument if a register hook attached to the CPU can't save its state.
+		ReverseDebugger(CPU& cpu, Memory& memory);
+		ReverseDebugger(CPU& cpu, Memory& memory, const Config& config);
+
+		// Runs forward for at least the given number of cycles, taking checkpoints on the way.
+		// Any history after the current cycle is discarded first, all of it if the register hooks changed.
+		// Throws std::invalid_argument if a register hook attached to the CPU can't save its state.
+		void Execute(uint64_t cycles);
+
+		// Moves back to the start of the previous instruction.
+		// Returns false if there is no recorded history before the current cycle.
+		// Going back throws std::invalid_argument if the register hooks changed since Execute.
+		bool StepBack();
+
+		// Moves back to just before the most recent instruction that changed the given data space address.
+		// Returns false, leaving the state untouched, if no such write is in the recorded history.
+		// Writes through the data space are found with a watchpoint at full speed, searching the whole
+		// history newest first. Registers, SREG, SP and hooked registers are also written directly,
+		// so they are single stepped and only searched back one checkpoint interval.
+		bool RunBackToWrite(Word address);
+
+		// Moves to the first instruction boundary at or after the given cycle.
+		// Returns false if the cycle is before the oldest checkpoint.
+		bool SeekTo(uint64_t cycle);
+
+		inline uint64_t GetInterval() const { return m_Interval; }
+		inline size_t GetCheckpointCount() const { return m_Checkpoints.size(); }
+		size_t GetMemoryUsage() const;
+
+	private:
+		struct Checkpoint
+		{
+			uint64_t Cycle;
+			std::shared_ptr<const Snapshot> Base;
+			IncrementalSnapshot Delta;
+			std::vector<Byte> Peripherals; // What m_Peripherals saved, one after another
+		};
+
+		void takeCheckpoint();
+		void enforceBudget();
+		void restore(const Checkpoint& checkpoint);
+
+		// Index of the latest checkpoint strictly before cycle, or the checkpoint count if there is none.
+		size_t findBefore(uint64_t cycle) const;
+
+		// Runs until CycleCount reaches cycle, stopping at the first instruction boundary at or after it.
+		void replayTo(uint64_t cycle);
+
+		std::vector<RegisterHook*> getPeripherals() const;
+
+		// Throws if the register hooks aren't the ones the history was recorded with
+		void checkAttachments() const;
+
+		uint64_t maxInterval() const;
+
+	private:
+		CPU& m_CPU;
+		Memory& m_Memory;
+		Config m_Config;
+
+		std::vector<Checkpoint> m_Checkpoints;
+		std::shared_ptr<const Snapshot> m_Base; // What the dirty bits of the CPU and memory are relative to
+		std::vector<RegisterHook*> m_Peripherals; // The register hooks attached while the history was recorded
+
+		uint64_t m_Interval;
+		double m_CyclesPerSecond = 0.0; // Measured while running forward, replays run at least as fast
+
+		Watchpoints m_Writes; // Attached while RunBackToWrite replays
+	};
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "ATMega328Emulator/Types.h"
+
+namespace ATMega328Emulator {
+
+	// A single producer, single consumer byte queue between the emulator thread and the host.
+	// Neither side locks or waits, the producer writes what fits and the consumer takes what is
+	// there, in bulk. Each side keeps its index and its copy of the other's on a cache line of
+	// its own, so the line only moves between cores when a copy runs out.
+	class RingBuffer
+	{
+	public:
+		static constexpr size_t CACHE_LINE_SIZE = 64;
+
+	public:
+		// The capacity is rounded up to a power of two
+		explicit RingBuffer(size_t capacity);
+
+		RingBuffer(const RingBuffer&) = delete;
+		RingBuffer& operator=(const RingBuffer&) = delete;
+
+		// Producer side. Returns how many bytes fit, the rest are left to the caller.
+		size_t Write(const Byte* data, size_t size);
+
+		inline bool Push(Byte value)
+		{
+			const size_t head = m_Producer.Head.load(std::memory_order_relaxed);
+			if (head - m_Producer.Tail == m_Capacity) {
+				m_Producer.Tail = m_Consumer.Tail.load(std::memory_order_acquire);
+				if (head - m_Producer.Tail == m_Capacity) {
+					return false;
+				}
+			}
+			m_Data[head & (m_Capacity - 1)] = value;
+			m_Producer.Head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer side. Peek returns the bytes that are there without copying them, up to where the
+		// storage wraps; after consuming them the next Peek returns the rest.
+		std::span<const Byte> Peek();
+		void Consume(size_t count);
+
+		// Copies out up to size bytes and consumes them.
+		size_t Read(Byte* data, size_t size);
+
+		inline bool Pop(Byte& value)
+		{
+			const size_t tail = m_Consumer.Tail.load(std::memory_order_relaxed);
+			if (tail == m_Consumer.Head) {
+				m_Consumer.Head = m_Producer.Head.load(std::memory_order_acquire);
+				if (tail == m_Consumer.Head) {
+					return false;
+				}
+			}
+			value = m_Data[tail & (m_Capacity - 1)];
+			m_Consumer.Tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Writes what is there to a file descriptor, e.g. a pipe, a pty or a log file, and consumes
+		// what was written. Stops early on a short write. Returns the bytes written, -1 on an error,
+		// a non-blocking descriptor that would block isn't one.
+		int64_t WriteTo(int fd);
+
+		// From either side, a snapshot that may be out of date by the time it returns
+		inline size_t GetSize() const { return m_Producer.Head.load(std::memory_order_acquire) - m_Consumer.Tail.load(std::memory_order_acquire); }
+		inline bool IsEmpty() const { return GetSize() == 0; }
+		inline size_t GetCapacity() const { return m_Capacity; }
+
+	private:
+		// Indices count bytes since the start and are masked on use
+		struct alignas(CACHE_LINE_SIZE) Producer
+		{
+			std::atomic<size_t> Head = 0;
+			size_t Tail = 0; // The consumer's, as of when it was last looked at
+		};
+
+		struct alignas(CACHE_LINE_SIZE) Consumer
+		{
+			std::atomic<size_t> Tail = 0;
+			size_t Head = 0; // The producer's, as of when it was last looked at
+		};
+
+	private:
+		Producer m_Producer;
+		Consumer m_Consumer;
+		std::unique_ptr<Byte[]> m_Data;
+		size_t m_Capacity;
+	};
+
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Memory.h"
+#include "ATMega328Emulator/RegisterHooks.h"
+#include "ATMega328Emulator/Scheduler.h"
+
+namespace ATMega328Emulator {
+
+	// A slave on the SPI bus, e.g. a flash chip or a display controller.
+	class SPIDevice
+	{
+	public:
+		virtual ~SPIDevice() = default;
+
+		// Chip select went low or high. Bytes sent before it was called have been transferred.
+		virtual void Select() {}
+		virtual void Deselect() {}
+
+		// Clocks a run of bytes through the device, miso is as long as mosi.
+		// Runs are as long as the firmware lets them be, see SPI.
+		virtual void Transfer(std::span<const Byte> mosi, std::span<Byte> miso) = 0;
+	};
+
+	struct SPIStats
+	{
+		uint64_t Bytes = 0;        // Bytes the master clocked out
+		uint64_t Transfers = 0;    // Calls to SPIDevice::Transfer, with a device per call
+		uint64_t SkippedPolls = 0; // Iterations of SPIF polling loops that weren't executed
+		uint64_t Collisions = 0;   // Writes to SPDR during a transfer, WCOL
+	};
+
+	// The SPI in master mode, at the transaction level. A byte takes 8 SCK periods from the write
+	// to SPDR and SPIF is worked out from the cycle the firmware looks at it, so polling and the
+	// interrupt both see the clock rate.
+	//
+	// Block transfers cost the host a few nanoseconds a byte instead of an emulated polling loop and
+	// a device call each:
+	//  - A read of SPSR at the top of the usual polling loop, in/sbrs/rjmp or lds/sbrs/rjmp, stalls
+	//    the IN for as many iterations as the loop would have taken and returns SPIF set. The CPU
+	//    ends up in the same state on the same cycle, the skipped iterations just don't retire.
+	//  - Sent bytes are collected and given to the device in one Transfer call when the firmware
+	//    reads SPDR, a chip select changes, a run grows to RUN_SIZE or Flush is called. Writing a
+	//    display is one call per run, reading flash one per byte read.
+	//
+	// Devices are selected with an active low pin, set as an output, on PORTB, PORTC or PORTD.
+	// Without a pin a device is always selected. With nothing selected MISO reads 0xFF.
+	//
+	// Wire it up with
+	//   cpu.AttachedRegisterHooks = &hooks;
+	//   spi.AddDevice(&flash, PORTB_ADDRESS, 2);
+	//   spi.Attach(hooks, memory);
+	//   scheduler.Add(&spi);
+	//   spi.Reset(cpu);
+	//
+	// Checkpoints save the byte in flight and the bytes collected. From the first one on, what MISO
+	// answered is logged, so running the same cycles again reads the same answers without the
+	// devices seeing those bytes or chip select changes a second time.
+	//
+	// Not modelled: slave mode, the SS pin turning the master into a slave, DORD, CPOL and CPHA,
+	// which devices here don't need since they see whole bytes. A polling loop a Run is told to
+	// stop in, see StopConditions::PC, is executed instead of skipped.
+	class SPI : public EventSource, public RegisterHook
+	{
+	public:
+		static constexpr Word SPCR_ADDRESS = CPU::IO_START + 0x2C;
+		static constexpr Word SPSR_ADDRESS = CPU::IO_START + 0x2D;
+		static constexpr Word SPDR_ADDRESS = CPU::IO_START + 0x2E;
+
+		static constexpr Word PORTB_ADDRESS = CPU::IO_START + 0x05;
+		static constexpr Word PORTC_ADDRESS = CPU::IO_START + 0x08;
+		static constexpr Word PORTD_ADDRESS = CPU::IO_START + 0x0B;
+
+		static constexpr Byte STC_VECTOR = 17; // SPI_STC, serial transfer complete
+
+		// SPCR
+		static constexpr Byte SPR0 = 1 << 0;
+		static constexpr Byte SPR1 = 1 << 1;
+		static constexpr Byte CPHA = 1 << 2;
+		static constexpr Byte CPOL = 1 << 3;
+		static constexpr Byte MSTR = 1 << 4;
+		static constexpr Byte DORD = 1 << 5;
+		static constexpr Byte SPE = 1 << 6;
+		static constexpr Byte SPIE = 1 << 7;
+
+		// SPSR
+		static constexpr Byte SPI2X = 1 << 0;
+		static constexpr Byte WCOL = 1 << 6;
+		static constexpr Byte SPIF = 1 << 7;
+
+		static constexpr size_t RUN_SIZE = 4096;
+
+		// An interrupt that is due while interrupts are disabled is tried again this much later
+		static constexpr uint64_t INTERRUPT_RETRY_CYCLES = 32;
+
+	public:
+		SPI();
+
+		// Hooks SPCR, SPSR, SPDR and the chip select ports and pins' DDRs. The flash is looked at
+		// to recognise polling loops.
+		void Attach(RegisterHooks& hooks, const Memory& memory);
+		void Detach();
+
+		// port is PORTB_ADDRESS, PORTC_ADDRESS or PORTD_ADDRESS, or 0 for a device that is always selected.
+		// Returns false for any other port or a pin past 7.
+		bool AddDevice(SPIDevice* device, Word port = 0, Byte pin = 0);
+
+		// Puts the registers in their reset state, drops the byte in flight and the bytes collected
+		// and works out which devices are selected from the ports.
+		void Reset(CPU& cpu);
+
+		// Finishes the byte in flight if it is done by now and hands the collected bytes to the
+		// selected devices, e.g. before looking at a device after Execute.
+		void Flush(const CPU& cpu);
+
+		inline const SPIStats& GetStats() const { return m_Stats; }
+
+		// Cycles a byte takes with SPCR and SPSR as they are
+		static uint64_t GetByteCycles(const CPU& cpu);
+
+		uint64_t GetNextEventCycle() const override;
+		void HandleEvents(CPU& cpu, Memory& memory) override;
+		std::vector<RegisterRange> GetRegisters() const override;
+
+		Byte OnRead(CPU& cpu, Word address, Byte value, uint64_t cycle) override;
+		Byte OnWrite(CPU& cpu, Word address, Byte value, uint64_t cycle) override;
+
+		bool SaveState(std::vector<Byte>& out) override;
+		const Byte* RestoreState(const Byte* in) override;
+
+	private:
+		struct Slave
+		{
+			SPIDevice* Device;
+			Word Port;
+			Byte Pin;
+			bool Selected;
+		};
+
+		// Finishes the byte in flight if it ends at or before cycle
+		void advance(uint64_t cycle);
+
+		// Hands the collected bytes to the selected devices
+		void flush();
+
+		// The cycles the SPSR read at cycle can skip, if it is the top of a polling loop that would only wait.
+		// Counts the iterations as skipped.
+		int getSkippableCycles(const CPU& cpu, uint64_t cycle);
+
+		// Flushes, then tells the devices whose chip select changed. The write to address hasn't landed yet.
+		void updateSelection(const CPU& cpu, Word address, Byte value);
+
+		// Clears SPIF and WCOL if SPSR was read with them set, on an SPDR access
+		void clearFlags();
+
+		Byte getStatus() const;
+
+		// Makes sure an interrupt or event the access brought forward is handled on time
+		void onAccessed(uint64_t nextEventBefore, uint64_t cycle);
+
+	private:
+		std::vector<Slave> m_Slaves;
+		RegisterHooks* m_Hooks = nullptr;
+		const Memory* m_Memory = nullptr;
+		SPIStats m_Stats;
+
+		Byte m_Control = 0; // SPCR
+		Byte m_Mode = 0;    // SPI2X
+		uint64_t m_InterruptCycle = NO_EVENT;
+
+		bool m_Busy = false;
+		bool m_Complete = false;   // SPIF
+		bool m_Collision = false;  // WCOL
+		bool m_FlagsSeen = false;  // SPSR was read with SPIF or WCOL set, accessing SPDR clears them
+		Byte m_Shift = 0;
+		Byte m_Received = 0xFF;
+		uint64_t m_End = 0;
+
+		// Sent, not handed to the devices yet, and what a device answered to them
+		std::vector<Byte> m_Run;
+		std::vector<Byte> m_Miso;
+
+		// Going back and running again, only m_Selections is saved with the rest.
+		// Bytes are numbered by SPIStats::Bytes, the log holds MISO from byte m_LogStart on.
+		bool m_Logging = false;
+		std::vector<Byte> m_Log;
+		uint64_t m_LogStart = 0;
+		uint64_t m_Delivered = 0;           // Bytes the devices have seen
+		uint64_t m_Selections = 0;          // Chip select changes
+		uint64_t m_SelectionsDelivered = 0; // Of those, the ones the devices have seen
+	};
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ATMega328Emulator/Types.h"
+
+namespace ATMega328Emulator {
+
+	class CPU;
+
+	// Takes a sample of the PC, SP and interrupt context about every MeanInterval cycles.
+	// The interval is drawn uniformly from [MeanInterval / 2, MeanInterval * 3 / 2] so it can't
+	// lock onto a firmware loop of the same period.
+	// Attach it with CPU::AttachedSampler. Run ends its slices where the next sample is due,
+	// so sampling costs nothing per instruction and works in every build configuration.
+	// Samples go into a ring buffer that keeps the most recent Capacity of them.
+	class SamplingProfiler
+	{
+	public:
+		struct Sample
+		{
+			uint64_t Cycle;
+			Word PC;              // The next instruction to execute
+			Word SP;
+			Byte InterruptDepth;  // Nested interrupt handlers, 0 in the main program
+			Byte InterruptVector; // The innermost handler's vector, if InterruptDepth is set
+			bool InterruptsEnabled;
+		};
+
+	public:
+		SamplingProfiler(uint32_t meanInterval = 10'000, size_t capacity = 4096, uint64_t seed = 1);
+
+		void Reset();
+
+		// Cycles until the next sample is due, Run uses it to end the slice there.
+		inline int GetCyclesUntilSample() const { return m_Countdown > 0 ? (int)m_Countdown : 0; }
+
+		// Called by Run after every slice with the cycles it took.
+		inline void Advance(const CPU& cpu, int cycles)
+		{
+			m_Countdown -= cycles;
+			if (m_Countdown <= 0) {
+				take(cpu);
+			}
+		}
+
+		// Oldest first.
+		std::vector<Sample> GetSamples() const;
+
+		// Including the ones the ring buffer has dropped since.
+		inline uint64_t GetTotalSamples() const { return m_Total; }
+		inline size_t GetCapacity() const { return m_Capacity; }
+
+	private:
+		void take(const CPU& cpu);
+		uint32_t nextInterval();
+
+	private:
+		uint32_t m_MeanInterval;
+		size_t m_Capacity;
+		uint64_t m_Seed;
+		uint64_t m_State;
+
+		int64_t m_Countdown;
+		uint64_t m_Total = 0;
+		std::unique_ptr<Sample[]> m_Samples;
+	};
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Memory.h"
+#include "ATMega328Emulator/Watchpoints.h"
+
+namespace ATMega328Emulator {
+
+	// Data space addresses [Address, Address + Size)
+	struct RegisterRange
+	{
+		Word Address;
+		Word Size;
+	};
+
+	// Anything that has to act at a specific cycle, e.g. a peripheral or a stimulus stream.
+	class EventSource
+	{
+	public:
+		static constexpr uint64_t NO_EVENT = UINT64_MAX;
+
+	public:
+		virtual ~EventSource() = default;
+
+		// Cycle of the next pending event, NO_EVENT if there is none.
+		virtual uint64_t GetNextEventCycle() const = 0;
+
+		// Handles every event due at or before cpu.CycleCount.
+		virtual void HandleEvents(CPU& cpu, Memory& memory) = 0;
+
+		// The registers the firmware talks to this source through, if any, asked once when it is added.
+		// See Scheduler::SetQuantum.
+		virtual std::vector<RegisterRange> GetRegisters() const { return {}; }
+
+		// Whether the source asked Execute to return since this was last called, e.g. because the
+		// firmware printed its verdict. Asked right after the source handled its events.
+		virtual bool TakeStopRequest() { return false; }
+	};
+
+	// Runs the CPU in slices that end at the next event, so events happen on the exact
+	// instruction boundary they were scheduled for without any per instruction checks.
+	class Scheduler
+	{
+	public:
+		Scheduler();
+
+		void Add(EventSource* source);
+		void Remove(EventSource* source);
+
+		// Runs the CPU for at least the given number of cycles.
+		// Returns false if a source asked to stop before then, see EventSource::TakeStopRequest.
+		bool Execute(CPU& cpu, Memory& memory, uint64_t cycles);
+
+		uint64_t GetNextEventCycle() const;
+
+		// 0, the default, is exact. A quantum lets the CPU run that many cycles past a due event before
+		// the sources handle it, so sources with dense events cost a slice per quantum instead of one
+		// per event. Events are handled late by up to the quantum, still in order.
+		// Accessing a source's registers ends the quantum after the accessing instruction, so a
+		// polling loop sees the source catch up on its next poll. That uses the CPU's watchpoint
+		// slot, with other Watchpoints attached quanta always run their full length.
+		inline void SetQuantum(uint64_t cycles) { m_Quantum = cycles; }
+		inline uint64_t GetQuantum() const { return m_Quantum; }
+
+	private:
+		// Returns true if a source asked to stop
+		bool handleDueEvents(CPU& cpu, Memory& memory);
+		void watchRegisters();
+
+	private:
+		std::vector<EventSource*> m_Sources;
+		uint64_t m_Quantum = 0;
+		Watchpoints m_Registers; // Every source's registers, watched in decoupled mode
+	};
+
+}
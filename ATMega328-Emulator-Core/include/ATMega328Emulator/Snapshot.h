@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Memory.h"
+
+namespace ATMega328Emulator {
+
+	// Full copy of the CPU and the program memory.
+	// Only the chip's state is restored, whatever is attached to the CPU and its Run bookkeeping are left alone.
+	// Capturing clears the dirty bits, so incremental snapshots can be taken against it.
+	class Snapshot
+	{
+	public:
+		static Snapshot Capture(CPU& cpu, Memory& memory);
+
+		void Restore(CPU& cpu, Memory& memory) const;
+
+		inline size_t GetSize() const { return sizeof(State) + Flash.size(); }
+
+	public:
+		CPU State;
+		std::vector<Byte> Flash;
+	};
+
+	// Holds only what changed since a base Snapshot.
+	// Every page is stored as a run-length encoded XOR delta against the base,
+	// so pages that were written but barely changed take a few bytes.
+	//
+	// Encoding, repeated until a page is complete:
+	//   0b1nnn'nnnn         - n + 1 unchanged bytes
+	//   0b0nnn'nnnn <bytes> - n + 1 bytes to XOR into the base
+	class IncrementalSnapshot
+	{
+	public:
+		static constexpr uint32_t PAGE_SIZE = 64;
+
+	public:
+		// The dirty bits must not have been cleared since base was captured.
+		static IncrementalSnapshot Capture(const Snapshot& base, const CPU& cpu, const Memory& memory);
+
+		// Brings the CPU and memory to the captured state.
+		// Both have to still be derived from base, i.e. base was the last full snapshot restored or taken.
+		void Restore(const Snapshot& base, CPU& cpu, Memory& memory) const;
+
+		inline size_t GetSize() const { return m_Data.size(); }
+		inline uint32_t GetPageCount() const { return m_PageCount; }
+
+	private:
+		std::vector<Byte> m_Data;
+		uint32_t m_PageCount = 0;
+	};
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Memory.h"
+#include "ATMega328Emulator/Scheduler.h"
+
+namespace ATMega328Emulator {
+
+	enum class StimulusType : Byte
+	{
+		PINB = 0, // Value is the new pin levels of port B
+		PINC,     // Value is the new pin levels of port C
+		PIND,     // Value is the new pin levels of port D
+		UDR0,     // Value is a byte received by USART0, an attached USART receives it at the baud rate
+		ADC,      // Value is a 10-bit conversion result
+
+		Count
+	};
+
+	// An input from outside the chip.
+	struct Stimulus
+	{
+		uint64_t Cycle;
+		StimulusType Type;
+		Word Value;
+
+		// Drives the input into the CPU.
+		// This is the one place external inputs enter, so harnesses never poke registers themselves.
+		void Apply(CPU& cpu) const;
+	};
+
+	// Compact log encoding, one record per stimulus:
+	//   LEB128 cycle delta from the previous record (from 0 for the first)
+	//   1 byte type
+	//   1 byte value, 2 bytes little endian for ADC
+	namespace StimulusEncoding {
+
+		// Appends a record. Returns the cycle to pass as previousCycle for the next one.
+		uint64_t Encode(std::vector<Byte>& out, const Stimulus& stimulus, uint64_t previousCycle);
+
+		// Decodes the record at in. Returns the position after it, or nullptr if it is truncated or invalid.
+		const Byte* Decode(const Byte* in, const Byte* end, Stimulus& stimulus, uint64_t previousCycle);
+
+	}
+
+	// Applies stimuli and logs them with the cycle they happened at.
+	class StimulusRecorder
+	{
+	public:
+		// Applies the stimulus to the CPU now, and records it at the current cycle.
+		void Inject(CPU& cpu, StimulusType type, Word value);
+
+		inline const std::vector<Byte>& GetLog() const { return m_Log; }
+		inline size_t GetCount() const { return m_Count; }
+
+		// Writes the log as a stimulus file, see StimulusFile.h.
+		bool Save(const std::string& filepath) const;
+
+	private:
+		std::vector<Byte> m_Log;
+		uint64_t m_LastCycle = 0;
+		size_t m_Count = 0;
+	};
+
+	// Feeds a recorded log back in at exactly the cycles it was recorded at.
+	// Records are decoded one at a time as they come due, the log is not copied.
+	class StimulusReplayer : public EventSource
+	{
+	public:
+		// The log has to outlive the replayer.
+		// startCycle is what the first record's cycle delta is relative to.
+		StimulusReplayer(const Byte* log, size_t size, uint64_t startCycle = 0);
+		StimulusReplayer(const std::vector<Byte>& log);
+
+		virtual uint64_t GetNextEventCycle() const override;
+		virtual void HandleEvents(CPU& cpu, Memory& memory) override;
+
+		inline bool IsDone() const { return !m_HasNext; }
+
+		// Start of the records not yet consumed.
+		inline const Byte* GetPosition() const { return m_Cursor; }
+
+		// False if the log ended in a truncated or invalid record.
+		inline bool IsValid() const { return m_Valid; }
+
+	private:
+		void decodeNext();
+
+	private:
+		const Byte* m_Cursor;
+		const Byte* m_End;
+
+		Stimulus m_Next = {};
+		bool m_HasNext = false;
+		bool m_Valid = true;
+	};
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/Stimulus.h"
+#include "ATMega328Emulator/Scheduler.h"
+
+/*
+ * Stimulus file format (.avrs), all values little endian
+ *
+ * Header, 16 bytes
+ *   0x00  4  Magic "AVRS"
+ *   0x04  2  Version, currently 1
+ *   0x06  2  Flags, reserved and 0
+ *   0x08  8  Start cycle, what the first record's cycle delta is relative to
+ *
+ * Records, back to back until the end of the file
+ *   LEB128  Cycles since the previous record (or the start cycle)
+ *   1       Type, see StimulusType
+ *             0 PINB - new pin levels of port B
+ *             1 PINC - new pin levels of port C
+ *             2 PIND - new pin levels of port D
+ *             3 UDR0 - byte received by USART0
+ *             4 ADC  - conversion result
+ *   1 or 2  Value, 2 bytes for ADC (10-bit result) and 1 byte for everything else
+ *
+ * Records are in cycle order. Several records may share a cycle and are applied in file order.
+ * There is no index or footer, so a capture can be appended to while it is being recorded.
+ */
+
+namespace ATMega328Emulator {
+
+	namespace StimulusFileFormat {
+
+		static constexpr char MAGIC[4] = { 'A', 'V', 'R', 'S' };
+		static constexpr uint16_t VERSION = 1;
+		static constexpr size_t HEADER_SIZE = 16;
+
+	}
+
+	// Streams records to a stimulus file as they are written, nothing is kept in memory.
+	class StimulusFileWriter
+	{
+	public:
+		~StimulusFileWriter();
+
+		bool Open(const std::string& filepath, uint64_t startCycle = 0);
+
+		// Returns false if anything written since Open didn't make it to the file.
+		bool Close();
+
+		void Write(const Stimulus& stimulus);
+
+		// Appends already encoded records, e.g. a StimulusRecorder log starting at the start cycle.
+		void WriteEncoded(const Byte* records, size_t size, uint64_t lastCycle);
+
+		inline bool IsOpen() const { return m_Stream.is_open(); }
+
+	private:
+		void flush();
+
+	private:
+		std::ofstream m_Stream;
+		std::vector<Byte> m_Buffer;
+		uint64_t m_LastCycle = 0;
+	};
+
+	// A memory mapped stimulus file that feeds its records to a Scheduler as they come due.
+	// Opening only maps the file; records are decoded lazily and pages that have been
+	// consumed are handed back to the OS, so a capture of any size replays without a load phase.
+	class StimulusFile : public EventSource
+	{
+	public:
+		StimulusFile() = default;
+		~StimulusFile();
+
+		StimulusFile(const StimulusFile&) = delete;
+		StimulusFile& operator=(const StimulusFile&) = delete;
+
+		bool Open(const std::string& filepath);
+		void Close();
+
+		virtual uint64_t GetNextEventCycle() const override;
+		virtual void HandleEvents(CPU& cpu, Memory& memory) override;
+
+		inline bool IsOpen() const { return m_Data != nullptr; }
+		inline bool IsDone() const { return !m_Replayer || m_Replayer->IsDone(); }
+		inline bool IsValid() const { return m_Replayer && m_Replayer->IsValid(); }
+
+		inline uint64_t GetStartCycle() const { return m_StartCycle; }
+		inline size_t GetSize() const { return m_Size; }
+
+	private:
+		void releaseConsumed();
+
+	private:
+		const Byte* m_Data = nullptr;
+		size_t m_Size = 0;
+		uint64_t m_StartCycle = 0;
+
+		std::unique_ptr<StimulusReplayer> m_Replayer;
+		const Byte* m_Released = nullptr; // Everything before this has been handed back
+
+#ifdef _WIN32
+		void* m_FileHandle = nullptr;
+		void* m_MappingHandle = nullptr;
+#endif
+	};
+
+}
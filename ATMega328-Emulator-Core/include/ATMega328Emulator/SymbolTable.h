@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ATMega328Emulator/Types.h"
+
+namespace ATMega328Emulator {
+
+	// Function names for flash addresses. Addresses are in bytes, like the ELF and avr-objdump use.
+	class SymbolTable
+	{
+	public:
+		struct Symbol
+		{
+			uint32_t Address;
+			uint32_t Size;
+			std::string Name;
+		};
+
+	public:
+		// Adds the function symbols of an AVR ELF file's symbol table.
+		// Returns false if the file can't be read or isn't a 32-bit little endian ELF with a symbol table.
+		bool LoadElf(const std::string& filepath);
+		bool LoadElf(const Byte* data, size_t size);
+
+		void Add(uint32_t address, uint32_t size, std::string name);
+
+		// The function containing address, or nullptr.
+		// A symbol without a size covers everything up to the next one.
+		const Symbol* Find(uint32_t address) const;
+
+		// The containing function's name, or the address as 0x%04X.
+		std::string GetName(uint32_t address) const;
+
+		inline size_t GetCount() const { return m_Symbols.size(); }
+
+	private:
+		std::vector<Symbol> m_Symbols; // Sorted by address
+	};
+
+}
@@ -0,0 +1,335 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <iterator>
+
+#include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/Instructions.h"
+
+// Cycle counts are from the AVR Instruction Set Manual, for devices with a 16-bit PC like the ATmega328.
+// This is the only place cycles are known; CPU::Execute charges them and handlers don't count at all.
+
+namespace ATMega328Emulator {
+
+	// One entry per instruction the CPU implements.
+	enum class OpcodeClass : Byte
+	{
+		Unknown = 0,
+
+		ADC, ADD, ADIW, AND, ANDI, ASR,
+		BCLR, BLD, BRBC, BRBS, BREAK, BSET, BST,
+		CALL, CBI, COM, CP, CPC, CPI, CPSE,
+		DEC, EOR,
+		FMUL, FMULS, FMULSU,
+		ICALL, IJMP, IN, INC,
+		JMP,
+		LAC, LAS, LAT, LD, LDD, LDI, LDS, LPM, LSR,
+		MOV, MOVW, MUL, MULS, MULSU,
+		NEG, NOP,
+		OR, ORI, OUT,
+		POP, PUSH,
+		RCALL, RET, RETI, RJMP, ROR,
+		SBC, SBCI, SBI, SBIC, SBIS, SBIW, SBRC, SBRS, SLEEP,
+		ST, STD, STS, SUB, SUBI, SWAP,
+
+		Count
+	};
+
+	// Mnemonics for reports and disassembly, indexed by OpcodeClass.
+	constexpr const char* OPCODE_NAMES[] = {
+		"???",
+
+		"ADC", "ADD", "ADIW", "AND", "ANDI", "ASR",
+		"BCLR", "BLD", "BRBC", "BRBS", "BREAK", "BSET", "BST",
+		"CALL", "CBI", "COM", "CP", "CPC", "CPI", "CPSE",
+		"DEC", "EOR",
+		"FMUL", "FMULS", "FMULSU",
+		"ICALL", "IJMP", "IN", "INC",
+		"JMP",
+		"LAC", "LAS", "LAT", "LD", "LDD", "LDI", "LDS", "LPM", "LSR",
+		"MOV", "MOVW", "MUL", "MULS", "MULSU",
+		"NEG", "NOP",
+		"OR", "ORI", "OUT",
+		"POP", "PUSH",
+		"RCALL", "RET", "RETI", "RJMP", "ROR",
+		"SBC", "SBCI", "SBI", "SBIC", "SBIS", "SBIW", "SBRC", "SBRS", "SLEEP",
+		"ST", "STD", "STS", "SUB", "SUBI", "SWAP",
+	};
+	static_assert(std::size(OPCODE_NAMES) == (size_t)OpcodeClass::Count, "Every opcode class needs a name");
+
+	constexpr const char* GetOpcodeName(OpcodeClass opcode)
+	{
+		return (size_t)opcode < std::size(OPCODE_NAMES) ? OPCODE_NAMES[(size_t)opcode] : "???";
+	}
+
+	struct InstructionTiming
+	{
+		Byte Words;       // Including the operand word of 32-bit instructions
+		Byte Cycles;      // Branch not taken, or nothing skipped
+		Byte TakenCycles; // Branch taken, or a 1 word instruction skipped. Skipping a 2 word instruction takes one more
+	};
+
+	namespace Timing {
+
+		static constexpr std::array<InstructionTiming, (size_t)OpcodeClass::Count> TABLE = [] {
+			std::array<InstructionTiming, (size_t)OpcodeClass::Count> table = {};
+
+			auto set = [&](OpcodeClass opcode, Byte words, Byte cycles, Byte takenCycles = 0) {
+				table[(size_t)opcode] = { words, cycles, takenCycles ? takenCycles : cycles };
+			};
+
+			// Unknown opcodes are skipped, which costs their fetch
+			set(OpcodeClass::Unknown, 1, 1);
+
+			set(OpcodeClass::ADC, 1, 1);
+			set(OpcodeClass::ADD, 1, 1);
+			set(OpcodeClass::ADIW, 1, 2);
+			set(OpcodeClass::AND, 1, 1);
+			set(OpcodeClass::ANDI, 1, 1);
+			set(OpcodeClass::ASR, 1, 1);
+			set(OpcodeClass::BCLR, 1, 1);
+			set(OpcodeClass::BLD, 1, 1);
+			set(OpcodeClass::BRBC, 1, 1, 2);
+			set(OpcodeClass::BRBS, 1, 1, 2);
+			set(OpcodeClass::BREAK, 1, 1);
+			set(OpcodeClass::BSET, 1, 1);
+			set(OpcodeClass::BST, 1, 1);
+			set(OpcodeClass::CALL, 2, 4);
+			set(OpcodeClass::CBI, 1, 2);
+			set(OpcodeClass::COM, 1, 1);
+			set(OpcodeClass::CP, 1, 1);
+			set(OpcodeClass::CPC, 1, 1);
+			set(OpcodeClass::CPI, 1, 1);
+			set(OpcodeClass::CPSE, 1, 1, 2);
+			set(OpcodeClass::DEC, 1, 1);
+			set(OpcodeClass::EOR, 1, 1);
+			set(OpcodeClass::FMUL, 1, 2);
+			set(OpcodeClass::FMULS, 1, 2);
+			set(OpcodeClass::FMULSU, 1, 2);
+			set(OpcodeClass::ICALL, 1, 3);
+			set(OpcodeClass::IJMP, 1, 2);
+			set(OpcodeClass::IN, 1, 1);
+			set(OpcodeClass::INC, 1, 1);
+			set(OpcodeClass::JMP, 2, 3);
+			set(OpcodeClass::LAC, 1, 2);
+			set(OpcodeClass::LAS, 1, 2);
+			set(OpcodeClass::LAT, 1, 2);
+			set(OpcodeClass::LD, 1, 2);
+			set(OpcodeClass::LDD, 1, 2);
+			set(OpcodeClass::LDI, 1, 1);
+			set(OpcodeClass::LDS, 2, 2);
+			set(OpcodeClass::LPM, 1, 3);
+			set(OpcodeClass::LSR, 1, 1);
+			set(OpcodeClass::MOV, 1, 1);
+			set(OpcodeClass::MOVW, 1, 1);
+			set(OpcodeClass::MUL, 1, 2);
+			set(OpcodeClass::MULS, 1, 2);
+			set(OpcodeClass::MULSU, 1, 2);
+			set(OpcodeClass::NEG, 1, 1);
+			set(OpcodeClass::NOP, 1, 1);
+			set(OpcodeClass::OR, 1, 1);
+			set(OpcodeClass::ORI, 1, 1);
+			set(OpcodeClass::OUT, 1, 1);
+			set(OpcodeClass::POP, 1, 2);
+			set(OpcodeClass::PUSH, 1, 2);
+			set(OpcodeClass::RCALL, 1, 3);
+			set(OpcodeClass::RET, 1, 4);
+			set(OpcodeClass::RETI, 1, 4);
+			set(OpcodeClass::RJMP, 1, 2);
+			set(OpcodeClass::ROR, 1, 1);
+			set(OpcodeClass::SBC, 1, 1);
+			set(OpcodeClass::SBCI, 1, 1);
+			set(OpcodeClass::SBI, 1, 2);
+			set(OpcodeClass::SBIC, 1, 1, 2);
+			set(OpcodeClass::SBIS, 1, 1, 2);
+			set(OpcodeClass::SBIW, 1, 2);
+			set(OpcodeClass::SBRC, 1, 1, 2);
+			set(OpcodeClass::SBRS, 1, 1, 2);
+			set(OpcodeClass::SLEEP, 1, 1);
+			set(OpcodeClass::ST, 1, 2);
+			set(OpcodeClass::STD, 1, 2);
+			set(OpcodeClass::STS, 2, 2);
+			set(OpcodeClass::SUB, 1, 1);
+			set(OpcodeClass::SUBI, 1, 1);
+			set(OpcodeClass::SWAP, 1, 1);
+
+			return table;
+		}();
+
+		static_assert([] {
+			for (const InstructionTiming& timing : TABLE) {
+				if (timing.Words == 0 || timing.Cycles == 0) {
+					return false;
+				}
+			}
+			return true;
+		}(), "Every opcode class needs a timing");
+
+		constexpr const InstructionTiming& Get(OpcodeClass opcode)
+		{
+			return TABLE[(size_t)opcode];
+		}
+
+		// Cycles the instruction takes, skipped is the number of words a skip instruction jumped over.
+		constexpr int GetCycles(OpcodeClass opcode, bool taken, Byte skipped = 0)
+		{
+			const InstructionTiming& timing = Get(opcode);
+			if (!taken) {
+				return timing.Cycles;
+			}
+			return timing.TakenCycles + (skipped > 1 ? skipped - 1 : 0);
+		}
+
+		// True for the 32-bit instructions (LDS, STS, JMP, CALL), whether or not they are implemented.
+		// Skip instructions need this to step over the operand word as well.
+		constexpr bool IsTwoWord(Word instruction)
+		{
+			return (instruction & 0b1111'1100'0000'1111) == 0b1001'0000'0000'0000 // LDS, STS
+				|| (instruction & 0b1111'1110'0000'1100) == 0b1001'0100'0000'1100; // JMP, CALL
+		}
+
+		// Works out which instruction an opcode is, in the same order CPU::Execute always has.
+		constexpr OpcodeClass Decode(Word instruction)
+		{
+			using namespace Instruction;
+
+			switch (instruction)
+			{
+				case BREAK: return OpcodeClass::BREAK;
+				case ICALL: return OpcodeClass::ICALL;
+				case IJMP: return OpcodeClass::IJMP;
+				case LPM: return OpcodeClass::LPM;
+				case NOP: return OpcodeClass::NOP;
+				case RET: return OpcodeClass::RET;
+				case RETI: return OpcodeClass::RETI;
+				case SLEEP: return OpcodeClass::SLEEP;
+				default: break;
+			}
+
+			// Bit 8 has to be part of the mask, WDR, SPM and ELPM only differ from BCLR there
+			switch (instruction & 0b1111'1111'1000'1111)
+			{
+				case BSET: return OpcodeClass::BSET;
+				case BCLR: return OpcodeClass::BCLR;
+				default: break;
+			}
+
+			switch (instruction & 0b1111'1110'0000'1111)
+			{
+				case ASR: return OpcodeClass::ASR;
+				case COM: return OpcodeClass::COM;
+				case DEC: return OpcodeClass::DEC;
+				case INC: return OpcodeClass::INC;
+				case LAC: return OpcodeClass::LAC;
+				case LAS: return OpcodeClass::LAS;
+				case LAT: return OpcodeClass::LAT;
+				case LD_X: case LD_X_INC: case LD_X_DEC:
+				case LD_Y_INC: case LD_Y_DEC:
+				case LD_Z_INC: case LD_Z_DEC: return OpcodeClass::LD;
+				case LDS: return OpcodeClass::LDS;
+				case LPM_Z: case LPM_Z_INC: return OpcodeClass::LPM;
+				case LSR: return OpcodeClass::LSR;
+				case NEG: return OpcodeClass::NEG;
+				case POP: return OpcodeClass::POP;
+				case PUSH: return OpcodeClass::PUSH;
+				case ROR: return OpcodeClass::ROR;
+				case ST_X: case ST_X_INC: case ST_X_DEC:
+				case ST_Y_INC: case ST_Y_DEC:
+				case ST_Z_INC: case ST_Z_DEC: return OpcodeClass::ST;
+				case STS: return OpcodeClass::STS;
+				case SWAP: return OpcodeClass::SWAP;
+				default: break;
+			}
+
+			switch (instruction & 0b1111'1110'0000'1110)
+			{
+				case CALL: return OpcodeClass::CALL;
+				case JMP: return OpcodeClass::JMP;
+				default: break;
+			}
+
+			switch (instruction & 0b1111'1111'1000'1000)
+			{
+				case FMUL: return OpcodeClass::FMUL;
+				case FMULS: return OpcodeClass::FMULS;
+				case FMULSU: return OpcodeClass::FMULSU;
+				case MULSU: return OpcodeClass::MULSU;
+				default: break;
+			}
+
+			switch (instruction & 0b1111'1111'0000'0000)
+			{
+				case ADIW: return OpcodeClass::ADIW;
+				case CBI: return OpcodeClass::CBI;
+				case MOVW: return OpcodeClass::MOVW;
+				case MULS: return OpcodeClass::MULS;
+				case SBI: return OpcodeClass::SBI;
+				case SBIC: return OpcodeClass::SBIC;
+				case SBIS: return OpcodeClass::SBIS;
+				case SBIW: return OpcodeClass::SBIW;
+				default: break;
+			}
+
+			switch (instruction & 0b1111'1110'0000'1000)
+			{
+				case BLD: return OpcodeClass::BLD;
+				case BST: return OpcodeClass::BST;
+				case SBRC: return OpcodeClass::SBRC;
+				case SBRS: return OpcodeClass::SBRS;
+				default: break;
+			}
+
+			switch (instruction & 0b1111'1100'0000'0000)
+			{
+				case ADC: return OpcodeClass::ADC;
+				case ADD: return OpcodeClass::ADD;
+				case AND: return OpcodeClass::AND;
+				case BRBC: return OpcodeClass::BRBC;
+				case BRBS: return OpcodeClass::BRBS;
+				case CP: return OpcodeClass::CP;
+				case CPC: return OpcodeClass::CPC;
+				case CPSE: return OpcodeClass::CPSE;
+				case EOR: return OpcodeClass::EOR;
+				case MOV: return OpcodeClass::MOV;
+				case MUL: return OpcodeClass::MUL;
+				case OR: return OpcodeClass::OR;
+				case SBC: return OpcodeClass::SBC;
+				case SUB: return OpcodeClass::SUB;
+				default: break;
+			}
+
+			switch (instruction & 0b1111'1000'0000'0000)
+			{
+				case IN: return OpcodeClass::IN;
+				case OUT: return OpcodeClass::OUT;
+				default: break;
+			}
+
+			// The displacement is spread over the opcode, LD Rd,Y and LD Rd,Z are the q = 0 encodings
+			switch (instruction & 0b1101'0010'0000'0000)
+			{
+				case LDD_Z: return OpcodeClass::LDD;
+				case STD_Z: return OpcodeClass::STD;
+				default: break;
+			}
+
+			switch (instruction & 0b1111'0000'0000'0000)
+			{
+				case RJMP: return OpcodeClass::RJMP;
+				case RCALL: return OpcodeClass::RCALL;
+				case ANDI: return OpcodeClass::ANDI;
+				case CPI: return OpcodeClass::CPI;
+				case LDI: return OpcodeClass::LDI;
+				case ORI: return OpcodeClass::ORI;
+				case SBCI: return OpcodeClass::SBCI;
+				case SUBI: return OpcodeClass::SUBI;
+				default: break;
+			}
+
+			return OpcodeClass::Unknown;
+		}
+
+	}
+
+}
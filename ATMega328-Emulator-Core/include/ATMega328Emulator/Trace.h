@@ -0,0 +1,223 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Timing.h"
+
+/*
+ * Execution trace format (.avrt), all values little endian
+ *
+ * Header, 16 bytes
+ *   0x00  4  Magic "AVRT"
+ *   0x04  2  Version, currently 1
+ *   0x06  2  Record size, 8
+ *   0x08  8  Start cycle, what the first record's cycle delta is relative to
+ *
+ * Records, 8 bytes each, one per retired instruction
+ *   0x00  1  Cycles since the previous record, when the instruction retired. 0xFF marks an escape record
+ *   0x01  1  Register the instruction changed, 0xFF if none. The lowest one if it changed several (MUL, MOVW, ADIW)
+ *   0x02  2  PC the instruction was fetched from, in words
+ *   0x04  2  Instruction word
+ *   0x06  1  New value of the register
+ *   0x07  1  SREG bits the instruction toggled
+ *
+ * Escape records, 8 bytes
+ *   0x00  1  0xFF
+ *   0x01  1  Kind
+ *             0 Operand - bytes 2-3 are the second word of the 32-bit instruction before
+ *             1 Cycles  - bytes 2-7 are cycles to add before the next record, for gaps of 255 cycles or more
+ *   0x02  6  Payload
+ */
+
+namespace ATMega328Emulator {
+
+	namespace TraceFormat {
+
+		static constexpr char MAGIC[4] = { 'A', 'V', 'R', 'T' };
+		static constexpr uint16_t VERSION = 1;
+		static constexpr size_t HEADER_SIZE = 16;
+		static constexpr size_t RECORD_SIZE = 8;
+
+		static constexpr Byte ESCAPE = 0xFF;
+		static constexpr Byte ESCAPE_OPERAND = 0;
+		static constexpr Byte ESCAPE_CYCLES = 1;
+		static constexpr Byte NO_REGISTER = 0xFF;
+
+		// Records travel as one little endian uint64_t, byte 0 is the lowest
+		constexpr uint64_t Encode(Byte cycleDelta, Byte reg, Word pc, Word instruction, Byte value, Byte sregDelta)
+		{
+			return cycleDelta | ((uint64_t)reg << 8) | ((uint64_t)pc << 16) | ((uint64_t)instruction << 32)
+				| ((uint64_t)value << 48) | ((uint64_t)sregDelta << 56);
+		}
+
+		constexpr uint64_t EncodeEscape(Byte kind, uint64_t payload)
+		{
+			return ESCAPE | ((uint64_t)kind << 8) | ((payload & 0xFFFF'FFFF'FFFF) << 16);
+		}
+
+	}
+
+	// What tracers compare to find out what an instruction changed.
+	struct TraceState
+	{
+		uint64_t Registers[4]; // R00 to R31
+		Word SP;
+		Byte SREG;
+
+		inline void Capture(const CPU& cpu)
+		{
+			std::memcpy(Registers, &cpu.R00, sizeof(Registers));
+			SP = cpu.IO.SP;
+			SREG = *(const Byte*)&cpu.IO.SREG;
+		}
+	};
+
+	// Records every retired instruction to a trace file without slowing the CPU down much.
+	// Attach it with CPU::AttachedTracer, Run then takes the profiled loop (not in Dist builds).
+	// Records go into a lock-free single producer, single consumer ring; a writer thread drains
+	// it to disk in large writes. When the disk can't keep up, the CPU waits for the writer,
+	// so traces are never lossy.
+	class TraceRecorder
+	{
+	public:
+		// capacity is in records and rounded up to a power of 2
+		TraceRecorder(size_t capacity = 1 << 20);
+		~TraceRecorder();
+
+		TraceRecorder(const TraceRecorder&) = delete;
+		TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+		bool Open(const std::string& filepath, uint64_t startCycle = 0);
+
+		// Writes out everything recorded and stops the writer thread.
+		// Returns false if anything recorded since Open didn't make it to the file.
+		bool Close();
+
+		inline bool IsOpen() const { return m_Writer.joinable(); }
+		inline uint64_t GetRecordCount() const { return m_Records; } // Escape records included
+
+		// Called by Run after every retired instruction with the state it had before.
+		inline void Record(const CPU& cpu, Memory& memory, Word pc, Word instruction, uint64_t cycle, const TraceState& before)
+		{
+			// Without a writer nothing drains the ring, so records are dropped until Open
+			if (!IsOpen()) [[unlikely]] {
+				return;
+			}
+
+			uint64_t delta = cycle - m_LastCycle;
+			m_LastCycle = cycle;
+			if (delta >= TraceFormat::ESCAPE) {
+				push(TraceFormat::EncodeEscape(TraceFormat::ESCAPE_CYCLES, delta));
+				delta = 0;
+			}
+
+			// The first differing byte of the register file is the changed register
+			TraceState after;
+			after.Capture(cpu);
+
+			Byte reg = TraceFormat::NO_REGISTER;
+			Byte value = 0;
+			for (int i = 0; i < 4; ++i) {
+				if (const uint64_t changed = before.Registers[i] ^ after.Registers[i]) {
+					reg = (Byte)(i * 8 + std::countr_zero(changed) / 8);
+					value = (&cpu.R00)[reg];
+					break;
+				}
+			}
+
+			push(TraceFormat::Encode((Byte)delta, reg, pc, instruction, value, after.SREG ^ before.SREG));
+
+			if (Timing::IsTwoWord(instruction)) {
+				const Word address = (pc + 1) * 2;
+				push(TraceFormat::EncodeEscape(TraceFormat::ESCAPE_OPERAND, memory[address] | (memory[address + 1] << 8)));
+			}
+		}
+
+	private:
+		// Records are published to the writer in batches to keep the shared cache line quiet
+		static constexpr uint64_t PUBLISH_BATCH = 256;
+
+		inline void push(uint64_t record)
+		{
+			if (m_Head - m_CachedTail == m_Capacity) {
+				waitForSpace();
+			}
+
+			m_Ring[m_Head & m_Mask] = record;
+			++m_Head;
+			++m_Records;
+
+			if ((m_Head & (PUBLISH_BATCH - 1)) == 0) {
+				m_PublishedHead.store(m_Head, std::memory_order_release);
+			}
+		}
+
+		void waitForSpace();
+		void writerLoop();
+
+	private:
+		size_t m_Capacity;
+		size_t m_Mask;
+		std::unique_ptr<uint64_t[]> m_Ring;
+
+		// Producer side
+		uint64_t m_Head = 0;
+		uint64_t m_CachedTail = 0;
+		uint64_t m_LastCycle = 0;
+		uint64_t m_Records = 0;
+
+		// Shared, each on its own cache line
+		alignas(64) std::atomic<uint64_t> m_PublishedHead = 0;
+		alignas(64) std::atomic<uint64_t> m_Tail = 0;
+		alignas(64) std::atomic<bool> m_Stopping = false;
+
+		// Writer side
+		std::ofstream m_Stream;
+		std::thread m_Writer;
+	};
+
+	// One decoded trace record.
+	struct TraceEntry
+	{
+		uint64_t Cycle;  // When the instruction retired
+		Word PC;
+		Word Instruction;
+		Word Operand;    // Second word of 32-bit instructions
+		Byte Register;   // TraceFormat::NO_REGISTER if none changed
+		Byte Value;
+		Byte SREGDelta;
+	};
+
+	// Reads a trace file back, a record at a time.
+	class TraceReader
+	{
+	public:
+		bool Open(const std::string& filepath);
+
+		// False at the end of the trace or if it's cut off mid record.
+		bool Next(TraceEntry& entry);
+
+		inline uint64_t GetStartCycle() const { return m_StartCycle; }
+
+	private:
+		bool read(uint64_t& record);
+
+	private:
+		std::ifstream m_Stream;
+		uint64_t m_StartCycle = 0;
+		uint64_t m_Cycle = 0;
+		bool m_HasPending = false;
+		uint64_t m_Pending = 0;
+	};
+
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ATMega328Emulator/Types.h"
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Timing.h"
+#include "ATMega328Emulator/Trace.h"
+
+/*
+ * Indexed trace archive (.avrx), all values little endian
+ *
+ * Header, 16 bytes
+ *   0x00  4  Magic "AVRX"
+ *   0x04  2  Version, currently 2
+ *   0x06 10  Reserved and 0
+ *
+ * Chunks, back to back. Every chunk decodes on its own
+ *   0x00  4  Records
+ *   0x04  4  Size of the encoded records
+ *   0x08  8  Keyframe cycle
+ *   0x10  2  Keyframe PC, the next instruction to execute
+ *   0x12  CPU::DATA_SPACE_SIZE  Keyframe data space, registers, I/O and SRAM
+ *   ...      Encoded records
+ *
+ * Encoded record, one per retired instruction
+ *   1  Flags
+ *        bit 0    PC follows. Otherwise it's where the chunk last saw the previous instruction go,
+ *                 or the previous instruction's PC plus its size if it hasn't seen it before
+ *        bit 1    Instruction follows (and its operand word if it has one), otherwise it's what
+ *                 this chunk last saw at the PC
+ *        bit 2    Register changes follow
+ *        bit 3    SREG change follows
+ *        bit 4    SP follows
+ *        bit 5-7  Cycles since the previous record (or the keyframe), 6 means a LEB128 count follows,
+ *                 7 marks a gap record instead
+ *   LEB128  Cycle delta, if bit 5-7 is 6
+ *   2       PC, if bit 0
+ *   2 or 4  Instruction and operand word, if bit 1
+ *   1 + 2n  Register changes, if bit 2: the count, then register and new value pairs
+ *   1       SREG bits toggled, if bit 3
+ *   2       New SP, if bit 4
+ *
+ * Gap record, for what changed between two instructions without being retired by either,
+ * e.g. an interrupt being entered or a host write. Comes before the next instruction's record
+ * and doesn't count as a record
+ *   1  Flags
+ *        bit 0    PC follows, where the previous instruction left it before the gap moved it
+ *        bit 2    Register changes follow
+ *        bit 3    SREG follows
+ *        bit 4    SP follows
+ *        bit 5-7  7
+ *   2       PC, if bit 0
+ *   1 + 2n  Register changes, if bit 2: the count, then register and new value pairs
+ *   1       New SREG, if bit 3
+ *   2       New SP, if bit 4
+ *
+ * Index, after the last chunk, one entry per chunk
+ *   0x00  8  Chunk offset
+ *   0x08  8  Keyframe cycle
+ *   0x10  8  Last record's cycle
+ *   0x18  4  Records
+ *   0x1C  2  Keyframe PC
+ *   0x1E  2  Reserved and 0
+ *   0x20  PC_BITMAP_SIZE  Bit n is set if the chunk has a record with PC / PC_BITMAP_GRANULE == n
+ *
+ * Footer, 16 bytes
+ *   0x00  8  Index offset
+ *   0x08  4  Chunks
+ *   0x0C  4  Magic "AVXI"
+ */
+
+namespace ATMega328Emulator {
+
+	namespace TraceArchiveFormat {
+
+		static constexpr char MAGIC[4] = { 'A', 'V', 'R', 'X' };
+		static constexpr char INDEX_MAGIC[4] = { 'A', 'V', 'X', 'I' };
+		static constexpr uint16_t VERSION = 2;
+		static constexpr size_t HEADER_SIZE = 16;
+		static constexpr size_t CHUNK_HEADER_SIZE = 18 + CPU::DATA_SPACE_SIZE;
+		static constexpr size_t FOOTER_SIZE = 16;
+
+		static constexpr Word PC_BITMAP_GRANULE = 1; // Words, coarser granules make loops hide rare PCs next to them
+		static constexpr size_t PC_BITMAP_SIZE = CPU::FLASH_SIZE / 2 / PC_BITMAP_GRANULE / 8;
+		static constexpr size_t INDEX_ENTRY_SIZE = 32 + PC_BITMAP_SIZE;
+
+		static constexpr Byte FLAG_PC = 1 << 0;
+		static constexpr Byte FLAG_INSTRUCTION = 1 << 1;
+		static constexpr Byte FLAG_REGISTERS = 1 << 2;
+		static constexpr Byte FLAG_SREG = 1 << 3;
+		static constexpr Byte FLAG_SP = 1 << 4;
+		static constexpr int CYCLE_SHIFT = 5;
+		static constexpr Byte CYCLE_ESCAPE = 6;
+		static constexpr Byte CYCLE_GAP = 7;
+
+		// An index entry
+		struct Chunk
+		{
+			uint64_t Offset;
+			uint64_t KeyframeCycle;
+			uint64_t LastCycle;
+			uint32_t Records;
+			Word KeyframePC;
+			std::array<Byte, PC_BITMAP_SIZE> PCs;
+
+			inline bool MayRun(Word pc) const
+			{
+				const size_t bit = (pc & (CPU::FLASH_SIZE / 2 - 1)) / PC_BITMAP_GRANULE;
+				return PCs[bit / 8] & (1 << (bit % 8));
+			}
+		};
+
+	}
+
+	// Writes an indexed trace archive. Unlike TraceRecorder, which streams flat records as fast as
+	// it can, this keeps everything needed to query a long trace without reading all of it:
+	// chunks that are encoded on their own, a keyframe of the data space at the start of every
+	// chunk, and an index of every chunk's cycle range and the PCs it ran.
+	// Attach it with CPU::AttachedTraceArchive, Run then takes the profiled loop (not in Dist builds).
+	class TraceArchiveWriter
+	{
+	public:
+		~TraceArchiveWriter();
+
+		// Starts the first chunk with a keyframe of the CPU as it is now.
+		bool Open(const std::string& filepath, const CPU& cpu, uint32_t chunkRecords = 64 * 1024);
+
+		// Writes the last chunk and the index, the archive can't be read before.
+		// Returns false if anything recorded since Open didn't make it to the file.
+		bool Close();
+
+		inline bool IsOpen() const { return m_Stream.is_open(); }
+		inline uint64_t GetRecordCount() const { return m_TotalRecords; }
+
+		// Called by Run after every retired instruction with the state it had before.
+		// Does nothing unless the archive is open.
+		void Record(const CPU& cpu, Memory& memory, Word pc, Word instruction, uint64_t cycle, const TraceState& before);
+
+	private:
+		void beginChunk(const CPU& cpu, uint64_t cycle);
+		void writeChunk();
+
+		// Appends a gap record if something changed the CPU since the last record
+		void recordGap(Word pc, const TraceState& before);
+
+	private:
+		std::ofstream m_Stream;
+		uint64_t m_Offset = 0;
+		uint32_t m_ChunkRecords = 0;
+		uint64_t m_TotalRecords = 0;
+
+		// The chunk being written
+		TraceArchiveFormat::Chunk m_Chunk = {};
+		std::vector<Byte> m_Keyframe;
+		std::vector<Byte> m_Data;
+		uint64_t m_LastCycle = 0;
+		Word m_NextPC = 0;
+		size_t m_PreviousSlot = 0;
+		TraceState m_After = {}; // The CPU as the last record or the keyframe left it
+		Word m_AfterPC = 0;
+		std::unique_ptr<Word[]> m_Instructions; // What the chunk last saw at every PC, 0xFFFF for nothing
+		std::unique_ptr<Word[]> m_Operands;
+		std::unique_ptr<Word[]> m_Successors;   // Where every PC last went, one more for the chunk start
+
+		std::vector<TraceArchiveFormat::Chunk> m_Index;
+	};
+
+	// Reads an indexed trace archive. Only the index is loaded, chunks are read when a query needs them.
+	class TraceArchive
+	{
+	public:
+		bool Open(const std::string& filepath);
+
+		inline size_t GetChunkCount() const { return m_Index.size(); }
+		uint64_t GetRecordCount() const;
+		uint64_t GetFirstCycle() const;
+		uint64_t GetLastCycle() const;
+
+		// Calls back with every record that retired in [fromCycle, toCycle], in order, until it returns false.
+		// The entry's Register is the lowest register the instruction changed.
+		void ForEach(uint64_t fromCycle, uint64_t toCycle, const std::function<bool(const TraceEntry&)>& callback);
+
+		// Records of the instruction at pc (in words) that retired in [fromCycle, toCycle].
+		// Only chunks whose index says they ran near pc are read.
+		std::vector<TraceEntry> FindVisits(Word pc, uint64_t fromCycle = 0, uint64_t toCycle = UINT64_MAX, size_t maxResults = SIZE_MAX);
+
+		// Puts the CPU into the state it had right after the last instruction that retired at or before cycle,
+		// before anything that happened between it and the next one, like entering an interrupt.
+		// Registers, SREG, SP, PC and CycleCount are exact, the rest of the data space is as of the keyframe before.
+		bool Rebuild(uint64_t cycle, CPU& cpu);
+
+	private:
+		struct RegisterChange
+		{
+			Byte Register;
+			Byte Value;
+		};
+
+		// Everything a record or a gap record changed
+		struct Changes
+		{
+			RegisterChange Registers[32];
+			Byte RegisterCount = 0;
+			bool SPChanged = false;
+			Word SP = 0;
+			bool SREGChanged = false; // Gap records only, instruction records have TraceEntry::SREGDelta
+			Byte SREG = 0;
+			bool PCChanged = false;   // Gap records only
+			Word PC = 0;
+		};
+
+		// Decodes a chunk, calling back with every record and all the registers it changed, until it returns false.
+		// Gap records go to onGap, if there is one, right before the record that follows them.
+		// Loads the chunk's keyframe into keyframe first, if there is one.
+		using ChunkCallback = std::function<bool(const TraceEntry& entry, const Changes& changes)>;
+		using GapCallback = std::function<void(const Changes& changes)>;
+		bool decodeChunk(size_t chunk, CPU* keyframe, const ChunkCallback& callback, const GapCallback& onGap = nullptr);
+
+		// The first chunk that may hold records retired at or after cycle
+		size_t findChunk(uint64_t cycle) const;
+
+	private:
+		std::ifstream m_Stream;
+		std::vector<TraceArchiveFormat::Chunk> m_Index;
+		std::vector<Byte> m_Buffer;
+		std::unique_ptr<Word[]> m_Instructions;
+		std::unique_ptr<Word[]> m_Operands;
+		std::unique_ptr<Word[]> m_Successors;
+	};
+
+}
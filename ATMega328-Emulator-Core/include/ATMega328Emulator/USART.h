@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/Memory.h"
+#include "ATMega328Emulator/RegisterHooks.h"
+#include "ATMega328Emulator/RingBuffer.h"
+#include "ATMega328Emulator/Scheduler.h"
+
+namespace ATMega328Emulator {
+
+	class OutputMatcher;
+
+	struct USARTStats
+	{
+		uint64_t Transmitted = 0; // Frames the firmware sent
+		uint64_t Dropped = 0;     // Of those, the ones that didn't fit in the transmit ring buffer
+		uint64_t Received = 0;    // Frames that made it into the receive buffer
+		uint64_t Overruns = 0;    // Frames lost because the firmware didn't read UDR0 in time
+	};
+
+	// USART0 in asynchronous mode, cycle exact from the firmware's side and a pair of byte streams
+	// from the host's. A frame takes as many cycles as UBRR0, U2X0 and the frame format say;
+	// the ends of frames are Scheduler events and the status flags are worked out from the cycle
+	// the firmware reads them at, so polling UDRE0 and the interrupts both see the baud rate.
+	//
+	// Sent bytes go into a ring buffer the host drains in bulk from another thread, with Peek or
+	// WriteTo a pipe, never a call per byte. Bytes the host queues with Receive arrive back to back
+	// at the baud rate, starting at the next slice boundary or USART register access.
+	//
+	// Wire it up with
+	//   cpu.AttachedRegisterHooks = &hooks;
+	//   usart.Attach(hooks);
+	//   scheduler.Add(&usart);
+	//   usart.Reset(cpu);
+	//
+	// Checkpoints save the frames in flight. From the first one on, bytes taken from the receive
+	// ring buffer are logged, so running the same cycles again receives them again, and frames sent
+	// or matched before aren't sent or matched again.
+	//
+	// Not modelled: synchronous and master SPI modes, parity and frame errors, the 9th data bit
+	// and multi-processor address filtering. Writes to UDR0 while UDRE0 is clear or TXEN0 is off
+	// are lost.
+	class USART : public EventSource, public RegisterHook
+	{
+	public:
+		static constexpr Word UCSR0A_ADDRESS = 0xC0;
+		static constexpr Word UCSR0B_ADDRESS = 0xC1;
+		static constexpr Word UCSR0C_ADDRESS = 0xC2;
+		static constexpr Word UBRR0_ADDRESS = 0xC4;
+		static constexpr Word UDR0_ADDRESS = 0xC6;
+
+		static constexpr Byte RX_VECTOR = 18;   // USART_RX, receive complete
+		static constexpr Byte UDRE_VECTOR = 19; // USART_UDRE, data register empty
+		static constexpr Byte TX_VECTOR = 20;   // USART_TX, transmit complete
+
+		// UCSR0A
+		static constexpr Byte MPCM0 = 1 << 0;
+		static constexpr Byte U2X0 = 1 << 1;
+		static constexpr Byte UPE0 = 1 << 2;
+		static constexpr Byte DOR0 = 1 << 3;
+		static constexpr Byte FE0 = 1 << 4;
+		static constexpr Byte UDRE0 = 1 << 5;
+		static constexpr Byte TXC0 = 1 << 6;
+		static constexpr Byte RXC0 = 1 << 7;
+
+		// UCSR0B
+		static constexpr Byte TXB80 = 1 << 0;
+		static constexpr Byte RXB80 = 1 << 1;
+		static constexpr Byte UCSZ02 = 1 << 2;
+		static constexpr Byte TXEN0 = 1 << 3;
+		static constexpr Byte RXEN0 = 1 << 4;
+		static constexpr Byte UDRIE0 = 1 << 5;
+		static constexpr Byte TXCIE0 = 1 << 6;
+		static constexpr Byte RXCIE0 = 1 << 7;
+
+		// UCSR0C
+		static constexpr Byte UCPOL0 = 1 << 0;
+		static constexpr Byte UCSZ00 = 1 << 1;
+		static constexpr Byte UCSZ01 = 1 << 2;
+		static constexpr Byte USBS0 = 1 << 3;
+		static constexpr Byte UPM00 = 1 << 4;
+		static constexpr Byte UPM01 = 1 << 5;
+
+		static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+		// An interrupt that is due while interrupts are disabled is tried again this much later
+		static constexpr uint64_t INTERRUPT_RETRY_CYCLES = 32;
+
+	public:
+		explicit USART(size_t bufferSize = DEFAULT_BUFFER_SIZE);
+
+		// Hooks UCSR0A, UCSR0B and UDR0, the rest are plain registers read when a frame starts.
+		void Attach(RegisterHooks& hooks);
+		void Detach();
+
+		// Puts the registers in their reset state and drops the frames in flight.
+		// The ring buffers belong to the host and are left alone.
+		void Reset(CPU& cpu);
+
+		// Host side. Drain sent bytes from one thread, queue bytes to receive from one thread.
+		inline RingBuffer& GetTransmitted() { return m_Transmitted; }
+		inline size_t Receive(std::span<const Byte> data) { return m_Received.Write(data.data(), data.size()); }
+
+		// Only from the thread running the CPU
+		inline const USARTStats& GetStats() const { return m_Stats; }
+
+		// Scans every sent byte as its frame ends, stamped with that cycle. A terminal match stops
+		// Scheduler::Execute after the instruction that was running, the matcher has the details.
+		inline void SetMatcher(OutputMatcher* matcher) { m_Matcher = matcher; }
+
+		// Cycles a frame takes with the registers as they are: start bit, data, parity and stop bits
+		static uint64_t GetFrameCycles(const CPU& cpu);
+
+		uint64_t GetNextEventCycle() const override;
+		void HandleEvents(CPU& cpu, Memory& memory) override;
+		std::vector<RegisterRange> GetRegisters() const override;
+		bool TakeStopRequest() override;
+
+		Byte OnRead(CPU& cpu, Word address, Byte value, uint64_t cycle) override;
+		Byte OnWrite(CPU& cpu, Word address, Byte value, uint64_t cycle) override;
+
+		// Stimuli for UDR0 are queued with Receive, so don't also Receive from another thread.
+		bool OnInput(CPU& cpu, Word address, Byte value) override;
+
+		bool SaveState(std::vector<Byte>& out) override;
+		const Byte* RestoreState(const Byte* in) override;
+
+	private:
+		struct Arrival
+		{
+			uint64_t Cycle; // What advance was called with when the byte was taken
+			Byte Value;
+		};
+
+		// Finishes the frames that end at or before cycle and starts the next ones
+		void advance(CPU& cpu, uint64_t cycle);
+		void transmit(CPU& cpu, Byte value, uint64_t cycle);
+
+		// The next received byte, from the log while running cycles that ran before
+		bool takeArrival(uint64_t cycle, Byte& value);
+
+		Byte getStatus() const;
+
+		// The vector of the highest priority interrupt that is flagged and enabled, 0 if none
+		Byte getInterruptVector() const;
+
+		// Makes sure an interrupt or event the access brought forward is handled on time
+		void onAccessed(uint64_t nextEventBefore, uint64_t cycle);
+
+	private:
+		RingBuffer m_Transmitted;
+		RingBuffer m_Received;
+		RegisterHooks* m_Hooks = nullptr;
+		OutputMatcher* m_Matcher = nullptr;
+		bool m_StopRequested = false;
+		USARTStats m_Stats;
+
+		Byte m_Control = 0; // UCSR0B
+		Byte m_Mode = 0;    // U2X0 and MPCM0
+		uint64_t m_Now = 0; // Advanced up to here
+		uint64_t m_InterruptCycle = NO_EVENT;
+
+		// Transmitter, a shift register with a one byte buffer in front
+		bool m_TxBusy = false;
+		bool m_TxBufferFull = false;
+		bool m_TxComplete = false;
+		Byte m_TxShift = 0;
+		Byte m_TxBuffer = 0;
+		uint64_t m_TxEnd = 0;
+
+		// Receiver, a shift register with a two byte FIFO behind
+		bool m_RxBusy = false;
+		bool m_Overrun = false;
+		Byte m_RxShift = 0;
+		Byte m_RxCount = 0;
+		Byte m_RxFifo[2] = {};
+		uint64_t m_RxEnd = 0;
+
+		// Going back and running again, only m_NextArrival is saved with the rest
+		bool m_Logging = false;
+		std::vector<Arrival> m_Arrivals;
+		size_t m_NextArrival = 0;
+		uint64_t m_Delivered = 0; // Frames pushed to the host and the matcher
+	};
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "ATMega328Emulator/Types.h"
+
+namespace ATMega328Emulator {
+
+	enum class WatchSpace : Byte
+	{
+		Data,   // Registers, I/O and SRAM, by data space address
+		EEPROM,
+	};
+
+	enum class WatchAccess : Byte
+	{
+		Read = 1 << 0,
+		Write = 1 << 1,
+		ReadWrite = Read | Write,
+	};
+
+	struct WatchEvent
+	{
+		int Id;             // What Watchpoints::Add returned
+		WatchSpace Space;
+		WatchAccess Access; // Read or Write
+		Word Address;
+		Byte OldValue;      // The same as NewValue for reads
+		Byte NewValue;
+		Word PC;            // Word address of the accessing instruction, the PC for accesses between Runs
+		uint64_t Cycle;     // CycleCount when the accessing instruction started
+	};
+
+	// Breaks on accesses to data space and EEPROM ranges.
+	// Attach it with CPU::AttachedWatchpoints. Watched ranges flag their pages in a bitmap that
+	// ReadData, WriteData and WriteEEPROM test, so accesses to other pages cost a bit test and
+	// only the rest are matched against the ranges.
+	// Registers are only seen when they are accessed through the data space (LDS, PUSH, OUT, SBI...),
+	// not when an instruction names them as an operand.
+	class Watchpoints
+	{
+	public:
+		static constexpr uint32_t PAGE_SIZE = 16;
+		static constexpr uint32_t DATA_PAGES = 0x1000 / PAGE_SIZE; // The masked data space, see CPU::DATA_SPACE_MASK
+		static constexpr uint32_t EEPROM_PAGES = 1024 / PAGE_SIZE;
+
+		// Return true to stop Run after the accessing instruction, with StopReason::Watchpoint.
+		using Callback = std::function<bool(const WatchEvent&)>;
+
+	public:
+		// Watches [address, address + size). Returns the id to remove it with, or -1 if the range is empty
+		// or runs past the end of its space.
+		int Add(WatchSpace space, Word address, Word size, WatchAccess access);
+		bool Remove(int id);
+		void Clear();
+
+		inline size_t GetCount() const { return m_Ranges.size(); }
+
+		inline void SetCallback(Callback callback) { m_Callback = std::move(callback); }
+
+		inline bool IsDataPageWatched(Word address) const
+		{
+			const uint32_t page = (address / PAGE_SIZE) & (DATA_PAGES - 1);
+			return (m_DataPages[page / 64] >> (page % 64)) & 1;
+		}
+
+		inline bool IsEEPROMPageWatched(Word address) const
+		{
+			const uint32_t page = (address / PAGE_SIZE) & (EEPROM_PAGES - 1);
+			return (m_EEPROMPages[page / 64] >> (page % 64)) & 1;
+		}
+
+		// Called by the CPU for accesses to watched pages, event has everything but the id.
+		void OnAccess(WatchEvent event);
+
+		// Whether a callback asked to stop since this was last called. Run takes it after every instruction.
+		inline bool TakeStopRequest()
+		{
+			// Nearly always false, so don't store every time
+			if (!m_StopRequested) {
+				return false;
+			}
+			m_StopRequested = false;
+			return true;
+		}
+
+	private:
+		struct Range
+		{
+			int Id;
+			WatchSpace Space;
+			WatchAccess Access;
+			uint32_t Begin;
+			uint32_t End;
+		};
+
+		void flagPages();
+
+	private:
+		std::vector<Range> m_Ranges;
+		int m_NextId = 0;
+		Callback m_Callback;
+		bool m_StopRequested = false;
+
+		std::array<uint64_t, DATA_PAGES / 64> m_DataPages = {};
+		std::array<uint64_t, EEPROM_PAGES / 64> m_EEPROMPages = {};
+	};
+
+}
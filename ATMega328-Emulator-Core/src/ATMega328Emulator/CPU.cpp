@@ -1,16 +1,33 @@
 #include "ATMega328Emulator/CPU.h"
 
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstddef>
 
+#include "ATMega328Emulator/CallProfiler.h"
+#include "ATMega328Emulator/InstructionMix.h"
 #include "ATMega328Emulator/Instructions.h"
+#include "ATMega328Emulator/Metrics.h"
+#include "ATMega328Emulator/Profiler.h"
+#include "ATMega328Emulator/SamplingProfiler.h"
+#include "ATMega328Emulator/Timing.h"
+#include "ATMega328Emulator/Trace.h"
+#include "ATMega328Emulator/TraceArchive.h"
 
 namespace ATMega328Emulator {
+
+	static_assert(offsetof(CPU, R00) == 0, "The data space starts at the CPU");
+	static_assert(offsetof(CPU, DataGuard) == CPU::DATA_SPACE_SIZE, "DataGuard has to follow the SRAM");
+	static_assert(offsetof(CPU, EEPROM) == CPU::DATA_SPACE_MASK + 1, "Masked data space accesses have to stay in the data space and its guard");
 	
 	void CPU::Reset(Memory& memory)
 	{
 		// I have no idea if this is correct
 		PC = 0x0;
-		IO.SP = 0x100; // First address of SRAM (Not true atm)
+		CycleCount = 0;
+		IO.SP = RAMEND;
+		InterruptDepth = 0;
 
 		IO.PORTB = IO.PORTC = IO.PORTD = 0;
 		IO.DDRB = IO.DDRC = IO.DDRD = 0;
@@ -23,114 +40,461 @@ namespace ATMega328Emulator {
 
 	void CPU::Execute(int cycles, Memory& memory)
 	{
-		while (cycles > 0) {
-			Word instruction = FetchWord(cycles, memory);
+		// Hook stops are for the Scheduler, to handle an event it didn't know about yet
+		uint64_t remaining = cycles > 0 ? (uint64_t)cycles : 0;
+		while (remaining) {
+			const RunResult result = Run(remaining, StopConditions(), memory);
+			if (result.Reason != StopReason::RegisterHook) {
+				break;
+			}
+			remaining -= std::min(result.Cycles, remaining);
+		}
+	}
+
+	RunResult CPU::Run(uint64_t maxCycles, const StopConditions& conditions, Memory& memory)
+	{
+		RunResult result;
+
+		// The host clock is only read when someone counts
+		const auto start = AttachedMetrics ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+		// The cycle target is just a shorter budget
+		uint64_t budget = maxCycles;
+		StopReason budgetReason = StopReason::CycleBudget;
+		if (conditions.CycleTarget != UINT64_MAX) {
+			uint64_t untilTarget = conditions.CycleTarget > CycleCount ? conditions.CycleTarget - CycleCount : 0;
+			if (untilTarget <= budget) {
+				budget = untilTarget;
+				budgetReason = StopReason::CycleTarget;
+			}
+		}
+
+		RunStopFlags =
+			(conditions.StopOnBreak ? STOP_ON_BREAK : 0)
+			| (conditions.StopOnIllegalOpcode ? STOP_ON_ILLEGAL_OPCODE : 0)
+			| (conditions.StopOnSleep ? STOP_ON_SLEEP : 0)
+			| (conditions.StopOnSelfLoop ? STOP_ON_SELF_LOOP : 0)
+			| (conditions.TrapFaults ? TRAP_FAULTS : 0)
+			| (conditions.StopOnPC ? STOP_ON_PC : 0)
+			| IN_RUN;
+		RunStop = StopReason::None;
+		RunStopPC = conditions.PC;
+		RunStallCycles = 0;
+
+		// Only stops asked for during this Run count
+		if (AttachedWatchpoints) {
+			AttachedWatchpoints->TakeStopRequest();
+		}
+		if (AttachedRegisterHooks) {
+			AttachedRegisterHooks->TakeStopRequest();
+		}
 
-			bool success = handleInstruction(instruction, cycles, memory);
+		// Only writes made while trapping count
+		if (conditions.TrapFaults) {
+			DirtyData.ClearRange(DATA_SPACE_SIZE, DATA_SPACE_MASK + 1 - DATA_SPACE_SIZE);
+		}
+
+		while (result.Cycles < budget && RunStop == StopReason::None) {
+			// Handlers count cycles in an int, a slice also ends where the next sample is due
+			int slice = (int)std::min<uint64_t>(budget - result.Cycles, INT_MAX);
+			if (AttachedSampler) {
+				slice = std::max(std::min(slice, AttachedSampler->GetCyclesUntilSample()), 1);
+			}
+			int cycles = slice;
+			RunSlice = slice;
+
+			// Watchpoints and hooks need to know which instruction made the access, profilers also see every instruction
+			const bool watched = AttachedWatchpoints || AttachedRegisterHooks;
+			bool profiled = false;
+#ifdef ATMEGA328_PROFILING
+			profiled = AttachedProfiler || AttachedInstructionMix || AttachedTracer || AttachedTraceArchive;
+#endif
 
-			if (!success) {
-				std::cout << "Instruction not handled " << std::hex << instruction << std::endl;
+			try {
+				if (profiled) {
+					if (conditions.StopOnPC) {
+						executeLoop<true, true, true>(cycles, result.Instructions, conditions.PC, memory);
+					}
+					else {
+						executeLoop<false, true, true>(cycles, result.Instructions, conditions.PC, memory);
+					}
+				}
+				else if (watched) {
+					if (conditions.StopOnPC) {
+						executeLoop<true, true, false>(cycles, result.Instructions, conditions.PC, memory);
+					}
+					else {
+						executeLoop<false, true, false>(cycles, result.Instructions, conditions.PC, memory);
+					}
+				}
+				else if (conditions.StopOnPC) {
+					executeLoop<true, false, false>(cycles, result.Instructions, conditions.PC, memory);
+				}
+				else {
+					executeLoop<false, false, false>(cycles, result.Instructions, conditions.PC, memory);
+				}
 			}
+			catch (EmulatorFault& fault) {
+				// Handlers decrement cycles in place, so they are still right here
+				CycleCount += (uint64_t)((int64_t)slice - cycles);
+				if (fault.Type != FaultType::IllegalOpcode) {
+					fault.PC = RunInstructionPC;
+				}
+				fault.Cycle = CycleCount;
+				RunStopFlags = 0;
+				throw;
+			}
+
+			if (RunStop != StopReason::None) {
+				cycles = RunStopCycles;
+			}
+
+			// The last instruction may overshoot the slice
+			const uint64_t consumed = (uint64_t)((int64_t)slice - cycles);
+			CycleCount += consumed;
+			result.Cycles += consumed;
+
+			if (AttachedSampler) {
+				AttachedSampler->Advance(*this, (int)consumed);
+			}
+
+			if (RunStopFlags & TRAP_FAULTS) {
+				checkDataGuard();
+			}
+		}
+
+		// A BREAK we stopped on is left for the debugger, so it didn't retire
+		if (RunStop == StopReason::Break) {
+			--result.Instructions;
+		}
+
+		result.Reason = RunStop != StopReason::None ? RunStop : budgetReason;
+		RunStopFlags = 0;
+
+		if (AttachedMetrics) {
+			const auto elapsed = std::chrono::steady_clock::now() - start;
+			AttachedMetrics->OnRun(result, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
 		}
+		return result;
 	}
 
-	bool CPU::handleInstruction(Word instruction, int& cycles, Memory& memory)
+	template<bool StopOnPC, bool Watched, bool Profiled>
+	void CPU::executeLoop(int& cycles, uint64_t& instructions, Word stopPC, Memory& memory)
 	{
-		using namespace Instruction;
+		while (cycles > 0) {
+#ifdef ATMEGA328_CHECK_ACCESSES
+			RunInstructionPC = PC;
+#endif
+			[[maybe_unused]] const Word pc = PC;
+			[[maybe_unused]] const int cyclesBefore = cycles;
+			if constexpr (Watched) {
+				RunInstructionPC = pc;
+				RunInstructionCycles = cycles;
+			}
 
-		switch (instruction)
-		{
-			case BREAK: return true; // I don't know how to implement the break instruction
-			case NOP: return true;
-			default: break;
+			Word instruction = FetchWord(memory);
+			const OpcodeClass opcode = Timing::Decode(instruction);
+
+			// Tracers record what the instruction changed
+			[[maybe_unused]] TraceState before;
+#ifdef ATMEGA328_PROFILING
+			if constexpr (Profiled) {
+				if (AttachedTracer || AttachedTraceArchive) {
+					before.Capture(*this);
+				}
+			}
+#endif
+
+			bool success = handleInstruction(instruction, opcode, cycles, memory);
+
+			if (!success && (RunStopFlags & (STOP_ON_ILLEGAL_OPCODE | TRAP_FAULTS))) {
+				// Leave the PC on the instruction, as if it was never fetched
+				--PC;
+				cycles += Timing::GetCycles(OpcodeClass::Unknown, false);
+
+				if (!(RunStopFlags & STOP_ON_ILLEGAL_OPCODE)) {
+					throw EmulatorFault(FaultType::IllegalOpcode, instruction, PC);
+				}
+
+				stop(StopReason::IllegalOpcode, cycles);
+				break;
+			}
+
+			++instructions;
+
+			if constexpr (Watched) {
+				if (RunStallCycles) [[unlikely]] {
+					cycles -= RunStallCycles;
+					RunStallCycles = 0;
+				}
+				if (AttachedWatchpoints && AttachedWatchpoints->TakeStopRequest() && RunStop == StopReason::None) {
+					stop(StopReason::Watchpoint, cycles);
+				}
+				if (AttachedRegisterHooks && AttachedRegisterHooks->TakeStopRequest() && RunStop == StopReason::None) {
+					stop(StopReason::RegisterHook, cycles);
+				}
+			}
+
+#ifdef ATMEGA328_PROFILING
+			if constexpr (Profiled) {
+				// A stop took the remaining cycles, a BREAK we stop on doesn't retire
+				if (RunStop != StopReason::Break) {
+					const int spent = cyclesBefore - (RunStop == StopReason::None ? cycles : RunStopCycles);
+					if (AttachedProfiler) {
+						AttachedProfiler->Record(pc, spent);
+					}
+					if (AttachedInstructionMix) {
+						AttachedInstructionMix->Record(opcode, spent);
+					}
+					if (AttachedTracer) {
+						AttachedTracer->Record(*this, memory, pc, instruction, getRunCycle(cyclesBefore - spent), before);
+					}
+					if (AttachedTraceArchive) {
+						AttachedTraceArchive->Record(*this, memory, pc, instruction, getRunCycle(cyclesBefore - spent), before);
+					}
+				}
+			}
+#endif
+
+			if constexpr (StopOnPC) {
+				if (PC == stopPC) {
+					stop(StopReason::PCMatch, cycles);
+				}
+			}
 		}
-		
-		switch (instruction & 0b1111'1111'1000'1111)
-		{
-			case BSET: Handle_BSET(instruction, this); return true;
-			default: break;
+	}
+
+	bool CPU::EnterInterrupt(Byte vector)
+	{
+		if (!IO.SREG.I) {
+			return false;
 		}
 
-		switch (instruction & 0b1111'1110'1000'1111)
-		{
-			case BCLR: Handle_BCLR(instruction, this); return true;
-			default: break;
+		const Word from = PC;
+		PushWord(PC);
+		IO.SREG.I = 0;
+		PC = vector * 2; // Every vector is a 2 word JMP
+
+		InterruptVectors[std::min<Byte>(InterruptDepth, MAX_INTERRUPT_NESTING - 1)] = vector;
+		if (InterruptDepth < UINT8_MAX) {
+			++InterruptDepth;
 		}
-		
-		switch (instruction & 0b1111'1110'0000'1111)
-		{
-			case ASR: Handle_ASR(instruction, this); return true;
-			case COM: Handle_COM(instruction, this); return true;
-			case DEC: Handle_DEC(instruction, this); return true;
-			case INC: Handle_INC(instruction, this); return true;
-			case LAC: Handle_LAC(instruction, cycles, this); return true;
-			case LAS: Handle_LAS(instruction, cycles, this); return true;
-			case LAT: Handle_LAT(instruction, cycles, this); return true;
-			case LDI: Handle_LDI(instruction, this); return true;
-			case LDS: Handle_LDS(instruction, cycles, this, memory); return true;
-			case LSR: Handle_LSR(instruction, this); return true;
-			case NEG: Handle_NEG(instruction, this); return true;
-			default: break;
+		CycleCount += 4;
+
+		if (AttachedMetrics) {
+			AttachedMetrics->OnInterrupt();
 		}
-		
-		switch (instruction & 0b1111'1111'1000'1000)
-		{
-			case FMUL: Handle_FMUL(instruction, cycles, this); return true;
-			case FMULS: Handle_FMULS(instruction, cycles, this); return true;
-			case FMULSU: Handle_FMULSU(instruction, cycles, this); return true;
-			case MULSU: Handle_MULSU(instruction, cycles, this); return true;
-			default: break;
+
+#ifdef ATMEGA328_PROFILING
+		if (AttachedCallProfiler) {
+			AttachedCallProfiler->OnInterrupt(from, vector, IO.SP, CycleCount);
 		}
-		
-		switch (instruction & 0b1111'1111'0000'0000)
-		{
-			case ADIW: Handle_ADIW(instruction, cycles, this); return true;
-			case CBI: Handle_CBI(instruction, this); return true;
-			case MOVW: Handle_MOVW(instruction, this); return true;
-			case MULS: Handle_MULS(instruction, cycles, this); return true;
-			case SBI: Handle_SBI(instruction, this); return true;
-			default: break;
+#endif
+		return true;
+	}
+
+	void CPU::onWatchedAccess(WatchSpace space, WatchAccess access, Word address, Byte oldValue, Byte newValue) const
+	{
+		WatchEvent event = { -1, space, access, address, oldValue, newValue, PC, CycleCount };
+		if (RunStopFlags & IN_RUN) {
+			event.PC = RunInstructionPC;
+			event.Cycle = getRunCycle(RunInstructionCycles);
 		}
-		
-		switch (instruction & 0b1111'1110'0000'1000)
-		{
-			case BLD: Handle_BLD(instruction, this); return true;
-			case BST: Handle_BST(instruction, this); return true;
-			default: break;
+		AttachedWatchpoints->OnAccess(event);
+	}
+
+	Byte CPU::onHookedRead(Word address) const
+	{
+		// Reads act on the peripheral, e.g. reading UDR0 pops the receive buffer
+		CPU& cpu = const_cast<CPU&>(*this);
+		const Word masked = address & DATA_SPACE_MASK;
+		return AttachedRegisterHooks->Get(masked)->OnRead(cpu, masked, getDataSpace()[masked], getRunCycle(RunInstructionCycles));
+	}
+
+	Byte CPU::onHookedWrite(Word address, Byte value)
+	{
+		const Word masked = address & DATA_SPACE_MASK;
+		return AttachedRegisterHooks->Get(masked)->OnWrite(*this, masked, value, getRunCycle(RunInstructionCycles));
+	}
+
+	void CPU::onCall(Word from, int cycles)
+	{
+#ifdef ATMEGA328_PROFILING
+		if (AttachedCallProfiler) {
+			AttachedCallProfiler->OnCall(from, PC, IO.SP, getRunCycle(cycles));
 		}
+#endif
+	}
 
-		switch (instruction & 0b1111'1100'0000'0000)
-		{
-			case ADC: Handle_ADC(instruction, this); return true;
-			case ADD: Handle_ADD(instruction, this); return true;
-			case AND: Handle_AND(instruction, this); return true;
-			case BRBC: Handle_BRBC(instruction, cycles, this); return true;
-			case BRBS: Handle_BRBS(instruction, cycles, this); return true;
-			case CP: Handle_CP(instruction, this); return true;
-			case CPC: Handle_CPC(instruction, this); return true;
-			case CPSE: Handle_CPSE(instruction, cycles, this); return true;
-			case EOR: Handle_EOR(instruction, this); return true;
-			case MOV: Handle_MOV(instruction, this); return true;
-			case MUL: Handle_MUL(instruction, cycles, this); return true;
-			case OR: Handle_OR(instruction, this); return true;
-			case SBC: Handle_SBC(instruction, this); return true;
-			case SUB: Handle_SUB(instruction, this); return true;
-			default: break;
+	void CPU::onReturn(int cycles)
+	{
+#ifdef ATMEGA328_PROFILING
+		if (AttachedCallProfiler) {
+			AttachedCallProfiler->OnReturn(IO.SP, getRunCycle(cycles));
 		}
+#endif
+	}
 
-		switch (instruction & 0b1111'1000'0000'0000)
-		{
-			case OUT: Handle_OUT(instruction, this); return true;
-			default: break;
+	void CPU::checkDataGuard()
+	{
+		constexpr uint32_t PAGE_SIZE = decltype(DirtyData)::PAGE_SIZE;
+
+		for (uint32_t address = DATA_SPACE_SIZE; address <= DATA_SPACE_MASK; address += PAGE_SIZE) {
+			if (DirtyData.IsDirty(address / PAGE_SIZE)) {
+				// Only the page is known, and only that it was written some time during the slice
+				DirtyData.ClearRange(DATA_SPACE_SIZE, DATA_SPACE_MASK + 1 - DATA_SPACE_SIZE);
+				RunStopFlags = 0;
+				throw EmulatorFault(FaultType::DataOutOfBounds, address, PC, CycleCount);
+			}
 		}
+	}
 
-		switch (instruction & 0b1111'0000'0000'0000)
+	bool CPU::handleInstruction(Word instruction, OpcodeClass opcode, int& cycles, Memory& memory)
+	{
+		using namespace Instruction;
+
+		cycles -= Timing::GetCycles(opcode, false);
+
+		switch (opcode)
 		{
-			case ANDI: Handle_ANDI(instruction, this); return true;
-			case CPI: Handle_CPI(instruction, this); return true;
-			case ORI: Handle_ORI(instruction, this); return true;
-			case SBCI: Handle_SBCI(instruction, this); return true;
-			case SUBI: Handle_SUBI(instruction, this); return true;
+			case OpcodeClass::BREAK:
+			{
+				// Only stops Run, otherwise there is no debugger to hand over to and it acts as a NOP
+				if (RunStopFlags & STOP_ON_BREAK) {
+					--PC;
+					cycles += Timing::GetCycles(opcode, false);
+					stop(StopReason::Break, cycles);
+				}
+				return true;
+			}
+			case OpcodeClass::NOP: return true;
+			case OpcodeClass::SLEEP:
+			{
+				// Nothing wakes the CPU up yet, so SLEEP is a NOP unless it could never return
+				if ((RunStopFlags & STOP_ON_SLEEP) && !IO.SREG.I) {
+					stop(StopReason::Sleep, cycles);
+				}
+				return true;
+			}
+
+			case OpcodeClass::BSET: Handle_BSET(instruction, this); return true;
+			case OpcodeClass::BCLR: Handle_BCLR(instruction, this); return true;
+
+			case OpcodeClass::ASR: Handle_ASR(instruction, this); return true;
+			case OpcodeClass::COM: Handle_COM(instruction, this); return true;
+			case OpcodeClass::DEC: Handle_DEC(instruction, this); return true;
+			case OpcodeClass::INC: Handle_INC(instruction, this); return true;
+			case OpcodeClass::LAC: Handle_LAC(instruction, this); return true;
+			case OpcodeClass::LAS: Handle_LAS(instruction, this); return true;
+			case OpcodeClass::LAT: Handle_LAT(instruction, this); return true;
+			case OpcodeClass::LD: Handle_LD(instruction, this); return true;
+			case OpcodeClass::LDI: Handle_LDI(instruction, this); return true;
+			case OpcodeClass::LDS: Handle_LDS(instruction, this, memory); return true;
+			case OpcodeClass::LPM: Handle_LPM(instruction, this, memory); return true;
+			case OpcodeClass::LSR: Handle_LSR(instruction, this); return true;
+			case OpcodeClass::NEG: Handle_NEG(instruction, this); return true;
+			case OpcodeClass::ROR: Handle_ROR(instruction, this); return true;
+			case OpcodeClass::ST: Handle_ST(instruction, this); return true;
+			case OpcodeClass::STS: Handle_STS(instruction, this, memory); return true;
+			case OpcodeClass::SWAP: Handle_SWAP(instruction, this); return true;
+
+			case OpcodeClass::FMUL: Handle_FMUL(instruction, this); return true;
+			case OpcodeClass::FMULS: Handle_FMULS(instruction, this); return true;
+			case OpcodeClass::FMULSU: Handle_FMULSU(instruction, this); return true;
+			case OpcodeClass::MULSU: Handle_MULSU(instruction, this); return true;
+
+			case OpcodeClass::ADIW: Handle_ADIW(instruction, this); return true;
+			case OpcodeClass::CBI: Handle_CBI(instruction, this); return true;
+			case OpcodeClass::MOVW: Handle_MOVW(instruction, this); return true;
+			case OpcodeClass::MULS: Handle_MULS(instruction, this); return true;
+			case OpcodeClass::SBI: Handle_SBI(instruction, this); return true;
+			case OpcodeClass::SBIW: Handle_SBIW(instruction, this); return true;
+
+			case OpcodeClass::BLD: Handle_BLD(instruction, this); return true;
+			case OpcodeClass::BST: Handle_BST(instruction, this); return true;
+
+			case OpcodeClass::ADC: Handle_ADC(instruction, this); return true;
+			case OpcodeClass::ADD: Handle_ADD(instruction, this); return true;
+			case OpcodeClass::AND: Handle_AND(instruction, this); return true;
+			case OpcodeClass::BRBC:
+			case OpcodeClass::BRBS:
+			{
+				bool taken = opcode == OpcodeClass::BRBC ? Handle_BRBC(instruction, this) : Handle_BRBS(instruction, this);
+				if (taken) {
+					cycles -= Timing::GetCycles(opcode, true) - Timing::GetCycles(opcode, false);
+				}
+				return true;
+			}
+			case OpcodeClass::CP: Handle_CP(instruction, this); return true;
+			case OpcodeClass::CPC: Handle_CPC(instruction, this); return true;
+			case OpcodeClass::CPSE:
+			case OpcodeClass::SBIC:
+			case OpcodeClass::SBIS:
+			case OpcodeClass::SBRC:
+			case OpcodeClass::SBRS:
+			{
+				Byte skipped = 0;
+				switch (opcode) {
+					case OpcodeClass::CPSE: skipped = Handle_CPSE(instruction, this, memory); break;
+					case OpcodeClass::SBIC: skipped = Handle_SBIC(instruction, this, memory); break;
+					case OpcodeClass::SBIS: skipped = Handle_SBIS(instruction, this, memory); break;
+					case OpcodeClass::SBRC: skipped = Handle_SBRC(instruction, this, memory); break;
+					default: skipped = Handle_SBRS(instruction, this, memory); break;
+				}
+				if (skipped) {
+					cycles -= Timing::GetCycles(opcode, true, skipped) - Timing::GetCycles(opcode, false);
+				}
+				return true;
+			}
+			case OpcodeClass::EOR: Handle_EOR(instruction, this); return true;
+			case OpcodeClass::MOV: Handle_MOV(instruction, this); return true;
+			case OpcodeClass::MUL: Handle_MUL(instruction, this); return true;
+			case OpcodeClass::OR: Handle_OR(instruction, this); return true;
+			case OpcodeClass::SBC: Handle_SBC(instruction, this); return true;
+			case OpcodeClass::SUB: Handle_SUB(instruction, this); return true;
+
+			case OpcodeClass::IN: Handle_IN(instruction, this); return true;
+			case OpcodeClass::OUT: Handle_OUT(instruction, this); return true;
+
+			case OpcodeClass::LDD: Handle_LDD(instruction, this); return true;
+			case OpcodeClass::STD: Handle_STD(instruction, this); return true;
+
+			case OpcodeClass::IJMP: Handle_IJMP(instruction, this); return true;
+			case OpcodeClass::JMP: Handle_JMP(instruction, this, memory); return true;
+
+			case OpcodeClass::CALL:
+			case OpcodeClass::ICALL:
+			case OpcodeClass::RCALL:
+			{
+				const Word from = PC - 1;
+				switch (opcode) {
+					case OpcodeClass::CALL: Handle_CALL(instruction, this, memory); break;
+					case OpcodeClass::ICALL: Handle_ICALL(instruction, this); break;
+					default: Handle_RCALL(instruction, this); break;
+				}
+				onCall(from, cycles);
+				return true;
+			}
+			case OpcodeClass::RET: Handle_RET(instruction, this); onReturn(cycles); return true;
+			case OpcodeClass::RETI: Handle_RETI(instruction, this); onReturn(cycles); return true;
+			case OpcodeClass::PUSH: Handle_PUSH(instruction, this); return true;
+			case OpcodeClass::POP: Handle_POP(instruction, this); return true;
+
+			case OpcodeClass::RJMP:
+			{
+				Handle_RJMP(instruction, this);
+
+				if (instruction == SELF_LOOP && (RunStopFlags & STOP_ON_SELF_LOOP)) {
+					stop(StopReason::SelfLoop, cycles);
+				}
+				return true;
+			}
+			case OpcodeClass::ANDI: Handle_ANDI(instruction, this); return true;
+			case OpcodeClass::CPI: Handle_CPI(instruction, this); return true;
+			case OpcodeClass::ORI: Handle_ORI(instruction, this); return true;
+			case OpcodeClass::SBCI: Handle_SBCI(instruction, this); return true;
+			case OpcodeClass::SUBI: Handle_SUBI(instruction, this); return true;
+
 			default: break;
 		}
 
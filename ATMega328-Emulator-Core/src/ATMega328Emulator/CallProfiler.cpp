@@ -0,0 +1,159 @@
+#include "ATMega328Emulator/CallProfiler.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace ATMega328Emulator {
+
+	void CallProfiler::OnCall(Word from, Word target, Word sp, uint64_t cycle)
+	{
+		begin(from, cycle);
+		push(target * 2, sp, cycle);
+	}
+
+	void CallProfiler::OnInterrupt(Word from, Byte vector, Word sp, uint64_t cycle)
+	{
+		begin(from, cycle);
+		push(INTERRUPT_KEY + vector, sp, cycle);
+	}
+
+	void CallProfiler::OnReturn(Word sp, uint64_t cycle)
+	{
+		// Frames deeper than the return address were left without returning (longjmp, context switch)
+		while (m_Stack.size() > 1 && (uint32_t)m_Stack.back().SP + 2 < sp) {
+			pop(cycle);
+		}
+
+		// A return without a matching call (a computed jump through the stack) is ignored
+		if (m_Stack.size() > 1 && (uint32_t)m_Stack.back().SP + 2 == sp) {
+			pop(cycle);
+		}
+	}
+
+	void CallProfiler::Finish(uint64_t cycle)
+	{
+		while (!m_Stack.empty()) {
+			pop(cycle);
+		}
+	}
+
+	void CallProfiler::begin(Word pc, uint64_t cycle)
+	{
+		if (!m_Stack.empty()) {
+			return;
+		}
+
+		// The root is whatever function was running when the first event came in
+		if (m_Nodes.empty()) {
+			const SymbolTable::Symbol* symbol = m_Symbols.Find(pc * 2);
+			m_Nodes.push_back({ symbol ? symbol->Address : (uint32_t)pc * 2, UINT32_MAX, 0, 0, 0, {} });
+		}
+
+		// The root never returns
+		m_Stack.push_back({ 0, 0xFFFF, cycle });
+	}
+
+	void CallProfiler::push(uint32_t function, Word sp, uint64_t cycle)
+	{
+		const uint32_t parent = m_Stack.back().Node;
+
+		uint32_t node;
+		auto it = m_Nodes[parent].Children.find(function);
+		if (it != m_Nodes[parent].Children.end()) {
+			node = it->second;
+		}
+		else {
+			node = (uint32_t)m_Nodes.size();
+			m_Nodes[parent].Children.emplace(function, node);
+			m_Nodes.push_back({ function, parent, 0, 0, 0, {} });
+		}
+
+		m_Stack.push_back({ node, sp, cycle });
+	}
+
+	void CallProfiler::pop(uint64_t cycle)
+	{
+		const Frame frame = m_Stack.back();
+		m_Stack.pop_back();
+
+		const uint64_t inclusive = cycle - frame.EntryCycle;
+
+		Node& node = m_Nodes[frame.Node];
+		node.InclusiveCycles += inclusive;
+		node.ExclusiveCycles += inclusive - std::min(frame.ChildCycles, inclusive);
+		++node.Calls;
+
+		if (!m_Stack.empty()) {
+			m_Stack.back().ChildCycles += inclusive;
+		}
+	}
+
+	std::vector<CallProfiler::FunctionStats> CallProfiler::GetFunctionStats() const
+	{
+		std::unordered_map<uint32_t, FunctionStats> functions;
+
+		for (const Node& node : m_Nodes) {
+			FunctionStats& stats = functions[node.Function];
+			stats.Calls += node.Calls;
+			stats.ExclusiveCycles += node.ExclusiveCycles;
+
+			// Recursion would count the same cycles again
+			bool recursive = false;
+			for (uint32_t parent = node.Parent; parent != UINT32_MAX; parent = m_Nodes[parent].Parent) {
+				if (m_Nodes[parent].Function == node.Function) {
+					recursive = true;
+					break;
+				}
+			}
+			if (!recursive) {
+				stats.InclusiveCycles += node.InclusiveCycles;
+			}
+		}
+
+		std::vector<FunctionStats> result;
+		result.reserve(functions.size());
+		for (auto& [function, stats] : functions) {
+			stats.Name = getName(function);
+			result.push_back(std::move(stats));
+		}
+
+		std::sort(result.begin(), result.end(), [](const FunctionStats& a, const FunctionStats& b) {
+			return a.ExclusiveCycles != b.ExclusiveCycles ? a.ExclusiveCycles > b.ExclusiveCycles : a.Name < b.Name;
+		});
+		return result;
+	}
+
+	void CallProfiler::WriteFolded(std::ostream& out) const
+	{
+		std::vector<std::string> path;
+
+		for (const Node& node : m_Nodes) {
+			if (!node.ExclusiveCycles) {
+				continue;
+			}
+
+			path.clear();
+			for (const Node* n = &node;; n = &m_Nodes[n->Parent]) {
+				path.push_back(getName(n->Function));
+				if (n->Parent == UINT32_MAX) {
+					break;
+				}
+			}
+
+			for (auto it = path.rbegin(); it != path.rend(); ++it) {
+				out << (it == path.rbegin() ? "" : ";") << *it;
+			}
+			out << " " << node.ExclusiveCycles << "\n";
+		}
+	}
+
+	std::string CallProfiler::getName(uint32_t function) const
+	{
+		if (function >= INTERRUPT_KEY) {
+			// What avr-gcc names interrupt handlers
+			return "__vector_" + std::to_string(function - INTERRUPT_KEY);
+		}
+		return m_Symbols.GetName(function);
+	}
+
+}
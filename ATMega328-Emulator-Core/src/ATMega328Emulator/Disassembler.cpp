@@ -0,0 +1,191 @@
+#include "ATMega328Emulator/Disassembler.h"
+
+#include <cctype>
+#include <cstdio>
+#include <string>
+
+#include "ATMega328Emulator/Timing.h"
+
+namespace ATMega328Emulator {
+
+	namespace Disassembler {
+
+		namespace {
+
+			// Register fields, see the encodings in Instructions.h
+			Byte Rd5(Word instruction) { return (instruction >> 4) & 0x1F; }
+			Byte Rr5(Word instruction) { return (instruction & 0xF) | ((instruction >> 5) & 0x10); }
+			Byte Rd4(Word instruction) { return 16 + ((instruction >> 4) & 0xF); }
+			Byte K8(Word instruction) { return ((instruction >> 4) & 0xF0) | (instruction & 0xF); }
+
+			// Relative jumps are printed in bytes, like avr-objdump
+			int Relative(int words) { return words * 2; }
+
+			// X, X+ or -X and so on for LD and ST, see Instruction::LD_X
+			std::string Pointer(Word instruction)
+			{
+				const char* pointer = (instruction & 0b1100) == 0b1100 ? "X" : (instruction & 0b1000) ? "Y" : "Z";
+				switch (instruction & 0b11)
+				{
+					case 0b01: return std::string(pointer) + "+";
+					case 0b10: return std::string("-") + pointer;
+					default: return pointer;
+				}
+			}
+
+			// Y+q or Z+q for LDD and STD, just Y or Z without a displacement
+			std::string Displaced(Word instruction)
+			{
+				const int q = (instruction & 0x7) | ((instruction >> 7) & 0x18) | ((instruction >> 8) & 0x20);
+				const std::string pointer = (instruction & 0b1000) ? "Y" : "Z";
+				return q ? pointer + "+" + std::to_string(q) : pointer;
+			}
+
+		}
+
+		std::string Disassemble(Word instruction, Word operand)
+		{
+			const OpcodeClass opcode = Timing::Decode(instruction);
+
+			std::string mnemonic = GetOpcodeName(opcode);
+			for (char& c : mnemonic) {
+				c = (char)std::tolower((unsigned char)c);
+			}
+
+			char operands[32] = {};
+			switch (opcode)
+			{
+				case OpcodeClass::Unknown:
+				{
+					char text[16];
+					std::snprintf(text, sizeof(text), ".word 0x%04X", instruction);
+					return text;
+				}
+
+				case OpcodeClass::ADC: case OpcodeClass::ADD: case OpcodeClass::AND: case OpcodeClass::CP:
+				case OpcodeClass::CPC: case OpcodeClass::CPSE: case OpcodeClass::EOR: case OpcodeClass::MOV:
+				case OpcodeClass::MUL: case OpcodeClass::OR: case OpcodeClass::SBC: case OpcodeClass::SUB:
+					std::snprintf(operands, sizeof(operands), "r%d, r%d", Rd5(instruction), Rr5(instruction));
+					break;
+
+				case OpcodeClass::ASR: case OpcodeClass::COM: case OpcodeClass::DEC: case OpcodeClass::INC:
+				case OpcodeClass::LSR: case OpcodeClass::NEG: case OpcodeClass::POP: case OpcodeClass::PUSH:
+				case OpcodeClass::ROR: case OpcodeClass::SWAP:
+					std::snprintf(operands, sizeof(operands), "r%d", Rd5(instruction));
+					break;
+
+				case OpcodeClass::LAC: case OpcodeClass::LAS: case OpcodeClass::LAT:
+					std::snprintf(operands, sizeof(operands), "Z, r%d", Rd5(instruction));
+					break;
+
+				case OpcodeClass::ANDI: case OpcodeClass::CPI: case OpcodeClass::LDI:
+				case OpcodeClass::ORI: case OpcodeClass::SBCI: case OpcodeClass::SUBI:
+					std::snprintf(operands, sizeof(operands), "r%d, 0x%02X", Rd4(instruction), K8(instruction));
+					break;
+
+				case OpcodeClass::ADIW: case OpcodeClass::SBIW:
+					std::snprintf(operands, sizeof(operands), "r%d, 0x%02X",
+						24 + 2 * ((instruction >> 4) & 0x3), ((instruction >> 2) & 0x30) | (instruction & 0xF));
+					break;
+
+				case OpcodeClass::BCLR: case OpcodeClass::BSET:
+					std::snprintf(operands, sizeof(operands), "%d", (instruction >> 4) & 0x7);
+					break;
+
+				case OpcodeClass::BLD: case OpcodeClass::BST: case OpcodeClass::SBRC: case OpcodeClass::SBRS:
+					std::snprintf(operands, sizeof(operands), "r%d, %d", Rd5(instruction), instruction & 0x7);
+					break;
+
+				case OpcodeClass::BRBC: case OpcodeClass::BRBS:
+				{
+					const int k = (int8_t)(instruction >> 2) >> 1; // 7-bit signed offset
+					std::snprintf(operands, sizeof(operands), "%d, .%+d", instruction & 0x7, Relative(k));
+					break;
+				}
+
+				case OpcodeClass::CALL: case OpcodeClass::JMP:
+				{
+					const uint32_t k = ((uint32_t)(((instruction >> 3) & 0x3E) | (instruction & 0x1)) << 16) | operand;
+					std::snprintf(operands, sizeof(operands), "0x%X", k * 2);
+					break;
+				}
+
+				case OpcodeClass::CBI: case OpcodeClass::SBI: case OpcodeClass::SBIC: case OpcodeClass::SBIS:
+					std::snprintf(operands, sizeof(operands), "0x%02X, %d", (instruction >> 3) & 0x1F, instruction & 0x7);
+					break;
+
+				case OpcodeClass::FMUL: case OpcodeClass::FMULS: case OpcodeClass::FMULSU: case OpcodeClass::MULSU:
+					std::snprintf(operands, sizeof(operands), "r%d, r%d", 16 + ((instruction >> 4) & 0x7), 16 + (instruction & 0x7));
+					break;
+
+				case OpcodeClass::MULS:
+					std::snprintf(operands, sizeof(operands), "r%d, r%d", Rd4(instruction), 16 + (instruction & 0xF));
+					break;
+
+				case OpcodeClass::MOVW:
+					std::snprintf(operands, sizeof(operands), "r%d, r%d", 2 * ((instruction >> 4) & 0xF), 2 * (instruction & 0xF));
+					break;
+
+				case OpcodeClass::LDS:
+					std::snprintf(operands, sizeof(operands), "r%d, 0x%04X", Rd5(instruction), operand);
+					break;
+
+				case OpcodeClass::STS:
+					std::snprintf(operands, sizeof(operands), "0x%04X, r%d", operand, Rd5(instruction));
+					break;
+
+				case OpcodeClass::IN:
+					std::snprintf(operands, sizeof(operands), "r%d, 0x%02X", Rd5(instruction), ((instruction >> 5) & 0x30) | (instruction & 0xF));
+					break;
+
+				case OpcodeClass::LD:
+					std::snprintf(operands, sizeof(operands), "r%d, %s", Rd5(instruction), Pointer(instruction).c_str());
+					break;
+
+				case OpcodeClass::ST:
+					std::snprintf(operands, sizeof(operands), "%s, r%d", Pointer(instruction).c_str(), Rd5(instruction));
+					break;
+
+				// Without a displacement these are LD Rd,Y and ST Y,Rr, like avr-objdump prints them
+				case OpcodeClass::LDD: case OpcodeClass::STD:
+				{
+					const std::string pointer = Displaced(instruction);
+					if (pointer.size() == 1) {
+						mnemonic.pop_back();
+					}
+					if (opcode == OpcodeClass::LDD) {
+						std::snprintf(operands, sizeof(operands), "r%d, %s", Rd5(instruction), pointer.c_str());
+					}
+					else {
+						std::snprintf(operands, sizeof(operands), "%s, r%d", pointer.c_str(), Rd5(instruction));
+					}
+					break;
+				}
+
+				case OpcodeClass::LPM:
+					if (instruction != Instruction::LPM) {
+						std::snprintf(operands, sizeof(operands), "r%d, %s", Rd5(instruction), (instruction & 0b1) ? "Z+" : "Z");
+					}
+					break;
+
+				case OpcodeClass::OUT:
+					std::snprintf(operands, sizeof(operands), "0x%02X, r%d", ((instruction >> 5) & 0x30) | (instruction & 0xF), Rd5(instruction));
+					break;
+
+				case OpcodeClass::RCALL: case OpcodeClass::RJMP:
+				{
+					const int k = (int16_t)(instruction << 4) >> 4; // 12-bit signed offset
+					std::snprintf(operands, sizeof(operands), ".%+d", Relative(k));
+					break;
+				}
+
+				default:
+					break;
+			}
+
+			return operands[0] ? mnemonic + " " + operands : mnemonic;
+		}
+
+	}
+
+}
@@ -0,0 +1,562 @@
+#include "ATMega328Emulator/GDBStub.h"
+
+#include <cstdio>
+
+#include "ATMega328Emulator/Instructions.h"
+
+namespace ATMega328Emulator {
+
+	namespace {
+
+		// avr-gdb's register numbers, the general purpose registers are 0 to 31
+		constexpr uint32_t REGISTER_SREG = 32;
+		constexpr uint32_t REGISTER_SP = 33;
+		constexpr uint32_t REGISTER_PC = 34;    // A byte address, 4 bytes wide
+		constexpr size_t REGISTERS_SIZE = 39;   // What g and G transfer
+
+		constexpr const char* HEX_DIGITS = "0123456789abcdef";
+
+		int HexValue(char c)
+		{
+			if (c >= '0' && c <= '9') return c - '0';
+			if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+			if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+			return -1;
+		}
+
+		void AppendHex(std::string& out, Byte value)
+		{
+			out += HEX_DIGITS[value >> 4];
+			out += HEX_DIGITS[value & 0xF];
+		}
+
+		// Little endian, like GDB sends register values
+		void AppendHex(std::string& out, uint32_t value, size_t bytes)
+		{
+			for (size_t i = 0; i < bytes; ++i) {
+				AppendHex(out, (Byte)(value >> (i * 8)));
+			}
+		}
+
+		bool ParseByte(std::string_view hex, size_t index, Byte& value)
+		{
+			if (hex.size() < index * 2 + 2) {
+				return false;
+			}
+
+			const int hi = HexValue(hex[index * 2]);
+			const int lo = HexValue(hex[index * 2 + 1]);
+			if (hi < 0 || lo < 0) {
+				return false;
+			}
+			value = (Byte)(hi << 4 | lo);
+			return true;
+		}
+
+		bool ParseLittleEndian(std::string_view hex, size_t bytes, uint32_t& value)
+		{
+			value = 0;
+			for (size_t i = 0; i < bytes; ++i) {
+				Byte byte;
+				if (!ParseByte(hex, i, byte)) {
+					return false;
+				}
+				value |= (uint32_t)byte << (i * 8);
+			}
+			return true;
+		}
+
+		// A big endian hex number, as addresses and lengths are written. Moves text past it.
+		bool ParseNumber(std::string_view& text, uint32_t& value)
+		{
+			size_t length = 0;
+			value = 0;
+			while (length < text.size() && HexValue(text[length]) >= 0) {
+				value = value << 4 | HexValue(text[length]);
+				++length;
+			}
+			text.remove_prefix(length);
+			return length > 0;
+		}
+
+		bool Expect(std::string_view& text, char c)
+		{
+			if (text.empty() || text.front() != c) {
+				return false;
+			}
+			text.remove_prefix(1);
+			return true;
+		}
+
+	}
+
+	GDBPacketReader::Event GDBPacketReader::Feed(char c)
+	{
+		switch (m_State)
+		{
+			case State::Idle:
+			{
+				if (c == '$') {
+					m_Packet.clear();
+					m_Sum = 0;
+					m_State = State::Payload;
+				}
+				else if (c == '\x03') {
+					return Event::Interrupt;
+				}
+				// Acks and noise between packets
+				return Event::None;
+			}
+			case State::Payload:
+			{
+				if (c == '#') {
+					m_State = State::ChecksumHigh;
+				}
+				else {
+					m_Packet += c;
+					m_Sum += (Byte)c;
+				}
+				return Event::None;
+			}
+			case State::ChecksumHigh:
+			{
+				m_Valid = HexValue(c) >= 0;
+				m_Checksum = m_Valid ? (Byte)(HexValue(c) << 4) : 0;
+				m_State = State::ChecksumLow;
+				return Event::None;
+			}
+			case State::ChecksumLow:
+			{
+				m_State = State::Idle;
+				if (!m_Valid || HexValue(c) < 0 || (Byte)(m_Checksum | HexValue(c)) != m_Sum) {
+					return Event::BadPacket;
+				}
+				return Event::Packet;
+			}
+		}
+
+		return Event::None;
+	}
+
+	GDBStub::GDBStub(CPU& cpu, Memory& memory)
+		: m_CPU(cpu), m_Memory(memory)
+	{
+		m_Watchpoints.SetCallback([this](const WatchEvent& event) {
+			m_WatchHit = true;
+			m_WatchEvent = event;
+			return true;
+		});
+	}
+
+	GDBStub::~GDBStub()
+	{
+		RemoveAllBreakpoints();
+		if (m_CPU.AttachedWatchpoints == &m_Watchpoints) {
+			m_CPU.AttachedWatchpoints = nullptr;
+		}
+	}
+
+	std::string GDBStub::EncodePacket(std::string_view payload)
+	{
+		Byte sum = 0;
+		for (char c : payload) {
+			sum += (Byte)c;
+		}
+
+		std::string packet;
+		packet.reserve(payload.size() + 4);
+		packet += '$';
+		packet += payload;
+		packet += '#';
+		AppendHex(packet, sum);
+		return packet;
+	}
+
+	std::string GDBStub::HandlePacket(std::string_view packet)
+	{
+		if (packet.empty()) {
+			return "";
+		}
+
+		const char command = packet.front();
+		std::string_view args = packet.substr(1);
+
+		switch (command)
+		{
+			case '?': return m_LastStop;
+			case 'g': return readRegisters();
+			case 'G': return writeRegisters(args) ? "OK" : "E01";
+			case 'p':
+			{
+				uint32_t index;
+				return ParseNumber(args, index) ? readRegister(index) : "E01";
+			}
+			case 'P':
+			{
+				uint32_t index;
+				if (!ParseNumber(args, index) || !Expect(args, '=')) {
+					return "E01";
+				}
+				return writeRegister(index, args) ? "OK" : "E01";
+			}
+			case 'm':
+			{
+				uint32_t address, length;
+				if (!ParseNumber(args, address) || !Expect(args, ',') || !ParseNumber(args, length)) {
+					return "E01";
+				}
+				return readMemory(address, length);
+			}
+			case 'M':
+			{
+				uint32_t address, length;
+				if (!ParseNumber(args, address) || !Expect(args, ',') || !ParseNumber(args, length) || !Expect(args, ':')
+					|| args.size() != (size_t)length * 2) {
+					return "E01";
+				}
+				return writeMemory(address, args) ? "OK" : "E01";
+			}
+			case 'c':
+			case 's':
+			{
+				// An address to resume from is optional
+				uint32_t address;
+				if (ParseNumber(args, address)) {
+					m_CPU.PC = (Word)(address / 2);
+				}
+				return resume(command == 's');
+			}
+			case 'Z':
+			case 'z':
+			{
+				const bool insert = command == 'Z';
+				const char type = args.empty() ? 0 : args.front();
+				args.remove_prefix(args.empty() ? 0 : 1);
+
+				uint32_t address, kind;
+				if (!Expect(args, ',') || !ParseNumber(args, address) || !Expect(args, ',') || !ParseNumber(args, kind)) {
+					return "E01";
+				}
+
+				// Hardware breakpoints are just as cheap as software ones here
+				if (type == '0' || type == '1') {
+					if (address >= DATA_OFFSET) {
+						return "E01";
+					}
+					const Word pc = (Word)((address & Memory::ADDRESS_MASK) / 2);
+					return (insert ? InsertBreakpoint(pc) : RemoveBreakpoint(pc)) ? "OK" : "E01";
+				}
+				if (type >= '2' && type <= '4') {
+					return setWatchpoint(insert, type, address, kind);
+				}
+				return "";
+			}
+			case 'H': return "OK"; // There is only one thread
+			case 'q':
+			{
+				if (args.starts_with("Supported")) {
+					return "PacketSize=1000";
+				}
+				if (args == "Attached") {
+					return "1";
+				}
+				return "";
+			}
+			case 'D':
+			case 'k':
+			{
+				RemoveAllBreakpoints();
+				m_Watchpoints.Clear();
+				m_WatchIds.clear();
+				m_WatchTypes.clear();
+				m_Detached = true;
+				return command == 'D' ? "OK" : "";
+			}
+			default: return "";
+		}
+	}
+
+	bool GDBStub::InsertBreakpoint(Word pc)
+	{
+		pc &= CPU::FLASH_MASK / 2;
+		if (m_Breakpoints.count(pc)) {
+			return true;
+		}
+
+		const uint32_t address = pc * 2;
+		m_Breakpoints.emplace(pc, (Word)(m_Memory[address] | (m_Memory[address + 1] << 8)));
+		m_Memory[address] = Instruction::BREAK & 0xFF;
+		m_Memory[address + 1] = Instruction::BREAK >> 8;
+		return true;
+	}
+
+	bool GDBStub::RemoveBreakpoint(Word pc)
+	{
+		pc &= CPU::FLASH_MASK / 2;
+		auto it = m_Breakpoints.find(pc);
+		if (it == m_Breakpoints.end()) {
+			return false;
+		}
+
+		const uint32_t address = pc * 2;
+		m_Memory[address] = it->second & 0xFF;
+		m_Memory[address + 1] = it->second >> 8;
+		m_Breakpoints.erase(it);
+		return true;
+	}
+
+	void GDBStub::RemoveAllBreakpoints()
+	{
+		while (!m_Breakpoints.empty()) {
+			RemoveBreakpoint(m_Breakpoints.begin()->first);
+		}
+	}
+
+	std::string GDBStub::readRegisters() const
+	{
+		std::string out;
+		out.reserve(REGISTERS_SIZE * 2);
+		for (uint32_t index = 0; index <= REGISTER_PC; ++index) {
+			out += readRegister(index);
+		}
+		return out;
+	}
+
+	bool GDBStub::writeRegisters(std::string_view hex)
+	{
+		if (hex.size() < REGISTERS_SIZE * 2) {
+			return false;
+		}
+
+		for (uint32_t index = 0; index < REGISTER_SREG; ++index) {
+			writeRegister(index, hex.substr(index * 2, 2));
+		}
+		writeRegister(REGISTER_SREG, hex.substr(64, 2));
+		writeRegister(REGISTER_SP, hex.substr(66, 4));
+		writeRegister(REGISTER_PC, hex.substr(70, 8));
+		return true;
+	}
+
+	std::string GDBStub::readRegister(uint32_t index) const
+	{
+		std::string out;
+		if (index < REGISTER_SREG) {
+			AppendHex(out, (&m_CPU.R00)[index]);
+		}
+		else if (index == REGISTER_SREG) {
+			AppendHex(out, *(const Byte*)&m_CPU.IO.SREG);
+		}
+		else if (index == REGISTER_SP) {
+			AppendHex(out, m_CPU.IO.SP, 2);
+		}
+		else if (index == REGISTER_PC) {
+			AppendHex(out, (uint32_t)m_CPU.PC * 2, 4);
+		}
+		else {
+			return "E01";
+		}
+		return out;
+	}
+
+	bool GDBStub::writeRegister(uint32_t index, std::string_view hex)
+	{
+		uint32_t value;
+		if (index < REGISTER_SREG && ParseLittleEndian(hex, 1, value)) {
+			(&m_CPU.R00)[index] = (Byte)value;
+		}
+		else if (index == REGISTER_SREG && ParseLittleEndian(hex, 1, value)) {
+			*(Byte*)&m_CPU.IO.SREG = (Byte)value;
+		}
+		else if (index == REGISTER_SP && ParseLittleEndian(hex, 2, value)) {
+			m_CPU.IO.SP = (Word)value;
+		}
+		else if (index == REGISTER_PC && ParseLittleEndian(hex, 4, value)) {
+			m_CPU.PC = (Word)(value / 2);
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	std::string GDBStub::readMemory(uint32_t address, uint32_t length) const
+	{
+		std::string out;
+		out.reserve((size_t)length * 2);
+
+		for (uint32_t i = 0; i < length; ++i) {
+			const uint32_t at = address + i;
+			if (at < DATA_OFFSET) {
+				AppendHex(out, readFlash(at));
+			}
+			else if (at < EEPROM_OFFSET) {
+				if (at - DATA_OFFSET >= CPU::DATA_SPACE_SIZE) {
+					return i ? out : "E01";
+				}
+				AppendHex(out, m_CPU.ReadData((Word)(at - DATA_OFFSET)));
+			}
+			else {
+				if (at - EEPROM_OFFSET >= CPU::EEPROM_SIZE) {
+					return i ? out : "E01";
+				}
+				AppendHex(out, m_CPU.EEPROM[at - EEPROM_OFFSET]);
+			}
+		}
+		return out;
+	}
+
+	bool GDBStub::writeMemory(uint32_t address, std::string_view hex)
+	{
+		for (uint32_t i = 0; i < hex.size() / 2; ++i) {
+			Byte value;
+			if (!ParseByte(hex, i, value)) {
+				return false;
+			}
+
+			const uint32_t at = address + i;
+			if (at < DATA_OFFSET) {
+				writeFlash(at, value);
+			}
+			else if (at < EEPROM_OFFSET) {
+				if (at - DATA_OFFSET >= CPU::DATA_SPACE_SIZE) {
+					return false;
+				}
+				m_CPU.WriteData((Word)(at - DATA_OFFSET), value);
+			}
+			else {
+				if (at - EEPROM_OFFSET >= CPU::EEPROM_SIZE) {
+					return false;
+				}
+				m_CPU.WriteEEPROM((Word)(at - EEPROM_OFFSET), value);
+			}
+		}
+		return true;
+	}
+
+	Byte GDBStub::readFlash(uint32_t address) const
+	{
+		auto it = m_Breakpoints.find((Word)((address & Memory::ADDRESS_MASK) / 2));
+		if (it != m_Breakpoints.end()) {
+			return (Byte)(address & 1 ? it->second >> 8 : it->second);
+		}
+		return m_Memory[address & Memory::ADDRESS_MASK];
+	}
+
+	void GDBStub::writeFlash(uint32_t address, Byte value)
+	{
+		// Under a breakpoint the BREAK stays and the write goes to what it replaced
+		auto it = m_Breakpoints.find((Word)((address & Memory::ADDRESS_MASK) / 2));
+		if (it != m_Breakpoints.end()) {
+			it->second = address & 1 ? (Word)((it->second & 0x00FF) | (value << 8)) : (Word)((it->second & 0xFF00) | value);
+			return;
+		}
+
+		int dummyCycles = 0;
+		m_Memory.Write(value, (Word)(address & Memory::ADDRESS_MASK), dummyCycles);
+	}
+
+	std::string GDBStub::setWatchpoint(bool insert, char type, uint32_t address, uint32_t length)
+	{
+		const auto key = std::make_tuple(type, address, length);
+		if (!insert) {
+			auto it = m_WatchIds.find(key);
+			if (it == m_WatchIds.end()) {
+				return "E01";
+			}
+			m_Watchpoints.Remove(it->second);
+			m_WatchTypes.erase(it->second);
+			m_WatchIds.erase(it);
+			return "OK";
+		}
+
+		// The CPU has one watchpoint slot, the host's watchpoints keep it
+		if (m_CPU.AttachedWatchpoints && m_CPU.AttachedWatchpoints != &m_Watchpoints) {
+			return "E01";
+		}
+
+		const WatchAccess access = type == '2' ? WatchAccess::Write : type == '3' ? WatchAccess::Read : WatchAccess::ReadWrite;
+		int id = -1;
+		if (address >= EEPROM_OFFSET) {
+			id = m_Watchpoints.Add(WatchSpace::EEPROM, (Word)(address - EEPROM_OFFSET), (Word)length, access);
+		}
+		else if (address >= DATA_OFFSET) {
+			id = m_Watchpoints.Add(WatchSpace::Data, (Word)(address - DATA_OFFSET), (Word)length, access);
+		}
+		if (id < 0) {
+			return "E01";
+		}
+
+		m_WatchIds[key] = id;
+		m_WatchTypes[id] = type;
+		return "OK";
+	}
+
+	std::string GDBStub::resume(bool step)
+	{
+		StopConditions conditions;
+		conditions.StopOnBreak = true;
+		conditions.StopOnIllegalOpcode = true;
+
+		// Watchpoints select Run's instrumented loop, so they are only attached while there are any.
+		// Watchpoints the host attached since they were set stay, GDB's don't stop then.
+		m_WatchHit = false;
+		const bool watching = m_Watchpoints.GetCount() && !m_CPU.AttachedWatchpoints;
+		if (watching) {
+			m_CPU.AttachedWatchpoints = &m_Watchpoints;
+		}
+
+		// The first instruction runs with its breakpoint taken out, so resuming doesn't stop on it again.
+		// A BREAK that is part of the firmware acts as a NOP there.
+		StopConditions first;
+		first.StopOnIllegalOpcode = true;
+
+		const Word pc = m_CPU.PC & (CPU::FLASH_MASK / 2);
+		auto breakpoint = m_Breakpoints.find(pc);
+		if (breakpoint != m_Breakpoints.end()) {
+			m_Memory[pc * 2] = breakpoint->second & 0xFF;
+			m_Memory[pc * 2 + 1] = breakpoint->second >> 8;
+		}
+
+		RunResult result = m_CPU.Run(1, first, m_Memory);
+
+		if (breakpoint != m_Breakpoints.end()) {
+			m_Memory[pc * 2] = Instruction::BREAK & 0xFF;
+			m_Memory[pc * 2 + 1] = Instruction::BREAK >> 8;
+		}
+
+		bool interrupted = false;
+		// Register hooks stop for a scheduler, there is none here
+		while (!step && (result.Reason == StopReason::CycleBudget || result.Reason == StopReason::RegisterHook)) {
+			if (m_InterruptCheck && m_InterruptCheck()) {
+				interrupted = true;
+				break;
+			}
+			result = m_CPU.Run(CONTINUE_SLICE, conditions, m_Memory);
+		}
+
+		if (watching) {
+			m_CPU.AttachedWatchpoints = nullptr;
+		}
+
+		if (result.Reason == StopReason::Watchpoint && m_WatchHit) {
+			// watch, rwatch or awatch, with the address as GDB knows it
+			const char type = m_WatchTypes.count(m_WatchEvent.Id) ? m_WatchTypes[m_WatchEvent.Id] : '2';
+			const uint32_t offset = m_WatchEvent.Space == WatchSpace::EEPROM ? EEPROM_OFFSET : DATA_OFFSET;
+			char reply[48];
+			std::snprintf(reply, sizeof(reply), "T05%s:%x;", type == '2' ? "watch" : type == '3' ? "rwatch" : "awatch",
+				offset + m_WatchEvent.Address);
+			m_LastStop = reply;
+		}
+		else if (result.Reason == StopReason::IllegalOpcode) {
+			m_LastStop = "S04"; // SIGILL
+		}
+		else if (interrupted) {
+			m_LastStop = "S02"; // SIGINT
+		}
+		else {
+			m_LastStop = "S05"; // SIGTRAP, a breakpoint or a finished step
+		}
+		return m_LastStop;
+	}
+
+}
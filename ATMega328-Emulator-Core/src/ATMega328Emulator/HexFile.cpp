@@ -0,0 +1,129 @@
+#include "ATMega328Emulator/HexFile.h"
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace ATMega328Emulator {
+
+	namespace HexFile {
+
+		namespace {
+
+			// Record types
+			constexpr int DATA = 0x00;
+			constexpr int END_OF_FILE = 0x01;
+			constexpr int EXTENDED_SEGMENT_ADDRESS = 0x02;
+			constexpr int START_SEGMENT_ADDRESS = 0x03;
+			constexpr int EXTENDED_LINEAR_ADDRESS = 0x04;
+			constexpr int START_LINEAR_ADDRESS = 0x05;
+
+			int HexDigit(char c)
+			{
+				if (c >= '0' && c <= '9') return c - '0';
+				if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+				if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+				return -1;
+			}
+
+		}
+
+		bool Load(const std::string& filepath, Memory& memory)
+		{
+			std::ifstream file(filepath, std::ios::binary);
+			if (!file) {
+				return false;
+			}
+
+			std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			return Parse(text, memory);
+		}
+
+		bool Parse(std::string_view text, Memory& memory)
+		{
+			uint32_t base = 0;
+			size_t position = 0;
+			while (position < text.size()) {
+				size_t end = text.find('\n', position);
+				if (end == std::string_view::npos) {
+					end = text.size();
+				}
+				std::string_view line = text.substr(position, end - position);
+				position = end + 1;
+
+				while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+					line.remove_suffix(1);
+				}
+				if (line.empty()) {
+					continue;
+				}
+
+				// :LLAAAATT<data>CC, the checksum makes all the bytes add up to 0
+				if (line[0] != ':' || line.size() < 11 || line.size() % 2 == 0) {
+					return false;
+				}
+
+				std::vector<Byte> bytes;
+				for (size_t i = 1; i < line.size(); i += 2) {
+					const int hi = HexDigit(line[i]);
+					const int lo = HexDigit(line[i + 1]);
+					if (hi < 0 || lo < 0) {
+						return false;
+					}
+					bytes.push_back((Byte)(hi << 4 | lo));
+				}
+
+				Byte sum = 0;
+				for (Byte byte : bytes) {
+					sum += byte;
+				}
+				const size_t length = bytes[0];
+				if (sum != 0 || bytes.size() != length + 5) {
+					return false;
+				}
+
+				const uint32_t address = bytes[1] << 8 | bytes[2];
+				const Byte* data = bytes.data() + 4;
+				switch (bytes[3])
+				{
+					case DATA:
+					{
+						if (base + address + length > Memory::MAX_MEM) {
+							return false;
+						}
+						int dummyCycles = 0;
+						for (size_t i = 0; i < length; ++i) {
+							memory.Write(data[i], (Word)(base + address + i), dummyCycles);
+						}
+						break;
+					}
+					case END_OF_FILE:
+						return true;
+					case EXTENDED_SEGMENT_ADDRESS:
+						if (length != 2) {
+							return false;
+						}
+						base = (data[0] << 8 | data[1]) << 4;
+						break;
+					case EXTENDED_LINEAR_ADDRESS:
+						if (length != 2) {
+							return false;
+						}
+						base = (uint32_t)(data[0] << 8 | data[1]) << 16;
+						break;
+					case START_SEGMENT_ADDRESS:
+					case START_LINEAR_ADDRESS:
+						// Where to start doesn't matter, the CPU always starts at the reset vector
+						break;
+					default:
+						return false;
+				}
+			}
+
+			// avr-objcopy always ends with an end of file record, but a missing one loses nothing
+			return true;
+		}
+
+	}
+
+}
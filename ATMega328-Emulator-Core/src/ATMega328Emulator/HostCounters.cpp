@@ -0,0 +1,213 @@
+#include "ATMega328Emulator/HostCounters.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef __linux__
+	#include <linux/perf_event.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+namespace ATMega328Emulator {
+
+	namespace {
+
+#ifdef __linux__
+		struct EventConfig
+		{
+			uint32_t Type;
+			uint64_t Config;
+		};
+
+		constexpr uint64_t CacheConfig(uint64_t cache, uint64_t op, uint64_t result)
+		{
+			return cache | (op << 8) | (result << 16);
+		}
+
+		constexpr EventConfig EVENT_CONFIGS[] = {
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+			{ PERF_TYPE_HW_CACHE, CacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		};
+		static_assert(sizeof(EVENT_CONFIGS) / sizeof(EVENT_CONFIGS[0]) == (size_t)HostEvent::Count, "A host event is missing its config");
+
+		// What a read returns with PERF_FORMAT_TOTAL_TIME_ENABLED and PERF_FORMAT_TOTAL_TIME_RUNNING
+		struct EventValue
+		{
+			uint64_t Value;
+			uint64_t TimeEnabled;
+			uint64_t TimeRunning;
+		};
+#endif
+
+		double Ratio(uint64_t a, uint64_t b)
+		{
+			return b ? (double)a / (double)b : 0.0;
+		}
+
+	}
+
+	double HostCounters::Reading::PerInstruction(HostEvent event) const
+	{
+		return IsAvailable(event) ? Ratio(Get(event), EmulatedInstructions) : 0.0;
+	}
+
+	double HostCounters::Reading::GetIPC() const
+	{
+		if (!IsAvailable(HostEvent::Cycles) || !IsAvailable(HostEvent::Instructions)) {
+			return 0.0;
+		}
+		return Ratio(Get(HostEvent::Instructions), Get(HostEvent::Cycles));
+	}
+
+	double HostCounters::Reading::GetBranchMissRate() const
+	{
+		if (!IsAvailable(HostEvent::Branches) || !IsAvailable(HostEvent::BranchMisses)) {
+			return 0.0;
+		}
+		return Ratio(Get(HostEvent::BranchMisses), Get(HostEvent::Branches));
+	}
+
+	void HostCounters::Reading::WriteReport(std::ostream& out) const
+	{
+		char line[128];
+		std::snprintf(line, sizeof(line), "%-14s %20s %16s\n", "Event", "Count", "Per instruction");
+		out << line;
+		for (size_t i = 0; i < (size_t)HostEvent::Count; ++i) {
+			if (!Available[i]) {
+				continue;
+			}
+			std::snprintf(line, sizeof(line), "%-14s %20llu %16.3f\n", HOST_EVENT_NAMES[i],
+				(unsigned long long)Values[i], PerInstruction((HostEvent)i));
+			out << line;
+		}
+		std::snprintf(line, sizeof(line), "%-14s %20llu\n", "Emulated", (unsigned long long)EmulatedInstructions);
+		out << line;
+		if (GetIPC() > 0.0) {
+			std::snprintf(line, sizeof(line), "Host IPC %.2f, branch miss rate %.2f%%\n", GetIPC(), GetBranchMissRate() * 100.0);
+			out << line;
+		}
+	}
+
+	HostCounters::HostCounters()
+	{
+		m_Fds.fill(-1);
+	}
+
+	HostCounters::~HostCounters()
+	{
+		Close();
+	}
+
+	bool HostCounters::Open()
+	{
+		Close();
+
+#ifdef __linux__
+		for (size_t i = 0; i < (size_t)HostEvent::Count; ++i) {
+			perf_event_attr attr = {};
+			attr.size = sizeof(attr);
+			attr.type = EVENT_CONFIGS[i].Type;
+			attr.config = EVENT_CONFIGS[i].Config;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+			// This thread on any CPU, every event on its own so the ones the host lacks don't take the others down
+			m_Fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+			m_Open |= m_Fds[i] >= 0;
+		}
+#endif
+
+		Reset();
+		return m_Open;
+	}
+
+	void HostCounters::Close()
+	{
+#ifdef __linux__
+		for (int& fd : m_Fds) {
+			if (fd >= 0) {
+				close(fd);
+			}
+			fd = -1;
+		}
+#endif
+		m_Open = false;
+	}
+
+	void HostCounters::Start()
+	{
+#ifdef __linux__
+		for (int fd : m_Fds) {
+			if (fd >= 0) {
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+#endif
+	}
+
+	void HostCounters::Stop(uint64_t emulatedInstructions, uint64_t emulatedCycles)
+	{
+#ifdef __linux__
+		for (int fd : m_Fds) {
+			if (fd >= 0) {
+				ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			}
+		}
+
+		for (size_t i = 0; i < (size_t)HostEvent::Count; ++i) {
+			EventValue value;
+			if (m_Fds[i] < 0 || read(m_Fds[i], &value, sizeof(value)) != sizeof(value) || value.TimeRunning == 0) {
+				continue;
+			}
+
+			// Scaled up if the kernel had to multiplex it
+			uint64_t count = value.Value;
+			if (value.TimeRunning < value.TimeEnabled) {
+				count = (uint64_t)((double)count * value.TimeEnabled / value.TimeRunning);
+			}
+			m_Reading.Values[i] += count;
+			m_Reading.Available[i] = true;
+		}
+#endif
+
+		m_Reading.EmulatedInstructions += emulatedInstructions;
+		m_Reading.EmulatedCycles += emulatedCycles;
+	}
+
+	void HostCounters::Reset()
+	{
+		m_Reading = Reading();
+	}
+
+	RunResult HostCounters::Run(CPU& cpu, uint64_t maxCycles, const StopConditions& conditions, Memory& memory)
+	{
+		Start();
+		RunResult result = cpu.Run(maxCycles, conditions, memory);
+		Stop(result);
+		return result;
+	}
+
+	void HostCounters::Execute(CPU& cpu, int cycles, Memory& memory)
+	{
+		// Execute is Run without stop conditions, Run tells how many instructions it took.
+		// Like CPU::Execute it runs on through hook stops, they are for the Scheduler.
+		uint64_t remaining = cycles > 0 ? (uint64_t)cycles : 0;
+		while (remaining) {
+			const RunResult result = Run(cpu, remaining, StopConditions(), memory);
+			if (result.Reason != StopReason::RegisterHook) {
+				break;
+			}
+			remaining -= std::min(result.Cycles, remaining);
+		}
+	}
+
+}
@@ -0,0 +1,109 @@
+#include "ATMega328Emulator/InstructionMix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace ATMega328Emulator {
+
+	namespace {
+
+		double Share(uint64_t part, uint64_t total)
+		{
+			return total ? 100.0 * (double)part / (double)total : 0.0;
+		}
+
+	}
+
+	void InstructionMix::Reset()
+	{
+		m_Counters.fill({});
+	}
+
+	uint64_t InstructionMix::GetTotalExecutions() const
+	{
+		uint64_t total = 0;
+		for (const Counters& counters : m_Counters) {
+			total += counters.Executions;
+		}
+		return total;
+	}
+
+	uint64_t InstructionMix::GetTotalCycles() const
+	{
+		uint64_t total = 0;
+		for (const Counters& counters : m_Counters) {
+			total += counters.Cycles;
+		}
+		return total;
+	}
+
+	InstructionMix& InstructionMix::operator+=(const InstructionMix& other)
+	{
+		for (size_t i = 0; i < m_Counters.size(); ++i) {
+			m_Counters[i].Executions += other.m_Counters[i].Executions;
+			m_Counters[i].Cycles += other.m_Counters[i].Cycles;
+		}
+		return *this;
+	}
+
+	void InstructionMix::WriteReport(std::ostream& out) const
+	{
+		std::vector<size_t> order;
+		for (size_t i = 0; i < m_Counters.size(); ++i) {
+			if (m_Counters[i].Executions) {
+				order.push_back(i);
+			}
+		}
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return m_Counters[a].Cycles > m_Counters[b].Cycles; });
+
+		const uint64_t totalCycles = GetTotalCycles();
+
+		char line[128];
+		std::snprintf(line, sizeof(line), "%-8s %20s %20s %8s\n", "Class", "Executions", "Cycles", "Time");
+		out << line;
+		for (size_t i : order) {
+			std::snprintf(line, sizeof(line), "%-8s %20llu %20llu %7.2f%%\n", GetOpcodeName((OpcodeClass)i),
+				(unsigned long long)m_Counters[i].Executions, (unsigned long long)m_Counters[i].Cycles, Share(m_Counters[i].Cycles, totalCycles));
+			out << line;
+		}
+		std::snprintf(line, sizeof(line), "%-8s %20llu %20llu %7.2f%%\n", "Total",
+			(unsigned long long)GetTotalExecutions(), (unsigned long long)totalCycles, totalCycles ? 100.0 : 0.0);
+		out << line;
+	}
+
+	void InstructionMix::WriteDiff(std::ostream& out, const InstructionMix& base, const InstructionMix& other,
+		const std::string& baseName, const std::string& otherName)
+	{
+		const uint64_t baseTotal = base.GetTotalCycles();
+		const uint64_t otherTotal = other.GetTotalCycles();
+
+		struct Row
+		{
+			size_t Opcode;
+			double Base, Other;
+		};
+
+		std::vector<Row> rows;
+		for (size_t i = 0; i < base.m_Counters.size(); ++i) {
+			if (base.m_Counters[i].Executions || other.m_Counters[i].Executions) {
+				rows.push_back({ i, Share(base.m_Counters[i].Cycles, baseTotal), Share(other.m_Counters[i].Cycles, otherTotal) });
+			}
+		}
+		std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+			return std::fabs(a.Other - a.Base) > std::fabs(b.Other - b.Base);
+		});
+
+		// Names are cut to fit the columns
+		char line[128];
+		std::snprintf(line, sizeof(line), "%-8s %10.10s %10.10s %10s\n", "Class", baseName.c_str(), otherName.c_str(), "Change");
+		out << line;
+		for (const Row& row : rows) {
+			std::snprintf(line, sizeof(line), "%-8s %9.2f%% %9.2f%% %+9.2f%%\n", GetOpcodeName((OpcodeClass)row.Opcode),
+				row.Base, row.Other, row.Other - row.Base);
+			out << line;
+		}
+	}
+
+}
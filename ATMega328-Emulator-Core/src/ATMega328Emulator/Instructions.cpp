@@ -1,5 +1,7 @@
 #include "ATMega328Emulator/Instructions.h"
 
+#include "ATMega328Emulator/Timing.h"
+
 namespace ATMega328Emulator {
 	
 	namespace Instruction {
@@ -31,7 +33,7 @@ namespace ATMega328Emulator {
 
 			namespace S {
 				
-				// N XOR V, for signed tests.
+				// N XOR V, for signed tests. N and V have to be set first.
 				static inline void SignedTest(CPU* cpu)
 				{
 					cpu->IO.SREG.S = cpu->IO.SREG.N ^ cpu->IO.SREG.V;
@@ -55,9 +57,14 @@ namespace ATMega328Emulator {
 					) >> 7;
 				}
 
-				static inline void WordAddTwosComplementOverflow(CPU* cpu, Word R, Word Rdh)
+				static inline void WordAddTwosComplementOverflow(CPU* cpu, Word R, Word Rd)
+				{
+					cpu->IO.SREG.V = ((~Rd & 0x8000) >> 15) & ((R & 0x8000) >> 15);
+				}
+
+				static inline void WordSubTwosComplementOverflow(CPU* cpu, Word R, Word Rd)
 				{
-					cpu->IO.SREG.V = ((~Rdh & 0x80) >> 7) & ((R & 0x8000) >> 15);
+					cpu->IO.SREG.V = ((Rd & 0x8000) >> 15) & ((~R & 0x8000) >> 15);
 				}
 
 				// Set if twos complement overflow resulted from the operation; cleared otherwise.
@@ -138,7 +145,13 @@ namespace ATMega328Emulator {
 				// Set if there was a carry from the Most Significant Bit(MSB) of the result; cleared otherwise.
 				static inline void WordCarryMSB(CPU* cpu, Word R, Word Rd)
 				{
-					cpu->IO.SREG.C = ((~R & 0x8000) >> 15) & ((Rd & 0x80) >> 7);
+					cpu->IO.SREG.C = ((~R & 0x8000) >> 15) & ((Rd & 0x8000) >> 15);
+				}
+
+				// Set if the absolute value of K is larger than the absolute value of Rd; cleared otherwise.
+				static inline void WordGreater(CPU* cpu, Word R, Word Rd)
+				{
+					cpu->IO.SREG.C = ((R & 0x8000) >> 15) & ((~Rd & 0x8000) >> 15);
 				}
 
 				// Set if the absolute value of the contents of Rr plus previous carry is larger than the absolute value of the Rd; cleared otherwise.
@@ -162,6 +175,50 @@ namespace ATMega328Emulator {
 				}
 			}
 		}
+
+		namespace Indirect {
+
+			// The X, Y or Z register of an LD or ST, from bits 3 and 2: 11 is X, 10 is Y and 00 is Z.
+			static inline Word* Pointer(Word instruction, CPU* cpu)
+			{
+				switch (instruction & 0b1100)
+				{
+					case 0b1100: return &cpu->X;
+					case 0b1000: return &cpu->Y;
+					default: return &cpu->Z;
+				}
+			}
+
+			// The address an LD or ST accesses, bits 1 and 0 are 01 for post-increment and 10 for pre-decrement.
+			static inline Word Address(Word instruction, CPU* cpu)
+			{
+				Word* pointer = Pointer(instruction, cpu);
+				switch (instruction & 0b11)
+				{
+					case 0b01: return (*pointer)++;
+					case 0b10: return --(*pointer);
+					default: return *pointer;
+				}
+			}
+
+			// The Y or Z address plus the 6-bit displacement of an LDD or STD - 10q0'qqxd'dddd'yqqq
+			static inline Word Displaced(Word instruction, CPU* cpu)
+			{
+				Byte q = (instruction & 0b111) | ((instruction & 0b1100'0000'0000) >> 7) | ((instruction & 0b10'0000'0000'0000) >> 8);
+				Word pointer = (instruction & 0b1000) ? cpu->Y : cpu->Z;
+				return pointer + q;
+			}
+
+		}
+
+		// The skip instructions step over the operand word of a 32-bit instruction as well.
+		// Returns the number of words skipped.
+		static inline Byte Skip(CPU* cpu, Memory& memory)
+		{
+			Byte skipped = Timing::IsTwoWord(cpu->PeekWord(memory)) ? 2 : 1;
+			cpu->PC += skipped;
+			return skipped;
+		}
 		
 		void Handle_ADC(Word instruction, CPU* cpu)
 		{
@@ -174,9 +231,9 @@ namespace ATMega328Emulator {
 			Byte R = *Rd + *Rr + cpu->IO.SREG.C;
 
 			StatusFlag::H::CarryBit3(cpu, R, *Rd, *Rr);
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::ByteAddTwosComplementOverflow(cpu, R, *Rd, *Rr);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 			StatusFlag::C::ByteCarryMSB(cpu, R, *Rd, *Rr);
 		
@@ -194,31 +251,30 @@ namespace ATMega328Emulator {
 			Byte R = *Rd + *Rr;
 		
 			StatusFlag::H::CarryBit3(cpu, R, *Rd, *Rr);
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::ByteAddTwosComplementOverflow(cpu, R, *Rd, *Rr);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 			StatusFlag::C::ByteCarryMSB(cpu, R, *Rd, *Rr);
 
 			*Rd = R;
 		}
 
-		void Handle_ADIW(Word instruction, int& cycles, CPU* cpu)
+		void Handle_ADIW(Word instruction, CPU* cpu)
 		{
 			Byte d = (instruction & 0b11'0000) >> 4; // 2 bits describing the offset from R24 in steps of 2.
-			Byte K = instruction & 0b1111 | ((instruction & 0b1100'0000) >> 2); // Value in the range of [0-63]
+			Byte K = (instruction & 0b1111) | ((instruction & 0b1100'0000) >> 2); // Value in the range of [0-63]
 
 			Word* Rdh = ((Word*)&cpu->R24) + d;
 			Word R = *Rdh + K;
 
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::WordAddTwosComplementOverflow(cpu, R, *Rdh);
 			StatusFlag::N::MSBSet(cpu, (R & 0xFF00) >> 8);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::WordZeroRes(cpu, R);
 			StatusFlag::C::WordCarryMSB(cpu, R, *Rdh);
 
 			*Rdh = R;
-			--cycles;
 		}
 
 		void Handle_AND(Word instruction, CPU* cpu)
@@ -231,9 +287,9 @@ namespace ATMega328Emulator {
 
 			Byte R = *Rd & *Rr;
 
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::Set(cpu, 0);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 
 			*Rd = R;
@@ -247,9 +303,9 @@ namespace ATMega328Emulator {
 			Byte* Rd = &cpu->R16 + d;
 			Byte R = *Rd & K;
 
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::Set(cpu, 0);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 
 			*Rd = R;
@@ -262,11 +318,11 @@ namespace ATMega328Emulator {
 			Byte* Rd = &cpu->R00 + d;
 			Byte R = (*Rd >> 1) | (*Rd & 0x80);
 
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::N::MSBSet(cpu, R);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 			StatusFlag::C::LSBSet(cpu, *Rd);
 			StatusFlag::V::NCXOR(cpu); // Has to be done at the end
+			StatusFlag::S::SignedTest(cpu);
 
 			*Rd = R;
 		}
@@ -283,31 +339,33 @@ namespace ATMega328Emulator {
 			Byte b = instruction & 0b111;
 
 			Byte* Rd = &cpu->R00 + d;
-			Byte R = *Rd | cpu->IO.SREG.T << b;
+			Byte R = (*Rd & ~(1 << b)) | cpu->IO.SREG.T << b;
 
 			*Rd = R;
 		}
 
-		void Handle_BRBC(Word instruction, int& cycles, CPU* cpu)
+		bool Handle_BRBC(Word instruction, CPU* cpu)
 		{
-			char k = ((instruction & 0b1'1111'1000) >> 3) | ((instruction & 0b10'0000'0000) >> 2);
+			int8_t k = (int8_t)((instruction >> 2) & 0b1111'1110) >> 1; // 7-bit signed offset
 			Byte s = instruction & 0b111;
 			
 			if (((*(Byte*)&cpu->IO.SREG) & (1 << s)) == 0) { // Bit in register is cleared
 				cpu->PC += k;
-				--cycles;
+				return true;
 			}
+			return false;
 		}
 
-		void Handle_BRBS(Word instruction, int& cycles, CPU* cpu)
+		bool Handle_BRBS(Word instruction, CPU* cpu)
 		{
-			char k = ((instruction & 0b1'1111'1000) >> 3) | ((instruction & 0b10'0000'0000) >> 2);
+			int8_t k = (int8_t)((instruction >> 2) & 0b1111'1110) >> 1; // 7-bit signed offset
 			Byte s = instruction & 0b111;
 
 			if ((*(Byte*)&cpu->IO.SREG) & (1 << s)) { // Bit in register is set
 				cpu->PC += k;
-				--cycles;
+				return true;
 			}
+			return false;
 		}
 
 		void Handle_BSET(Word instruction, CPU* cpu)
@@ -325,12 +383,22 @@ namespace ATMega328Emulator {
 			cpu->IO.SREG.T = (*Rd >> b) & 0b1;
 		}
 
+		void Handle_CALL(Word, CPU* cpu, Memory& memory)
+		{
+			// The high address bits in the first word are always 0 with 16K words of flash
+			Word k = cpu->FetchWord(memory);
+
+			cpu->PushWord(cpu->PC);
+			cpu->PC = k;
+		}
+
 		void Handle_CBI(Word instruction, CPU* cpu)
 		{
 			Byte A = (instruction & 0b1111'1000) >> 3;
 			Byte b = instruction & 0b111;
 
-			*((Byte*)&cpu->IO + A) &= ~(1 << b);
+			Word address = CPU::IO_START + A;
+			cpu->WriteData(address, cpu->ReadData(address) & ~(1 << b));
 		}
 		
 		void Handle_COM(Word instruction, CPU* cpu)
@@ -340,9 +408,9 @@ namespace ATMega328Emulator {
 			Byte* Rd = &cpu->R00 + d;
 			Byte R = ~*Rd;
 			
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::Set(cpu, 0);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 			StatusFlag::C::Set(cpu, 1);
 			
@@ -360,9 +428,9 @@ namespace ATMega328Emulator {
 			Byte R = *Rd - *Rr;
 
 			StatusFlag::H::BorrowBit3(cpu, R, *Rd, *Rr);
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::ByteSubTwosComplementOverflow(cpu, R, *Rd, *Rr);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 			StatusFlag::C::ByteGreater(cpu, R, *Rd, *Rr);
 		}
@@ -378,10 +446,10 @@ namespace ATMega328Emulator {
 			Byte R = *Rd - *Rr - cpu->IO.SREG.C;
 
 			StatusFlag::H::BorrowBit3(cpu, R, *Rd, *Rr);
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::ByteSubTwosComplementOverflow(cpu, R, *Rd, *Rr);
 			StatusFlag::N::MSBSet(cpu, R);
-			StatusFlag::Z::ByteZeroRes(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
+			StatusFlag::Z::ByteZeroResCarry(cpu, R);
 			StatusFlag::C::ByteGreater(cpu, R, *Rd, *Rr);
 		}
 
@@ -390,19 +458,19 @@ namespace ATMega328Emulator {
 			Byte d = (instruction & 0b1111'0000) >> 4;
 			Byte K = (instruction & 0b1111) | ((instruction & 0b1111'0000'0000) >> 4);
 			
-			Byte* Rd = &cpu->R00 + d;
+			Byte* Rd = &cpu->R16 + d;
 
 			Byte R = *Rd - K;
 
 			StatusFlag::H::BorrowBit3(cpu, R, *Rd, K);
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::ByteSubTwosComplementOverflow(cpu, R, *Rd, K);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 			StatusFlag::C::ByteGreater(cpu, R, *Rd, K);
 		}
 
-		void Handle_CPSE(Word instruction, int& cycles, CPU* cpu)
+		Byte Handle_CPSE(Word instruction, CPU* cpu, Memory& memory)
 		{
 			Byte d = (instruction & 0b1'1111'0000) >> 4;
 			Byte r = (instruction & 0b1111) | ((instruction & 0b10'0000'0000) >> 5);
@@ -410,10 +478,10 @@ namespace ATMega328Emulator {
 			Byte* Rd = &cpu->R00 + d;
 			Byte* Rr = &cpu->R00 + r;
 
-			if (*Rd == *Rr) {
-				++cpu->PC;
-				--cycles;
+			if (*Rd != *Rr) {
+				return 0;
 			}
+			return Skip(cpu, memory);
 		}
 
 		void Handle_DEC(Word instruction, CPU* cpu)
@@ -423,9 +491,9 @@ namespace ATMega328Emulator {
 			Byte* Rd = &cpu->R00 + d;
 			Byte R = *Rd - 1;
 
-			StatusFlag::S::SignedTest(cpu);
 			cpu->IO.SREG.V = R == 0x7F;
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 
 			*Rd = R;
@@ -441,15 +509,15 @@ namespace ATMega328Emulator {
 
 			Byte R = *Rd ^ *Rr;
 
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::Set(cpu, 0);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 
 			*Rd = R;
 		}
 
-		void Handle_FMUL(Word instruction, int& cycles, CPU* cpu)
+		void Handle_FMUL(Word instruction, CPU* cpu)
 		{
 			Byte d = (instruction & 0b111'0000) >> 4;
 			Byte r = instruction & 0b111;
@@ -459,18 +527,16 @@ namespace ATMega328Emulator {
 
 			Word R = *Rd * *Rr;
 
-			StatusFlag::C::MSBSet(cpu, *(Byte*)&R); // Has to happen before the shift
+			StatusFlag::C::MSBSet(cpu, R >> 8); // Has to happen before the shift
 
 			R = R << 1;
 			
 			StatusFlag::Z::WordZeroRes(cpu, R);
 
 			*(Word*)&cpu->R00 = R;
-			
-			--cycles;
 		}
 
-		void Handle_FMULS(Word instruction, int& cycles, CPU* cpu)
+		void Handle_FMULS(Word instruction, CPU* cpu)
 		{
 			Byte d = (instruction & 0b111'0000) >> 4;
 			Byte r = instruction & 0b111;
@@ -480,18 +546,16 @@ namespace ATMega328Emulator {
 
 			short R = *Rd * *Rr;
 
-			StatusFlag::C::MSBSet(cpu, *(Byte*)&R); // Has to happen before the shift
+			StatusFlag::C::MSBSet(cpu, R >> 8); // Has to happen before the shift
 
 			R = R << 1;
 
 			StatusFlag::Z::WordZeroRes(cpu, R);
 
 			*(short*)&cpu->R00 = R;
-
-			--cycles;
 		}
 
-		void Handle_FMULSU(Word instruction, int& cycles, CPU* cpu)
+		void Handle_FMULSU(Word instruction, CPU* cpu)
 		{
 			Byte d = (instruction & 0b111'0000) >> 4;
 			Byte r = instruction & 0b111;
@@ -501,15 +565,34 @@ namespace ATMega328Emulator {
 
 			short R = *Rd * *Rr;
 
-			StatusFlag::C::MSBSet(cpu, *(Byte*)&R); // Has to happen before the shift
+			StatusFlag::C::MSBSet(cpu, R >> 8); // Has to happen before the shift
 
 			R = R << 1;
 
 			StatusFlag::Z::WordZeroRes(cpu, R);
 
 			*(short*)&cpu->R00 = R;
+		}
 
-			--cycles;
+		void Handle_ICALL(Word, CPU* cpu)
+		{
+			cpu->PushWord(cpu->PC);
+			cpu->PC = cpu->Z;
+		}
+
+		void Handle_IJMP(Word, CPU* cpu)
+		{
+			cpu->PC = cpu->Z;
+		}
+
+		void Handle_IN(Word instruction, CPU* cpu)
+		{
+			Byte A = (instruction & 0b1111) | ((instruction & 0b110'0000'0000) >> 5);
+			Byte d = (instruction & 0b1'1111'0000) >> 4;
+
+			Byte* Rd = &cpu->R00 + d;
+
+			*Rd = cpu->ReadData(CPU::IO_START + A);
 		}
 
 		void Handle_INC(Word instruction, CPU* cpu)
@@ -519,51 +602,72 @@ namespace ATMega328Emulator {
 			Byte* Rd = &cpu->R00 + d;
 			Byte R = *Rd + 1;
 
-			StatusFlag::S::SignedTest(cpu);
 			cpu->IO.SREG.V = R == 0x80;
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 
 			*Rd = R;
 		}
 
-		void Handle_LAC(Word instruction, int& cycles, CPU* cpu)
+		void Handle_JMP(Word, CPU* cpu, Memory& memory)
+		{
+			// The high address bits in the first word are always 0 with 16K words of flash
+			cpu->PC = cpu->FetchWord(memory);
+		}
+
+		void Handle_LAC(Word instruction, CPU* cpu)
 		{
 			Byte r = (instruction & 0b1'1111'0000) >> 4;
 
 			Byte* Rr = &cpu->R00 + r;
-			Byte* DS = cpu->SRAM + cpu->Z;
+			Word address = cpu->Z;
 
-			*DS = (~*Rr) & *DS;
-			*Rr = *DS;
-
-			--cycles;
+			Byte R = (~*Rr) & cpu->ReadData(address);
+			cpu->WriteData(address, R);
+			*Rr = R;
 		}
 
-		void Handle_LAS(Word instruction, int& cycles, CPU* cpu)
+		void Handle_LAS(Word instruction, CPU* cpu)
 		{
 			Byte r = (instruction & 0b1'1111'0000) >> 4;
 
 			Byte* Rr = &cpu->R00 + r;
-			Byte* DS = cpu->SRAM + cpu->Z;
-
-			*DS = *Rr | *DS;
-			*Rr = *DS;
+			Word address = cpu->Z;
 
-			--cycles;
+			Byte R = *Rr | cpu->ReadData(address);
+			cpu->WriteData(address, R);
+			*Rr = R;
 		}
 
-		void Handle_LAT(Word instruction, int& cycles, CPU* cpu)
+		void Handle_LAT(Word instruction, CPU* cpu)
 		{
 			Byte r = (instruction & 0b1'1111'0000) >> 4;
 
 			Byte* Rr = &cpu->R00 + r;
-			Byte* DS = cpu->SRAM + cpu->Z;
+			Word address = cpu->Z;
+
+			Byte R = *Rr ^ cpu->ReadData(address);
+			cpu->WriteData(address, R);
+			*Rr = R;
+		}
 
-			*DS = *Rr ^ *DS;
-			*Rr = *DS;
+		void Handle_LD(Word instruction, CPU* cpu)
+		{
+			Byte d = (instruction & 0b1'1111'0000) >> 4;
+
+			Byte* Rd = &cpu->R00 + d;
+
+			*Rd = cpu->ReadData(Indirect::Address(instruction, cpu));
+		}
+
+		void Handle_LDD(Word instruction, CPU* cpu)
+		{
+			Byte d = (instruction & 0b1'1111'0000) >> 4;
+
+			Byte* Rd = &cpu->R00 + d;
 
-			--cycles;
+			*Rd = cpu->ReadData(Indirect::Displaced(instruction, cpu));
 		}
 
 		void Handle_LDI(Word instruction, CPU* cpu)
@@ -576,15 +680,32 @@ namespace ATMega328Emulator {
 			*Rd = K;
 		}
 
-		void Handle_LDS(Word instruction, int& cycles, CPU* cpu, Memory& memory)
+		void Handle_LDS(Word instruction, CPU* cpu, Memory& memory)
 		{
 			Byte d = (instruction & 0b1'1111'0000) >> 4;
-			Word k = cpu->FetchWord(cycles, memory);
+			Word k = cpu->FetchWord(memory);
 
 			Byte* Rd = &cpu->R00 + d;
-			Byte* DS = cpu->SRAM + k;
 
-			*Rd = *DS;
+			*Rd = cpu->ReadData(k);
+		}
+
+		void Handle_LPM(Word instruction, CPU* cpu, Memory& memory)
+		{
+			if (instruction == LPM) {
+				cpu->R00 = memory[cpu->Z];
+				return;
+			}
+
+			Byte d = (instruction & 0b1'1111'0000) >> 4;
+
+			Byte* Rd = &cpu->R00 + d;
+
+			// Z is a byte address into the flash
+			*Rd = memory[cpu->Z];
+			if (instruction & 0b1) {
+				++cpu->Z;
+			}
 		}
 
 		void Handle_LSR(Word instruction, CPU* cpu)
@@ -594,11 +715,11 @@ namespace ATMega328Emulator {
 			Byte* Rd = &cpu->R00 + d;
 			Byte R = *Rd >> 1;
 
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::N::Set(cpu, 0);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 			StatusFlag::C::LSBSet(cpu, *Rd);
 			StatusFlag::V::NCXOR(cpu); // Has to be done at the end
+			StatusFlag::S::SignedTest(cpu);
 
 			*Rd = R;
 		}
@@ -625,7 +746,7 @@ namespace ATMega328Emulator {
 			*Rd = *Rr;
 		}
 
-		void Handle_MUL(Word instruction, int& cycles, CPU* cpu)
+		void Handle_MUL(Word instruction, CPU* cpu)
 		{
 			Byte d = (instruction & 0b1'1111'0000) >> 4;
 			Byte r = (instruction & 0b1111) | ((instruction & 0b10'0000'0000) >> 5);
@@ -638,16 +759,15 @@ namespace ATMega328Emulator {
 			StatusFlag::Z::WordZeroRes(cpu, R);
 
 			*(Word*)&cpu->R00 = R;
-			--cycles;
 		}
 
-		void Handle_MULS(Word instruction, int& cycles, CPU* cpu)
+		void Handle_MULS(Word instruction, CPU* cpu)
 		{
 			Byte d = (instruction & 0b1111'0000) >> 4;
 			Byte r = instruction & 0b1111;
 			
-			char* Rd = (char*)&cpu->R00 + d;
-			char* Rr = (char*)&cpu->R00 + r;
+			char* Rd = (char*)&cpu->R16 + d;
+			char* Rr = (char*)&cpu->R16 + r;
 			
 			short R = *Rd * *Rr;
 
@@ -657,13 +777,13 @@ namespace ATMega328Emulator {
 			*(short*)&cpu->R00 = R;
 		}
 
-		void Handle_MULSU(Word instruction, int& cycles, CPU* cpu)
+		void Handle_MULSU(Word instruction, CPU* cpu)
 		{
 			Byte d = (instruction & 0b111'0000) >> 4;
 			Byte r = instruction & 0b111;
 
-			char* Rd = (char*)cpu->R00 + d;
-			Byte* Rr = &cpu->R00 + r;
+			char* Rd = (char*)&cpu->R16 + d;
+			Byte* Rr = &cpu->R16 + r;
 
 			short R = *Rd * *Rr;
 
@@ -680,10 +800,10 @@ namespace ATMega328Emulator {
 			Byte* Rd = &cpu->R00 + d;
 			Byte R = (~*Rd) + 1;
 			
-			StatusFlag::H::BorrowBit3(cpu, R, *Rd, 0);
-			StatusFlag::S::SignedTest(cpu);
+			StatusFlag::H::BorrowBit3(cpu, R, 0, *Rd);
 			cpu->IO.SREG.V = R == 0x80;
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 			StatusFlag::C::NotNull(cpu, R);
 
@@ -700,9 +820,9 @@ namespace ATMega328Emulator {
 			
 			Byte R = *Rd | *Rr;
 
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::Set(cpu, 0);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 
 			*Rd = R;
@@ -716,9 +836,9 @@ namespace ATMega328Emulator {
 			Byte* Rd = &cpu->R16 + d;
 			Byte R = *Rd | K;
 
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::Set(cpu, 0);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 			
 			*Rd = R;
@@ -727,12 +847,75 @@ namespace ATMega328Emulator {
 		void Handle_OUT(Word instruction, CPU* cpu)
 		{
 			Byte A = (instruction & 0b1111) | ((instruction & 0b110'0000'0000) >> 5);
-			Byte r = (instruction & 0b1111'0000) >> 4;
+			Byte r = (instruction & 0b1'1111'0000) >> 4;
+
+			Byte* Rr = &cpu->R00 + r;
+
+			cpu->WriteData(CPU::IO_START + A, *Rr);
+		}
+
+		void Handle_POP(Word instruction, CPU* cpu)
+		{
+			Byte d = (instruction & 0b1'1111'0000) >> 4;
+
+			Byte* Rd = &cpu->R00 + d;
+
+			*Rd = cpu->Pop();
+		}
+
+		void Handle_PUSH(Word instruction, CPU* cpu)
+		{
+			Byte r = (instruction & 0b1'1111'0000) >> 4;
 
-			Byte* IO = (Byte*)&cpu->IO + A;
 			Byte* Rr = &cpu->R00 + r;
 
-			*IO = *Rr;
+			cpu->Push(*Rr);
+		}
+
+		void Handle_RCALL(Word instruction, CPU* cpu)
+		{
+			short k = (short)(instruction << 4) >> 4; // 12-bit signed offset
+
+			cpu->PushWord(cpu->PC);
+			cpu->PC += k;
+		}
+
+		void Handle_RET(Word, CPU* cpu)
+		{
+			cpu->PC = cpu->PopWord();
+		}
+
+		void Handle_RETI(Word, CPU* cpu)
+		{
+			cpu->PC = cpu->PopWord();
+			cpu->IO.SREG.I = 1;
+
+			if (cpu->InterruptDepth) {
+				--cpu->InterruptDepth;
+			}
+		}
+
+		void Handle_RJMP(Word instruction, CPU* cpu)
+		{
+			short k = (short)(instruction << 4) >> 4; // 12-bit signed offset
+
+			cpu->PC += k;
+		}
+
+		void Handle_ROR(Word instruction, CPU* cpu)
+		{
+			Byte d = (instruction & 0b1'1111'0000) >> 4;
+
+			Byte* Rd = &cpu->R00 + d;
+			Byte R = (*Rd >> 1) | (cpu->IO.SREG.C << 7);
+
+			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::Z::ByteZeroRes(cpu, R);
+			StatusFlag::C::LSBSet(cpu, *Rd);
+			StatusFlag::V::NCXOR(cpu); // Has to be done at the end
+			StatusFlag::S::SignedTest(cpu);
+
+			*Rd = R;
 		}
 
 		void Handle_SBC(Word instruction, CPU* cpu)
@@ -746,9 +929,9 @@ namespace ATMega328Emulator {
 			Byte R = *Rd - *Rr - cpu->IO.SREG.C;
 
 			StatusFlag::H::BorrowBit3(cpu, R, *Rd, *Rr);
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::ByteSubTwosComplementOverflow(cpu, R, *Rd, *Rr);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroResCarry(cpu, R);
 			StatusFlag::C::ByteGreater(cpu, R, *Rd, *Rr);
 
@@ -764,9 +947,9 @@ namespace ATMega328Emulator {
 			Byte R = *Rd - K - cpu->IO.SREG.C;
 
 			StatusFlag::H::BorrowBit3(cpu, R, *Rd, K);
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::ByteSubTwosComplementOverflow(cpu, R, *Rd, K);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroResCarry(cpu, R);
 			StatusFlag::C::ByteGreater(cpu, R, *Rd, K);
 
@@ -778,8 +961,101 @@ namespace ATMega328Emulator {
 			Byte A = (instruction & 0b1111'1000) >> 3;
 			Byte b = instruction & 0b111;
 
-			Byte* reg = (Byte*)&cpu->IO + A;
-			*reg |= (1 << b);
+			Word address = CPU::IO_START + A;
+			cpu->WriteData(address, cpu->ReadData(address) | (1 << b));
+		}
+
+		Byte Handle_SBIC(Word instruction, CPU* cpu, Memory& memory)
+		{
+			Byte A = (instruction & 0b1111'1000) >> 3;
+			Byte b = instruction & 0b111;
+
+			if (cpu->ReadData(CPU::IO_START + A) & (1 << b)) {
+				return 0;
+			}
+			return Skip(cpu, memory);
+		}
+
+		Byte Handle_SBIS(Word instruction, CPU* cpu, Memory& memory)
+		{
+			Byte A = (instruction & 0b1111'1000) >> 3;
+			Byte b = instruction & 0b111;
+
+			if (!(cpu->ReadData(CPU::IO_START + A) & (1 << b))) {
+				return 0;
+			}
+			return Skip(cpu, memory);
+		}
+
+		void Handle_SBIW(Word instruction, CPU* cpu)
+		{
+			Byte d = (instruction & 0b11'0000) >> 4; // 2 bits describing the offset from R24 in steps of 2.
+			Byte K = (instruction & 0b1111) | ((instruction & 0b1100'0000) >> 2); // Value in the range of [0-63]
+
+			Word* Rdh = ((Word*)&cpu->R24) + d;
+			Word R = *Rdh - K;
+
+			StatusFlag::V::WordSubTwosComplementOverflow(cpu, R, *Rdh);
+			StatusFlag::N::MSBSet(cpu, (R & 0xFF00) >> 8);
+			StatusFlag::S::SignedTest(cpu);
+			StatusFlag::Z::WordZeroRes(cpu, R);
+			StatusFlag::C::WordGreater(cpu, R, *Rdh);
+
+			*Rdh = R;
+		}
+
+		Byte Handle_SBRC(Word instruction, CPU* cpu, Memory& memory)
+		{
+			Byte r = (instruction & 0b1'1111'0000) >> 4;
+			Byte b = instruction & 0b111;
+
+			Byte* Rr = &cpu->R00 + r;
+
+			if (*Rr & (1 << b)) {
+				return 0;
+			}
+			return Skip(cpu, memory);
+		}
+
+		Byte Handle_SBRS(Word instruction, CPU* cpu, Memory& memory)
+		{
+			Byte r = (instruction & 0b1'1111'0000) >> 4;
+			Byte b = instruction & 0b111;
+
+			Byte* Rr = &cpu->R00 + r;
+
+			if (!(*Rr & (1 << b))) {
+				return 0;
+			}
+			return Skip(cpu, memory);
+		}
+
+		void Handle_ST(Word instruction, CPU* cpu)
+		{
+			Byte r = (instruction & 0b1'1111'0000) >> 4;
+
+			Byte* Rr = &cpu->R00 + r;
+
+			cpu->WriteData(Indirect::Address(instruction, cpu), *Rr);
+		}
+
+		void Handle_STD(Word instruction, CPU* cpu)
+		{
+			Byte r = (instruction & 0b1'1111'0000) >> 4;
+
+			Byte* Rr = &cpu->R00 + r;
+
+			cpu->WriteData(Indirect::Displaced(instruction, cpu), *Rr);
+		}
+
+		void Handle_STS(Word instruction, CPU* cpu, Memory& memory)
+		{
+			Byte r = (instruction & 0b1'1111'0000) >> 4;
+			Word k = cpu->FetchWord(memory);
+
+			Byte* Rr = &cpu->R00 + r;
+
+			cpu->WriteData(k, *Rr);
 		}
 
 		void Handle_SUBI(Word instruction, CPU* cpu)
@@ -791,9 +1067,9 @@ namespace ATMega328Emulator {
 			Byte R = *Rd - K;
 
 			StatusFlag::H::BorrowBit3(cpu, R, *Rd, K);
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::ByteSubTwosComplementOverflow(cpu, R, *Rd, K);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 			StatusFlag::C::ByteGreater(cpu, R, *Rd, K);
 
@@ -811,14 +1087,23 @@ namespace ATMega328Emulator {
 			Byte R = *Rd - *Rr;
 
 			StatusFlag::H::BorrowBit3(cpu, R, *Rd, *Rr);
-			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::V::ByteSubTwosComplementOverflow(cpu, R, *Rd, *Rr);
 			StatusFlag::N::MSBSet(cpu, R);
+			StatusFlag::S::SignedTest(cpu);
 			StatusFlag::Z::ByteZeroRes(cpu, R);
 			StatusFlag::C::ByteGreater(cpu, R, *Rd, *Rr);
 
 			*Rd = R;
 		}
+
+		void Handle_SWAP(Word instruction, CPU* cpu)
+		{
+			Byte d = (instruction & 0b1'1111'0000) >> 4;
+
+			Byte* Rd = &cpu->R00 + d;
+
+			*Rd = (*Rd << 4) | (*Rd >> 4);
+		}
 		
 	}
 }
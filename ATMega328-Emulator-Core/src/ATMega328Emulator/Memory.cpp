@@ -12,7 +12,7 @@ namespace ATMega328Emulator {
 
 	Memory::~Memory()
 	{
-		delete[] Data;
+		std::free(Data);
 	}
 
 	void Memory::Initialize()
@@ -20,4 +20,17 @@ namespace ATMega328Emulator {
 		std::memset(Data, 0, MAX_MEM);
 	}
 
+	void Memory::Load(const Word* words, size_t count, uint32_t address)
+	{
+		if (count == 0) {
+			return;
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			Data[(address + i * 2) & ADDRESS_MASK] = words[i] & 0xFF;
+			Data[(address + i * 2 + 1) & ADDRESS_MASK] = words[i] >> 8;
+		}
+		Dirty.MarkRange(address, (uint32_t)count * 2);
+	}
+
 }
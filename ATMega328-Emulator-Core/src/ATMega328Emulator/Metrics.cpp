@@ -0,0 +1,286 @@
+#include "ATMega328Emulator/Metrics.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <vector>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+namespace ATMega328Emulator {
+
+	namespace {
+
+		constexpr const char* STOP_REASON_NAMES[] = {
+			"none", "cycle_budget", "cycle_target", "pc_match", "break",
+			"illegal_opcode", "sleep", "self_loop", "watchpoint", "register_hook",
+		};
+		static_assert(sizeof(STOP_REASON_NAMES) / sizeof(STOP_REASON_NAMES[0]) == MetricsFormat::STOP_REASON_COUNT, "A stop reason is missing a name");
+
+		// Label values escape backslashes, quotes and line feeds
+		std::string EscapeLabel(const std::string& value)
+		{
+			std::string escaped;
+			for (char c : value) {
+				switch (c) {
+					case '\\': escaped += "\\\\"; break;
+					case '"': escaped += "\\\""; break;
+					case '\n': escaped += "\\n"; break;
+					default: escaped += c; break;
+				}
+			}
+			return escaped;
+		}
+
+		void WriteFamily(std::ostream& out, const char* name, const char* type, const char* help)
+		{
+			out << "# HELP " << name << ' ' << help << '\n';
+			out << "# TYPE " << name << ' ' << type << '\n';
+		}
+
+	}
+
+	void MetricsCounters::OnRun(const RunResult& result, uint64_t nanoseconds)
+	{
+		Add(Instructions, result.Instructions);
+		Add(Cycles, result.Cycles);
+		Add(Runs, 1);
+		Add(ExecuteNanoseconds, nanoseconds);
+		Add(Stops[(size_t)result.Reason], 1);
+	}
+
+	Metrics::Metrics(uint32_t capacity)
+	{
+		m_Size = getStorageSize(capacity);
+		initialize(::operator new(m_Size, std::align_val_t(MetricsFormat::CACHE_LINE_SIZE)), capacity);
+	}
+
+	Metrics::~Metrics()
+	{
+		release();
+	}
+
+	bool Metrics::Share(const std::string& filepath)
+	{
+		if (m_Header->Count.load(std::memory_order_relaxed) != 0) {
+			return false;
+		}
+
+		const uint32_t capacity = m_Header->Capacity;
+		const size_t size = getStorageSize(capacity);
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, nullptr);
+		void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : nullptr;
+		if (!data) {
+			if (mapping) {
+				CloseHandle(mapping);
+			}
+			CloseHandle(file);
+			return false;
+		}
+
+		release();
+		m_FileHandle = file;
+		m_MappingHandle = mapping;
+#else
+		int fd = open(filepath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			return false;
+		}
+
+		if (ftruncate(fd, (off_t)size) != 0) {
+			close(fd);
+			return false;
+		}
+
+		void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd); // The mapping keeps the file alive
+		if (data == MAP_FAILED) {
+			return false;
+		}
+
+		release();
+#endif
+
+		m_Size = size;
+		m_Shared = true;
+		initialize(data, capacity);
+		return true;
+	}
+
+	MetricsCounters* Metrics::Register(const std::string& name)
+	{
+		const uint32_t index = m_Header->Count.fetch_add(1, std::memory_order_relaxed);
+		if (index >= m_Header->Capacity) {
+			m_Header->Count.store(m_Header->Capacity, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		MetricsCounters& counters = m_Counters[index];
+		const size_t length = std::min(name.size(), MetricsFormat::NAME_SIZE - 1);
+		std::memcpy(counters.Name, name.data(), length);
+		counters.Name[length] = '\0';
+
+		// Readers only look at the name once this says it is there
+		counters.Ready.store(1, std::memory_order_release);
+		return &counters;
+	}
+
+	MetricsSample Metrics::Sample(uint32_t index) const
+	{
+		MetricsSample sample;
+		if (index >= GetCount()) {
+			return sample;
+		}
+
+		const MetricsCounters& counters = m_Counters[index];
+		if (counters.Ready.load(std::memory_order_acquire)) {
+			sample.Name = counters.Name;
+		}
+
+		sample.Instructions = counters.Instructions.load(std::memory_order_relaxed);
+		sample.Cycles = counters.Cycles.load(std::memory_order_relaxed);
+		sample.Runs = counters.Runs.load(std::memory_order_relaxed);
+		sample.Interrupts = counters.Interrupts.load(std::memory_order_relaxed);
+		sample.ExecuteNanoseconds = counters.ExecuteNanoseconds.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < MetricsFormat::STOP_REASON_COUNT; ++i) {
+			sample.Stops[i] = counters.Stops[i].load(std::memory_order_relaxed);
+		}
+		return sample;
+	}
+
+	void Metrics::WritePrometheus(std::ostream& out) const
+	{
+		std::vector<MetricsSample> samples;
+		for (uint32_t i = 0; i < GetCount(); ++i) {
+			MetricsSample sample = Sample(i);
+			if (!sample.Name.empty()) {
+				sample.Name = EscapeLabel(sample.Name);
+				samples.push_back(std::move(sample));
+			}
+		}
+
+		// One family at a time, the format wants every sample of a family together
+		char value[64];
+		auto writeCounter = [&](const char* name, const char* help, uint64_t MetricsSample::* field) {
+			WriteFamily(out, name, "counter", help);
+			for (const MetricsSample& sample : samples) {
+				out << name << "{worker=\"" << sample.Name << "\"} " << sample.*field << '\n';
+			}
+		};
+
+		writeCounter("atmega328_instructions_retired_total", "Emulated instructions retired.", &MetricsSample::Instructions);
+		writeCounter("atmega328_cycles_total", "Emulated cycles.", &MetricsSample::Cycles);
+		writeCounter("atmega328_runs_total", "Calls to CPU::Run.", &MetricsSample::Runs);
+		writeCounter("atmega328_interrupts_total", "Interrupts taken.", &MetricsSample::Interrupts);
+
+		WriteFamily(out, "atmega328_execute_seconds_total", "counter", "Host time spent in CPU::Run.");
+		for (const MetricsSample& sample : samples) {
+			std::snprintf(value, sizeof(value), "%.9f", sample.ExecuteNanoseconds / 1e9);
+			out << "atmega328_execute_seconds_total{worker=\"" << sample.Name << "\"} " << value << '\n';
+		}
+
+		WriteFamily(out, "atmega328_run_stops_total", "counter", "Why CPU::Run returned.");
+		for (const MetricsSample& sample : samples) {
+			for (size_t i = 1; i < MetricsFormat::STOP_REASON_COUNT; ++i) {
+				out << "atmega328_run_stops_total{worker=\"" << sample.Name << "\",reason=\"" << STOP_REASON_NAMES[i] << "\"} " << sample.Stops[i] << '\n';
+			}
+		}
+
+		WriteFamily(out, "atmega328_emulated_mhz", "gauge", "Emulated clock while in CPU::Run, since the worker started.");
+		for (const MetricsSample& sample : samples) {
+			std::snprintf(value, sizeof(value), "%.3f", sample.GetEmulatedMHz());
+			out << "atmega328_emulated_mhz{worker=\"" << sample.Name << "\"} " << value << '\n';
+		}
+	}
+
+	bool Metrics::WritePrometheusFile(const std::string& filepath) const
+	{
+		const std::string temporary = filepath + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				return false;
+			}
+			WritePrometheus(file);
+			if (!file.flush()) {
+				return false;
+			}
+		}
+
+		// Windows doesn't rename over an existing file
+		if (std::rename(temporary.c_str(), filepath.c_str()) != 0) {
+			std::remove(filepath.c_str());
+			if (std::rename(temporary.c_str(), filepath.c_str()) != 0) {
+				std::remove(temporary.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	size_t Metrics::getStorageSize(uint32_t capacity)
+	{
+		return MetricsFormat::HEADER_SIZE + (size_t)capacity * sizeof(MetricsCounters);
+	}
+
+	void Metrics::initialize(void* storage, uint32_t capacity)
+	{
+		static_assert(sizeof(Header) <= MetricsFormat::HEADER_SIZE, "The header has to fit its shared layout");
+
+		std::memset(storage, 0, m_Size);
+
+		m_Header = new (storage) Header();
+		std::memcpy(m_Header->Magic, MetricsFormat::MAGIC, sizeof(MetricsFormat::MAGIC));
+		m_Header->Version = MetricsFormat::VERSION;
+		m_Header->BlockSize = (uint16_t)sizeof(MetricsCounters);
+		m_Header->Capacity = capacity;
+
+		m_Counters = reinterpret_cast<MetricsCounters*>((Byte*)storage + MetricsFormat::HEADER_SIZE);
+		for (uint32_t i = 0; i < capacity; ++i) {
+			new (&m_Counters[i]) MetricsCounters();
+		}
+	}
+
+	void Metrics::release()
+	{
+		if (!m_Header) {
+			return;
+		}
+
+		if (!m_Shared) {
+			::operator delete((void*)m_Header, std::align_val_t(MetricsFormat::CACHE_LINE_SIZE));
+		}
+		else {
+#ifdef _WIN32
+			UnmapViewOfFile(m_Header);
+			CloseHandle(m_MappingHandle);
+			CloseHandle(m_FileHandle);
+			m_MappingHandle = nullptr;
+			m_FileHandle = nullptr;
+#else
+			munmap((void*)m_Header, m_Size);
+#endif
+		}
+
+		m_Header = nullptr;
+		m_Counters = nullptr;
+		m_Shared = false;
+	}
+
+}
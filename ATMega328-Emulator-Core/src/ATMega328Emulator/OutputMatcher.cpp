@@ -0,0 +1,353 @@
+#include "ATMega328Emulator/OutputMatcher.h"
+
+#include <bitset>
+#include <cctype>
+#include <deque>
+
+namespace ATMega328Emulator {
+
+	namespace {
+
+		using ByteSet = std::bitset<256>;
+
+		struct Atom
+		{
+			ByteSet Bytes;
+			bool Optional = false; // ? and *
+			bool Repeat = false;   // * and +
+		};
+
+		ByteSet Matching(int (*predicate)(int))
+		{
+			ByteSet set;
+			for (int c = 0; c < 256; ++c) {
+				set[c] = predicate(c) != 0;
+			}
+			return set;
+		}
+
+		int IsWord(int c)
+		{
+			return std::isalnum(c) || c == '_';
+		}
+
+		// The byte set of the escape at pattern[i], just past the backslash. Moves i past it.
+		bool ParseEscape(std::string_view pattern, size_t& i, ByteSet& set)
+		{
+			if (i >= pattern.size()) {
+				return false;
+			}
+
+			const char c = pattern[i++];
+			switch (c) {
+				case 'd': set = Matching([](int ch) { return std::isdigit(ch); }); break;
+				case 'D': set = ~Matching([](int ch) { return std::isdigit(ch); }); break;
+				case 'w': set = Matching(IsWord); break;
+				case 'W': set = ~Matching(IsWord); break;
+				case 's': set = Matching([](int ch) { return std::isspace(ch); }); break;
+				case 'S': set = ~Matching([](int ch) { return std::isspace(ch); }); break;
+				case 'n': set.reset(); set['\n'] = true; break;
+				case 'r': set.reset(); set['\r'] = true; break;
+				case 't': set.reset(); set['\t'] = true; break;
+				default: set.reset(); set[(Byte)c] = true; break;
+			}
+			return true;
+		}
+
+		// A class from just past its [ to its ], moves i past the ].
+		bool ParseClass(std::string_view pattern, size_t& i, ByteSet& set)
+		{
+			set.reset();
+			const bool complement = i < pattern.size() && pattern[i] == '^';
+			if (complement) {
+				++i;
+			}
+
+			bool first = true;
+			while (i < pattern.size() && (pattern[i] != ']' || first)) {
+				first = false;
+
+				ByteSet item;
+				int low = -1;
+				if (pattern[i] == '\\') {
+					++i;
+					if (!ParseEscape(pattern, i, item)) {
+						return false;
+					}
+					if (item.count() == 1) {
+						for (low = 0; !item[low]; ++low) {
+						}
+					}
+				}
+				else {
+					low = (Byte)pattern[i++];
+					item[low] = true;
+				}
+
+				// A range, unless the - is the last thing in the class
+				if (low >= 0 && i + 1 < pattern.size() && pattern[i] == '-' && pattern[i + 1] != ']') {
+					int high = (Byte)pattern[i + 1];
+					i += 2;
+					if (high == '\\') {
+						ByteSet end;
+						if (!ParseEscape(pattern, i, end) || end.count() != 1) {
+							return false;
+						}
+						for (high = 0; !end[high]; ++high) {
+						}
+					}
+					if (high < low) {
+						return false;
+					}
+					for (int c = low; c <= high; ++c) {
+						item[c] = true;
+					}
+				}
+
+				set |= item;
+			}
+
+			if (i >= pattern.size()) {
+				return false; // No ]
+			}
+			++i;
+
+			if (complement) {
+				set = ~set;
+			}
+			return true;
+		}
+
+		bool ParseRegex(std::string_view pattern, std::vector<Atom>& atoms)
+		{
+			size_t i = 0;
+			while (i < pattern.size()) {
+				Atom atom;
+				const char c = pattern[i++];
+				switch (c) {
+					case '.':
+						atom.Bytes.set();
+						break;
+
+					case '[':
+						if (!ParseClass(pattern, i, atom.Bytes)) {
+							return false;
+						}
+						break;
+
+					case '\\':
+						if (!ParseEscape(pattern, i, atom.Bytes)) {
+							return false;
+						}
+						break;
+
+					// A quantifier without an atom, a stray ] or something that isn't supported
+					case '?': case '*': case '+': case ']':
+					case '(': case ')': case '{': case '}': case '|': case '^': case '$':
+						return false;
+
+					default:
+						atom.Bytes[(Byte)c] = true;
+						break;
+				}
+
+				if (i < pattern.size() && (pattern[i] == '?' || pattern[i] == '*' || pattern[i] == '+')) {
+					atom.Optional = pattern[i] != '+';
+					atom.Repeat = pattern[i] != '?';
+					++i;
+				}
+
+				atoms.push_back(atom);
+				if (atoms.size() > OutputMatcher::MAX_REGEX_ATOMS) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+	}
+
+	OutputMatcher::OutputMatcher()
+	{
+		buildAutomaton();
+	}
+
+	int OutputMatcher::AddLiteral(std::string_view text, bool terminal)
+	{
+		if (text.empty()) {
+			return -1;
+		}
+
+		const int id = (int)m_Patterns.size();
+		m_Patterns.push_back({ terminal, 0, {} });
+		m_Literals.emplace_back(id, std::string(text));
+		buildAutomaton();
+		return id;
+	}
+
+	int OutputMatcher::AddRegex(std::string_view pattern, bool terminal)
+	{
+		std::vector<Atom> atoms;
+		if (!ParseRegex(pattern, atoms) || atoms.empty()) {
+			return -1;
+		}
+
+		Regex regex;
+		regex.Id = (int)m_Patterns.size();
+		regex.Follow.resize(atoms.size());
+
+		const size_t count = atoms.size();
+		bool empty = true;
+		for (size_t i = 0; i < count; ++i) {
+			regex.First |= (uint64_t)1 << i;
+			if (!atoms[i].Optional) {
+				empty = false;
+				break;
+			}
+		}
+		if (empty) {
+			return -1;
+		}
+
+		for (size_t i = count; i-- > 0;) {
+			regex.Final |= (uint64_t)1 << i;
+			if (!atoms[i].Optional) {
+				break;
+			}
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			if (atoms[i].Repeat) {
+				regex.Follow[i] |= (uint64_t)1 << i;
+			}
+			for (size_t j = i + 1; j < count; ++j) {
+				regex.Follow[i] |= (uint64_t)1 << j;
+				if (!atoms[j].Optional) {
+					break;
+				}
+			}
+
+			for (int c = 0; c < 256; ++c) {
+				if (atoms[i].Bytes[c]) {
+					regex.Accept[c] |= (uint64_t)1 << i;
+				}
+			}
+		}
+
+		m_Patterns.push_back({ terminal, 0, {} });
+		m_Regexes.push_back(std::move(regex));
+		return (int)m_Patterns.size() - 1;
+	}
+
+	bool OutputMatcher::Feed(std::span<const Byte> data, uint64_t cycle)
+	{
+		bool terminal = false;
+		for (Byte value : data) {
+			terminal |= Feed(value, cycle);
+		}
+		return terminal;
+	}
+
+	void OutputMatcher::Reset()
+	{
+		m_State = 0;
+		m_Offset = 0;
+		m_Terminal.reset();
+		for (Pattern& pattern : m_Patterns) {
+			pattern.Count = 0;
+			pattern.First = OutputMatch();
+		}
+		for (Regex& regex : m_Regexes) {
+			regex.State = 0;
+		}
+	}
+
+	bool OutputMatcher::onLiteralMatch(uint32_t state, uint64_t cycle)
+	{
+		bool terminal = false;
+		for (int id : m_Outputs[state]) {
+			terminal |= onMatch(id, cycle);
+		}
+		return terminal;
+	}
+
+	bool OutputMatcher::onMatch(int id, uint64_t cycle)
+	{
+		const OutputMatch match = { id, cycle, m_Offset };
+		Pattern& pattern = m_Patterns[id];
+		if (!pattern.Count++) {
+			pattern.First = match;
+		}
+
+		if (pattern.Terminal && !m_Terminal) {
+			m_Terminal = match;
+			return true;
+		}
+		return false;
+	}
+
+	void OutputMatcher::buildAutomaton()
+	{
+		constexpr uint32_t NONE = UINT32_MAX;
+
+		// The trie
+		std::vector<uint32_t> next(256, NONE);
+		m_Outputs.assign(1, {});
+		for (const auto& [id, text] : m_Literals) {
+			uint32_t state = 0;
+			for (char c : text) {
+				uint32_t& edge = next[state * 256 + (Byte)c];
+				if (edge == NONE) {
+					edge = (uint32_t)m_Outputs.size();
+					m_Outputs.emplace_back();
+					next.resize(next.size() + 256, NONE);
+				}
+				state = next[state * 256 + (Byte)c];
+			}
+			m_Outputs[state].push_back(id);
+		}
+
+		// Failure links breadth first, a state's missing edges become its failure state's edges
+		std::vector<uint32_t> failure(m_Outputs.size(), 0);
+		std::deque<uint32_t> queue;
+		for (int c = 0; c < 256; ++c) {
+			if (next[c] == NONE) {
+				next[c] = 0;
+			}
+			else {
+				queue.push_back(next[c]);
+			}
+		}
+
+		while (!queue.empty()) {
+			const uint32_t state = queue.front();
+			queue.pop_front();
+
+			// The failure state is shallower, its outputs are complete already
+			const std::vector<int>& inherited = m_Outputs[failure[state]];
+			m_Outputs[state].insert(m_Outputs[state].end(), inherited.begin(), inherited.end());
+
+			for (int c = 0; c < 256; ++c) {
+				uint32_t& edge = next[state * 256 + c];
+				const uint32_t fallback = next[failure[state] * 256 + c];
+				if (edge == NONE) {
+					edge = fallback;
+				}
+				else {
+					failure[edge] = fallback;
+					queue.push_back(edge);
+				}
+			}
+		}
+
+		for (uint32_t& edge : next) {
+			if (!m_Outputs[edge].empty()) {
+				edge |= HAS_OUTPUT;
+			}
+		}
+
+		m_Transitions = std::move(next);
+		m_State = 0;
+	}
+
+}
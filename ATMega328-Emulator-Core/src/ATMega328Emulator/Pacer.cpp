@@ -0,0 +1,141 @@
+#include "ATMega328Emulator/Pacer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+
+#ifndef _WIN32
+	#include <time.h>
+#endif
+
+namespace ATMega328Emulator {
+
+	Pacer::Pacer(const PacingOptions& options)
+		: m_Options(options)
+	{
+		m_Options.MinQuantumCycles = std::max<uint64_t>(m_Options.MinQuantumCycles, 1);
+		m_Options.MaxQuantumCycles = std::max(m_Options.MaxQuantumCycles, m_Options.MinQuantumCycles);
+
+		// Until the host's speed is known, assume it is so fast the whole quantum is lead
+		m_QuantumCycles = std::clamp(m_Options.JitterBoundNanoseconds * CPU::FREQUENCY / 1'000'000'000, m_Options.MinQuantumCycles, m_Options.MaxQuantumCycles);
+		m_Stats.QuantumCycles = m_QuantumCycles;
+	}
+
+	void Pacer::Start(const CPU& cpu)
+	{
+		m_Started = true;
+		m_StartNanoseconds = Now();
+		m_StartCycle = cpu.CycleCount;
+	}
+
+	void Pacer::Execute(CPU& cpu, Memory& memory, uint64_t cycles)
+	{
+		execute(cpu, cycles, [&](uint64_t quantum) { cpu.Run(quantum, StopConditions(), memory); return true; });
+	}
+
+	bool Pacer::Execute(Scheduler& scheduler, CPU& cpu, Memory& memory, uint64_t cycles)
+	{
+		return execute(cpu, cycles, [&](uint64_t quantum) { return scheduler.Execute(cpu, memory, quantum); });
+	}
+
+	uint64_t Pacer::Now()
+	{
+#ifdef _WIN32
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (uint64_t)now.tv_sec * 1'000'000'000 + (uint64_t)now.tv_nsec;
+#endif
+	}
+
+	template<typename RunQuantum>
+	bool Pacer::execute(CPU& cpu, uint64_t cycles, RunQuantum&& runQuantum)
+	{
+		// A reset CPU starts over
+		if (!m_Started || cpu.CycleCount < m_StartCycle) {
+			Start(cpu);
+		}
+
+		const uint64_t target = cpu.CycleCount + cycles;
+		while (cpu.CycleCount < target) {
+			const uint64_t quantumStart = Now();
+			const uint64_t cycleStart = cpu.CycleCount;
+
+			const bool finished = runQuantum(std::min(m_QuantumCycles, target - cpu.CycleCount));
+
+			const uint64_t now = Now();
+			++m_Stats.Quanta;
+			adaptQuantum(CyclesToNanoseconds(cpu.CycleCount - cycleStart), now - quantumStart);
+			if (!finished) {
+				return false;
+			}
+
+			const uint64_t deadline = m_StartNanoseconds + CyclesToNanoseconds(cpu.CycleCount - m_StartCycle);
+			if (now <= deadline) {
+				waitUntil(deadline);
+				continue;
+			}
+
+			// Behind, run the next quantum straight away
+			const uint64_t lag = now - deadline;
+			m_Stats.MaxLagNanoseconds = std::max(m_Stats.MaxLagNanoseconds, lag);
+			if (lag > m_Options.JitterBoundNanoseconds) {
+				++m_Stats.Overruns;
+				if (m_OverrunCallback) {
+					m_OverrunCallback(cpu.CycleCount, lag);
+				}
+			}
+
+			if (lag > m_Options.ResyncNanoseconds) {
+				++m_Stats.Resyncs;
+				m_StartNanoseconds = now;
+				m_StartCycle = cpu.CycleCount;
+			}
+		}
+		return true;
+	}
+
+	void Pacer::waitUntil(uint64_t deadline)
+	{
+		const uint64_t start = Now();
+
+		if (deadline > start + m_Options.SpinNanoseconds) {
+			const uint64_t wake = deadline - m_Options.SpinNanoseconds;
+#if defined(__linux__)
+			timespec until = { (time_t)(wake / 1'000'000'000), (long)(wake % 1'000'000'000) };
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr) == EINTR) {
+			}
+#else
+			std::this_thread::sleep_for(std::chrono::nanoseconds(wake - start));
+#endif
+		}
+
+		uint64_t now = Now();
+		while (now < deadline) {
+			now = Now();
+		}
+
+		m_Stats.WaitedNanoseconds += now - start;
+		m_Stats.MaxLateWakeNanoseconds = std::max(m_Stats.MaxLateWakeNanoseconds, now - deadline);
+	}
+
+	void Pacer::adaptQuantum(uint64_t emulatedNanoseconds, uint64_t hostNanoseconds)
+	{
+		// Within a quantum emulated time runs ahead by what the host saves on it, so the quantum
+		// can be as long as the bound scaled by emulated / saved time. A host that isn't faster
+		// than the chip gets the longest quantum, syncing more often wouldn't help it catch up.
+		double ideal = (double)m_Options.MaxQuantumCycles;
+		if (emulatedNanoseconds > hostNanoseconds) {
+			const double quantumNanoseconds = (double)m_Options.JitterBoundNanoseconds * emulatedNanoseconds / (emulatedNanoseconds - hostNanoseconds);
+			ideal = std::min(ideal, quantumNanoseconds * CPU::FREQUENCY / 1e9);
+		}
+
+		// Halfway there, so a quantum that was preempted doesn't swing the next one
+		const uint64_t next = (m_QuantumCycles + (uint64_t)ideal) / 2;
+		m_QuantumCycles = std::clamp(next, m_Options.MinQuantumCycles, m_Options.MaxQuantumCycles);
+		m_Stats.QuantumCycles = m_QuantumCycles;
+	}
+
+}
@@ -0,0 +1,200 @@
+#include "ATMega328Emulator/Profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace ATMega328Emulator {
+
+	namespace {
+
+		// Just enough protobuf to write profile.proto
+		class ProtoWriter
+		{
+		public:
+			void Varint(uint64_t value)
+			{
+				do {
+					Byte b = value & 0x7F;
+					value >>= 7;
+					m_Data.push_back(value ? (b | 0x80) : b);
+				} while (value);
+			}
+
+			void VarintField(uint32_t field, uint64_t value)
+			{
+				Varint((uint64_t)field << 3);
+				Varint(value);
+			}
+
+			void BytesField(uint32_t field, const void* data, size_t size)
+			{
+				Varint(((uint64_t)field << 3) | 2);
+				Varint(size);
+				m_Data.insert(m_Data.end(), (const Byte*)data, (const Byte*)data + size);
+			}
+
+			void MessageField(uint32_t field, const ProtoWriter& message)
+			{
+				BytesField(field, message.m_Data.data(), message.m_Data.size());
+			}
+
+			const std::vector<Byte>& GetData() const { return m_Data; }
+
+		private:
+			std::vector<Byte> m_Data;
+		};
+
+		// profile.proto field numbers
+		namespace Pprof {
+			constexpr uint32_t PROFILE_SAMPLE_TYPE = 1, PROFILE_SAMPLE = 2, PROFILE_MAPPING = 3, PROFILE_LOCATION = 4,
+				PROFILE_FUNCTION = 5, PROFILE_STRING_TABLE = 6, PROFILE_PERIOD_TYPE = 11, PROFILE_PERIOD = 12;
+			constexpr uint32_t VALUE_TYPE_TYPE = 1, VALUE_TYPE_UNIT = 2;
+			constexpr uint32_t SAMPLE_LOCATION_ID = 1, SAMPLE_VALUE = 2;
+			constexpr uint32_t MAPPING_ID = 1, MAPPING_MEMORY_START = 2, MAPPING_MEMORY_LIMIT = 3, MAPPING_FILENAME = 5, MAPPING_HAS_FUNCTIONS = 7;
+			constexpr uint32_t LOCATION_ID = 1, LOCATION_MAPPING_ID = 2, LOCATION_ADDRESS = 3, LOCATION_LINE = 4;
+			constexpr uint32_t LINE_FUNCTION_ID = 1;
+			constexpr uint32_t FUNCTION_ID = 1, FUNCTION_NAME = 2, FUNCTION_SYSTEM_NAME = 3;
+		}
+
+		// The fixed part of the string table, the address names follow
+		enum PprofString : uint64_t
+		{
+			STRING_EMPTY = 0,
+			STRING_SAMPLES,
+			STRING_COUNT,
+			STRING_CYCLES,
+			STRING_FIRMWARE,
+		};
+
+	}
+
+	Profiler::Profiler()
+		: m_Counters(new Counters[FLASH_WORDS])
+	{
+		Reset();
+	}
+
+	void Profiler::Reset()
+	{
+		std::memset(m_Counters.get(), 0, sizeof(Counters) * FLASH_WORDS);
+	}
+
+	uint64_t Profiler::GetTotalExecutions() const
+	{
+		uint64_t total = 0;
+		for (uint32_t pc = 0; pc < FLASH_WORDS; ++pc) {
+			total += m_Counters[pc].Executions;
+		}
+		return total;
+	}
+
+	uint64_t Profiler::GetTotalCycles() const
+	{
+		uint64_t total = 0;
+		for (uint32_t pc = 0; pc < FLASH_WORDS; ++pc) {
+			total += m_Counters[pc].Cycles;
+		}
+		return total;
+	}
+
+	void Profiler::WriteCallgrind(std::ostream& out, const std::string& objectName) const
+	{
+		out << "# callgrind format\n";
+		out << "version: 1\n";
+		out << "creator: ATMega328-Emulator\n";
+		out << "positions: instr\n";
+		out << "events: Executions Cycles\n";
+		out << "summary: " << GetTotalExecutions() << " " << GetTotalCycles() << "\n\n";
+
+		out << "ob=" << objectName << "\n";
+		out << "fl=" << objectName << "\n";
+		out << "fn=" << objectName << "\n";
+
+		char address[16];
+		for (uint32_t pc = 0; pc < FLASH_WORDS; ++pc) {
+			const Counters& counters = m_Counters[pc];
+			if (counters.Executions) {
+				// Byte addresses, like avr-objdump shows them
+				std::snprintf(address, sizeof(address), "0x%X", pc * 2);
+				out << address << " " << counters.Executions << " " << counters.Cycles << "\n";
+			}
+		}
+	}
+
+	void Profiler::WritePprof(std::ostream& out) const
+	{
+		using namespace Pprof;
+
+		ProtoWriter profile;
+		std::vector<std::string> strings = { "", "samples", "count", "cycles", "firmware" };
+
+		auto valueType = [](uint64_t type, uint64_t unit) {
+			ProtoWriter message;
+			message.VarintField(VALUE_TYPE_TYPE, type);
+			message.VarintField(VALUE_TYPE_UNIT, unit);
+			return message;
+		};
+
+		profile.MessageField(PROFILE_SAMPLE_TYPE, valueType(STRING_SAMPLES, STRING_COUNT));
+		profile.MessageField(PROFILE_SAMPLE_TYPE, valueType(STRING_CYCLES, STRING_COUNT));
+
+		{
+			// Addresses are already resolved to functions, stops pprof from looking for the binary
+			ProtoWriter mapping;
+			mapping.VarintField(MAPPING_ID, 1);
+			mapping.VarintField(MAPPING_MEMORY_START, 0);
+			mapping.VarintField(MAPPING_MEMORY_LIMIT, CPU::FLASH_SIZE);
+			mapping.VarintField(MAPPING_FILENAME, STRING_FIRMWARE);
+			mapping.VarintField(MAPPING_HAS_FUNCTIONS, 1);
+			profile.MessageField(PROFILE_MAPPING, mapping);
+		}
+
+		// Location, function and sample ids are all the same, one of each per address that ran
+		uint64_t id = 0;
+		char name[16];
+		for (uint32_t pc = 0; pc < FLASH_WORDS; ++pc) {
+			const Counters& counters = m_Counters[pc];
+			if (!counters.Executions) {
+				continue;
+			}
+			++id;
+
+			std::snprintf(name, sizeof(name), "0x%04X", pc * 2);
+			const uint64_t nameIndex = strings.size();
+			strings.push_back(name);
+
+			ProtoWriter function;
+			function.VarintField(FUNCTION_ID, id);
+			function.VarintField(FUNCTION_NAME, nameIndex);
+			function.VarintField(FUNCTION_SYSTEM_NAME, nameIndex);
+			profile.MessageField(PROFILE_FUNCTION, function);
+
+			ProtoWriter line;
+			line.VarintField(LINE_FUNCTION_ID, id);
+
+			ProtoWriter location;
+			location.VarintField(LOCATION_ID, id);
+			location.VarintField(LOCATION_MAPPING_ID, 1);
+			location.VarintField(LOCATION_ADDRESS, pc * 2);
+			location.MessageField(LOCATION_LINE, line);
+			profile.MessageField(PROFILE_LOCATION, location);
+
+			ProtoWriter sample;
+			sample.VarintField(SAMPLE_LOCATION_ID, id);
+			sample.VarintField(SAMPLE_VALUE, counters.Executions);
+			sample.VarintField(SAMPLE_VALUE, counters.Cycles);
+			profile.MessageField(PROFILE_SAMPLE, sample);
+		}
+
+		profile.MessageField(PROFILE_PERIOD_TYPE, valueType(STRING_CYCLES, STRING_COUNT));
+		profile.VarintField(PROFILE_PERIOD, 1);
+
+		for (const std::string& string : strings) {
+			profile.BytesField(PROFILE_STRING_TABLE, string.data(), string.size());
+		}
+
+		out.write((const char*)profile.GetData().data(), profile.GetData().size());
+	}
+
+}
@@ -0,0 +1,46 @@
+#include "ATMega328Emulator/RegisterHooks.h"
+
+#include <algorithm>
+
+#include "ATMega328Emulator/CPU.h"
+
+namespace ATMega328Emulator {
+
+	static_assert(RegisterHooks::ADDRESS_COUNT == CPU::SRAM_START, "Every register and I/O address needs a hook slot");
+
+	bool RegisterHooks::Add(Word address, Word size, RegisterHook* hook)
+	{
+		const uint32_t end = (uint32_t)address + size;
+		if (!size || end > ADDRESS_COUNT || !hook) {
+			return false;
+		}
+
+		for (uint32_t i = address; i < end; ++i) {
+			m_Hooks[i] = hook;
+			m_Hooked[i / 64] |= (uint64_t)1 << (i % 64);
+		}
+		return true;
+	}
+
+	void RegisterHooks::Remove(RegisterHook* hook)
+	{
+		for (uint32_t i = 0; i < ADDRESS_COUNT; ++i) {
+			if (m_Hooks[i] == hook) {
+				m_Hooks[i] = nullptr;
+				m_Hooked[i / 64] &= ~((uint64_t)1 << (i % 64));
+			}
+		}
+	}
+
+	std::vector<RegisterHook*> RegisterHooks::GetHooks() const
+	{
+		std::vector<RegisterHook*> hooks;
+		for (RegisterHook* hook : m_Hooks) {
+			if (hook && std::find(hooks.begin(), hooks.end(), hook) == hooks.end()) {
+				hooks.push_back(hook);
+			}
+		}
+		return hooks;
+	}
+
+}
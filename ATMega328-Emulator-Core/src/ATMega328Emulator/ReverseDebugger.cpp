@@ -0,0 +1,372 @@
+#include "ATMega328Emulator/ReverseDebugger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <stdexcept>
+
+#include "ATMega328Emulator/Timing.h"
+
+namespace ATMega328Emulator {
+
+	namespace {
+
+		// The longest an instruction can take, skipping a 2 word instruction takes one more than the table says
+		constexpr uint64_t MAX_INSTRUCTION_CYCLES = [] {
+			Byte cycles = 0;
+			for (const InstructionTiming& timing : Timing::TABLE) {
+				cycles = std::max({ cycles, timing.Cycles, timing.TakenCycles });
+			}
+			return cycles + 1;
+		}();
+
+		// Instructions and peripherals write these without going through WriteData, where a watchpoint sees it
+		bool IsWrittenDirectly(const CPU& cpu, Word address)
+		{
+			return address < CPU::IO_START
+				|| address == offsetof(CPU, IO.SPL) || address == offsetof(CPU, IO.SPH) || address == offsetof(CPU, IO.SREG)
+				|| (cpu.AttachedRegisterHooks && cpu.AttachedRegisterHooks->IsHooked(address));
+		}
+
+		// Detaches everything observing the CPU while history is replayed, it already saw it the first time
+		class DetachedObservers
+		{
+		public:
+			DetachedObservers(CPU& cpu)
+				: m_CPU(cpu), m_Saved(cpu)
+			{
+				cpu.AttachedProfiler = nullptr;
+				cpu.AttachedCallProfiler = nullptr;
+				cpu.AttachedInstructionMix = nullptr;
+				cpu.AttachedTracer = nullptr;
+				cpu.AttachedTraceArchive = nullptr;
+				cpu.AttachedSampler = nullptr;
+				cpu.AttachedWatchpoints = nullptr;
+				cpu.AttachedMetrics = nullptr;
+			}
+
+			~DetachedObservers()
+			{
+				m_CPU.AttachedProfiler = m_Saved.AttachedProfiler;
+				m_CPU.AttachedCallProfiler = m_Saved.AttachedCallProfiler;
+				m_CPU.AttachedInstructionMix = m_Saved.AttachedInstructionMix;
+				m_CPU.AttachedTracer = m_Saved.AttachedTracer;
+				m_CPU.AttachedTraceArchive = m_Saved.AttachedTraceArchive;
+				m_CPU.AttachedSampler = m_Saved.AttachedSampler;
+				m_CPU.AttachedWatchpoints = m_Saved.AttachedWatchpoints;
+				m_CPU.AttachedMetrics = m_Saved.AttachedMetrics;
+			}
+
+		private:
+			CPU& m_CPU;
+
+			struct Attachments
+			{
+				Attachments(const CPU& cpu)
+					: AttachedProfiler(cpu.AttachedProfiler), AttachedCallProfiler(cpu.AttachedCallProfiler),
+					AttachedInstructionMix(cpu.AttachedInstructionMix), AttachedTracer(cpu.AttachedTracer),
+					AttachedTraceArchive(cpu.AttachedTraceArchive), AttachedSampler(cpu.AttachedSampler),
+					AttachedWatchpoints(cpu.AttachedWatchpoints), AttachedMetrics(cpu.AttachedMetrics)
+				{
+				}
+
+				Profiler* AttachedProfiler;
+				CallProfiler* AttachedCallProfiler;
+				InstructionMix* AttachedInstructionMix;
+				TraceRecorder* AttachedTracer;
+				TraceArchiveWriter* AttachedTraceArchive;
+				SamplingProfiler* AttachedSampler;
+				Watchpoints* AttachedWatchpoints;
+				MetricsCounters* AttachedMetrics;
+			} m_Saved;
+		};
+
+	}
+
+	ReverseDebugger::ReverseDebugger(CPU& cpu, Memory& memory)
+		: ReverseDebugger(cpu, memory, Config())
+	{
+	}
+
+	ReverseDebugger::ReverseDebugger(CPU& cpu, Memory& memory, const Config& config)
+		: m_CPU(cpu), m_Memory(memory), m_Config(config), m_Interval(std::max<uint64_t>(config.InitialInterval, 1))
+	{
+		m_Peripherals = getPeripherals();
+		takeCheckpoint();
+	}
+
+	void ReverseDebugger::Execute(uint64_t cycles)
+	{
+		// The history can only be replayed with the peripherals it was recorded with
+		std::vector<RegisterHook*> peripherals = getPeripherals();
+		if (peripherals != m_Peripherals) {
+			m_Checkpoints.clear();
+			m_Peripherals = std::move(peripherals);
+		}
+
+		// The future may differ from what was recorded, e.g. when registers were edited
+		while (!m_Checkpoints.empty() && m_Checkpoints.back().Cycle > m_CPU.CycleCount) {
+			m_Checkpoints.pop_back();
+		}
+		if (m_Checkpoints.empty() || m_Checkpoints.back().Cycle != m_CPU.CycleCount) {
+			takeCheckpoint();
+		}
+
+		const uint64_t startCycle = m_CPU.CycleCount;
+		const uint64_t target = startCycle + cycles;
+		const auto startTime = std::chrono::steady_clock::now();
+
+		while (m_CPU.CycleCount < target) {
+			uint64_t next = m_Checkpoints.back().Cycle + m_Interval;
+			uint64_t end = std::min(target, next);
+
+			m_CPU.Execute((int)std::min<uint64_t>(end - m_CPU.CycleCount, INT_MAX), m_Memory);
+
+			if (m_CPU.CycleCount >= next) {
+				takeCheckpoint();
+			}
+		}
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+		if (elapsed.count() > 0.01) {
+			m_CyclesPerSecond = (m_CPU.CycleCount - startCycle) / elapsed.count();
+		}
+	}
+
+	bool ReverseDebugger::StepBack()
+	{
+		checkAttachments();
+
+		const uint64_t now = m_CPU.CycleCount;
+
+		size_t index = findBefore(now);
+		if (index == m_Checkpoints.size()) {
+			return false;
+		}
+
+		DetachedObservers detached(m_CPU);
+
+		// First pass finds where the last instruction before now started, only its last few cycles are single stepped
+		restore(m_Checkpoints[index]);
+		if (now - m_CPU.CycleCount > MAX_INSTRUCTION_CYCLES) {
+			replayTo(now - MAX_INSTRUCTION_CYCLES);
+		}
+
+		uint64_t previous = m_CPU.CycleCount;
+		while (m_CPU.CycleCount < now) {
+			previous = m_CPU.CycleCount;
+			m_CPU.Execute(1, m_Memory);
+		}
+
+		restore(m_Checkpoints[index]);
+		replayTo(previous);
+		return true;
+	}
+
+	bool ReverseDebugger::RunBackToWrite(Word address)
+	{
+		checkAttachments();
+
+		const uint64_t now = m_CPU.CycleCount;
+
+		// Single stepping is slower than a step back replays, so it only goes back as far as a step back might
+		const bool watched = address < CPU::DATA_SPACE_SIZE && !IsWrittenDirectly(m_CPU, address);
+		const uint64_t oldest = (watched || now < m_Interval) ? 0 : now - m_Interval;
+
+		DetachedObservers detached(m_CPU);
+		bool found = false;
+		uint64_t writeCycle = 0;
+		m_Writes.Clear();
+		m_Writes.Add(WatchSpace::Data, address, 1, WatchAccess::Write);
+		m_Writes.SetCallback([&](const WatchEvent& event) {
+			if (event.OldValue != event.NewValue) {
+				found = true;
+				writeCycle = event.Cycle;
+			}
+			return false;
+		});
+
+		// Search one checkpoint interval at a time, newest first
+		for (size_t index = findBefore(now); index < m_Checkpoints.size(); --index) {
+			uint64_t end = now;
+			if (index + 1 < m_Checkpoints.size()) {
+				end = std::min(end, m_Checkpoints[index + 1].Cycle);
+			}
+
+			restore(m_Checkpoints[index]);
+
+			if (watched) {
+				m_CPU.AttachedWatchpoints = &m_Writes;
+				replayTo(end);
+				m_CPU.AttachedWatchpoints = nullptr;
+			}
+			else {
+				if (m_CPU.CycleCount < oldest) {
+					replayTo(oldest);
+				}
+				while (m_CPU.CycleCount < end) {
+					uint64_t start = m_CPU.CycleCount;
+					Byte before = m_CPU.ReadData(address);
+
+					m_CPU.Execute(1, m_Memory);
+
+					if (m_CPU.ReadData(address) != before) {
+						found = true;
+						writeCycle = start;
+					}
+				}
+			}
+
+			if (found) {
+				restore(m_Checkpoints[index]);
+				replayTo(writeCycle);
+				return true;
+			}
+
+			if (m_Checkpoints[index].Cycle <= oldest) {
+				break;
+			}
+		}
+
+		SeekTo(now);
+		return false;
+	}
+
+	bool ReverseDebugger::SeekTo(uint64_t cycle)
+	{
+		checkAttachments();
+
+		size_t index = findBefore(cycle + 1);
+		if (index == m_Checkpoints.size()) {
+			return false;
+		}
+
+		DetachedObservers detached(m_CPU);
+		restore(m_Checkpoints[index]);
+		replayTo(cycle);
+		return true;
+	}
+
+	size_t ReverseDebugger::GetMemoryUsage() const
+	{
+		size_t usage = 0;
+		const Snapshot* base = nullptr;
+
+		for (const Checkpoint& checkpoint : m_Checkpoints) {
+			usage += sizeof(Checkpoint) + checkpoint.Delta.GetSize() + checkpoint.Peripherals.size();
+
+			// Checkpoints sharing a base are always adjacent
+			if (checkpoint.Base.get() != base) {
+				base = checkpoint.Base.get();
+				usage += base->GetSize();
+			}
+		}
+
+		return usage;
+	}
+
+	void ReverseDebugger::takeCheckpoint()
+	{
+		std::vector<Byte> peripherals;
+		for (RegisterHook* hook : m_Peripherals) {
+			if (!hook->SaveState(peripherals)) {
+				throw std::invalid_argument("ReverseDebugger can't checkpoint a register hook that doesn't save its state");
+			}
+		}
+
+		IncrementalSnapshot delta;
+		if (m_Base) {
+			delta = IncrementalSnapshot::Capture(*m_Base, m_CPU, m_Memory);
+		}
+
+		// Deltas are against the base, so they keep growing until a new one is taken
+		if (!m_Base || delta.GetSize() * m_Config.KeyframeRatio > m_Base->GetSize()) {
+			m_Base = std::make_shared<const Snapshot>(Snapshot::Capture(m_CPU, m_Memory));
+			delta = IncrementalSnapshot::Capture(*m_Base, m_CPU, m_Memory);
+		}
+
+		m_Checkpoints.push_back({ m_CPU.CycleCount, m_Base, std::move(delta), std::move(peripherals) });
+
+		enforceBudget();
+	}
+
+	void ReverseDebugger::enforceBudget()
+	{
+		while (m_Checkpoints.size() > 1 && GetMemoryUsage() > m_Config.MemoryBudget) {
+			if (m_Interval * 2 <= maxInterval()) {
+				// Keep every other checkpoint, counting from the newest
+				std::vector<Checkpoint> kept;
+				for (size_t i = (m_Checkpoints.size() - 1) % 2; i < m_Checkpoints.size(); i += 2) {
+					kept.push_back(std::move(m_Checkpoints[i]));
+				}
+				m_Checkpoints = std::move(kept);
+				m_Interval *= 2;
+			}
+			else {
+				m_Checkpoints.erase(m_Checkpoints.begin());
+			}
+		}
+	}
+
+	void ReverseDebugger::restore(const Checkpoint& checkpoint)
+	{
+		// The delta only applies on top of its own base
+		if (checkpoint.Base != m_Base) {
+			checkpoint.Base->Restore(m_CPU, m_Memory);
+			m_Base = checkpoint.Base;
+		}
+
+		checkpoint.Delta.Restore(*checkpoint.Base, m_CPU, m_Memory);
+
+		const Byte* state = checkpoint.Peripherals.data();
+		for (RegisterHook* hook : m_Peripherals) {
+			state = hook->RestoreState(state);
+		}
+	}
+
+	size_t ReverseDebugger::findBefore(uint64_t cycle) const
+	{
+		for (size_t index = m_Checkpoints.size(); index > 0; --index) {
+			if (m_Checkpoints[index - 1].Cycle < cycle) {
+				return index - 1;
+			}
+		}
+
+		return m_Checkpoints.size();
+	}
+
+	void ReverseDebugger::replayTo(uint64_t cycle)
+	{
+		// One Run at full speed, nothing but the target can stop it
+		StopConditions conditions;
+		conditions.CycleTarget = cycle;
+		while (m_CPU.CycleCount < cycle) {
+			m_CPU.Run(UINT64_MAX, conditions, m_Memory);
+		}
+	}
+
+	std::vector<RegisterHook*> ReverseDebugger::getPeripherals() const
+	{
+		return m_CPU.AttachedRegisterHooks ? m_CPU.AttachedRegisterHooks->GetHooks() : std::vector<RegisterHook*>();
+	}
+
+	void ReverseDebugger::checkAttachments() const
+	{
+		// Checkpoints only have state for the peripherals that were attached when they were taken
+		if (getPeripherals() != m_Peripherals) {
+			throw std::invalid_argument("ReverseDebugger's history was recorded with other register hooks, Execute to start it over");
+		}
+	}
+
+	uint64_t ReverseDebugger::maxInterval() const
+	{
+		if (m_CyclesPerSecond <= 0.0) {
+			return UINT64_MAX;
+		}
+
+		// A step back replays up to one interval twice
+		return std::max<uint64_t>((uint64_t)(m_CyclesPerSecond * m_Config.MaxStepBackSeconds / 2), 1);
+	}
+
+}
@@ -0,0 +1,101 @@
+#include "ATMega328Emulator/RingBuffer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+
+namespace ATMega328Emulator {
+
+	RingBuffer::RingBuffer(size_t capacity)
+		: m_Capacity(std::bit_ceil(std::max<size_t>(capacity, 1)))
+	{
+		m_Data = std::make_unique<Byte[]>(m_Capacity);
+	}
+
+	size_t RingBuffer::Write(const Byte* data, size_t size)
+	{
+		const size_t head = m_Producer.Head.load(std::memory_order_relaxed);
+		if (m_Capacity - (head - m_Producer.Tail) < size) {
+			m_Producer.Tail = m_Consumer.Tail.load(std::memory_order_acquire);
+		}
+
+		size = std::min(size, m_Capacity - (head - m_Producer.Tail));
+		const size_t offset = head & (m_Capacity - 1);
+		const size_t first = std::min(size, m_Capacity - offset);
+		std::memcpy(&m_Data[offset], data, first);
+		std::memcpy(&m_Data[0], data + first, size - first);
+
+		m_Producer.Head.store(head + size, std::memory_order_release);
+		return size;
+	}
+
+	std::span<const Byte> RingBuffer::Peek()
+	{
+		const size_t tail = m_Consumer.Tail.load(std::memory_order_relaxed);
+		m_Consumer.Head = m_Producer.Head.load(std::memory_order_acquire);
+
+		const size_t offset = tail & (m_Capacity - 1);
+		const size_t size = std::min(m_Consumer.Head - tail, m_Capacity - offset);
+		return { &m_Data[offset], size };
+	}
+
+	void RingBuffer::Consume(size_t count)
+	{
+		const size_t tail = m_Consumer.Tail.load(std::memory_order_relaxed);
+		m_Consumer.Tail.store(tail + std::min(count, m_Consumer.Head - tail), std::memory_order_release);
+	}
+
+	size_t RingBuffer::Read(Byte* data, size_t size)
+	{
+		size_t read = 0;
+		while (read < size) {
+			std::span<const Byte> available = Peek();
+			if (available.empty()) {
+				break;
+			}
+
+			const size_t count = std::min(available.size(), size - read);
+			std::memcpy(data + read, available.data(), count);
+			Consume(count);
+			read += count;
+		}
+		return read;
+	}
+
+	int64_t RingBuffer::WriteTo(int fd)
+	{
+		int64_t total = 0;
+		while (true) {
+			std::span<const Byte> available = Peek();
+			if (available.empty()) {
+				return total;
+			}
+
+#ifdef _WIN32
+			const int written = _write(fd, available.data(), (unsigned int)std::min<size_t>(available.size(), INT32_MAX));
+#else
+			const ssize_t written = write(fd, available.data(), available.size());
+#endif
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return errno == EAGAIN || errno == EWOULDBLOCK ? total : -1;
+			}
+
+			Consume((size_t)written);
+			total += written;
+			if ((size_t)written < available.size()) {
+				return total;
+			}
+		}
+	}
+
+}
@@ -0,0 +1,438 @@
+#include "ATMega328Emulator/SPI.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "ATMega328Emulator/Timing.h"
+
+namespace ATMega328Emulator {
+
+	static_assert(offsetof(CPU, IO.SPCR) == SPI::SPCR_ADDRESS, "SPCR has moved");
+	static_assert(offsetof(CPU, IO.SPSR) == SPI::SPSR_ADDRESS, "SPSR has moved");
+	static_assert(offsetof(CPU, IO.SPDR) == SPI::SPDR_ADDRESS, "SPDR has moved");
+	static_assert(offsetof(CPU, IO.PORTB) == SPI::PORTB_ADDRESS, "PORTB has moved");
+
+	namespace {
+
+		// 8 SCK periods, SPR1:0 divide the clock by 4, 16, 64 or 128 and SPI2X halves that
+		uint64_t ByteCycles(Byte control, Byte status)
+		{
+			static constexpr uint64_t DIVISORS[4] = { 4, 16, 64, 128 };
+			const uint64_t divisor = DIVISORS[control & (SPI::SPR1 | SPI::SPR0)];
+			return 8 * ((status & SPI::SPI2X) ? divisor / 2 : divisor);
+		}
+
+		// Wraps at the end of the flash like the PC does
+		Word PeekFlash(const Memory& memory, Word pc)
+		{
+			const uint32_t address = ((uint32_t)pc & CPU::FLASH_MASK) * 2;
+			return (Word)(memory[address] | (memory[address + 1] << 8));
+		}
+
+	}
+
+	SPI::SPI()
+	{
+		m_Run.reserve(RUN_SIZE);
+		m_Miso.reserve(RUN_SIZE);
+	}
+
+	void SPI::Attach(RegisterHooks& hooks, const Memory& memory)
+	{
+		Detach();
+		hooks.Add(SPCR_ADDRESS, 3, this);
+		for (const Slave& slave : m_Slaves) {
+			if (slave.Port) {
+				hooks.Add(slave.Port - 1, 2, this); // DDRx and PORTx
+			}
+		}
+		m_Hooks = &hooks;
+		m_Memory = &memory;
+	}
+
+	void SPI::Detach()
+	{
+		if (m_Hooks) {
+			m_Hooks->Remove(this);
+			m_Hooks = nullptr;
+		}
+		m_Memory = nullptr;
+	}
+
+	bool SPI::AddDevice(SPIDevice* device, Word port, Byte pin)
+	{
+		if (!device || pin > 7 || (port && port != PORTB_ADDRESS && port != PORTC_ADDRESS && port != PORTD_ADDRESS)) {
+			return false;
+		}
+
+		m_Slaves.push_back({ device, port, pin, false });
+		return true;
+	}
+
+	void SPI::Reset(CPU& cpu)
+	{
+		cpu.IO.SPCR = 0;
+		cpu.IO.SPSR = 0;
+		cpu.IO.SPDR = 0;
+
+		m_Control = 0;
+		m_Mode = 0;
+		m_InterruptCycle = NO_EVENT;
+		m_Busy = m_Complete = m_Collision = m_FlagsSeen = false;
+		m_Received = 0xFF;
+		m_Run.clear();
+
+		// R0 is no port, so this only reads them
+		updateSelection(cpu, 0, 0);
+	}
+
+	void SPI::Flush(const CPU& cpu)
+	{
+		advance(cpu.CycleCount);
+		flush();
+	}
+
+	void SPI::flush()
+	{
+		if (m_Run.empty()) {
+			return;
+		}
+
+		// Running cycles again sends their bytes again, the devices already answered those
+		const uint64_t first = m_Stats.Bytes - m_Run.size();
+		const size_t answered = (size_t)std::min<uint64_t>(m_Delivered > first ? m_Delivered - first : 0, m_Run.size());
+		if (answered == m_Run.size()) {
+			m_Received = m_Log[first + answered - 1 - m_LogStart];
+			m_Run.clear();
+			return;
+		}
+
+		const std::span<const Byte> mosi(m_Run.data() + answered, m_Run.size() - answered);
+		// Bytes Reset dropped never got an answer, they keep their place in the log
+		const size_t logged = (size_t)(first + answered - m_LogStart);
+		if (m_Logging) {
+			m_Log.resize(logged + mosi.size(), 0xFF);
+		}
+
+		// Selected devices share MISO, a device drives a bit low or leaves it pulled up
+		m_Miso.resize(mosi.size());
+		Byte received = 0xFF;
+		for (const Slave& slave : m_Slaves) {
+			if (slave.Selected) {
+				std::fill(m_Miso.begin(), m_Miso.end(), (Byte)0xFF);
+				slave.Device->Transfer(mosi, m_Miso);
+				received &= m_Miso.back();
+				++m_Stats.Transfers;
+
+				if (m_Logging) {
+					for (size_t i = 0; i < m_Miso.size(); ++i) {
+						m_Log[logged + i] &= m_Miso[i];
+					}
+				}
+			}
+		}
+
+		m_Received = received;
+		m_Delivered = m_Stats.Bytes;
+		m_Run.clear();
+	}
+
+	uint64_t SPI::GetByteCycles(const CPU& cpu)
+	{
+		return ByteCycles(cpu.IO.SPCR, cpu.IO.SPSR);
+	}
+
+	uint64_t SPI::GetNextEventCycle() const
+	{
+		// Without the interrupt nothing happens at the end of a byte the firmware doesn't look at
+		if (m_Busy && (m_Control & SPIE)) {
+			return std::min(m_InterruptCycle, m_End);
+		}
+		return m_InterruptCycle;
+	}
+
+	void SPI::HandleEvents(CPU& cpu, Memory&)
+	{
+		advance(cpu.CycleCount);
+
+		m_InterruptCycle = NO_EVENT;
+		if ((m_Control & SPIE) && m_Complete) {
+			// Entering the handler clears SPIF, masked it is tried again later
+			if (cpu.EnterInterrupt(STC_VECTOR)) {
+				m_Complete = false;
+			}
+			else {
+				m_InterruptCycle = cpu.CycleCount + INTERRUPT_RETRY_CYCLES;
+			}
+		}
+
+		cpu.IO.SPSR = getStatus();
+	}
+
+	std::vector<RegisterRange> SPI::GetRegisters() const
+	{
+		return { { SPCR_ADDRESS, (Word)(SPDR_ADDRESS - SPCR_ADDRESS + 1) } };
+	}
+
+	Byte SPI::OnRead(CPU& cpu, Word address, Byte value, uint64_t cycle)
+	{
+		const uint64_t before = GetNextEventCycle();
+
+		switch (address) {
+			case SPSR_ADDRESS:
+				// The loop would have read SPSR again every period until SPIF showed up, read it then
+				if (const int skipped = getSkippableCycles(cpu, cycle)) {
+					cpu.Stall(skipped);
+					cycle += (uint64_t)skipped;
+				}
+				advance(cycle);
+				m_FlagsSeen = m_Complete || m_Collision;
+				value = cpu.IO.SPSR = getStatus();
+				break;
+
+			case SPDR_ADDRESS:
+				advance(cycle);
+				clearFlags();
+				flush();
+				value = cpu.IO.SPDR = m_Received;
+				break;
+
+			default:
+				advance(cycle);
+				break;
+		}
+
+		onAccessed(before, cycle);
+		return value;
+	}
+
+	Byte SPI::OnWrite(CPU& cpu, Word address, Byte value, uint64_t cycle)
+	{
+		const uint64_t before = GetNextEventCycle();
+		advance(cycle);
+
+		switch (address) {
+			case SPCR_ADDRESS:
+				// Disabling the SPI drops the byte in flight
+				m_Control = value;
+				if (!(value & SPE)) {
+					m_Busy = false;
+				}
+				break;
+
+			case SPSR_ADDRESS:
+				// Only SPI2X can be written
+				m_Mode = value & SPI2X;
+				value = getStatus();
+				break;
+
+			case SPDR_ADDRESS:
+				clearFlags();
+				if (m_Busy) {
+					m_Collision = true;
+					++m_Stats.Collisions;
+				}
+				else if ((m_Control & (SPE | MSTR)) == (SPE | MSTR)) {
+					m_Busy = true;
+					m_Shift = value;
+					m_End = cycle + ByteCycles(m_Control, m_Mode);
+				}
+				value = cpu.IO.SPDR; // Reads see the received byte
+				break;
+
+			default:
+				updateSelection(cpu, address, value);
+				break;
+		}
+
+		onAccessed(before, cycle);
+		return value;
+	}
+
+	void SPI::advance(uint64_t cycle)
+	{
+		if (!m_Busy || m_End > cycle) {
+			return;
+		}
+
+		m_Busy = false;
+		m_Complete = true;
+		m_Run.push_back(m_Shift);
+		++m_Stats.Bytes;
+		if (m_Run.size() >= RUN_SIZE) {
+			flush();
+		}
+	}
+
+	bool SPI::SaveState(std::vector<Byte>& out)
+	{
+		if (!m_Logging) {
+			m_Logging = true;
+			m_LogStart = m_Stats.Bytes - m_Run.size();
+		}
+
+		SaveValue(out, m_Control);
+		SaveValue(out, m_Mode);
+		SaveValue(out, m_InterruptCycle);
+		SaveValue(out, m_Busy);
+		SaveValue(out, m_Complete);
+		SaveValue(out, m_Collision);
+		SaveValue(out, m_FlagsSeen);
+		SaveValue(out, m_Shift);
+		SaveValue(out, m_Received);
+		SaveValue(out, m_End);
+		SaveValue(out, m_Selections);
+		for (const Slave& slave : m_Slaves) {
+			SaveValue(out, slave.Selected);
+		}
+
+		SaveValue(out, m_Run.size());
+		out.insert(out.end(), m_Run.begin(), m_Run.end());
+
+		// Transfers counts device calls, those don't happen again
+		SaveValue(out, m_Stats.Bytes);
+		SaveValue(out, m_Stats.SkippedPolls);
+		SaveValue(out, m_Stats.Collisions);
+		return true;
+	}
+
+	const Byte* SPI::RestoreState(const Byte* in)
+	{
+		in = RestoreValue(in, m_Control);
+		in = RestoreValue(in, m_Mode);
+		in = RestoreValue(in, m_InterruptCycle);
+		in = RestoreValue(in, m_Busy);
+		in = RestoreValue(in, m_Complete);
+		in = RestoreValue(in, m_Collision);
+		in = RestoreValue(in, m_FlagsSeen);
+		in = RestoreValue(in, m_Shift);
+		in = RestoreValue(in, m_Received);
+		in = RestoreValue(in, m_End);
+		in = RestoreValue(in, m_Selections);
+		for (Slave& slave : m_Slaves) {
+			in = RestoreValue(in, slave.Selected);
+		}
+
+		size_t size;
+		in = RestoreValue(in, size);
+		m_Run.assign(in, in + size);
+		in += size;
+
+		in = RestoreValue(in, m_Stats.Bytes);
+		in = RestoreValue(in, m_Stats.SkippedPolls);
+		in = RestoreValue(in, m_Stats.Collisions);
+		return in;
+	}
+
+	int SPI::getSkippableCycles(const CPU& cpu, uint64_t cycle)
+	{
+		if (!m_Busy || m_End <= cycle || !m_Memory) {
+			return 0;
+		}
+
+		// in rX, SPSR or lds rX, SPSR, then sbrs rX, SPIF and rjmp back to the first
+		const Word pc = cpu.RunInstructionPC;
+		const Word first = PeekFlash(*m_Memory, pc);
+		Word next;
+		int period;
+		switch (Timing::Decode(first)) {
+			case OpcodeClass::IN:
+				if (((first & 0b1111) | ((first & 0b110'0000'0000) >> 5)) != SPSR_ADDRESS - CPU::IO_START) {
+					return 0;
+				}
+				next = pc + 1;
+				period = Timing::GetCycles(OpcodeClass::IN, false);
+				break;
+
+			case OpcodeClass::LDS:
+				if (PeekFlash(*m_Memory, pc + 1) != SPSR_ADDRESS) {
+					return 0;
+				}
+				next = pc + 2;
+				period = Timing::GetCycles(OpcodeClass::LDS, false);
+				break;
+
+			default:
+				return 0;
+		}
+
+		const Word test = PeekFlash(*m_Memory, next);
+		const Word jump = PeekFlash(*m_Memory, next + 1);
+		const int offset = (int)((jump & 0x0FFF) ^ 0x0800) - 0x0800;
+		if (Timing::Decode(test) != OpcodeClass::SBRS || (test & 0b111) != 7 || ((test ^ first) & 0b1'1111'0000)
+			|| Timing::Decode(jump) != OpcodeClass::RJMP || offset != (int)pc - (int)(next + 2)) {
+			return 0;
+		}
+		period += Timing::GetCycles(OpcodeClass::SBRS, false) + Timing::GetCycles(OpcodeClass::RJMP, true);
+
+		// A Run told to stop inside the loop has to get there
+		if ((cpu.RunStopFlags & CPU::STOP_ON_PC) && cpu.RunStopPC >= pc && cpu.RunStopPC <= next + 1) {
+			return 0;
+		}
+
+		// The first read at or past the end of the byte, as long as it is still in this slice
+		// so the Scheduler's other events aren't passed over
+		const uint64_t iterations = std::min<uint64_t>((m_End - cycle + period - 1) / period, (uint64_t)std::max(cpu.RunInstructionCycles - 1, 0) / period);
+		m_Stats.SkippedPolls += iterations;
+		return (int)iterations * period;
+	}
+
+	void SPI::updateSelection(const CPU& cpu, Word address, Byte value)
+	{
+		auto read = [&](Word at) { return at == address ? value : (&cpu.R00)[at]; };
+
+		bool flushed = false;
+		for (Slave& slave : m_Slaves) {
+			const Byte bit = (Byte)(1 << slave.Pin);
+			const bool selected = !slave.Port || ((read(slave.Port - 1) & bit) && !(read(slave.Port) & bit));
+			if (selected == slave.Selected) {
+				continue;
+			}
+
+			// The bytes sent so far went to the devices selected while they were sent
+			if (!flushed) {
+				flush();
+				flushed = true;
+			}
+			slave.Selected = selected;
+			if (++m_Selections <= m_SelectionsDelivered) {
+				continue; // Running cycles again, the device saw this one already
+			}
+			m_SelectionsDelivered = m_Selections;
+			if (selected) {
+				slave.Device->Select();
+			}
+			else {
+				slave.Device->Deselect();
+			}
+		}
+	}
+
+	void SPI::clearFlags()
+	{
+		if (m_FlagsSeen) {
+			m_Complete = m_Collision = false;
+			m_FlagsSeen = false;
+		}
+	}
+
+	Byte SPI::getStatus() const
+	{
+		return (m_Complete ? SPIF : 0)
+			| (m_Collision ? WCOL : 0)
+			| m_Mode;
+	}
+
+	void SPI::onAccessed(uint64_t nextEventBefore, uint64_t cycle)
+	{
+		if ((m_Control & SPIE) && m_Complete && m_InterruptCycle > cycle) {
+			m_InterruptCycle = cycle;
+		}
+
+		// The Scheduler's slice was cut to the old next event, a sooner one needs the slice to end now
+		if (m_Hooks && GetNextEventCycle() < nextEventBefore) {
+			m_Hooks->RequestStop();
+		}
+	}
+
+}
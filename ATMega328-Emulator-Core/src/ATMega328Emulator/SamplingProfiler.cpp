@@ -0,0 +1,65 @@
+#include "ATMega328Emulator/SamplingProfiler.h"
+
+#include <algorithm>
+
+#include "ATMega328Emulator/CPU.h"
+
+namespace ATMega328Emulator {
+
+	SamplingProfiler::SamplingProfiler(uint32_t meanInterval, size_t capacity, uint64_t seed)
+		: m_MeanInterval(std::max<uint32_t>(meanInterval, 2)), m_Capacity(std::max<size_t>(capacity, 1)), m_Seed(seed),
+		m_Samples(new Sample[m_Capacity])
+	{
+		Reset();
+	}
+
+	void SamplingProfiler::Reset()
+	{
+		// xorshift gets stuck on 0
+		m_State = m_Seed ? m_Seed : 0x9E3779B97F4A7C15;
+		m_Countdown = nextInterval();
+		m_Total = 0;
+	}
+
+	std::vector<SamplingProfiler::Sample> SamplingProfiler::GetSamples() const
+	{
+		const size_t count = (size_t)std::min<uint64_t>(m_Total, m_Capacity);
+		const size_t oldest = (size_t)((m_Total - count) % m_Capacity);
+
+		std::vector<Sample> samples;
+		samples.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			samples.push_back(m_Samples[(oldest + i) % m_Capacity]);
+		}
+		return samples;
+	}
+
+	void SamplingProfiler::take(const CPU& cpu)
+	{
+		Sample& sample = m_Samples[m_Total % m_Capacity];
+		sample.Cycle = cpu.CycleCount;
+		sample.PC = cpu.PC;
+		sample.SP = cpu.IO.SP;
+		sample.InterruptDepth = cpu.InterruptDepth;
+		sample.InterruptVector = cpu.GetInterruptVector();
+		sample.InterruptsEnabled = cpu.IO.SREG.I;
+		++m_Total;
+
+		// The last instruction may have overshot, the next sample makes up for it
+		m_Countdown += nextInterval();
+		if (m_Countdown <= 0) {
+			m_Countdown = 1;
+		}
+	}
+
+	uint32_t SamplingProfiler::nextInterval()
+	{
+		// xorshift64
+		m_State ^= m_State << 13;
+		m_State ^= m_State >> 7;
+		m_State ^= m_State << 17;
+
+		return m_MeanInterval / 2 + (uint32_t)(m_State % (m_MeanInterval + 1));
+	}
+
+}
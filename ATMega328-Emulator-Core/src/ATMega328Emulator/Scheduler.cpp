@@ -0,0 +1,115 @@
+#include "ATMega328Emulator/Scheduler.h"
+
+#include <algorithm>
+
+namespace ATMega328Emulator {
+
+	namespace {
+
+		// Attaches the register watchpoints for one Execute, if the CPU's slot is free
+		class RegisterWatch
+		{
+		public:
+			RegisterWatch(CPU& cpu, Watchpoints* registers)
+				: m_CPU(cpu), m_Attached(registers && !cpu.AttachedWatchpoints)
+			{
+				if (m_Attached) {
+					cpu.AttachedWatchpoints = registers;
+				}
+			}
+
+			~RegisterWatch()
+			{
+				if (m_Attached) {
+					m_CPU.AttachedWatchpoints = nullptr;
+				}
+			}
+
+		private:
+			CPU& m_CPU;
+			bool m_Attached;
+		};
+
+	}
+
+	Scheduler::Scheduler()
+	{
+		// Any access to a source's registers ends the quantum
+		m_Registers.SetCallback([](const WatchEvent&) { return true; });
+	}
+
+	void Scheduler::Add(EventSource* source)
+	{
+		m_Sources.push_back(source);
+		watchRegisters();
+	}
+
+	void Scheduler::Remove(EventSource* source)
+	{
+		m_Sources.erase(std::remove(m_Sources.begin(), m_Sources.end(), source), m_Sources.end());
+		watchRegisters();
+	}
+
+	bool Scheduler::Execute(CPU& cpu, Memory& memory, uint64_t cycles)
+	{
+		const uint64_t target = cpu.CycleCount + cycles;
+
+		// Watching costs the CPU its fast loop, exact slices don't need it
+		RegisterWatch watch(cpu, m_Quantum && m_Registers.GetCount() ? &m_Registers : nullptr);
+
+		if (handleDueEvents(cpu, memory)) {
+			return false;
+		}
+
+		while (cpu.CycleCount < target) {
+			uint64_t end = GetNextEventCycle();
+			if (m_Quantum) {
+				end = std::max(end, cpu.CycleCount + m_Quantum);
+			}
+
+			// Always make progress, even if a source left an event in the past
+			end = std::max(std::min(target, end), cpu.CycleCount + 1);
+			const uint64_t slice = end - cpu.CycleCount;
+
+			// Run rather than Execute, a register hook may have scheduled an event inside the slice
+			cpu.Run(slice, StopConditions(), memory);
+
+			if (handleDueEvents(cpu, memory)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint64_t Scheduler::GetNextEventCycle() const
+	{
+		uint64_t next = EventSource::NO_EVENT;
+		for (const EventSource* source : m_Sources) {
+			next = std::min(next, source->GetNextEventCycle());
+		}
+		return next;
+	}
+
+	bool Scheduler::handleDueEvents(CPU& cpu, Memory& memory)
+	{
+		bool stop = false;
+		for (EventSource* source : m_Sources) {
+			if (source->GetNextEventCycle() <= cpu.CycleCount) {
+				source->HandleEvents(cpu, memory);
+				stop |= source->TakeStopRequest();
+			}
+		}
+		return stop;
+	}
+
+	void Scheduler::watchRegisters()
+	{
+		m_Registers.Clear();
+		for (const EventSource* source : m_Sources) {
+			for (const RegisterRange& range : source->GetRegisters()) {
+				m_Registers.Add(WatchSpace::Data, range.Address, range.Size, WatchAccess::ReadWrite);
+			}
+		}
+	}
+
+}
@@ -0,0 +1,185 @@
+#include "ATMega328Emulator/Snapshot.h"
+
+#include <cstring>
+#include <cstddef>
+
+namespace ATMega328Emulator {
+
+	namespace {
+
+		enum class Region : Byte
+		{
+			Data = 0,
+			EEPROM,
+			Flash,
+		};
+
+		// The chip's state ends where the Run bookkeeping starts.
+		// That and the attached profilers, tracers and peripherals belong to the host and are never restored.
+		constexpr size_t CPU_STATE_SIZE = offsetof(CPU, RunStopFlags);
+
+		// Everything in the CPU's state after the EEPROM (PC, cycle count, interrupt state, dirty bits) is small and always captured.
+		constexpr size_t CPU_TAIL_OFFSET = offsetof(CPU, EEPROM) + CPU::EEPROM_SIZE;
+		constexpr size_t CPU_TAIL_SIZE = CPU_STATE_SIZE - CPU_TAIL_OFFSET;
+
+		constexpr uint32_t PAGE_SIZE = IncrementalSnapshot::PAGE_SIZE;
+
+		static_assert(decltype(CPU::DirtyData)::PAGE_SIZE == PAGE_SIZE);
+		static_assert(decltype(CPU::DirtyEEPROM)::PAGE_SIZE == PAGE_SIZE);
+		static_assert(decltype(Memory::Dirty)::PAGE_SIZE == PAGE_SIZE);
+
+		void EncodeDelta(std::vector<Byte>& out, const Byte* current, const Byte* base, size_t size)
+		{
+			size_t i = 0;
+			while (i < size) {
+				size_t run = 0;
+				if (current[i] == base[i]) {
+					while (i + run < size && run < 128 && current[i + run] == base[i + run]) {
+						++run;
+					}
+					out.push_back(0x80 | (Byte)(run - 1));
+				}
+				else {
+					while (i + run < size && run < 128 && current[i + run] != base[i + run]) {
+						++run;
+					}
+					out.push_back((Byte)(run - 1));
+					for (size_t j = i; j < i + run; ++j) {
+						out.push_back(current[j] ^ base[j]);
+					}
+				}
+				i += run;
+			}
+		}
+
+		const Byte* DecodeDelta(const Byte* in, Byte* dest, const Byte* base, size_t size)
+		{
+			size_t i = 0;
+			while (i < size) {
+				Byte token = *in++;
+				size_t run = (token & 0x7F) + 1;
+				if (token & 0x80) {
+					std::memcpy(dest + i, base + i, run);
+				}
+				else {
+					for (size_t j = i; j < i + run; ++j) {
+						dest[j] = base[j] ^ *in++;
+					}
+				}
+				i += run;
+			}
+			return in;
+		}
+
+		void EncodePage(std::vector<Byte>& out, Region region, uint32_t page, const Byte* current, const Byte* base)
+		{
+			out.push_back((Byte)region);
+			out.push_back(page & 0xFF);
+			out.push_back((page >> 8) & 0xFF);
+			EncodeDelta(out, current + page * PAGE_SIZE, base + page * PAGE_SIZE, PAGE_SIZE);
+		}
+
+		// SRAM pages of the data space, everything below is part of the always captured core.
+		template<typename Fn>
+		void ForEachSRAMPage(const CPU& cpu, Fn&& fn)
+		{
+			cpu.DirtyData.ForEach([&](uint32_t page) {
+				if (page * PAGE_SIZE >= CPU::SRAM_START && page * PAGE_SIZE < CPU::DATA_SPACE_SIZE) {
+					fn(page);
+				}
+			});
+		}
+
+	}
+
+	Snapshot Snapshot::Capture(CPU& cpu, Memory& memory)
+	{
+		cpu.DirtyData.Clear();
+		cpu.DirtyEEPROM.Clear();
+		memory.Dirty.Clear();
+
+		Snapshot snapshot;
+		snapshot.State = cpu;
+		snapshot.Flash.assign(memory.Data, memory.Data + Memory::MAX_MEM);
+		return snapshot;
+	}
+
+	void Snapshot::Restore(CPU& cpu, Memory& memory) const
+	{
+		std::memcpy((Byte*)&cpu, (const Byte*)&State, CPU_STATE_SIZE);
+		std::memcpy(memory.Data, Flash.data(), Memory::MAX_MEM);
+		memory.Dirty.Clear();
+	}
+
+	IncrementalSnapshot IncrementalSnapshot::Capture(const Snapshot& base, const CPU& cpu, const Memory& memory)
+	{
+		const Byte* cpuBytes = (const Byte*)&cpu;
+		const Byte* baseBytes = (const Byte*)&base.State;
+
+		IncrementalSnapshot snapshot;
+		EncodeDelta(snapshot.m_Data, cpuBytes, baseBytes, CPU::SRAM_START);
+		EncodeDelta(snapshot.m_Data, cpuBytes + CPU_TAIL_OFFSET, baseBytes + CPU_TAIL_OFFSET, CPU_TAIL_SIZE);
+
+		ForEachSRAMPage(cpu, [&](uint32_t page) {
+			EncodePage(snapshot.m_Data, Region::Data, page, &cpu.R00, &base.State.R00);
+			++snapshot.m_PageCount;
+		});
+
+		cpu.DirtyEEPROM.ForEach([&](uint32_t page) {
+			EncodePage(snapshot.m_Data, Region::EEPROM, page, cpu.EEPROM, base.State.EEPROM);
+			++snapshot.m_PageCount;
+		});
+
+		memory.Dirty.ForEach([&](uint32_t page) {
+			EncodePage(snapshot.m_Data, Region::Flash, page, memory.Data, base.Flash.data());
+			++snapshot.m_PageCount;
+		});
+
+		return snapshot;
+	}
+
+	void IncrementalSnapshot::Restore(const Snapshot& base, CPU& cpu, Memory& memory) const
+	{
+		// Pages written after this snapshot was taken go back to the base first
+		ForEachSRAMPage(cpu, [&](uint32_t page) {
+			std::memcpy(&cpu.R00 + page * PAGE_SIZE, &base.State.R00 + page * PAGE_SIZE, PAGE_SIZE);
+		});
+		cpu.DirtyEEPROM.ForEach([&](uint32_t page) {
+			std::memcpy(cpu.EEPROM + page * PAGE_SIZE, base.State.EEPROM + page * PAGE_SIZE, PAGE_SIZE);
+		});
+		memory.Dirty.ForEach([&](uint32_t page) {
+			std::memcpy(memory.Data + page * PAGE_SIZE, base.Flash.data() + page * PAGE_SIZE, PAGE_SIZE);
+		});
+		memory.Dirty.Clear();
+
+		// The core also brings back the dirty bits as they were at capture
+		Byte* cpuBytes = (Byte*)&cpu;
+		const Byte* baseBytes = (const Byte*)&base.State;
+
+		const Byte* in = m_Data.data();
+		const Byte* end = in + m_Data.size();
+		in = DecodeDelta(in, cpuBytes, baseBytes, CPU::SRAM_START);
+		in = DecodeDelta(in, cpuBytes + CPU_TAIL_OFFSET, baseBytes + CPU_TAIL_OFFSET, CPU_TAIL_SIZE);
+
+		while (in < end) {
+			Region region = (Region)in[0];
+			uint32_t page = in[1] | (in[2] << 8);
+			in += 3;
+
+			switch (region)
+			{
+				case Region::Data:
+					in = DecodeDelta(in, &cpu.R00 + page * PAGE_SIZE, &base.State.R00 + page * PAGE_SIZE, PAGE_SIZE);
+					break;
+				case Region::EEPROM:
+					in = DecodeDelta(in, cpu.EEPROM + page * PAGE_SIZE, base.State.EEPROM + page * PAGE_SIZE, PAGE_SIZE);
+					break;
+				case Region::Flash:
+					in = DecodeDelta(in, memory.Data + page * PAGE_SIZE, base.Flash.data() + page * PAGE_SIZE, PAGE_SIZE);
+					memory.Dirty.Mark(page * PAGE_SIZE);
+					break;
+			}
+		}
+	}
+
+}
@@ -0,0 +1,186 @@
+#include "ATMega328Emulator/Stimulus.h"
+
+#include <stdexcept>
+
+#include "ATMega328Emulator/RegisterHooks.h"
+#include "ATMega328Emulator/StimulusFile.h"
+
+namespace ATMega328Emulator {
+
+	namespace {
+
+		// Data space addresses
+		constexpr Word PINB_ADDRESS = 0x23;
+		constexpr Word PINC_ADDRESS = 0x26;
+		constexpr Word PIND_ADDRESS = 0x29;
+		constexpr Word ADCL_ADDRESS = 0x78;
+		constexpr Word ADCH_ADDRESS = 0x79;
+		constexpr Word ADCSRA_ADDRESS = 0x7A;
+		constexpr Word UCSR0A_ADDRESS = 0xC0;
+		constexpr Word UDR0_ADDRESS = 0xC6;
+
+		constexpr Byte RXC0 = 1 << 7; // UCSR0A - USART Receive Complete
+		constexpr Byte ADSC = 1 << 6; // ADCSRA - ADC Start Conversion
+		constexpr Byte ADIF = 1 << 4; // ADCSRA - ADC Interrupt Flag
+		constexpr Byte ADLAR = 1 << 5; // ADMUX - ADC Left Adjust Result
+
+	}
+
+	void Stimulus::Apply(CPU& cpu) const
+	{
+		switch (Type)
+		{
+			case StimulusType::PINB: cpu.WriteData(PINB_ADDRESS, (Byte)Value); break;
+			case StimulusType::PINC: cpu.WriteData(PINC_ADDRESS, (Byte)Value); break;
+			case StimulusType::PIND: cpu.WriteData(PIND_ADDRESS, (Byte)Value); break;
+			case StimulusType::UDR0:
+			{
+				// A peripheral that owns UDR0, like USART, would overwrite the register and RXC0
+				if (RegisterHook* hook = cpu.AttachedRegisterHooks ? cpu.AttachedRegisterHooks->Get(UDR0_ADDRESS) : nullptr) {
+					if (!hook->OnInput(cpu, UDR0_ADDRESS, (Byte)Value)) {
+						throw std::invalid_argument("UDR0 is hooked by a peripheral that takes no stimuli");
+					}
+					break;
+				}
+
+				cpu.WriteData(UDR0_ADDRESS, (Byte)Value);
+				cpu.WriteData(UCSR0A_ADDRESS, cpu.EXIO.UCSR0A | RXC0);
+				break;
+			}
+			case StimulusType::ADC:
+			{
+				Word result = Value & 0x3FF;
+				if (cpu.EXIO.ADMUX & ADLAR) {
+					result <<= 6;
+				}
+
+				cpu.WriteData(ADCL_ADDRESS, result & 0xFF);
+				cpu.WriteData(ADCH_ADDRESS, result >> 8);
+				cpu.WriteData(ADCSRA_ADDRESS, (cpu.EXIO.ADCSRA & ~ADSC) | ADIF);
+				break;
+			}
+			default: break;
+		}
+	}
+
+	namespace StimulusEncoding {
+
+		uint64_t Encode(std::vector<Byte>& out, const Stimulus& stimulus, uint64_t previousCycle)
+		{
+			uint64_t delta = stimulus.Cycle - previousCycle;
+			do {
+				Byte b = delta & 0x7F;
+				delta >>= 7;
+				out.push_back(delta ? (b | 0x80) : b);
+			} while (delta);
+
+			out.push_back((Byte)stimulus.Type);
+			out.push_back(stimulus.Value & 0xFF);
+			if (stimulus.Type == StimulusType::ADC) {
+				out.push_back(stimulus.Value >> 8);
+			}
+
+			return stimulus.Cycle;
+		}
+
+		const Byte* Decode(const Byte* in, const Byte* end, Stimulus& stimulus, uint64_t previousCycle)
+		{
+			uint64_t delta = 0;
+			for (int shift = 0;; shift += 7) {
+				if (in == end || shift > 63) {
+					return nullptr;
+				}
+
+				Byte b = *in++;
+				delta |= (uint64_t)(b & 0x7F) << shift;
+				if (!(b & 0x80)) {
+					break;
+				}
+			}
+
+			if (in == end || *in >= (Byte)StimulusType::Count) {
+				return nullptr;
+			}
+			stimulus.Type = (StimulusType)*in++;
+
+			size_t valueSize = stimulus.Type == StimulusType::ADC ? 2 : 1;
+			if ((size_t)(end - in) < valueSize) {
+				return nullptr;
+			}
+
+			stimulus.Value = in[0];
+			if (valueSize == 2) {
+				stimulus.Value |= in[1] << 8;
+			}
+			in += valueSize;
+
+			stimulus.Cycle = previousCycle + delta;
+			return in;
+		}
+
+	}
+
+	void StimulusRecorder::Inject(CPU& cpu, StimulusType type, Word value)
+	{
+		Stimulus stimulus = { cpu.CycleCount, type, value };
+		stimulus.Apply(cpu);
+
+		m_LastCycle = StimulusEncoding::Encode(m_Log, stimulus, m_LastCycle);
+		++m_Count;
+	}
+
+	bool StimulusRecorder::Save(const std::string& filepath) const
+	{
+		StimulusFileWriter writer;
+		if (!writer.Open(filepath)) {
+			return false;
+		}
+
+		writer.WriteEncoded(m_Log.data(), m_Log.size(), m_LastCycle);
+		return writer.Close();
+	}
+
+	StimulusReplayer::StimulusReplayer(const Byte* log, size_t size, uint64_t startCycle)
+		: m_Cursor(log), m_End(log + size)
+	{
+		m_Next.Cycle = startCycle;
+		decodeNext();
+	}
+
+	StimulusReplayer::StimulusReplayer(const std::vector<Byte>& log)
+		: StimulusReplayer(log.data(), log.size())
+	{
+	}
+
+	uint64_t StimulusReplayer::GetNextEventCycle() const
+	{
+		return m_HasNext ? m_Next.Cycle : NO_EVENT;
+	}
+
+	void StimulusReplayer::HandleEvents(CPU& cpu, Memory&)
+	{
+		while (m_HasNext && m_Next.Cycle <= cpu.CycleCount) {
+			m_Next.Apply(cpu);
+			decodeNext();
+		}
+	}
+
+	void StimulusReplayer::decodeNext()
+	{
+		m_HasNext = false;
+		if (m_Cursor == m_End) {
+			return;
+		}
+
+		const Byte* next = StimulusEncoding::Decode(m_Cursor, m_End, m_Next, m_Next.Cycle);
+		if (!next) {
+			m_Valid = false;
+			m_Cursor = m_End;
+			return;
+		}
+
+		m_Cursor = next;
+		m_HasNext = true;
+	}
+
+}
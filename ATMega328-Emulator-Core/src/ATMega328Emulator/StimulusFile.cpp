@@ -0,0 +1,216 @@
+#include "ATMega328Emulator/StimulusFile.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace ATMega328Emulator {
+
+	namespace {
+
+		constexpr size_t WRITE_BUFFER_SIZE = 64 * 1024;
+		constexpr size_t RELEASE_GRANULARITY = 16 * 1024 * 1024;
+
+	}
+
+	StimulusFileWriter::~StimulusFileWriter()
+	{
+		Close();
+	}
+
+	bool StimulusFileWriter::Open(const std::string& filepath, uint64_t startCycle)
+	{
+		Close();
+
+		m_Stream.open(filepath, std::ios::binary | std::ios::trunc);
+		if (!m_Stream) {
+			return false;
+		}
+
+		Byte header[StimulusFileFormat::HEADER_SIZE] = {};
+		std::memcpy(header, StimulusFileFormat::MAGIC, sizeof(StimulusFileFormat::MAGIC));
+		header[4] = StimulusFileFormat::VERSION & 0xFF;
+		header[5] = StimulusFileFormat::VERSION >> 8;
+		for (int i = 0; i < 8; ++i) {
+			header[8 + i] = (startCycle >> (i * 8)) & 0xFF;
+		}
+
+		m_Stream.write((const char*)header, sizeof(header));
+		m_LastCycle = startCycle;
+		return (bool)m_Stream;
+	}
+
+	bool StimulusFileWriter::Close()
+	{
+		if (!m_Stream.is_open()) {
+			return true;
+		}
+
+		flush();
+		m_Stream.close();
+		return m_Stream.good();
+	}
+
+	void StimulusFileWriter::Write(const Stimulus& stimulus)
+	{
+		m_LastCycle = StimulusEncoding::Encode(m_Buffer, stimulus, m_LastCycle);
+		if (m_Buffer.size() >= WRITE_BUFFER_SIZE) {
+			flush();
+		}
+	}
+
+	void StimulusFileWriter::WriteEncoded(const Byte* records, size_t size, uint64_t lastCycle)
+	{
+		flush();
+		m_Stream.write((const char*)records, size);
+		m_LastCycle = lastCycle;
+	}
+
+	void StimulusFileWriter::flush()
+	{
+		m_Stream.write((const char*)m_Buffer.data(), m_Buffer.size());
+		m_Buffer.clear();
+	}
+
+	StimulusFile::~StimulusFile()
+	{
+		Close();
+	}
+
+	bool StimulusFile::Open(const std::string& filepath)
+	{
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || (size_t)size.QuadPart < StimulusFileFormat::HEADER_SIZE) {
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (!data) {
+			if (mapping) {
+				CloseHandle(mapping);
+			}
+			CloseHandle(file);
+			return false;
+		}
+
+		m_FileHandle = file;
+		m_MappingHandle = mapping;
+		m_Size = (size_t)size.QuadPart;
+#else
+		int fd = open(filepath.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || (size_t)info.st_size < StimulusFileFormat::HEADER_SIZE) {
+			close(fd);
+			return false;
+		}
+
+		void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd); // The mapping keeps the file alive
+		if (data == MAP_FAILED) {
+			return false;
+		}
+
+		madvise(data, info.st_size, MADV_SEQUENTIAL);
+		m_Size = (size_t)info.st_size;
+#endif
+
+		m_Data = (const Byte*)data;
+		m_Released = m_Data;
+
+		if (std::memcmp(m_Data, StimulusFileFormat::MAGIC, sizeof(StimulusFileFormat::MAGIC)) != 0
+			|| (m_Data[4] | (m_Data[5] << 8)) != StimulusFileFormat::VERSION) {
+			Close();
+			return false;
+		}
+
+		m_StartCycle = 0;
+		for (int i = 0; i < 8; ++i) {
+			m_StartCycle |= (uint64_t)m_Data[8 + i] << (i * 8);
+		}
+
+		const size_t headerSize = StimulusFileFormat::HEADER_SIZE;
+		m_Replayer = std::make_unique<StimulusReplayer>(m_Data + headerSize, m_Size - headerSize, m_StartCycle);
+		return true;
+	}
+
+	void StimulusFile::Close()
+	{
+		m_Replayer.reset();
+
+		if (!m_Data) {
+			return;
+		}
+
+#ifdef _WIN32
+		UnmapViewOfFile(m_Data);
+		CloseHandle(m_MappingHandle);
+		CloseHandle(m_FileHandle);
+		m_MappingHandle = nullptr;
+		m_FileHandle = nullptr;
+#else
+		munmap((void*)m_Data, m_Size);
+#endif
+
+		m_Data = nullptr;
+		m_Released = nullptr;
+		m_Size = 0;
+	}
+
+	uint64_t StimulusFile::GetNextEventCycle() const
+	{
+		return m_Replayer ? m_Replayer->GetNextEventCycle() : NO_EVENT;
+	}
+
+	void StimulusFile::HandleEvents(CPU& cpu, Memory& memory)
+	{
+		if (!m_Replayer) {
+			return;
+		}
+
+		m_Replayer->HandleEvents(cpu, memory);
+		releaseConsumed();
+	}
+
+	void StimulusFile::releaseConsumed()
+	{
+		if ((size_t)(m_Replayer->GetPosition() - m_Released) < RELEASE_GRANULARITY) {
+			return;
+		}
+
+#ifndef _WIN32
+		// Only whole pages before the record being decoded can go
+		const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+		const Byte* end = m_Data + ((m_Replayer->GetPosition() - m_Data) / pageSize) * pageSize;
+
+		madvise((void*)m_Released, end - m_Released, MADV_DONTNEED);
+		m_Released = end;
+#else
+		// Read only file backed views are trimmed from the working set by the OS on its own
+		m_Released = m_Replayer->GetPosition();
+#endif
+	}
+
+}
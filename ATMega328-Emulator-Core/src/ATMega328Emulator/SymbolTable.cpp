@@ -0,0 +1,141 @@
+#include "ATMega328Emulator/SymbolTable.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace ATMega328Emulator {
+
+	namespace {
+
+		// ELF32 offsets and values, see the System V ABI
+		constexpr size_t EHDR_SIZE = 52;
+		constexpr size_t EHDR_SHOFF = 0x20;
+		constexpr size_t EHDR_SHENTSIZE = 0x2E;
+		constexpr size_t EHDR_SHNUM = 0x30;
+
+		constexpr size_t SHDR_SIZE = 40;
+		constexpr size_t SHDR_TYPE = 4;
+		constexpr size_t SHDR_OFFSET = 16;
+		constexpr size_t SHDR_SIZE_FIELD = 20;
+		constexpr size_t SHDR_LINK = 24;
+		constexpr size_t SHDR_ENTSIZE = 36;
+		constexpr uint32_t SHT_SYMTAB = 2;
+
+		constexpr size_t SYM_SIZE = 16;
+		constexpr size_t SYM_NAME = 0;
+		constexpr size_t SYM_VALUE = 4;
+		constexpr size_t SYM_SIZE_FIELD = 8;
+		constexpr size_t SYM_INFO = 12;
+		constexpr Byte STT_FUNC = 2;
+
+		// avr-gcc puts the data space at 0x800000 and up, flash is below
+		constexpr uint32_t AVR_DATA_OFFSET = 0x800000;
+
+		uint16_t Read16(const Byte* data) { return data[0] | (data[1] << 8); }
+		uint32_t Read32(const Byte* data) { return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24); }
+
+	}
+
+	bool SymbolTable::LoadElf(const std::string& filepath)
+	{
+		std::ifstream file(filepath, std::ios::binary);
+		if (!file) {
+			return false;
+		}
+
+		std::vector<Byte> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		return LoadElf(data.data(), data.size());
+	}
+
+	bool SymbolTable::LoadElf(const Byte* data, size_t size)
+	{
+		// Magic, ELFCLASS32, ELFDATA2LSB
+		if (size < EHDR_SIZE || std::memcmp(data, "\x7F" "ELF", 4) != 0 || data[4] != 1 || data[5] != 1) {
+			return false;
+		}
+
+		const uint32_t shoff = Read32(data + EHDR_SHOFF);
+		const uint16_t shentsize = Read16(data + EHDR_SHENTSIZE);
+		const uint16_t shnum = Read16(data + EHDR_SHNUM);
+		if (shentsize < SHDR_SIZE || shoff > size || (size_t)shnum * shentsize > size - shoff) {
+			return false;
+		}
+
+		auto section = [&](uint32_t index) { return data + shoff + (size_t)index * shentsize; };
+
+		bool found = false;
+		for (uint32_t i = 0; i < shnum; ++i) {
+			const Byte* symtab = section(i);
+			if (Read32(symtab + SHDR_TYPE) != SHT_SYMTAB) {
+				continue;
+			}
+
+			const uint32_t link = Read32(symtab + SHDR_LINK);
+			if (link >= shnum) {
+				return false;
+			}
+
+			const Byte* strtab = section(link);
+			const uint32_t symOffset = Read32(symtab + SHDR_OFFSET);
+			const uint32_t symSize = Read32(symtab + SHDR_SIZE_FIELD);
+			const uint32_t symEntSize = std::max<uint32_t>(Read32(symtab + SHDR_ENTSIZE), SYM_SIZE);
+			const uint32_t strOffset = Read32(strtab + SHDR_OFFSET);
+			const uint32_t strSize = Read32(strtab + SHDR_SIZE_FIELD);
+			if (symOffset > size || symSize > size - symOffset || strOffset > size || strSize > size - strOffset) {
+				return false;
+			}
+
+			for (uint32_t offset = 0; offset + SYM_SIZE <= symSize; offset += symEntSize) {
+				const Byte* symbol = data + symOffset + offset;
+				const uint32_t value = Read32(symbol + SYM_VALUE);
+				const uint32_t name = Read32(symbol + SYM_NAME);
+				if ((symbol[SYM_INFO] & 0xF) != STT_FUNC || value >= AVR_DATA_OFFSET || name >= strSize) {
+					continue;
+				}
+
+				const char* begin = (const char*)data + strOffset + name;
+				Add(value, Read32(symbol + SYM_SIZE_FIELD), std::string(begin, strnlen(begin, strSize - name)));
+			}
+			found = true;
+		}
+
+		return found;
+	}
+
+	void SymbolTable::Add(uint32_t address, uint32_t size, std::string name)
+	{
+		auto it = std::upper_bound(m_Symbols.begin(), m_Symbols.end(), address,
+			[](uint32_t value, const Symbol& symbol) { return value < symbol.Address; });
+		m_Symbols.insert(it, { address, size, std::move(name) });
+	}
+
+	const SymbolTable::Symbol* SymbolTable::Find(uint32_t address) const
+	{
+		auto it = std::upper_bound(m_Symbols.begin(), m_Symbols.end(), address,
+			[](uint32_t value, const Symbol& symbol) { return value < symbol.Address; });
+		if (it == m_Symbols.begin()) {
+			return nullptr;
+		}
+
+		const Symbol& symbol = *--it;
+		if (symbol.Size && address >= symbol.Address + symbol.Size) {
+			return nullptr;
+		}
+		return &symbol;
+	}
+
+	std::string SymbolTable::GetName(uint32_t address) const
+	{
+		if (const Symbol* symbol = Find(address)) {
+			return symbol->Name;
+		}
+
+		char name[16];
+		std::snprintf(name, sizeof(name), "0x%04X", address);
+		return name;
+	}
+
+}
@@ -0,0 +1,194 @@
+#include "ATMega328Emulator/Trace.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+
+namespace ATMega328Emulator {
+
+	static_assert(std::endian::native == std::endian::little, "Records are written to disk as they are in memory");
+
+	TraceRecorder::TraceRecorder(size_t capacity)
+		: m_Capacity(std::bit_ceil(std::max<size_t>(capacity, PUBLISH_BATCH))), m_Mask(m_Capacity - 1),
+		m_Ring(new uint64_t[m_Capacity])
+	{
+	}
+
+	TraceRecorder::~TraceRecorder()
+	{
+		Close();
+	}
+
+	bool TraceRecorder::Open(const std::string& filepath, uint64_t startCycle)
+	{
+		Close();
+
+		m_Stream.open(filepath, std::ios::binary | std::ios::trunc);
+		if (!m_Stream) {
+			return false;
+		}
+
+		Byte header[TraceFormat::HEADER_SIZE] = {};
+		std::memcpy(header, TraceFormat::MAGIC, sizeof(TraceFormat::MAGIC));
+		header[4] = TraceFormat::VERSION & 0xFF;
+		header[5] = TraceFormat::VERSION >> 8;
+		header[6] = TraceFormat::RECORD_SIZE & 0xFF;
+		header[7] = TraceFormat::RECORD_SIZE >> 8;
+		for (int i = 0; i < 8; ++i) {
+			header[8 + i] = (startCycle >> (i * 8)) & 0xFF;
+		}
+		m_Stream.write((const char*)header, sizeof(header));
+
+		m_Head = m_CachedTail = 0;
+		m_Records = 0;
+		m_LastCycle = startCycle;
+		m_PublishedHead.store(0, std::memory_order_relaxed);
+		m_Tail.store(0, std::memory_order_relaxed);
+		m_Stopping.store(false, std::memory_order_relaxed);
+
+		m_Writer = std::thread(&TraceRecorder::writerLoop, this);
+		return (bool)m_Stream;
+	}
+
+	bool TraceRecorder::Close()
+	{
+		if (m_Writer.joinable()) {
+			m_PublishedHead.store(m_Head, std::memory_order_release);
+			m_Stopping.store(true, std::memory_order_release);
+			m_Writer.join();
+		}
+		if (!m_Stream.is_open()) {
+			return true;
+		}
+
+		m_Stream.close();
+		return m_Stream.good();
+	}
+
+	void TraceRecorder::waitForSpace()
+	{
+		// The writer only sees published records, so the ring could never drain otherwise
+		m_PublishedHead.store(m_Head, std::memory_order_release);
+
+		while (m_Head - (m_CachedTail = m_Tail.load(std::memory_order_acquire)) == m_Capacity) {
+			std::this_thread::yield();
+		}
+	}
+
+	void TraceRecorder::writerLoop()
+	{
+		uint64_t tail = 0;
+		while (true) {
+			// Stopping is looked at first, so the head read after it is the final one
+			const bool stopping = m_Stopping.load(std::memory_order_acquire);
+			const uint64_t head = m_PublishedHead.load(std::memory_order_acquire);
+
+			if (head == tail) {
+				if (stopping) {
+					break;
+				}
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+				continue;
+			}
+
+			// At most two writes, the ring may wrap
+			while (tail != head) {
+				const size_t start = tail & m_Mask;
+				const size_t count = (size_t)std::min<uint64_t>(head - tail, m_Capacity - start);
+				m_Stream.write((const char*)&m_Ring[start], count * TraceFormat::RECORD_SIZE);
+				tail += count;
+			}
+			m_Tail.store(tail, std::memory_order_release);
+		}
+
+		m_Stream.flush();
+	}
+
+	bool TraceReader::Open(const std::string& filepath)
+	{
+		m_Stream.open(filepath, std::ios::binary);
+		if (!m_Stream) {
+			return false;
+		}
+
+		Byte header[TraceFormat::HEADER_SIZE];
+		if (!m_Stream.read((char*)header, sizeof(header)) || std::memcmp(header, TraceFormat::MAGIC, sizeof(TraceFormat::MAGIC)) != 0) {
+			return false;
+		}
+
+		const uint16_t version = header[4] | (header[5] << 8);
+		const uint16_t recordSize = header[6] | (header[7] << 8);
+		if (version != TraceFormat::VERSION || recordSize != TraceFormat::RECORD_SIZE) {
+			return false;
+		}
+
+		m_StartCycle = 0;
+		for (int i = 0; i < 8; ++i) {
+			m_StartCycle |= (uint64_t)header[8 + i] << (i * 8);
+		}
+		m_Cycle = m_StartCycle;
+		m_HasPending = false;
+		return true;
+	}
+
+	bool TraceReader::Next(TraceEntry& entry)
+	{
+		uint64_t record;
+		while (true) {
+			if (!read(record)) {
+				return false;
+			}
+			if ((record & 0xFF) != TraceFormat::ESCAPE) {
+				break;
+			}
+
+			// A stray operand without its instruction is skipped
+			if (((record >> 8) & 0xFF) == TraceFormat::ESCAPE_CYCLES) {
+				m_Cycle += record >> 16;
+			}
+		}
+
+		m_Cycle += record & 0xFF;
+		entry.Cycle = m_Cycle;
+		entry.Register = (record >> 8) & 0xFF;
+		entry.PC = (record >> 16) & 0xFFFF;
+		entry.Instruction = (record >> 32) & 0xFFFF;
+		entry.Value = (record >> 48) & 0xFF;
+		entry.SREGDelta = (record >> 56) & 0xFF;
+		entry.Operand = 0;
+
+		// The operand of a 32-bit instruction follows it
+		uint64_t next;
+		if (read(next)) {
+			if ((next & 0xFF) == TraceFormat::ESCAPE && ((next >> 8) & 0xFF) == TraceFormat::ESCAPE_OPERAND) {
+				entry.Operand = (next >> 16) & 0xFFFF;
+			}
+			else {
+				m_Pending = next;
+				m_HasPending = true;
+			}
+		}
+		return true;
+	}
+
+	bool TraceReader::read(uint64_t& record)
+	{
+		if (m_HasPending) {
+			m_HasPending = false;
+			record = m_Pending;
+			return true;
+		}
+
+		Byte data[TraceFormat::RECORD_SIZE];
+		if (!m_Stream.read((char*)data, sizeof(data))) {
+			return false;
+		}
+
+		record = 0;
+		for (int i = 0; i < 8; ++i) {
+			record |= (uint64_t)data[i] << (i * 8);
+		}
+		return true;
+	}
+
+}
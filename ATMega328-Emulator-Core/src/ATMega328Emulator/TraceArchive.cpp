@@ -0,0 +1,657 @@
+#include "ATMega328Emulator/TraceArchive.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ATMega328Emulator {
+
+	using namespace TraceArchiveFormat;
+
+	namespace {
+
+		constexpr size_t FLASH_WORDS = CPU::FLASH_SIZE / 2;
+		constexpr Word NO_INSTRUCTION = 0xFFFF;
+
+		void Put16(std::vector<Byte>& out, uint16_t value)
+		{
+			out.push_back(value & 0xFF);
+			out.push_back(value >> 8);
+		}
+
+		void Put(Byte* out, uint64_t value, int size)
+		{
+			for (int i = 0; i < size; ++i) {
+				out[i] = (value >> (i * 8)) & 0xFF;
+			}
+		}
+
+		uint64_t Get(const Byte* data, int size)
+		{
+			uint64_t value = 0;
+			for (int i = 0; i < size; ++i) {
+				value |= (uint64_t)data[i] << (i * 8);
+			}
+			return value;
+		}
+
+		void PutLEB128(std::vector<Byte>& out, uint64_t value)
+		{
+			do {
+				Byte b = value & 0x7F;
+				value >>= 7;
+				out.push_back(value ? (b | 0x80) : b);
+			} while (value);
+		}
+
+		// Appends the registers that differ between from and to as a count and register, value pairs.
+		// Usually one register changes, MUL, MOVW and ADIW change two. Returns false if none did.
+		bool PutRegisterChanges(std::vector<Byte>& out, const TraceState& from, const TraceState& to)
+		{
+			Byte changes[64];
+			int changeCount = 0;
+			for (int i = 0; i < 4; ++i) {
+				for (uint64_t bits = from.Registers[i] ^ to.Registers[i]; bits; bits &= ~(0xFFull << (std::countr_zero(bits) & ~7))) {
+					const Byte reg = (Byte)(i * 8 + std::countr_zero(bits) / 8);
+					changes[changeCount++] = reg;
+					changes[changeCount++] = (Byte)(to.Registers[i] >> (reg % 8 * 8));
+				}
+			}
+			if (!changeCount) {
+				return false;
+			}
+
+			out.push_back((Byte)(changeCount / 2));
+			out.insert(out.end(), changes, changes + changeCount);
+			return true;
+		}
+
+		void SerializeChunk(const Chunk& chunk, Byte* out)
+		{
+			std::memset(out, 0, INDEX_ENTRY_SIZE);
+			Put(out + 0x00, chunk.Offset, 8);
+			Put(out + 0x08, chunk.KeyframeCycle, 8);
+			Put(out + 0x10, chunk.LastCycle, 8);
+			Put(out + 0x18, chunk.Records, 4);
+			Put(out + 0x1C, chunk.KeyframePC, 2);
+			std::memcpy(out + 0x20, chunk.PCs.data(), PC_BITMAP_SIZE);
+		}
+
+		Chunk DeserializeChunk(const Byte* data)
+		{
+			Chunk chunk;
+			chunk.Offset = Get(data + 0x00, 8);
+			chunk.KeyframeCycle = Get(data + 0x08, 8);
+			chunk.LastCycle = Get(data + 0x10, 8);
+			chunk.Records = (uint32_t)Get(data + 0x18, 4);
+			chunk.KeyframePC = (Word)Get(data + 0x1C, 2);
+			std::memcpy(chunk.PCs.data(), data + 0x20, PC_BITMAP_SIZE);
+			return chunk;
+		}
+
+	}
+
+	TraceArchiveWriter::~TraceArchiveWriter()
+	{
+		Close();
+	}
+
+	bool TraceArchiveWriter::Open(const std::string& filepath, const CPU& cpu, uint32_t chunkRecords)
+	{
+		Close();
+
+		m_Stream.open(filepath, std::ios::binary | std::ios::trunc);
+		if (!m_Stream) {
+			return false;
+		}
+
+		Byte header[HEADER_SIZE] = {};
+		std::memcpy(header, MAGIC, sizeof(MAGIC));
+		Put(header + 4, VERSION, 2);
+		m_Stream.write((const char*)header, sizeof(header));
+
+		m_Offset = HEADER_SIZE;
+		m_ChunkRecords = std::max<uint32_t>(chunkRecords, 1);
+		m_TotalRecords = 0;
+		m_Index.clear();
+
+		if (!m_Instructions) {
+			m_Instructions.reset(new Word[FLASH_WORDS]);
+			m_Operands.reset(new Word[FLASH_WORDS]);
+			m_Successors.reset(new Word[FLASH_WORDS + 1]);
+		}
+
+		beginChunk(cpu, cpu.CycleCount);
+		return (bool)m_Stream;
+	}
+
+	bool TraceArchiveWriter::Close()
+	{
+		if (!m_Stream.is_open()) {
+			return true;
+		}
+
+		if (m_Chunk.Records) {
+			writeChunk();
+		}
+
+		const uint64_t indexOffset = m_Offset;
+		std::vector<Byte> index(m_Index.size() * INDEX_ENTRY_SIZE);
+		for (size_t i = 0; i < m_Index.size(); ++i) {
+			SerializeChunk(m_Index[i], index.data() + i * INDEX_ENTRY_SIZE);
+		}
+		m_Stream.write((const char*)index.data(), index.size());
+
+		Byte footer[FOOTER_SIZE];
+		Put(footer, indexOffset, 8);
+		Put(footer + 8, m_Index.size(), 4);
+		std::memcpy(footer + 12, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+		m_Stream.write((const char*)footer, sizeof(footer));
+
+		m_Stream.close();
+		return m_Stream.good();
+	}
+
+	void TraceArchiveWriter::Record(const CPU& cpu, Memory& memory, Word pc, Word instruction, uint64_t cycle, const TraceState& before)
+	{
+		// The tables are only there once an Open succeeded
+		if (!IsOpen()) [[unlikely]] {
+			return;
+		}
+
+		recordGap(pc, before);
+
+		const size_t flagsAt = m_Data.size();
+		m_Data.push_back(0);
+		Byte flags = 0;
+
+		const uint64_t delta = cycle - m_LastCycle;
+		m_LastCycle = cycle;
+		if (delta >= CYCLE_ESCAPE) {
+			flags |= CYCLE_ESCAPE << CYCLE_SHIFT;
+			PutLEB128(m_Data, delta);
+		}
+		else {
+			flags |= (Byte)delta << CYCLE_SHIFT;
+		}
+
+		const size_t slot = pc & (FLASH_WORDS - 1);
+
+		// Where the previous instruction went last time, or the next one in flash
+		const Word predicted = m_Successors[m_PreviousSlot] != NO_INSTRUCTION ? m_Successors[m_PreviousSlot] : m_NextPC;
+		if (pc != predicted) {
+			flags |= FLAG_PC;
+			Put16(m_Data, pc);
+		}
+		m_Successors[m_PreviousSlot] = pc;
+		m_PreviousSlot = slot;
+
+		const bool twoWord = Timing::IsTwoWord(instruction);
+		const Word operand = twoWord ? memory[(pc + 1) * 2] | (memory[(pc + 1) * 2 + 1] << 8) : 0;
+		if (m_Instructions[slot] != instruction || (twoWord && m_Operands[slot] != operand)) {
+			flags |= FLAG_INSTRUCTION;
+			Put16(m_Data, instruction);
+			if (twoWord) {
+				Put16(m_Data, operand);
+			}
+			m_Instructions[slot] = instruction;
+			m_Operands[slot] = operand;
+		}
+
+		TraceState after;
+		after.Capture(cpu);
+
+		if (PutRegisterChanges(m_Data, before, after)) {
+			flags |= FLAG_REGISTERS;
+		}
+
+		if (after.SREG != before.SREG) {
+			flags |= FLAG_SREG;
+			m_Data.push_back(after.SREG ^ before.SREG);
+		}
+
+		if (after.SP != before.SP) {
+			flags |= FLAG_SP;
+			Put16(m_Data, after.SP);
+		}
+
+		m_Data[flagsAt] = flags;
+		m_NextPC = pc + (twoWord ? 2 : 1);
+		m_After = after;
+		m_AfterPC = cpu.PC;
+
+		const size_t bit = slot / PC_BITMAP_GRANULE;
+		m_Chunk.PCs[bit / 8] |= 1 << (bit % 8);
+		m_Chunk.LastCycle = cycle;
+		++m_Chunk.Records;
+		++m_TotalRecords;
+
+		// The next chunk starts with the state this instruction left behind
+		if (m_Chunk.Records == m_ChunkRecords) {
+			writeChunk();
+			beginChunk(cpu, cycle);
+		}
+	}
+
+	void TraceArchiveWriter::beginChunk(const CPU& cpu, uint64_t cycle)
+	{
+		m_Chunk = {};
+		m_Chunk.Offset = m_Offset;
+		m_Chunk.KeyframeCycle = m_Chunk.LastCycle = cycle;
+		m_Chunk.KeyframePC = cpu.PC;
+
+		m_Keyframe.assign(&cpu.R00, &cpu.R00 + CPU::DATA_SPACE_SIZE);
+		m_Data.clear();
+		m_LastCycle = cycle;
+		m_NextPC = cpu.PC;
+		m_PreviousSlot = FLASH_WORDS;
+		m_After.Capture(cpu);
+		m_AfterPC = cpu.PC;
+		std::fill_n(m_Instructions.get(), FLASH_WORDS, NO_INSTRUCTION);
+		std::fill_n(m_Operands.get(), FLASH_WORDS, 0);
+		std::fill_n(m_Successors.get(), FLASH_WORDS + 1, NO_INSTRUCTION);
+	}
+
+	void TraceArchiveWriter::recordGap(Word pc, const TraceState& before)
+	{
+		const bool pcMoved = pc != m_AfterPC;
+		const bool registersChanged = std::memcmp(before.Registers, m_After.Registers, sizeof(before.Registers)) != 0;
+		if (!pcMoved && !registersChanged && before.SREG == m_After.SREG && before.SP == m_After.SP) {
+			return;
+		}
+
+		const size_t flagsAt = m_Data.size();
+		m_Data.push_back(0);
+		Byte flags = CYCLE_GAP << CYCLE_SHIFT;
+
+		if (pcMoved) {
+			flags |= FLAG_PC;
+			Put16(m_Data, m_AfterPC);
+		}
+
+		if (registersChanged) {
+			flags |= FLAG_REGISTERS;
+			PutRegisterChanges(m_Data, m_After, before);
+		}
+
+		if (before.SREG != m_After.SREG) {
+			flags |= FLAG_SREG;
+			m_Data.push_back(before.SREG);
+		}
+
+		if (before.SP != m_After.SP) {
+			flags |= FLAG_SP;
+			Put16(m_Data, before.SP);
+		}
+
+		m_Data[flagsAt] = flags;
+	}
+
+	void TraceArchiveWriter::writeChunk()
+	{
+		Byte header[18];
+		Put(header, m_Chunk.Records, 4);
+		Put(header + 4, m_Data.size(), 4);
+		Put(header + 8, m_Chunk.KeyframeCycle, 8);
+		Put(header + 16, m_Chunk.KeyframePC, 2);
+
+		m_Stream.write((const char*)header, sizeof(header));
+		m_Stream.write((const char*)m_Keyframe.data(), m_Keyframe.size());
+		m_Stream.write((const char*)m_Data.data(), m_Data.size());
+
+		m_Offset += CHUNK_HEADER_SIZE + m_Data.size();
+		m_Index.push_back(m_Chunk);
+	}
+
+	bool TraceArchive::Open(const std::string& filepath)
+	{
+		m_Index.clear();
+		m_Stream.close();
+		m_Stream.open(filepath, std::ios::binary);
+		if (!m_Stream) {
+			return false;
+		}
+
+		Byte header[HEADER_SIZE];
+		if (!m_Stream.read((char*)header, sizeof(header))
+			|| std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0 || Get(header + 4, 2) != VERSION) {
+			return false;
+		}
+
+		// A missing footer means the writer never closed the archive
+		Byte footer[FOOTER_SIZE];
+		m_Stream.seekg(-(std::streamoff)FOOTER_SIZE, std::ios::end);
+		if (!m_Stream.read((char*)footer, sizeof(footer)) || std::memcmp(footer + 12, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+			return false;
+		}
+
+		const uint64_t indexOffset = Get(footer, 8);
+		const uint32_t chunks = (uint32_t)Get(footer + 8, 4);
+
+		std::vector<Byte> index((size_t)chunks * INDEX_ENTRY_SIZE);
+		m_Stream.seekg((std::streamoff)indexOffset);
+		if (!m_Stream.read((char*)index.data(), index.size())) {
+			return false;
+		}
+
+		m_Index.reserve(chunks);
+		for (uint32_t i = 0; i < chunks; ++i) {
+			m_Index.push_back(DeserializeChunk(index.data() + (size_t)i * INDEX_ENTRY_SIZE));
+		}
+
+		if (!m_Instructions) {
+			m_Instructions.reset(new Word[FLASH_WORDS]);
+			m_Operands.reset(new Word[FLASH_WORDS]);
+			m_Successors.reset(new Word[FLASH_WORDS + 1]);
+		}
+		return true;
+	}
+
+	uint64_t TraceArchive::GetRecordCount() const
+	{
+		uint64_t records = 0;
+		for (const Chunk& chunk : m_Index) {
+			records += chunk.Records;
+		}
+		return records;
+	}
+
+	uint64_t TraceArchive::GetFirstCycle() const
+	{
+		return m_Index.empty() ? 0 : m_Index.front().KeyframeCycle;
+	}
+
+	uint64_t TraceArchive::GetLastCycle() const
+	{
+		return m_Index.empty() ? 0 : m_Index.back().LastCycle;
+	}
+
+	void TraceArchive::ForEach(uint64_t fromCycle, uint64_t toCycle, const std::function<bool(const TraceEntry&)>& callback)
+	{
+		bool more = true;
+		for (size_t i = findChunk(fromCycle); more && i < m_Index.size() && m_Index[i].KeyframeCycle <= toCycle; ++i) {
+			decodeChunk(i, nullptr, [&](const TraceEntry& entry, const Changes&) {
+				if (entry.Cycle > toCycle) {
+					return false;
+				}
+				if (entry.Cycle >= fromCycle) {
+					more = callback(entry);
+				}
+				return more;
+			});
+		}
+	}
+
+	std::vector<TraceEntry> TraceArchive::FindVisits(Word pc, uint64_t fromCycle, uint64_t toCycle, size_t maxResults)
+	{
+		std::vector<TraceEntry> visits;
+		for (size_t i = findChunk(fromCycle); i < m_Index.size() && m_Index[i].KeyframeCycle <= toCycle && visits.size() < maxResults; ++i) {
+			if (!m_Index[i].MayRun(pc)) {
+				continue;
+			}
+
+			decodeChunk(i, nullptr, [&](const TraceEntry& entry, const Changes&) {
+				if (entry.Cycle > toCycle) {
+					return false;
+				}
+				if (entry.PC == pc && entry.Cycle >= fromCycle) {
+					visits.push_back(entry);
+				}
+				return visits.size() < maxResults;
+			});
+		}
+		return visits;
+	}
+
+	bool TraceArchive::Rebuild(uint64_t cycle, CPU& cpu)
+	{
+		// The last keyframe at or before cycle
+		auto it = std::upper_bound(m_Index.begin(), m_Index.end(), cycle,
+			[](uint64_t target, const Chunk& chunk) { return target < chunk.KeyframeCycle; });
+		if (it == m_Index.begin()) {
+			return false;
+		}
+		const size_t chunk = (size_t)(it - m_Index.begin()) - 1;
+
+		auto apply = [&](const Changes& changes) {
+			for (Byte i = 0; i < changes.RegisterCount; ++i) {
+				(&cpu.R00)[changes.Registers[i].Register & 0x1F] = changes.Registers[i].Value;
+			}
+			if (changes.SPChanged) {
+				cpu.IO.SP = changes.SP;
+			}
+		};
+
+		// A gap only applies once the instruction after it retired in time
+		bool pcKnown = false;
+		bool gapPending = false;
+		Changes gap;
+		const bool ok = decodeChunk(chunk, &cpu, [&](const TraceEntry& entry, const Changes& changes) {
+			if (entry.Cycle > cycle) {
+				// The next instruction to run, unless the gap moved the PC away from where the last one left it
+				cpu.PC = gapPending && gap.PCChanged ? gap.PC : entry.PC;
+				pcKnown = true;
+				return false;
+			}
+
+			if (gapPending) {
+				apply(gap);
+				if (gap.SREGChanged) {
+					*(Byte*)&cpu.IO.SREG = gap.SREG;
+				}
+				gapPending = false;
+			}
+
+			apply(changes);
+			*(Byte*)&cpu.IO.SREG ^= entry.SREGDelta;
+			cpu.CycleCount = entry.Cycle;
+			cpu.PC = entry.PC + (Timing::IsTwoWord(entry.Instruction) ? 2 : 1);
+			return true;
+		}, [&](const Changes& changes) {
+			gap = changes;
+			gapPending = true;
+		});
+
+		// Jumps out of the last instruction of the chunk land where the next keyframe says.
+		// The keyframe is taken right after it, before any gap.
+		if (ok && !pcKnown && chunk + 1 < m_Index.size()) {
+			cpu.PC = m_Index[chunk + 1].KeyframePC;
+		}
+		return ok;
+	}
+
+	bool TraceArchive::decodeChunk(size_t chunk, CPU* keyframe, const ChunkCallback& callback, const GapCallback& onGap)
+	{
+		const Chunk& index = m_Index[chunk];
+		const uint64_t end = chunk + 1 < m_Index.size() ? m_Index[chunk + 1].Offset : UINT64_MAX;
+
+		Byte header[CHUNK_HEADER_SIZE - CPU::DATA_SPACE_SIZE];
+		m_Stream.clear();
+		m_Stream.seekg((std::streamoff)index.Offset);
+		if (!m_Stream.read((char*)header, sizeof(header))) {
+			return false;
+		}
+
+		const uint32_t records = (uint32_t)Get(header, 4);
+		const uint32_t size = (uint32_t)Get(header + 4, 4);
+		if (records != index.Records || index.Offset + CHUNK_HEADER_SIZE + size > end) {
+			return false;
+		}
+
+		m_Buffer.resize(CPU::DATA_SPACE_SIZE + size);
+		if (!m_Stream.read((char*)m_Buffer.data(), m_Buffer.size())) {
+			return false;
+		}
+
+		if (keyframe) {
+			std::memcpy(&keyframe->R00, m_Buffer.data(), CPU::DATA_SPACE_SIZE);
+			keyframe->PC = index.KeyframePC;
+			keyframe->CycleCount = index.KeyframeCycle;
+		}
+
+		std::fill_n(m_Instructions.get(), FLASH_WORDS, NO_INSTRUCTION);
+		std::fill_n(m_Operands.get(), FLASH_WORDS, 0);
+		std::fill_n(m_Successors.get(), FLASH_WORDS + 1, NO_INSTRUCTION);
+		size_t previousSlot = FLASH_WORDS;
+
+		const Byte* data = m_Buffer.data() + CPU::DATA_SPACE_SIZE;
+		const Byte* dataEnd = data + size;
+
+		// Every field is checked against the end, a damaged chunk stops decoding instead of reading past it
+		auto need = [&](size_t bytes) { return (size_t)(dataEnd - data) >= bytes; };
+
+		auto readRegisters = [&](Changes& changes) {
+			if (!need(1)) {
+				return false;
+			}
+			changes.RegisterCount = std::min<Byte>(*data++, 32);
+			if (!need(changes.RegisterCount * 2)) {
+				return false;
+			}
+			for (Byte i = 0; i < changes.RegisterCount; ++i) {
+				changes.Registers[i] = { data[0], data[1] };
+				data += 2;
+			}
+			return true;
+		};
+
+		auto readSP = [&](Changes& changes) {
+			if (!need(2)) {
+				return false;
+			}
+			changes.SPChanged = true;
+			changes.SP = (Word)Get(data, 2);
+			data += 2;
+			return true;
+		};
+
+		TraceEntry entry = {};
+		entry.Cycle = index.KeyframeCycle;
+		Word nextPC = index.KeyframePC;
+
+		for (uint32_t record = 0; record < records;) {
+			if (!need(1)) {
+				return false;
+			}
+			const Byte flags = *data++;
+
+			if ((flags >> CYCLE_SHIFT) == CYCLE_GAP) {
+				Changes gap;
+				if (flags & FLAG_PC) {
+					if (!need(2)) {
+						return false;
+					}
+					gap.PCChanged = true;
+					gap.PC = (Word)Get(data, 2);
+					data += 2;
+				}
+				if ((flags & FLAG_REGISTERS) && !readRegisters(gap)) {
+					return false;
+				}
+				if (flags & FLAG_SREG) {
+					if (!need(1)) {
+						return false;
+					}
+					gap.SREGChanged = true;
+					gap.SREG = *data++;
+				}
+				if ((flags & FLAG_SP) && !readSP(gap)) {
+					return false;
+				}
+
+				if (onGap) {
+					onGap(gap);
+				}
+				continue;
+			}
+
+			uint64_t delta = flags >> CYCLE_SHIFT;
+			if (delta == CYCLE_ESCAPE) {
+				delta = 0;
+				for (int shift = 0;; shift += 7) {
+					if (!need(1) || shift > 63) {
+						return false;
+					}
+					const Byte b = *data++;
+					delta |= (uint64_t)(b & 0x7F) << shift;
+					if (!(b & 0x80)) {
+						break;
+					}
+				}
+			}
+			entry.Cycle += delta;
+
+			entry.PC = m_Successors[previousSlot] != NO_INSTRUCTION ? m_Successors[previousSlot] : nextPC;
+			if (flags & FLAG_PC) {
+				if (!need(2)) {
+					return false;
+				}
+				entry.PC = (Word)Get(data, 2);
+				data += 2;
+			}
+
+			const size_t slot = entry.PC & (FLASH_WORDS - 1);
+			m_Successors[previousSlot] = entry.PC;
+			previousSlot = slot;
+			if (flags & FLAG_INSTRUCTION) {
+				if (!need(2)) {
+					return false;
+				}
+				m_Instructions[slot] = (Word)Get(data, 2);
+				data += 2;
+
+				if (Timing::IsTwoWord(m_Instructions[slot])) {
+					if (!need(2)) {
+						return false;
+					}
+					m_Operands[slot] = (Word)Get(data, 2);
+					data += 2;
+				}
+			}
+			entry.Instruction = m_Instructions[slot];
+			entry.Operand = m_Operands[slot];
+			const bool twoWord = Timing::IsTwoWord(entry.Instruction);
+
+			Changes changes;
+			entry.Register = TraceFormat::NO_REGISTER;
+			entry.Value = 0;
+			if (flags & FLAG_REGISTERS) {
+				if (!readRegisters(changes)) {
+					return false;
+				}
+				if (changes.RegisterCount) {
+					entry.Register = changes.Registers[0].Register;
+					entry.Value = changes.Registers[0].Value;
+				}
+			}
+
+			entry.SREGDelta = 0;
+			if (flags & FLAG_SREG) {
+				if (!need(1)) {
+					return false;
+				}
+				entry.SREGDelta = *data++;
+			}
+
+			if ((flags & FLAG_SP) && !readSP(changes)) {
+				return false;
+			}
+
+			nextPC = entry.PC + (twoWord ? 2 : 1);
+			++record;
+
+			if (!callback(entry, changes)) {
+				break;
+			}
+		}
+
+		return true;
+	}
+
+	size_t TraceArchive::findChunk(uint64_t cycle) const
+	{
+		auto it = std::lower_bound(m_Index.begin(), m_Index.end(), cycle,
+			[](const Chunk& chunk, uint64_t target) { return chunk.LastCycle < target; });
+		return (size_t)(it - m_Index.begin());
+	}
+
+}
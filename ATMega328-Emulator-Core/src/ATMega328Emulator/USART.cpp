@@ -0,0 +1,365 @@
+#include "ATMega328Emulator/USART.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "ATMega328Emulator/OutputMatcher.h"
+
+namespace ATMega328Emulator {
+
+	static_assert(offsetof(CPU, EXIO.UCSR0A) == USART::UCSR0A_ADDRESS, "UCSR0A has moved");
+	static_assert(offsetof(CPU, EXIO.UBRR0) == USART::UBRR0_ADDRESS, "UBRR0 has moved");
+	static_assert(offsetof(CPU, EXIO.UDR0) == USART::UDR0_ADDRESS, "UDR0 has moved");
+
+	USART::USART(size_t bufferSize)
+		: m_Transmitted(bufferSize), m_Received(bufferSize)
+	{
+	}
+
+	void USART::Attach(RegisterHooks& hooks)
+	{
+		Detach();
+		hooks.Add(UCSR0A_ADDRESS, 2, this);
+		hooks.Add(UDR0_ADDRESS, 1, this);
+		m_Hooks = &hooks;
+	}
+
+	void USART::Detach()
+	{
+		if (m_Hooks) {
+			m_Hooks->Remove(this);
+			m_Hooks = nullptr;
+		}
+	}
+
+	void USART::Reset(CPU& cpu)
+	{
+		cpu.EXIO.UCSR0A = UDRE0;
+		cpu.EXIO.UCSR0B = 0;
+		cpu.EXIO.UCSR0C = UCSZ01 | UCSZ00; // 8N1
+		cpu.EXIO.UBRR0 = 0;
+		cpu.EXIO.UDR0 = 0;
+
+		m_Control = 0;
+		m_Mode = 0;
+		m_Now = cpu.CycleCount;
+		m_InterruptCycle = NO_EVENT;
+		m_TxBusy = m_TxBufferFull = m_TxComplete = false;
+		m_RxBusy = m_Overrun = false;
+		m_RxCount = 0;
+		m_StopRequested = false;
+	}
+
+	uint64_t USART::GetFrameCycles(const CPU& cpu)
+	{
+		const uint64_t bitCycles = ((cpu.EXIO.UCSR0A & U2X0) ? 8 : 16) * ((uint64_t)(cpu.EXIO.UBRR0 & 0x0FFF) + 1);
+
+		// UCSZ0 2:0, 5 to 8 bits or 7 for 9, the reserved sizes are taken as 8
+		const int size = ((cpu.EXIO.UCSR0B & UCSZ02) ? 4 : 0) | ((cpu.EXIO.UCSR0C >> 1) & 3);
+		const int dataBits = size == 7 ? 9 : std::min(size, 3) + 5;
+
+		const int bits = 1 + dataBits + ((cpu.EXIO.UCSR0C & UPM01) ? 1 : 0) + ((cpu.EXIO.UCSR0C & USBS0) ? 2 : 1);
+		return bitCycles * bits;
+	}
+
+	uint64_t USART::GetNextEventCycle() const
+	{
+		uint64_t next = m_StopRequested ? m_Now : m_InterruptCycle;
+		if (m_TxBusy) {
+			next = std::min(next, m_TxEnd);
+		}
+		if (m_RxBusy) {
+			next = std::min(next, m_RxEnd);
+		}
+		else if (m_Control & RXEN0) {
+			if (m_NextArrival < m_Arrivals.size()) {
+				next = std::min(next, std::max(m_Now, m_Arrivals[m_NextArrival].Cycle));
+			}
+			else if (!m_Received.IsEmpty()) {
+				next = std::min(next, m_Now); // The host queued something, start receiving it
+			}
+		}
+		return next;
+	}
+
+	void USART::HandleEvents(CPU& cpu, Memory&)
+	{
+		advance(cpu, cpu.CycleCount);
+
+		m_InterruptCycle = NO_EVENT;
+		if (const Byte vector = getInterruptVector()) {
+			// Entering the TX complete handler clears TXC0, the other flags stay until the firmware acts on them
+			if (cpu.EnterInterrupt(vector) && vector == TX_VECTOR) {
+				m_TxComplete = false;
+			}
+
+			// Masked, or another one is waiting behind the one just taken
+			if (getInterruptVector()) {
+				m_InterruptCycle = cpu.CycleCount + INTERRUPT_RETRY_CYCLES;
+			}
+		}
+
+		cpu.EXIO.UCSR0A = getStatus();
+	}
+
+	std::vector<RegisterRange> USART::GetRegisters() const
+	{
+		return { { UCSR0A_ADDRESS, (Word)(UDR0_ADDRESS - UCSR0A_ADDRESS + 1) } };
+	}
+
+	bool USART::TakeStopRequest()
+	{
+		const bool requested = m_StopRequested;
+		m_StopRequested = false;
+		return requested;
+	}
+
+	Byte USART::OnRead(CPU& cpu, Word address, Byte value, uint64_t cycle)
+	{
+		const uint64_t before = GetNextEventCycle();
+		advance(cpu, cycle);
+
+		if (address == UCSR0A_ADDRESS) {
+			value = cpu.EXIO.UCSR0A = getStatus();
+		}
+		else if (address == UDR0_ADDRESS && m_RxCount) {
+			value = cpu.EXIO.UDR0 = m_RxFifo[0];
+			m_RxFifo[0] = m_RxFifo[1];
+			--m_RxCount;
+			m_Overrun = false;
+		}
+
+		onAccessed(before, cycle);
+		return value;
+	}
+
+	Byte USART::OnWrite(CPU& cpu, Word address, Byte value, uint64_t cycle)
+	{
+		const uint64_t before = GetNextEventCycle();
+		advance(cpu, cycle);
+
+		switch (address) {
+			case UCSR0A_ADDRESS:
+				// TXC0 is cleared by writing a one, the other flags are read only
+				if (value & TXC0) {
+					m_TxComplete = false;
+				}
+				m_Mode = value & (U2X0 | MPCM0);
+				value = getStatus();
+				break;
+
+			case UCSR0B_ADDRESS:
+				m_Control = value;
+				if (!(value & RXEN0)) {
+					// Disabling the receiver flushes it
+					m_RxBusy = m_Overrun = false;
+					m_RxCount = 0;
+				}
+				break;
+
+			case UDR0_ADDRESS:
+				transmit(cpu, value, cycle);
+				value = cpu.EXIO.UDR0; // Reads see the receive side
+				break;
+		}
+
+		onAccessed(before, cycle);
+		return value;
+	}
+
+	bool USART::OnInput(CPU&, Word address, Byte value)
+	{
+		if (address != UDR0_ADDRESS) {
+			return false;
+		}
+
+		// The byte arrives down the line like a host byte, the Scheduler starts its frame
+		Receive({ &value, 1 });
+		return true;
+	}
+
+	bool USART::SaveState(std::vector<Byte>& out)
+	{
+		m_Logging = true;
+
+		SaveValue(out, m_Control);
+		SaveValue(out, m_Mode);
+		SaveValue(out, m_Now);
+		SaveValue(out, m_InterruptCycle);
+		SaveValue(out, m_TxBusy);
+		SaveValue(out, m_TxBufferFull);
+		SaveValue(out, m_TxComplete);
+		SaveValue(out, m_TxShift);
+		SaveValue(out, m_TxBuffer);
+		SaveValue(out, m_TxEnd);
+		SaveValue(out, m_RxBusy);
+		SaveValue(out, m_Overrun);
+		SaveValue(out, m_RxShift);
+		SaveValue(out, m_RxCount);
+		SaveValue(out, m_RxFifo);
+		SaveValue(out, m_RxEnd);
+		SaveValue(out, m_NextArrival);
+
+		// Dropped counts what the host missed, that doesn't happen again
+		SaveValue(out, m_Stats.Transmitted);
+		SaveValue(out, m_Stats.Received);
+		SaveValue(out, m_Stats.Overruns);
+		return true;
+	}
+
+	const Byte* USART::RestoreState(const Byte* in)
+	{
+		in = RestoreValue(in, m_Control);
+		in = RestoreValue(in, m_Mode);
+		in = RestoreValue(in, m_Now);
+		in = RestoreValue(in, m_InterruptCycle);
+		in = RestoreValue(in, m_TxBusy);
+		in = RestoreValue(in, m_TxBufferFull);
+		in = RestoreValue(in, m_TxComplete);
+		in = RestoreValue(in, m_TxShift);
+		in = RestoreValue(in, m_TxBuffer);
+		in = RestoreValue(in, m_TxEnd);
+		in = RestoreValue(in, m_RxBusy);
+		in = RestoreValue(in, m_Overrun);
+		in = RestoreValue(in, m_RxShift);
+		in = RestoreValue(in, m_RxCount);
+		in = RestoreValue(in, m_RxFifo);
+		in = RestoreValue(in, m_RxEnd);
+		in = RestoreValue(in, m_NextArrival);
+
+		in = RestoreValue(in, m_Stats.Transmitted);
+		in = RestoreValue(in, m_Stats.Received);
+		in = RestoreValue(in, m_Stats.Overruns);
+
+		m_StopRequested = false;
+		return in;
+	}
+
+	void USART::advance(CPU& cpu, uint64_t cycle)
+	{
+		m_Now = std::max(m_Now, cycle);
+
+		while (m_TxBusy && m_TxEnd <= cycle) {
+			// Running cycles again sends their frames again, the host already has them
+			if (++m_Stats.Transmitted > m_Delivered) {
+				m_Delivered = m_Stats.Transmitted;
+				if (!m_Transmitted.Push(m_TxShift)) {
+					++m_Stats.Dropped;
+				}
+				if (m_Matcher && m_Matcher->Feed(m_TxShift, m_TxEnd)) {
+					m_StopRequested = true;
+				}
+			}
+
+			if (m_TxBufferFull) {
+				m_TxShift = m_TxBuffer;
+				m_TxBufferFull = false;
+				m_TxEnd += GetFrameCycles(cpu);
+			}
+			else {
+				m_TxBusy = false;
+				m_TxComplete = true;
+			}
+		}
+
+		// A frame that follows another starts where it ended, one after an idle line starts now
+		uint64_t lineFree = cycle;
+		while (true) {
+			if (m_RxBusy) {
+				if (m_RxEnd > cycle) {
+					break;
+				}
+
+				if (m_RxCount < 2) {
+					m_RxFifo[m_RxCount++] = m_RxShift;
+					++m_Stats.Received;
+				}
+				else {
+					m_Overrun = true;
+					++m_Stats.Overruns;
+				}
+				m_RxBusy = false;
+				lineFree = m_RxEnd;
+			}
+
+			if (!(m_Control & RXEN0) || !takeArrival(cycle, m_RxShift)) {
+				break;
+			}
+			m_RxBusy = true;
+			m_RxEnd = lineFree + GetFrameCycles(cpu);
+		}
+	}
+
+	void USART::transmit(CPU& cpu, Byte value, uint64_t cycle)
+	{
+		if (!(m_Control & TXEN0)) {
+			return;
+		}
+
+		if (!m_TxBusy) {
+			m_TxBusy = true;
+			m_TxShift = value;
+			m_TxEnd = cycle + GetFrameCycles(cpu);
+		}
+		else if (!m_TxBufferFull) {
+			m_TxBufferFull = true;
+			m_TxBuffer = value;
+		}
+	}
+
+	bool USART::takeArrival(uint64_t cycle, Byte& value)
+	{
+		if (m_NextArrival < m_Arrivals.size()) {
+			if (m_Arrivals[m_NextArrival].Cycle > cycle) {
+				return false;
+			}
+			value = m_Arrivals[m_NextArrival++].Value;
+			return true;
+		}
+
+		if (!m_Received.Pop(value)) {
+			return false;
+		}
+		if (m_Logging) {
+			m_Arrivals.push_back({ cycle, value });
+			++m_NextArrival;
+		}
+		return true;
+	}
+
+	Byte USART::getStatus() const
+	{
+		return (m_RxCount ? RXC0 : 0)
+			| (m_TxComplete ? TXC0 : 0)
+			| (m_TxBufferFull ? 0 : UDRE0)
+			| (m_Overrun ? DOR0 : 0)
+			| m_Mode;
+	}
+
+	Byte USART::getInterruptVector() const
+	{
+		if ((m_Control & RXCIE0) && m_RxCount) {
+			return RX_VECTOR;
+		}
+		if ((m_Control & UDRIE0) && !m_TxBufferFull) {
+			return UDRE_VECTOR;
+		}
+		if ((m_Control & TXCIE0) && m_TxComplete) {
+			return TX_VECTOR;
+		}
+		return 0;
+	}
+
+	void USART::onAccessed(uint64_t nextEventBefore, uint64_t cycle)
+	{
+		if (getInterruptVector() && m_InterruptCycle > cycle) {
+			m_InterruptCycle = cycle;
+		}
+
+		// The Scheduler's slice was cut to the old next event, a sooner one needs the slice to end now
+		if (m_Hooks && (m_StopRequested || GetNextEventCycle() < nextEventBefore)) {
+			m_Hooks->RequestStop();
+		}
+	}
+
+}
@@ -0,0 +1,72 @@
+#include "ATMega328Emulator/Watchpoints.h"
+
+#include <algorithm>
+
+#include "ATMega328Emulator/CPU.h"
+
+namespace ATMega328Emulator {
+
+	static_assert(Watchpoints::DATA_PAGES * Watchpoints::PAGE_SIZE == CPU::DATA_SPACE_MASK + 1, "Every masked data space address needs a page");
+	static_assert(Watchpoints::EEPROM_PAGES * Watchpoints::PAGE_SIZE == CPU::EEPROM_SIZE, "Every EEPROM address needs a page");
+
+	int Watchpoints::Add(WatchSpace space, Word address, Word size, WatchAccess access)
+	{
+		const uint32_t end = (uint32_t)address + size;
+		const uint32_t limit = space == WatchSpace::Data ? DATA_PAGES * PAGE_SIZE : EEPROM_PAGES * PAGE_SIZE;
+		if (!size || end > limit) {
+			return -1;
+		}
+
+		m_Ranges.push_back({ m_NextId, space, access, address, end });
+		flagPages();
+		return m_NextId++;
+	}
+
+	bool Watchpoints::Remove(int id)
+	{
+		auto it = std::find_if(m_Ranges.begin(), m_Ranges.end(), [id](const Range& range) { return range.Id == id; });
+		if (it == m_Ranges.end()) {
+			return false;
+		}
+
+		m_Ranges.erase(it);
+		flagPages();
+		return true;
+	}
+
+	void Watchpoints::Clear()
+	{
+		m_Ranges.clear();
+		flagPages();
+	}
+
+	void Watchpoints::OnAccess(WatchEvent event)
+	{
+		// The page is watched, the address may still not be
+		for (const Range& range : m_Ranges) {
+			if (range.Space != event.Space || event.Address < range.Begin || event.Address >= range.End
+				|| !((Byte)range.Access & (Byte)event.Access)) {
+				continue;
+			}
+
+			event.Id = range.Id;
+			if (m_Callback && m_Callback(event)) {
+				m_StopRequested = true;
+			}
+		}
+	}
+
+	void Watchpoints::flagPages()
+	{
+		m_DataPages.fill(0);
+		m_EEPROMPages.fill(0);
+
+		for (const Range& range : m_Ranges) {
+			uint64_t* pages = range.Space == WatchSpace::Data ? m_DataPages.data() : m_EEPROMPages.data();
+			for (uint32_t page = range.Begin / PAGE_SIZE; page <= (range.End - 1) / PAGE_SIZE; ++page) {
+				pages[page / 64] |= 1ull << (page % 64);
+			}
+		}
+	}
+
+}
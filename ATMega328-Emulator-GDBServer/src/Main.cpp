@@ -0,0 +1,191 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+	#include <winsock2.h>
+	using Socket = SOCKET;
+	static void CloseSocket(Socket socket) { closesocket(socket); }
+#else
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <poll.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+	using Socket = int;
+	static constexpr Socket INVALID_SOCKET = -1;
+	static void CloseSocket(Socket socket) { close(socket); }
+#endif
+
+#include "ATMega328Emulator/CPU.h"
+#include "ATMega328Emulator/GDBStub.h"
+#include "ATMega328Emulator/Memory.h"
+
+using namespace ATMega328Emulator;
+
+namespace {
+
+	bool SendAll(Socket socket, const std::string& data)
+	{
+		for (size_t sent = 0; sent < data.size();) {
+			const int result = (int)send(socket, data.data() + sent, (int)(data.size() - sent), 0);
+			if (result <= 0) {
+				return false;
+			}
+			sent += result;
+		}
+		return true;
+	}
+
+	// Whether a Ctrl-C from GDB is waiting, without blocking
+	bool PollInterrupt(Socket socket)
+	{
+#ifdef _WIN32
+		fd_set read;
+		FD_ZERO(&read);
+		FD_SET(socket, &read);
+		timeval timeout = {};
+		if (select(0, &read, nullptr, nullptr, &timeout) <= 0) {
+			return false;
+		}
+#else
+		pollfd fd = { socket, POLLIN, 0 };
+		if (poll(&fd, 1, 0) <= 0) {
+			return false;
+		}
+#endif
+		char c = 0;
+		return recv(socket, &c, 1, 0) == 1 && c == '\x03';
+	}
+
+	Socket Listen(int port, const char* unixPath)
+	{
+#ifndef _WIN32
+		if (unixPath) {
+			Socket listener = socket(AF_UNIX, SOCK_STREAM, 0);
+			sockaddr_un address = {};
+			address.sun_family = AF_UNIX;
+			std::strncpy(address.sun_path, unixPath, sizeof(address.sun_path) - 1);
+			unlink(unixPath);
+			if (listener == INVALID_SOCKET || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 1) != 0) {
+				return INVALID_SOCKET;
+			}
+			return listener;
+		}
+#endif
+
+		Socket listener = socket(AF_INET, SOCK_STREAM, 0);
+		int reuse = 1;
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+		// Only local debuggers, the stub can write anywhere in the emulated chip
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons((unsigned short)port);
+		if (listener == INVALID_SOCKET || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 1) != 0) {
+			return INVALID_SOCKET;
+		}
+		return listener;
+	}
+
+}
+
+// Serves one avr-gdb session:
+//   ATMega328-Emulator-GDBServer [--port 1234 | --unix /tmp/atmega328.sock] [firmware.bin]
+//   avr-gdb firmware.elf -ex "target remote :1234"
+// Without a raw binary to start from, GDB's load command can write the ELF's flash image.
+int main(int argc, char** argv)
+{
+	int port = 1234;
+	const char* unixPath = nullptr;
+	const char* firmwarePath = nullptr;
+	for (int i = 1; i < argc; ++i) {
+		if (!std::strcmp(argv[i], "--port") && i + 1 < argc) {
+			port = std::atoi(argv[++i]);
+		}
+		else if (!std::strcmp(argv[i], "--unix") && i + 1 < argc) {
+			unixPath = argv[++i];
+		}
+		else {
+			firmwarePath = argv[i];
+		}
+	}
+
+	Memory memory;
+	CPU cpu;
+	cpu.Reset(memory);
+
+	if (firmwarePath) {
+		FILE* file = std::fopen(firmwarePath, "rb");
+		if (!file) {
+			std::fprintf(stderr, "Can't read %s\n", firmwarePath);
+			return 1;
+		}
+		std::fread(memory.Data, 1, Memory::MAX_MEM, file);
+		std::fclose(file);
+	}
+
+#ifdef _WIN32
+	WSADATA wsa;
+	WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+
+	Socket listener = Listen(port, unixPath);
+	if (listener == INVALID_SOCKET) {
+		std::fprintf(stderr, "Can't listen on %s\n", unixPath ? unixPath : std::to_string(port).c_str());
+		return 1;
+	}
+
+	std::fprintf(stderr, "Waiting for GDB on %s\n", unixPath ? unixPath : (":" + std::to_string(port)).c_str());
+	Socket connection = accept(listener, nullptr, nullptr);
+	CloseSocket(listener);
+	if (connection == INVALID_SOCKET) {
+		return 1;
+	}
+
+	// Replies are small and GDB waits for each one
+	if (!unixPath) {
+		int noDelay = 1;
+		setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+	}
+
+	GDBStub stub(cpu, memory);
+	stub.SetInterruptCheck([connection]() { return PollInterrupt(connection); });
+
+	GDBPacketReader reader;
+	char buffer[4096];
+	while (!stub.IsDetached()) {
+		const int received = (int)recv(connection, buffer, sizeof(buffer), 0);
+		if (received <= 0) {
+			break;
+		}
+
+		for (int i = 0; i < received && !stub.IsDetached(); ++i) {
+			switch (reader.Feed(buffer[i]))
+			{
+				case GDBPacketReader::Event::Packet:
+					SendAll(connection, "+" + GDBStub::EncodePacket(stub.HandlePacket(reader.GetPacket())));
+					break;
+				case GDBPacketReader::Event::BadPacket:
+					SendAll(connection, "-");
+					break;
+				case GDBPacketReader::Event::Interrupt:
+					// Nothing is running between packets, so the CPU is already stopped
+					SendAll(connection, GDBStub::EncodePacket(stub.HandlePacket("?")));
+					break;
+				default: break;
+			}
+		}
+	}
+
+	CloseSocket(connection);
+#ifndef _WIN32
+	if (unixPath) {
+		unlink(unixPath);
+	}
+#endif
+	return 0;
+}
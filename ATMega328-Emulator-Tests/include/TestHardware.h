@@ -20,5 +20,5 @@ public:
 
 public:
 	Memory memory;
-	CPU cpu;
+	CPU cpu{}; // Reset leaves most of the data space alone, tests expect it zeroed
 };
@@ -24,6 +24,11 @@ project "ATMega328-Emulator-Tests"
 		"vendor/gtest/googletest/",
     }
 
+	-- Firmware images WorkloadTests.cpp loads
+	defines {
+		"KOM_WORKLOADS_DIR=\"%{wks.location}/workloads/\"",
+	}
+
 	links {
         "ATMega328-Emulator-Core"
     }
@@ -31,6 +36,9 @@ project "ATMega328-Emulator-Tests"
 	filter "system:windows"
 		systemversion "latest"
 
+	filter "system:linux"
+		links { "pthread" }
+
 	filter "configurations:Debug"
 		defines "KOM_DEBUG"
 		runtime "Debug"
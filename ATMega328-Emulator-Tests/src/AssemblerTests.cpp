@@ -0,0 +1,106 @@
+#include "TestHardware.h"
+
+#include <stdexcept>
+
+#include "ATMega328Emulator/Assembler.h"
+
+using namespace ATMega328Emulator::asm_;
+
+namespace {
+
+	// Checked by the compiler, against the encodings the instruction tests build by hand
+	static_assert(Assemble(add(r1, r2))[0] == (Instruction::ADD | 0b1'0000 | 0b0'0010));
+	static_assert(Assemble(adc(r31, r16))[0] == 0x1FF0);
+	static_assert(Assemble(ldi(r16, 0x2A))[0] == 0xE20A);
+	static_assert(Assemble(subi(r22, 0x0F))[0] == (Instruction::SUBI | 0b110'0000 | 0b1111));
+	static_assert(Assemble(subi(r16, -1))[0] == 0x5F0F);
+	static_assert(Assemble(adiw(r26, 1))[0] == (Instruction::ADIW | (1 << 4) | 1));
+	static_assert(Assemble(sbiw(r30, 63))[0] == 0x97FF);
+	static_assert(Assemble(movw(r16, r18))[0] == (Instruction::MOVW | (8 << 4) | 9));
+	static_assert(Assemble(muls(r18, r19))[0] == (Instruction::MULS | (2 << 4) | 3));
+	static_assert(Assemble(out(0x3D, r16))[0] == 0xBF0D);
+	static_assert(Assemble(in(r16, 0x3F))[0] == 0xB70F);
+	static_assert(Assemble(sbi(5, 1))[0] == (Instruction::SBI | (5 << 3) | 1));
+	static_assert(Assemble(ld(r16, X_INC))[0] == 0x910D);
+	static_assert(Assemble(st(Y, r17))[0] == 0x8318);
+	static_assert(Assemble(ldd(r16, Y, 12))[0] == 0x850C);
+	static_assert(Assemble(std_(Z, 63, r0))[0] == 0xAE07);
+	static_assert(Assemble(lpm(r0, Z_INC))[0] == 0x9005);
+	static_assert(Assemble(sei())[0] == Instruction::SEI);
+	static_assert(Assemble(rjmp(-1))[0] == Instruction::SELF_LOOP);
+	static_assert(Assemble(brne(1))[0] == (Instruction::BRBC | (1 << 3) | 1));
+
+	static_assert(Assemble(jmp(0x1234)) == std::array<Word, 2>{ 0x940C, 0x1234 });
+	static_assert(Assemble(call(0x12345)) == std::array<Word, 2>{ 0x940F, 0x2345 });
+	static_assert(Assemble(lds(r20, 0x0110)) == std::array<Word, 2>{ 0x9140, 0x0110 });
+
+	// Labels resolve backwards and forwards, two word instructions count twice
+	constexpr auto LOOP = Assemble(
+		ldi(r16, 3),      // 0
+		label("loop"),
+		dec(r16),         // 1
+		breq("done"),     // 2
+		sts(0x0100, r16), // 3, 4
+		rjmp("loop"),     // 5
+		label("done"),
+		call("loop"),     // 6, 7
+		break_());        // 8
+
+	static_assert(LOOP.size() == 9);
+	static_assert(LOOP[2] == (Instruction::BRBS | (3 << 3) | 1)); // breq .+6
+	static_assert(LOOP[5] == (Instruction::RJMP | (-5 & 0xFFF)));
+	static_assert(LOOP[6] == Instruction::CALL && LOOP[7] == 1);
+
+}
+
+TEST_F(ATMega328, Assembler_Run)
+{
+	constexpr auto program = Assemble(
+		ldi(r16, 10),
+		clr(r17),
+		label("loop"),
+		subi(r17, -3),
+		dec(r16),
+		brne("loop"),
+		sts(CPU::SRAM_START, r17),
+		break_());
+
+	asm_::Load(program, memory);
+
+	StopConditions conditions;
+	conditions.StopOnBreak = true;
+
+	// Act
+	RunResult result = cpu.Run(1000, conditions, memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::Break);
+	EXPECT_EQ(cpu.ReadData(CPU::SRAM_START), 30);
+	EXPECT_EQ(cpu.PC, program.size() - 1);
+}
+
+TEST_F(ATMega328, Assembler_Load)
+{
+	constexpr auto program = Assemble(word(0x1234), word(0xABCD));
+
+	// Act, at a byte address like WriteWord
+	asm_::Load(program, memory, 0x10);
+
+	// Assert
+	EXPECT_EQ(memory[0x10], 0x34);
+	EXPECT_EQ(memory[0x11], 0x12);
+	EXPECT_EQ(memory[0x12], 0xCD);
+	EXPECT_EQ(memory[0x13], 0xAB);
+	EXPECT_TRUE(memory.Dirty.IsDirty(0));
+}
+
+TEST_F(ATMega328, Assembler_Errors)
+{
+	// In a constant expression these don't compile, at run time they throw
+	EXPECT_THROW(ldi(r15, 1), std::invalid_argument);
+	EXPECT_THROW(adiw(r25, 1), std::invalid_argument);
+	EXPECT_THROW(ldd(r0, X, 1), std::invalid_argument);
+	EXPECT_THROW(brne(64), std::invalid_argument);
+	EXPECT_THROW(Assemble(rjmp("nowhere")), std::invalid_argument);
+	EXPECT_THROW(Assemble(label("twice"), label("twice")), std::invalid_argument);
+}
@@ -0,0 +1,181 @@
+#include "TestHardware.h"
+
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "ATMega328Emulator/CallProfiler.h"
+#include "ATMega328Emulator/Instructions.h"
+
+namespace {
+
+	// main: 0: rcall f
+	//       1: rjmp 1
+	// f:    4: nop
+	//       5: rcall g
+	//       6: ret
+	// g:    8: nop
+	//       9: nop
+	//      10: ret
+	void LoadCalls(Memory& memory)
+	{
+		int dummyCycles = 0;
+		memory.WriteWord(Instruction::RCALL | 3, 0x0 * 2, dummyCycles);
+		memory.WriteWord(Instruction::RJMP | 0xFFF, 0x1 * 2, dummyCycles);
+		memory.WriteWord(Instruction::NOP, 0x4 * 2, dummyCycles);
+		memory.WriteWord(Instruction::RCALL | 2, 0x5 * 2, dummyCycles);
+		memory.WriteWord(Instruction::RET, 0x6 * 2, dummyCycles);
+		memory.WriteWord(Instruction::NOP, 0x8 * 2, dummyCycles);
+		memory.WriteWord(Instruction::NOP, 0x9 * 2, dummyCycles);
+		memory.WriteWord(Instruction::RET, 0xA * 2, dummyCycles);
+	}
+
+	void Write16(std::vector<Byte>& data, size_t offset, uint16_t value)
+	{
+		data[offset] = value & 0xFF;
+		data[offset + 1] = value >> 8;
+	}
+
+	void Write32(std::vector<Byte>& data, size_t offset, uint32_t value)
+	{
+		Write16(data, offset, value & 0xFFFF);
+		Write16(data, offset + 2, value >> 16);
+	}
+
+}
+
+#ifdef ATMEGA328_PROFILING
+TEST_F(ATMega328, CallProfiler_NestedCalls)
+{
+	LoadCalls(memory);
+
+	CallProfiler profiler;
+	profiler.GetSymbols().Add(0x0, 8, "main");
+	profiler.GetSymbols().Add(0x8, 6, "f");
+	profiler.GetSymbols().Add(0x10, 6, "g");
+	cpu.AttachedCallProfiler = &profiler;
+
+	StopConditions conditions;
+	conditions.StopOnSelfLoop = true;
+
+	// Act
+	RunResult result = cpu.Run(100, conditions, memory);
+	EXPECT_EQ(result.Reason, StopReason::SelfLoop);
+	EXPECT_EQ(profiler.GetDepth(), 1);
+	profiler.Finish(cpu.CycleCount);
+
+	// Assert, call cycles count to the caller and return cycles to the callee
+	std::vector<CallProfiler::FunctionStats> stats = profiler.GetFunctionStats();
+	ASSERT_EQ(stats.size(), 3);
+
+	EXPECT_EQ(stats[0].Name, "f");
+	EXPECT_EQ(stats[0].Calls, 1);
+	EXPECT_EQ(stats[0].InclusiveCycles, 14);
+	EXPECT_EQ(stats[0].ExclusiveCycles, 8);
+
+	EXPECT_EQ(stats[1].Name, "g");
+	EXPECT_EQ(stats[1].InclusiveCycles, 6);
+	EXPECT_EQ(stats[1].ExclusiveCycles, 6);
+
+	// main is profiled from the first call on
+	EXPECT_EQ(stats[2].Name, "main");
+	EXPECT_EQ(stats[2].InclusiveCycles, cpu.CycleCount - 3);
+	EXPECT_EQ(stats[2].ExclusiveCycles, 2);
+
+	std::ostringstream folded;
+	profiler.WriteFolded(folded);
+	EXPECT_EQ(folded.str(), "main 2\nmain;f 8\nmain;f;g 6\n");
+}
+
+TEST_F(ATMega328, CallProfiler_Interrupt)
+{
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::RJMP | 0xFFF, 0x0 * 2, dummyCycles);
+	memory.WriteWord(Instruction::NOP, 0x6 * 2, dummyCycles);
+	memory.WriteWord(Instruction::RETI, 0x7 * 2, dummyCycles);
+
+	CallProfiler profiler;
+	profiler.GetSymbols().Add(0x0, 2, "main");
+	cpu.AttachedCallProfiler = &profiler;
+
+	// Act
+	cpu.IO.SREG.I = 1;
+	ASSERT_TRUE(cpu.EnterInterrupt(3));
+	EXPECT_EQ(profiler.GetDepth(), 2);
+
+	StopConditions conditions;
+	conditions.StopOnSelfLoop = true;
+	cpu.Run(100, conditions, memory);
+	profiler.Finish(cpu.CycleCount);
+
+	// Assert, entered with the 4 cycle response time and left by the RETI
+	EXPECT_EQ(cpu.PC, 0);
+	EXPECT_TRUE(cpu.IO.SREG.I);
+
+	std::ostringstream folded;
+	profiler.WriteFolded(folded);
+	EXPECT_EQ(folded.str(), "main 2\nmain;__vector_3 5\n");
+}
+#endif
+
+TEST_F(ATMega328, CallProfiler_InterruptsDisabled)
+{
+	cpu.IO.SREG.I = 0;
+	const Word sp = cpu.IO.SP;
+
+	// Act, Assert
+	EXPECT_FALSE(cpu.EnterInterrupt(3));
+	EXPECT_EQ(cpu.PC, 0);
+	EXPECT_EQ(cpu.IO.SP, sp);
+}
+
+TEST(SymbolTable, SymbolTable_LoadElf)
+{
+	// Header, null + .symtab + .strtab section headers, 3 symbols, names
+	const char names[] = "\0main\0buffer\0";
+	std::vector<Byte> elf(52 + 3 * 40 + 3 * 16 + sizeof(names), 0);
+	std::memcpy(elf.data(), "\x7F" "ELF\x01\x01\x01", 7);
+	Write32(elf, 0x20, 52);      // e_shoff
+	Write16(elf, 0x2E, 40);      // e_shentsize
+	Write16(elf, 0x30, 3);       // e_shnum
+
+	const size_t symtab = 52 + 40;
+	const size_t symbols = 52 + 3 * 40;
+	Write32(elf, symtab + 4, 2);           // SHT_SYMTAB
+	Write32(elf, symtab + 16, symbols);
+	Write32(elf, symtab + 20, 3 * 16);
+	Write32(elf, symtab + 24, 2);          // .strtab
+	Write32(elf, symtab + 36, 16);
+
+	const size_t strtab = 52 + 2 * 40;
+	Write32(elf, strtab + 4, 3);           // SHT_STRTAB
+	Write32(elf, strtab + 16, symbols + 3 * 16);
+	Write32(elf, strtab + 20, sizeof(names));
+	std::memcpy(elf.data() + symbols + 3 * 16, names, sizeof(names));
+
+	// main, a function
+	Write32(elf, symbols + 16 + 0, 1);
+	Write32(elf, symbols + 16 + 4, 0x80);
+	Write32(elf, symbols + 16 + 8, 0x20);
+	elf[symbols + 16 + 12] = 0x12;         // STB_GLOBAL, STT_FUNC
+
+	// buffer, an object in the data space
+	Write32(elf, symbols + 32 + 0, 6);
+	Write32(elf, symbols + 32 + 4, 0x800100);
+	Write32(elf, symbols + 32 + 8, 0x40);
+	elf[symbols + 32 + 12] = 0x11;         // STB_GLOBAL, STT_OBJECT
+
+	SymbolTable table;
+
+	// Act
+	ASSERT_TRUE(table.LoadElf(elf.data(), elf.size()));
+
+	// Assert
+	EXPECT_EQ(table.GetCount(), 1);
+	EXPECT_EQ(table.GetName(0x80), "main");
+	EXPECT_EQ(table.GetName(0x9E), "main");
+	EXPECT_EQ(table.GetName(0xA0), "0x00A0");
+	EXPECT_EQ(table.Find(0x7E), nullptr);
+
+	EXPECT_FALSE(table.LoadElf(elf.data(), 16));
+}
@@ -0,0 +1,112 @@
+#include "TestHardware.h"
+
+#include <cstring>
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Fault_IllegalOpcode)
+{
+	int dummyCycles = 0;
+	memory.WriteWord(0xFFFF, 0x3 * 2, dummyCycles);
+
+	StopConditions conditions;
+	conditions.TrapFaults = true;
+
+	// Act
+	try {
+		cpu.Run(100, conditions, memory);
+		FAIL() << "Expected an EmulatorFault";
+	}
+	catch (const EmulatorFault& fault) {
+		// Assert
+		EXPECT_EQ(fault.Type, FaultType::IllegalOpcode);
+		EXPECT_EQ(fault.Address, 0xFFFF);
+		EXPECT_EQ(fault.PC, 0x3);
+		EXPECT_EQ(fault.Cycle, 3);
+	}
+
+	EXPECT_EQ(cpu.PC, 0x3);
+	EXPECT_EQ(cpu.CycleCount, 3);
+}
+
+TEST_F(ATMega328, Fault_StopOnIllegalOpcodeWins)
+{
+	int dummyCycles = 0;
+	memory.WriteWord(0xFFFF, 0x3 * 2, dummyCycles);
+
+	StopConditions conditions;
+	conditions.TrapFaults = true;
+	conditions.StopOnIllegalOpcode = true;
+
+	// Act
+	RunResult result = cpu.Run(100, conditions, memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::IllegalOpcode);
+}
+
+TEST_F(ATMega328, Fault_WriteOutsideDataSpace)
+{
+	// LAS r16 with Z pointing past the end of the SRAM
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::LAS | (16 << 4), 0x2 * 2, dummyCycles);
+	cpu.Z = 0xA00;
+	cpu.R16 = 0xFF;
+
+	Byte eeprom[CPU::EEPROM_SIZE];
+	std::memcpy(eeprom, cpu.EEPROM, sizeof(eeprom));
+
+	StopConditions conditions;
+	conditions.TrapFaults = true;
+
+	// Act
+	try {
+		cpu.Run(50, conditions, memory);
+		FAIL() << "Expected an EmulatorFault";
+	}
+	catch (const EmulatorFault& fault) {
+		// Assert
+		EXPECT_EQ(fault.Type, FaultType::DataOutOfBounds);
+		EXPECT_EQ(fault.Address, 0xA00);
+		EXPECT_EQ(fault.Cycle, cpu.CycleCount);
+	}
+
+	// Whatever the build, nothing past the data space was touched
+	EXPECT_EQ(std::memcmp(eeprom, cpu.EEPROM, sizeof(eeprom)), 0);
+}
+
+TEST_F(ATMega328, Fault_AccessesAreMasked)
+{
+	int dummyCycles = 0;
+	memory.Write(0x42, 0x10, dummyCycles);
+
+	// Act, Assert
+	EXPECT_EQ(memory[Memory::MAX_MEM + 0x10], 0x42);
+
+	cpu.WriteData(0xF000 + 0x20, 0x24);
+	EXPECT_EQ(cpu.ReadData(0x20), 0x24);
+
+	// Not trapping, stray writes go unreported
+	cpu.WriteData(0x0A00, 0x01);
+	RunResult result = cpu.Run(10, StopConditions(), memory);
+	EXPECT_EQ(result.Reason, StopReason::CycleBudget);
+}
+
+TEST_F(ATMega328, Fault_PCWrapsPastEndOfFlash)
+{
+	// inc r16 at the start of flash, the rest is NOPs
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::INC | (16 << 4), 0x0, dummyCycles);
+	cpu.PC = CPU::FLASH_SIZE / 2 - 1;
+	cpu.R16 = 0;
+
+	StopConditions conditions;
+	conditions.TrapFaults = true;
+
+	// Act
+	cpu.Run(2, conditions, memory);
+
+	// Assert, the NOP at the last word ran, then the PC wrapped to 0
+	EXPECT_EQ(cpu.R16, 1);
+	EXPECT_EQ(cpu.PC % (CPU::FLASH_SIZE / 2), 1);
+}
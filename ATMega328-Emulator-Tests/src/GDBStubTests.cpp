@@ -0,0 +1,217 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/GDBStub.h"
+#include "ATMega328Emulator/Instructions.h"
+
+namespace {
+
+	// 0: inc r16
+	// 1: push r16
+	// 2: pop r17
+	// 3: rjmp 0
+	void LoadLoop(Memory& memory)
+	{
+		int dummyCycles = 0;
+		memory.WriteWord(Instruction::INC | (16 << 4), 0x0 * 2, dummyCycles);
+		memory.WriteWord(Instruction::PUSH | (16 << 4), 0x1 * 2, dummyCycles);
+		memory.WriteWord(Instruction::POP | (17 << 4), 0x2 * 2, dummyCycles);
+		memory.WriteWord(Instruction::RJMP | (-4 & 0xFFF), 0x3 * 2, dummyCycles);
+	}
+
+}
+
+TEST(GDBStub, GDBStub_Packets)
+{
+	EXPECT_EQ(GDBStub::EncodePacket("OK"), "$OK#9a");
+
+	GDBPacketReader reader;
+	GDBPacketReader::Event event = GDBPacketReader::Event::None;
+	for (char c : std::string("+$m0,2#fb")) {
+		event = reader.Feed(c);
+	}
+	EXPECT_EQ(event, GDBPacketReader::Event::Packet);
+	EXPECT_EQ(reader.GetPacket(), "m0,2");
+
+	for (char c : std::string("$m0,2#fc")) {
+		event = reader.Feed(c);
+	}
+	EXPECT_EQ(event, GDBPacketReader::Event::BadPacket);
+
+	EXPECT_EQ(reader.Feed('\x03'), GDBPacketReader::Event::Interrupt);
+}
+
+TEST_F(ATMega328, GDBStub_Registers)
+{
+	GDBStub stub(cpu, memory);
+	cpu.R05 = 0x12;
+	cpu.R31 = 0;
+	cpu.PC = 0x10;
+	*(Byte*)&cpu.IO.SREG = 0x82;
+
+	// Act
+	std::string registers = stub.HandlePacket("g");
+
+	// Assert, r0 to r31, SREG, SP and the PC as a byte address
+	ASSERT_EQ(registers.size(), 39 * 2);
+	EXPECT_EQ(registers.substr(5 * 2, 2), "12");
+	EXPECT_EQ(registers.substr(64, 2), "82");
+	EXPECT_EQ(registers.substr(66, 4), "ff08");
+	EXPECT_EQ(registers.substr(70, 8), "20000000");
+	EXPECT_EQ(stub.HandlePacket("p5"), "12");
+
+	// Act
+	EXPECT_EQ(stub.HandlePacket("P22=40000000"), "OK");
+	EXPECT_EQ(stub.HandlePacket("P1f=7e"), "OK");
+	registers[0] = 'a';
+	EXPECT_EQ(stub.HandlePacket("G" + registers), "OK");
+
+	// Assert, G wrote back what g read, with r0 changed
+	EXPECT_EQ(cpu.PC, 0x10);
+	EXPECT_EQ(cpu.R31, 0);
+	EXPECT_EQ(cpu.R00 >> 4, 0xA);
+}
+
+TEST_F(ATMega328, GDBStub_Memory)
+{
+	GDBStub stub(cpu, memory);
+
+	// Act
+	EXPECT_EQ(stub.HandlePacket("M800100,2:abcd"), "OK");
+	EXPECT_EQ(stub.HandlePacket("M810010,1:5a"), "OK");
+	EXPECT_EQ(stub.HandlePacket("M6,2:0895"), "OK");
+
+	// Assert
+	EXPECT_EQ(cpu.SRAM[0], 0xAB);
+	EXPECT_EQ(cpu.SRAM[1], 0xCD);
+	EXPECT_EQ(cpu.EEPROM[0x10], 0x5A);
+	EXPECT_EQ(memory[6], 0x08);
+	EXPECT_EQ(stub.HandlePacket("m800100,2"), "abcd");
+	EXPECT_EQ(stub.HandlePacket("m810010,1"), "5a");
+	EXPECT_EQ(stub.HandlePacket("m6,2"), "0895");
+	EXPECT_EQ(stub.HandlePacket("m800900,1"), "E01"); // Past RAMEND
+	EXPECT_EQ(stub.HandlePacket("M800100,2:ab"), "E01");
+}
+
+TEST_F(ATMega328, GDBStub_Breakpoints)
+{
+	LoadLoop(memory);
+	cpu.R16 = 0;
+
+	GDBStub stub(cpu, memory);
+
+	// Act, break on the pop
+	EXPECT_EQ(stub.HandlePacket("Z0,4,2"), "OK");
+
+	// Assert, GDB still sees the pop
+	EXPECT_EQ(memory[4] | (memory[5] << 8), Instruction::BREAK);
+	EXPECT_EQ(stub.HandlePacket("m4,2"), "1f91");
+
+	// Act
+	EXPECT_EQ(stub.HandlePacket("c"), "S05");
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 2);
+	EXPECT_EQ(cpu.R16, 1);
+
+	// Act, continuing runs the pop and stops on the next lap
+	EXPECT_EQ(stub.HandlePacket("c"), "S05");
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 2);
+	EXPECT_EQ(cpu.R16, 2);
+	EXPECT_EQ(cpu.R17, 1);
+
+	// Act, stepping over the breakpoint
+	EXPECT_EQ(stub.HandlePacket("s"), "S05");
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 3);
+	EXPECT_EQ(cpu.R17, 2);
+
+	// Act
+	EXPECT_EQ(stub.HandlePacket("z0,4,2"), "OK");
+
+	// Assert
+	EXPECT_EQ(memory[4] | (memory[5] << 8), Instruction::POP | (17 << 4));
+	EXPECT_EQ(stub.HandlePacket("z0,4,2"), "E01");
+}
+
+TEST_F(ATMega328, GDBStub_RemovesBreakpointsOnDestruction)
+{
+	LoadLoop(memory);
+
+	{
+		GDBStub stub(cpu, memory);
+		stub.InsertBreakpoint(0);
+		stub.InsertBreakpoint(3);
+		EXPECT_EQ(stub.GetBreakpointCount(), 2);
+	}
+
+	EXPECT_EQ(memory[0] | (memory[1] << 8), Instruction::INC | (16 << 4));
+	EXPECT_EQ(memory[6] | (memory[7] << 8), Instruction::RJMP | (-4 & 0xFFF));
+}
+
+TEST_F(ATMega328, GDBStub_Watchpoints)
+{
+	LoadLoop(memory);
+	cpu.R16 = 0;
+
+	GDBStub stub(cpu, memory);
+
+	// Act, watch the top of the stack
+	EXPECT_EQ(stub.HandlePacket("Z2,8008ff,1"), "OK");
+	EXPECT_EQ(stub.HandlePacket("c"), "T05watch:8008ff;");
+
+	// Assert, the push retired
+	EXPECT_EQ(cpu.PC, 2);
+	EXPECT_EQ(cpu.ReadData(CPU::RAMEND), 1);
+	EXPECT_EQ(cpu.AttachedWatchpoints, nullptr);
+
+	// Act, read watchpoint
+	EXPECT_EQ(stub.HandlePacket("z2,8008ff,1"), "OK");
+	EXPECT_EQ(stub.HandlePacket("Z3,8008ff,1"), "OK");
+	EXPECT_EQ(stub.HandlePacket("c"), "T05rwatch:8008ff;");
+
+	// Assert, the pop retired
+	EXPECT_EQ(cpu.PC, 3);
+	EXPECT_EQ(cpu.R17, 1);
+}
+
+TEST_F(ATMega328, GDBStub_KeepsHostWatchpoints)
+{
+	LoadLoop(memory);
+
+	int writes = 0;
+	Watchpoints watchpoints;
+	watchpoints.Add(WatchSpace::Data, CPU::RAMEND, 1, WatchAccess::Write);
+	watchpoints.SetCallback([&](const WatchEvent&) { ++writes; return false; });
+	cpu.AttachedWatchpoints = &watchpoints;
+
+	GDBStub stub(cpu, memory);
+
+	// Act, the slot is taken
+	EXPECT_EQ(stub.HandlePacket("Z2,8008ff,1"), "E01");
+	EXPECT_EQ(stub.HandlePacket("s"), "S05");
+	EXPECT_EQ(stub.HandlePacket("s"), "S05");
+
+	// Assert, the host's watchpoints saw the push and are still attached
+	EXPECT_EQ(writes, 1);
+	EXPECT_EQ(cpu.AttachedWatchpoints, &watchpoints);
+}
+
+TEST_F(ATMega328, GDBStub_Interrupt)
+{
+	LoadLoop(memory);
+
+	GDBStub stub(cpu, memory);
+	int polls = 0;
+	stub.SetInterruptCheck([&]() { return ++polls == 3; });
+
+	// Act
+	EXPECT_EQ(stub.HandlePacket("c"), "S02");
+
+	// Assert, two slices ran
+	EXPECT_EQ(polls, 3);
+	EXPECT_GE(cpu.CycleCount, 2 * GDBStub::CONTINUE_SLICE);
+	EXPECT_EQ(stub.HandlePacket("?"), "S02");
+}
@@ -0,0 +1,77 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/HexFile.h"
+
+TEST_F(ATMega328, HexFile_Data)
+{
+	// Act, avr-objcopy output for "ldi r16, 0x2A; rjmp .-4" at 0x10
+	bool loaded = HexFile::Parse(
+		":040010000AE2FECF33\r\n"
+		":00000001FF\r\n", memory);
+
+	// Assert
+	EXPECT_TRUE(loaded);
+	EXPECT_EQ(memory[0x10], 0x0A);
+	EXPECT_EQ(memory[0x11], 0xE2);
+	EXPECT_EQ(memory[0x12], 0xFE);
+	EXPECT_EQ(memory[0x13], 0xCF);
+	EXPECT_EQ(memory[0x0F], 0x00);
+	EXPECT_EQ(memory[0x14], 0x00);
+}
+
+TEST_F(ATMega328, HexFile_StopsAtEndOfFile)
+{
+	// Act
+	bool loaded = HexFile::Parse(
+		":00000001FF\n"
+		":0100000055AA\n", memory);
+
+	// Assert
+	EXPECT_TRUE(loaded);
+	EXPECT_EQ(memory[0x00], 0x00);
+}
+
+TEST_F(ATMega328, HexFile_ExtendedSegmentAddress)
+{
+	// Act, the segment 0x0100 puts the data at 0x1000
+	bool loaded = HexFile::Parse(
+		":020000020100FB\n"
+		":010020007768\n"
+		":00000001FF\n", memory);
+
+	// Assert
+	EXPECT_TRUE(loaded);
+	EXPECT_EQ(memory[0x1020], 0x77);
+}
+
+TEST_F(ATMega328, HexFile_BadChecksum)
+{
+	// Act
+	bool loaded = HexFile::Parse(":040010000AE2FECF34\n", memory);
+
+	// Assert
+	EXPECT_FALSE(loaded);
+}
+
+TEST_F(ATMega328, HexFile_Malformed)
+{
+	EXPECT_FALSE(HexFile::Parse("040010000AE2FECF33\n", memory));    // No start code
+	EXPECT_FALSE(HexFile::Parse(":040010000AE2FECF\n", memory));     // Too short for its length
+	EXPECT_FALSE(HexFile::Parse(":04001000XAE2FECF33\n", memory));   // Not hex
+}
+
+TEST_F(ATMega328, HexFile_PastEndOfFlash)
+{
+	// Act, the extended linear address 0x0001 puts the data at 0x10000
+	bool loaded = HexFile::Parse(
+		":020000040001F9\n"
+		":0100000055AA\n", memory);
+
+	// Assert
+	EXPECT_FALSE(loaded);
+}
+
+TEST_F(ATMega328, HexFile_MissingFile)
+{
+	EXPECT_FALSE(HexFile::Load("does/not/exist.hex", memory));
+}
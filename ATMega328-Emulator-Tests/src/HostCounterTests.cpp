@@ -0,0 +1,164 @@
+#include "TestHardware.h"
+
+#include <sstream>
+
+#include "ATMega328Emulator/HostCounters.h"
+#include "ATMega328Emulator/Instructions.h"
+#include "ATMega328Emulator/RegisterHooks.h"
+
+namespace {
+
+	// 0: inc r16
+	// 1: rjmp 0
+	// 3 cycles a loop
+	void LoadLoop(Memory& memory)
+	{
+		int dummyCycles = 0;
+		memory.WriteWord(Instruction::INC | (16 << 4), 0x0 * 2, dummyCycles);
+		memory.WriteWord(Instruction::RJMP | (-2 & 0xFFF), 0x1 * 2, dummyCycles);
+	}
+
+	// Asks Run to stop after every write, like a peripheral scheduling an event
+	class StoppingHook : public RegisterHook
+	{
+	public:
+		StoppingHook(RegisterHooks& hooks) : m_Hooks(hooks) {}
+
+		Byte OnRead(CPU&, Word, Byte value, uint64_t) override { return value; }
+
+		Byte OnWrite(CPU&, Word, Byte value, uint64_t) override
+		{
+			m_Hooks.RequestStop();
+			return value;
+		}
+
+	private:
+		RegisterHooks& m_Hooks;
+	};
+
+	HostCounters::Reading MakeReading()
+	{
+		HostCounters::Reading reading;
+		reading.Values[(size_t)HostEvent::Cycles] = 4000;
+		reading.Values[(size_t)HostEvent::Instructions] = 10000;
+		reading.Values[(size_t)HostEvent::Branches] = 2000;
+		reading.Values[(size_t)HostEvent::BranchMisses] = 50;
+		reading.Available[(size_t)HostEvent::Cycles] = true;
+		reading.Available[(size_t)HostEvent::Instructions] = true;
+		reading.Available[(size_t)HostEvent::Branches] = true;
+		reading.Available[(size_t)HostEvent::BranchMisses] = true;
+		reading.EmulatedInstructions = 500;
+		reading.EmulatedCycles = 750;
+		return reading;
+	}
+
+}
+
+TEST(HostCounters, Reading_Ratios)
+{
+	HostCounters::Reading reading = MakeReading();
+
+	// Assert
+	EXPECT_DOUBLE_EQ(reading.GetIPC(), 2.5);
+	EXPECT_DOUBLE_EQ(reading.GetBranchMissRate(), 0.025);
+	EXPECT_DOUBLE_EQ(reading.PerInstruction(HostEvent::Instructions), 20.0);
+	EXPECT_DOUBLE_EQ(reading.PerInstruction(HostEvent::BranchMisses), 0.1);
+}
+
+TEST(HostCounters, Reading_UnavailableEventsAreZero)
+{
+	HostCounters::Reading reading = MakeReading();
+	reading.Values[(size_t)HostEvent::LLCMisses] = 1234;
+	reading.Available[(size_t)HostEvent::Cycles] = false;
+
+	// Assert
+	EXPECT_DOUBLE_EQ(reading.GetIPC(), 0.0);
+	EXPECT_DOUBLE_EQ(reading.PerInstruction(HostEvent::LLCMisses), 0.0);
+	EXPECT_DOUBLE_EQ(reading.GetBranchMissRate(), 0.025);
+}
+
+TEST(HostCounters, Reading_NothingEmulated)
+{
+	HostCounters::Reading reading = MakeReading();
+	reading.EmulatedInstructions = 0;
+
+	// Assert
+	EXPECT_DOUBLE_EQ(reading.PerInstruction(HostEvent::Instructions), 0.0);
+}
+
+TEST(HostCounters, Reading_Report)
+{
+	HostCounters::Reading reading = MakeReading();
+	std::ostringstream out;
+
+	// Act
+	reading.WriteReport(out);
+
+	// Assert
+	const std::string report = out.str();
+	EXPECT_NE(report.find("BranchMisses"), std::string::npos);
+	EXPECT_NE(report.find("Host IPC 2.50"), std::string::npos);
+	EXPECT_EQ(report.find("LLCMisses"), std::string::npos);
+}
+
+TEST_F(ATMega328, HostCounters_RunCountsEmulated)
+{
+	LoadLoop(memory);
+	HostCounters counters;
+
+	// Act, counting or not the emulated side adds up
+	counters.Open();
+	RunResult first = counters.Run(cpu, 30, StopConditions(), memory);
+	counters.Execute(cpu, 30, memory);
+
+	// Assert
+	EXPECT_EQ(first.Instructions, 20);
+	EXPECT_EQ(counters.GetReading().EmulatedInstructions, 40);
+	EXPECT_EQ(counters.GetReading().EmulatedCycles, 60);
+
+	counters.Reset();
+	EXPECT_EQ(counters.GetReading().EmulatedInstructions, 0);
+}
+
+TEST_F(ATMega328, HostCounters_ExecuteRunsThroughHookStops)
+{
+	// 0: out GPIOR0, r16
+	// 1: rjmp 0
+	// 3 cycles a loop
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::OUT | 0b010'0000'0000 | (16 << 4) | 0b1110, 0x0 * 2, dummyCycles);
+	memory.WriteWord(Instruction::RJMP | (-2 & 0xFFF), 0x1 * 2, dummyCycles);
+
+	RegisterHooks hooks;
+	StoppingHook hook(hooks);
+	hooks.Add(CPU::IO_START + 0x1E, 1, &hook);
+	cpu.AttachedRegisterHooks = &hooks;
+	HostCounters counters;
+
+	// Act
+	counters.Execute(cpu, 30, memory);
+
+	// Assert, every write stopped Run but Execute spent the whole budget
+	EXPECT_EQ(cpu.CycleCount, 30);
+	EXPECT_EQ(counters.GetReading().EmulatedInstructions, 20);
+	EXPECT_EQ(counters.GetReading().EmulatedCycles, 30);
+}
+
+TEST_F(ATMega328, HostCounters_CountHostWork)
+{
+	LoadLoop(memory);
+	HostCounters counters;
+	if (!counters.Open()) {
+		GTEST_SKIP() << "No perf events on this host";
+	}
+
+	// Act
+	counters.Run(cpu, 300'000, StopConditions(), memory);
+
+	// Assert, emulating an instruction takes more than one host instruction
+	const HostCounters::Reading& reading = counters.GetReading();
+	if (!reading.IsAvailable(HostEvent::Instructions)) {
+		GTEST_SKIP() << "No instruction counter on this host";
+	}
+	EXPECT_GT(reading.PerInstruction(HostEvent::Instructions), 1.0);
+}
@@ -0,0 +1,80 @@
+#include "TestHardware.h"
+
+#include <sstream>
+
+#include "ATMega328Emulator/InstructionMix.h"
+#include "ATMega328Emulator/Instructions.h"
+
+namespace {
+
+	// 0: inc r16
+	// 1: rjmp 0
+	// 3 cycles a loop
+	void LoadLoop(Memory& memory)
+	{
+		int dummyCycles = 0;
+		memory.WriteWord(Instruction::INC | (16 << 4), 0x0 * 2, dummyCycles);
+		memory.WriteWord(Instruction::RJMP | (-2 & 0xFFF), 0x1 * 2, dummyCycles);
+	}
+
+}
+
+#ifdef ATMEGA328_PROFILING
+TEST_F(ATMega328, InstructionMix_CountsPerClass)
+{
+	LoadLoop(memory);
+
+	InstructionMix mix;
+	cpu.AttachedInstructionMix = &mix;
+
+	// Act
+	cpu.Run(30, StopConditions(), memory);
+
+	// Assert
+	EXPECT_EQ(mix.Get(OpcodeClass::INC).Executions, 10);
+	EXPECT_EQ(mix.Get(OpcodeClass::INC).Cycles, 10);
+	EXPECT_EQ(mix.Get(OpcodeClass::RJMP).Executions, 10);
+	EXPECT_EQ(mix.Get(OpcodeClass::RJMP).Cycles, 20);
+	EXPECT_EQ(mix.Get(OpcodeClass::ADD).Executions, 0);
+	EXPECT_EQ(mix.GetTotalCycles(), cpu.CycleCount);
+
+	std::ostringstream report;
+	mix.WriteReport(report);
+	EXPECT_NE(report.str().find("RJMP                       10                   20   66.67%\n"), std::string::npos);
+	EXPECT_NE(report.str().find("INC                        10                   10   33.33%\n"), std::string::npos);
+	EXPECT_LT(report.str().find("RJMP"), report.str().find("INC"));
+	EXPECT_EQ(report.str().find("ADD"), std::string::npos);
+}
+#endif
+
+TEST(InstructionMix, InstructionMix_MergeAndDiff)
+{
+	InstructionMix base;
+	base.Record(OpcodeClass::LDI, 1);
+	base.Record(OpcodeClass::RJMP, 2);
+	base.Record(OpcodeClass::ADD, 1);
+
+	InstructionMix otherThread;
+	otherThread.Record(OpcodeClass::ADD, 1);
+
+	InstructionMix other;
+	other.Record(OpcodeClass::LDI, 1);
+	other.Record(OpcodeClass::RJMP, 2);
+
+	// Act
+	base += otherThread;
+
+	std::ostringstream diff;
+	InstructionMix::WriteDiff(diff, base, other, "v1", "v2");
+
+	// Assert
+	EXPECT_EQ(base.Get(OpcodeClass::ADD).Executions, 2);
+	EXPECT_EQ(base.GetTotalCycles(), 5);
+
+	// ADD lost its 40% of the time, RJMP went from 40% to 66.67%
+	EXPECT_EQ(diff.str(),
+		"Class            v1         v2     Change\n"
+		"ADD          40.00%      0.00%    -40.00%\n"
+		"RJMP         40.00%     66.67%    +26.67%\n"
+		"LDI          20.00%     33.33%    +13.33%\n");
+}
@@ -98,3 +98,28 @@ TEST_F(ATMega328, Test_INS_ADD_CarryFlag)
 	EXPECT_FALSE(cpu.IO.SREG.Z);
 	EXPECT_TRUE(cpu.IO.SREG.C);
 }
+
+TEST_F(ATMega328, Test_INS_ADD_SignFromNewFlags)
+{
+	cpu.R01 = 0x80;
+	cpu.R02 = 0x01;
+
+	// add r1,r2 ; 0x80 + 0x01, negative without an overflow
+	constexpr Word instruction =
+		Instruction::ADD
+		| 0b1'0000  // Rd = R1
+		| 0b0'0010; // Rr = R2
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory); // ADD takes 1 cycle
+
+	// Assert, S is N XOR V of this result, not the previous one
+	EXPECT_EQ(cpu.R01, 0x81);
+
+	EXPECT_TRUE(cpu.IO.SREG.S);
+	EXPECT_FALSE(cpu.IO.SREG.V);
+	EXPECT_TRUE(cpu.IO.SREG.N);
+}
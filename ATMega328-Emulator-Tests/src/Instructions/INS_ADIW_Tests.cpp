@@ -70,3 +70,65 @@ TEST_F(ATMega328, Test_INS_ADIW_ZPointer)
 	EXPECT_FALSE(cpu.IO.SREG.Z);
 	EXPECT_FALSE(cpu.IO.SREG.C);
 }
+
+TEST_F(ATMega328, Test_INS_ADIW_Overflow)
+{
+	cpu.R24 = 0xFF;
+	cpu.R25 = 0x7F;
+
+	// adiw r25:r24, 1
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::ADIW | 1, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // ADIW takes 2 cycles
+
+	// Assert, V and C look at bit 15 of the word, not bit 7 of the low byte
+	EXPECT_EQ(*(Word*)&cpu.R24, 0x8000);
+
+	EXPECT_FALSE(cpu.IO.SREG.S);
+	EXPECT_TRUE(cpu.IO.SREG.V);
+	EXPECT_TRUE(cpu.IO.SREG.N);
+	EXPECT_FALSE(cpu.IO.SREG.Z);
+	EXPECT_FALSE(cpu.IO.SREG.C);
+}
+
+TEST_F(ATMega328, Test_INS_ADIW_NoCarryFromLowByte)
+{
+	cpu.R24 = 0x80;
+	cpu.R25 = 0x00;
+
+	// adiw r25:r24, 1
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::ADIW | 1, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory);
+
+	// Assert
+	EXPECT_EQ(*(Word*)&cpu.R24, 0x0081);
+
+	EXPECT_FALSE(cpu.IO.SREG.V);
+	EXPECT_FALSE(cpu.IO.SREG.C);
+}
+
+TEST_F(ATMega328, Test_INS_ADIW_Carry)
+{
+	cpu.Y = 0xFFC1;
+
+	// adiw r29:r28, 63
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::ADIW | (2 << 4) | 0b1100'1111, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.Y, 0x0000);
+
+	EXPECT_FALSE(cpu.IO.SREG.S);
+	EXPECT_FALSE(cpu.IO.SREG.V);
+	EXPECT_FALSE(cpu.IO.SREG.N);
+	EXPECT_TRUE(cpu.IO.SREG.Z);
+	EXPECT_TRUE(cpu.IO.SREG.C);
+}
@@ -0,0 +1,55 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_BLD)
+{
+	CPU cpuCopy = cpu;
+
+	cpu.R20 = 0x00;
+	cpu.IO.SREG.T = 1;
+
+	// bld r20, 3 ; Load T into bit 3 of r20
+	constexpr Word instruction =
+		Instruction::BLD
+		| 0b1'0100'0000 // Rd = R20
+		| 0b011;        // b = 3
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory); // BLD takes 1 cycle
+
+	// Assert
+	EXPECT_EQ(cpu.R20, 0x08);
+
+	EXPECT_EQ(cpu.IO.SREG.I, cpuCopy.IO.SREG.I);
+	EXPECT_EQ(cpu.IO.SREG.H, cpuCopy.IO.SREG.H);
+	EXPECT_EQ(cpu.IO.SREG.S, cpuCopy.IO.SREG.S);
+	EXPECT_EQ(cpu.IO.SREG.V, cpuCopy.IO.SREG.V);
+	EXPECT_EQ(cpu.IO.SREG.N, cpuCopy.IO.SREG.N);
+	EXPECT_EQ(cpu.IO.SREG.Z, cpuCopy.IO.SREG.Z);
+	EXPECT_EQ(cpu.IO.SREG.C, cpuCopy.IO.SREG.C);
+}
+
+TEST_F(ATMega328, Test_INS_BLD_ClearsBit)
+{
+	cpu.R20 = 0xFF;
+	cpu.IO.SREG.T = 0;
+
+	// bld r20, 3
+	constexpr Word instruction =
+		Instruction::BLD
+		| 0b1'0100'0000 // Rd = R20
+		| 0b011;        // b = 3
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.R20, 0xF7);
+}
@@ -0,0 +1,52 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_BRBC)
+{
+	cpu.PC = 0x10;
+	cpu.IO.SREG.Z = 0;
+
+	// brne .+6
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::BRBC | (3 << 3) | 1, 0x10 * 2, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // Taken branches take 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0x14);
+	EXPECT_EQ(cpu.CycleCount, 2);
+}
+
+TEST_F(ATMega328, Test_INS_BRBC_Backwards)
+{
+	cpu.PC = 0x100;
+	cpu.IO.SREG.Z = 0;
+
+	// brne .-128, the furthest back a branch goes
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::BRBC | (-64 & 0x7F) << 3 | 1, 0x100 * 2, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0x101 - 64);
+}
+
+TEST_F(ATMega328, Test_INS_BRBS_Backwards)
+{
+	cpu.PC = 0x10;
+	cpu.IO.SREG.Z = 1;
+
+	// breq .-4
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::BRBS | (-2 & 0x7F) << 3 | 1, 0x10 * 2, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0xF);
+}
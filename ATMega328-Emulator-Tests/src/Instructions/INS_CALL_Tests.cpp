@@ -0,0 +1,62 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_CALL)
+{
+	CPU cpuCopy = cpu;
+	cpu.PC = 0x10;
+
+	// call 0x200 ; Word address 0x100
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::CALL, 0x10 * 2, dummyCycles);
+	memory.WriteWord(0x100, 0x11 * 2, dummyCycles);
+
+	// Act
+	cpu.Execute(4, memory); // CALL takes 4 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0x100);
+	EXPECT_EQ(cpu.CycleCount, 4);
+
+	// Return address 0x12, low byte pushed first
+	EXPECT_EQ(cpu.IO.SP, CPU::RAMEND - 2);
+	EXPECT_EQ(cpu.ReadData(CPU::RAMEND), 0x12);
+	EXPECT_EQ(cpu.ReadData(CPU::RAMEND - 1), 0x00);
+
+	EXPECT_EQ(*(Byte*)&cpu.IO.SREG, *(Byte*)&cpuCopy.IO.SREG);
+}
+
+TEST_F(ATMega328, Test_INS_RCALL)
+{
+	cpu.PC = 0x10;
+
+	// rcall .-8 ; 4 words back
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::RCALL | 0xFFC, 0x10 * 2, dummyCycles);
+
+	// Act
+	cpu.Execute(3, memory); // RCALL takes 3 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0x0D);
+	EXPECT_EQ(cpu.CycleCount, 3);
+	EXPECT_EQ(cpu.PopWord(), 0x11);
+}
+
+TEST_F(ATMega328, Test_INS_ICALL)
+{
+	cpu.Z = 0x123;
+
+	// icall
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::ICALL, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(3, memory); // ICALL takes 3 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0x123);
+	EXPECT_EQ(cpu.CycleCount, 3);
+	EXPECT_EQ(cpu.PopWord(), 0x01);
+}
@@ -0,0 +1,60 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_CPC)
+{
+	CPU cpuCopy = cpu;
+
+	cpu.R03 = 0x12;
+	cpu.R02 = 0x12;
+	cpu.IO.SREG.Z = 1;
+
+	// cpc r3,r2 ; Compare high byte, the low bytes were equal
+	constexpr Word instruction =
+		Instruction::CPC
+		| 0b11'0000  // Rd = R3
+		| 0b00'0010; // Rr = R2
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory); // CPC takes 1 cycle
+
+	// Assert
+	EXPECT_EQ(cpu.R03, 0x12);
+
+	EXPECT_EQ(cpu.IO.SREG.I, cpuCopy.IO.SREG.I);
+	EXPECT_EQ(cpu.IO.SREG.T, cpuCopy.IO.SREG.T);
+
+	EXPECT_FALSE(cpu.IO.SREG.H);
+	EXPECT_FALSE(cpu.IO.SREG.S);
+	EXPECT_FALSE(cpu.IO.SREG.V);
+	EXPECT_FALSE(cpu.IO.SREG.N);
+	EXPECT_TRUE(cpu.IO.SREG.Z);
+	EXPECT_FALSE(cpu.IO.SREG.C);
+}
+
+TEST_F(ATMega328, Test_INS_CPC_ZeroKeepsZ)
+{
+	cpu.R03 = 0x12;
+	cpu.R02 = 0x12;
+	cpu.IO.SREG.Z = 0;
+
+	// cpc r3,r2 ; The low bytes differed, so the words do too
+	constexpr Word instruction =
+		Instruction::CPC
+		| 0b11'0000  // Rd = R3
+		| 0b00'0010; // Rr = R2
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory);
+
+	// Assert, a zero result leaves Z alone
+	EXPECT_FALSE(cpu.IO.SREG.Z);
+	EXPECT_FALSE(cpu.IO.SREG.C);
+}
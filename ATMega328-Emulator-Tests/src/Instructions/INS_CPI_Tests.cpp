@@ -0,0 +1,37 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_CPI)
+{
+	CPU cpuCopy = cpu;
+
+	cpu.R02 = 0x55; // Where r18 would be if the base register was r0
+	cpu.R18 = 0x01;
+
+	//cpi r18,0x01 ; Compare r18 with 0x01
+	constexpr Word instruction =
+		Instruction::CPI
+		| 0b10'0000 // Rd = R18
+		| 0b0001;   // K = 0x01
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory); // CPI takes 1 cycle
+
+	// Assert
+	EXPECT_EQ(cpu.R18, 0x01);
+	EXPECT_EQ(cpu.R02, 0x55);
+
+	EXPECT_EQ(cpu.IO.SREG.I, cpuCopy.IO.SREG.I);
+	EXPECT_EQ(cpu.IO.SREG.T, cpuCopy.IO.SREG.T);
+
+	EXPECT_FALSE(cpu.IO.SREG.H);
+	EXPECT_FALSE(cpu.IO.SREG.S);
+	EXPECT_FALSE(cpu.IO.SREG.V);
+	EXPECT_FALSE(cpu.IO.SREG.N);
+	EXPECT_TRUE(cpu.IO.SREG.Z);
+	EXPECT_FALSE(cpu.IO.SREG.C);
+}
@@ -31,7 +31,7 @@ TEST_F(ATMega328, Test_INS_EOR)
 	EXPECT_EQ(cpu.IO.SREG.T, cpuCopy.IO.SREG.T);
 	EXPECT_EQ(cpu.IO.SREG.H, cpuCopy.IO.SREG.H);
 
-	EXPECT_FALSE(cpu.IO.SREG.S);
+	EXPECT_TRUE(cpu.IO.SREG.S); // N XOR V
 	EXPECT_FALSE(cpu.IO.SREG.V);
 	EXPECT_TRUE(cpu.IO.SREG.N);
 	EXPECT_FALSE(cpu.IO.SREG.Z);
@@ -0,0 +1,51 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_FMUL)
+{
+	cpu.R16 = 0xFF;
+	cpu.R17 = 0xFF;
+
+	// fmul r16,r17 ; 0xFF * 0xFF = 0xFE01, shifted left
+	constexpr Word instruction =
+		Instruction::FMUL
+		| 0b000'0000 // Rd = R16
+		| 0b001;     // Rr = R17
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // FMUL takes 2 cycles
+
+	// Assert, C is bit 15 of the product before the shift
+	EXPECT_EQ(*(Word*)&cpu.R00, 0xFC02);
+
+	EXPECT_FALSE(cpu.IO.SREG.Z);
+	EXPECT_TRUE(cpu.IO.SREG.C);
+}
+
+TEST_F(ATMega328, Test_INS_FMULS)
+{
+	cpu.R18 = 0xC0; // -64
+	cpu.R19 = 0x04;
+
+	// fmuls r18,r19 ; -64 * 4 = 0xFF00, shifted left
+	constexpr Word instruction =
+		Instruction::FMULS
+		| 0b010'0000 // Rd = R18
+		| 0b011;     // Rr = R19
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // FMULS takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(*(Word*)&cpu.R00, 0xFE00);
+
+	EXPECT_FALSE(cpu.IO.SREG.Z);
+	EXPECT_TRUE(cpu.IO.SREG.C);
+}
@@ -0,0 +1,34 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_IN)
+{
+	*(Byte*)&cpu.IO.SREG = 0x83;
+
+	// in r20, SREG ; I/O address 0x3F
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::IN | (0b11 << 9) | (20 << 4) | 0xF, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory); // IN takes 1 cycle
+
+	// Assert
+	EXPECT_EQ(cpu.R20, 0x83);
+	EXPECT_EQ(cpu.CycleCount, 1);
+}
+
+TEST_F(ATMega328, Test_INS_OUT_HighRegister)
+{
+	cpu.R17 = 0x42;
+
+	// out 0x3E, r17 ; SPH, r17 needs the fifth bit of the register field
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::OUT | (0b11 << 9) | (17 << 4) | 0xE, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory); // OUT takes 1 cycle
+
+	// Assert
+	EXPECT_EQ(cpu.ReadData(CPU::IO_START + 0x3E), 0x42);
+}
@@ -0,0 +1,38 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_JMP)
+{
+	cpu.PC = 0x10;
+
+	// jmp 0x400 ; Word address 0x200
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::JMP, 0x10 * 2, dummyCycles);
+	memory.WriteWord(0x200, 0x11 * 2, dummyCycles);
+
+	// Act
+	cpu.Execute(3, memory); // JMP takes 3 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0x200);
+	EXPECT_EQ(cpu.IO.SP, CPU::RAMEND);
+	EXPECT_EQ(cpu.CycleCount, 3);
+}
+
+TEST_F(ATMega328, Test_INS_IJMP)
+{
+	cpu.Z = 0x1234;
+
+	// ijmp
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::IJMP, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // IJMP takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0x1234);
+	EXPECT_EQ(cpu.IO.SP, CPU::RAMEND);
+	EXPECT_EQ(cpu.CycleCount, 2);
+}
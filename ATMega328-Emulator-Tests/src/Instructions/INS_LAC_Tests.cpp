@@ -0,0 +1,56 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_LAC)
+{
+	cpu.Z = CPU::SRAM_START;
+	cpu.WriteData(CPU::SRAM_START, 0xFF);
+	cpu.WriteData(CPU::SRAM_START + CPU::SRAM_START, 0xFF);
+	cpu.R16 = 0x0F;
+
+	// lac Z, r16 ; Z is a data space address
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::LAC | (16 << 4), 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // LAC takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.ReadData(CPU::SRAM_START), 0xF0);
+	EXPECT_EQ(cpu.ReadData(CPU::SRAM_START + CPU::SRAM_START), 0xFF);
+}
+
+TEST_F(ATMega328, Test_INS_LAS)
+{
+	cpu.Z = CPU::SRAM_START;
+	cpu.WriteData(CPU::SRAM_START, 0x01);
+	cpu.R16 = 0x80;
+
+	// las Z, r16
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::LAS | (16 << 4), 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.ReadData(CPU::SRAM_START), 0x81);
+}
+
+TEST_F(ATMega328, Test_INS_LAT)
+{
+	cpu.Z = CPU::SRAM_START;
+	cpu.WriteData(CPU::SRAM_START, 0x0F);
+	cpu.R16 = 0xFF;
+
+	// lat Z, r16
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::LAT | (16 << 4), 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.ReadData(CPU::SRAM_START), 0xF0);
+}
@@ -0,0 +1,110 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_LD_X)
+{
+	cpu.X = CPU::SRAM_START + 0x20;
+	cpu.WriteData(CPU::SRAM_START + 0x20, 0x5A);
+
+	// ld r3, X
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::LD_X | (3 << 4), 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // LD takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.R03, 0x5A);
+	EXPECT_EQ(cpu.X, CPU::SRAM_START + 0x20);
+	EXPECT_EQ(cpu.CycleCount, 2);
+}
+
+TEST_F(ATMega328, Test_INS_LD_PostIncrement)
+{
+	cpu.Y = CPU::SRAM_START;
+	cpu.WriteData(CPU::SRAM_START, 0x11);
+	cpu.WriteData(CPU::SRAM_START + 1, 0x22);
+
+	// ld r16, Y+
+	// ld r17, Y+
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::LD_Y_INC | (16 << 4), 0x0, dummyCycles);
+	memory.WriteWord(Instruction::LD_Y_INC | (17 << 4), 0x2, dummyCycles);
+
+	// Act
+	cpu.Execute(4, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.R16, 0x11);
+	EXPECT_EQ(cpu.R17, 0x22);
+	EXPECT_EQ(cpu.Y, CPU::SRAM_START + 2);
+}
+
+TEST_F(ATMega328, Test_INS_LD_PreDecrement)
+{
+	cpu.Z = CPU::SRAM_START + 1;
+	cpu.WriteData(CPU::SRAM_START, 0x33);
+
+	// ld r0, -Z
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::LD_Z_DEC, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.R00, 0x33);
+	EXPECT_EQ(cpu.Z, CPU::SRAM_START);
+}
+
+TEST_F(ATMega328, Test_INS_LDD)
+{
+	cpu.Y = CPU::SRAM_START;
+	cpu.WriteData(CPU::SRAM_START + 63, 0x44);
+
+	// ldd r20, Y+63 ; The largest displacement, q is spread over bits 13, 11-10 and 2-0
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::LDD_Y | (20 << 4) | (1 << 13) | (0b11 << 10) | 0b111, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // LDD takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.R20, 0x44);
+	EXPECT_EQ(cpu.Y, CPU::SRAM_START);
+	EXPECT_EQ(cpu.CycleCount, 2);
+}
+
+TEST_F(ATMega328, Test_INS_LDS)
+{
+	cpu.WriteData(0x0123, 0x66);
+
+	// lds r7, 0x0123
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::LDS | (7 << 4), 0x0, dummyCycles);
+	memory.WriteWord(0x0123, 0x2, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // LDS takes 2 cycles
+
+	// Assert, k is a data space address, registers and I/O included
+	EXPECT_EQ(cpu.R07, 0x66);
+	EXPECT_EQ(cpu.PC, 2);
+}
+
+TEST_F(ATMega328, Test_INS_LDS_IORegister)
+{
+	cpu.IO.SREG.C = 1;
+
+	// lds r16, 0x005F ; SREG through its data space address
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::LDS | (16 << 4), 0x0, dummyCycles);
+	memory.WriteWord(CPU::IO_START + 0x3F, 0x2, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.R16, 0x01);
+}
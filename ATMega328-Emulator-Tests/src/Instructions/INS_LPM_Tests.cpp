@@ -0,0 +1,41 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_LPM)
+{
+	int dummyCycles = 0;
+	memory.Write(0xAB, 0x101, dummyCycles);
+	cpu.Z = 0x101; // A byte address, the high byte of word 0x80
+
+	// lpm ; r0 = (Z)
+	memory.WriteWord(Instruction::LPM, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(3, memory); // LPM takes 3 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.R00, 0xAB);
+	EXPECT_EQ(cpu.Z, 0x101);
+	EXPECT_EQ(cpu.CycleCount, 3);
+}
+
+TEST_F(ATMega328, Test_INS_LPM_PostIncrement)
+{
+	int dummyCycles = 0;
+	memory.WriteWord(0xBEEF, 0x100, dummyCycles);
+	cpu.Z = 0x100;
+
+	// lpm r24, Z+
+	// lpm r25, Z+
+	memory.WriteWord(Instruction::LPM_Z_INC | (24 << 4), 0x0, dummyCycles);
+	memory.WriteWord(Instruction::LPM_Z_INC | (25 << 4), 0x2, dummyCycles);
+
+	// Act
+	cpu.Execute(6, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.R24, 0xEF);
+	EXPECT_EQ(cpu.R25, 0xBE);
+	EXPECT_EQ(cpu.Z, 0x102);
+}
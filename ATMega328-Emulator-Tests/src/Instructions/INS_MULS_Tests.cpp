@@ -0,0 +1,30 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_MULS)
+{
+	cpu.R01 = 0x55; // Where r17 would be if the base register was r0
+	cpu.R02 = 0x55;
+	cpu.R17 = 0xFE; // -2
+	cpu.R18 = 0x03;
+
+	// muls r17,r18 ; -2 * 3
+	constexpr Word instruction =
+		Instruction::MULS
+		| 0b0001'0000 // Rd = R17
+		| 0b0010;     // Rr = R18
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // MULS takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(*(Word*)&cpu.R00, 0xFFFA);
+	EXPECT_EQ(cpu.R02, 0x55);
+
+	EXPECT_FALSE(cpu.IO.SREG.Z);
+	EXPECT_TRUE(cpu.IO.SREG.C);
+}
@@ -32,3 +32,29 @@ TEST_F(ATMega328, Test_INS_NEG)
 	EXPECT_FALSE(cpu.IO.SREG.Z);
 	EXPECT_TRUE(cpu.IO.SREG.C);
 }
+
+TEST_F(ATMega328, Test_INS_NEG_HalfBorrow)
+{
+	cpu.R11 = 0x08;
+
+	// neg r11 ; 0 - 0x08 borrows from bit 4
+	constexpr Word instruction =
+		Instruction::NEG
+		| 0b1011'0000; // Rd = R11
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.R11, 0xF8);
+
+	EXPECT_TRUE(cpu.IO.SREG.H);
+	EXPECT_TRUE(cpu.IO.SREG.S);
+	EXPECT_FALSE(cpu.IO.SREG.V);
+	EXPECT_TRUE(cpu.IO.SREG.N);
+	EXPECT_FALSE(cpu.IO.SREG.Z);
+	EXPECT_TRUE(cpu.IO.SREG.C);
+}
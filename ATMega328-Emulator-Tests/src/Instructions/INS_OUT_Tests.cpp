@@ -0,0 +1,26 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_OUT)
+{
+	cpu.R01 = 0x55; // Where r17 would be with a 4-bit register field
+	cpu.R17 = 0xA5;
+
+	// out 0x1E, r17 ; GPIOR0
+	constexpr Word instruction =
+		Instruction::OUT
+		| 0b010'0000'0000 // A = 0x1E
+		| 0b1'0001'0000   // Rr = R17
+		| 0b1110;
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory); // OUT takes 1 cycle
+
+	// Assert
+	EXPECT_EQ(cpu.ReadData(CPU::IO_START + 0x1E), 0xA5);
+	EXPECT_EQ(cpu.CycleCount, 1);
+}
@@ -0,0 +1,37 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_PUSH)
+{
+	cpu.R17 = 0xAB;
+
+	// push r17
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::PUSH | (17 << 4), 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // PUSH takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.IO.SP, CPU::RAMEND - 1);
+	EXPECT_EQ(cpu.ReadData(CPU::RAMEND), 0xAB);
+	EXPECT_EQ(cpu.CycleCount, 2);
+}
+
+TEST_F(ATMega328, Test_INS_POP)
+{
+	cpu.Push(0xCD);
+
+	// pop r3
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::POP | (3 << 4), 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // POP takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.R03, 0xCD);
+	EXPECT_EQ(cpu.IO.SP, CPU::RAMEND);
+	EXPECT_EQ(cpu.CycleCount, 2);
+}
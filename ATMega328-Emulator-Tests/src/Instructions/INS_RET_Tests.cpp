@@ -0,0 +1,43 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_RET)
+{
+	CPU cpuCopy = cpu;
+	cpu.PushWord(0x1234);
+
+	// ret
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::RET, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(4, memory); // RET takes 4 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0x1234);
+	EXPECT_EQ(cpu.IO.SP, CPU::RAMEND);
+	EXPECT_EQ(cpu.CycleCount, 4);
+
+	EXPECT_EQ(*(Byte*)&cpu.IO.SREG, *(Byte*)&cpuCopy.IO.SREG);
+}
+
+TEST_F(ATMega328, Test_INS_RETI)
+{
+	cpu.PushWord(0x1234);
+	cpu.IO.SREG.I = 0;
+	cpu.InterruptDepth = 1;
+
+	// reti
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::RETI, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(4, memory); // RETI takes 4 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0x1234);
+	EXPECT_EQ(cpu.IO.SP, CPU::RAMEND);
+	EXPECT_TRUE(cpu.IO.SREG.I);
+	EXPECT_EQ(cpu.InterruptDepth, 0);
+}
@@ -0,0 +1,44 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_RJMP)
+{
+	CPU cpuCopy = cpu;
+
+	// rjmp .+10 ; Jump 5 words forward
+	constexpr Word instruction =
+		Instruction::RJMP
+		| 0x005; // k = 5
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // RJMP takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 6);
+	EXPECT_EQ(cpu.CycleCount, 2);
+
+	EXPECT_EQ(*(Byte*)&cpu.IO.SREG, *(Byte*)&cpuCopy.IO.SREG);
+}
+
+TEST_F(ATMega328, Test_INS_RJMP_Backwards)
+{
+	cpu.PC = 0x10;
+
+	// rjmp .-8 ; Jump 4 words back
+	constexpr Word instruction =
+		Instruction::RJMP
+		| 0xFFC; // k = -4
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x10 * 2, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // RJMP takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0x0D);
+}
@@ -0,0 +1,47 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_ROR)
+{
+	cpu.R10 = 0x03;
+	cpu.IO.SREG.C = 1;
+
+	// ror r10 ; Carry goes into bit 7, bit 0 into carry
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::ROR | (10 << 4), 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory); // ROR takes 1 cycle
+
+	// Assert
+	EXPECT_EQ(cpu.R10, 0x81);
+
+	EXPECT_TRUE(cpu.IO.SREG.C);
+	EXPECT_TRUE(cpu.IO.SREG.N);
+	EXPECT_FALSE(cpu.IO.SREG.V); // N XOR C
+	EXPECT_TRUE(cpu.IO.SREG.S);
+	EXPECT_FALSE(cpu.IO.SREG.Z);
+}
+
+TEST_F(ATMega328, Test_INS_ROR_Zero)
+{
+	cpu.R10 = 0x01;
+	cpu.IO.SREG.C = 0;
+
+	// ror r10
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::ROR | (10 << 4), 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.R10, 0x00);
+
+	EXPECT_TRUE(cpu.IO.SREG.C);
+	EXPECT_FALSE(cpu.IO.SREG.N);
+	EXPECT_TRUE(cpu.IO.SREG.V);
+	EXPECT_TRUE(cpu.IO.SREG.S);
+	EXPECT_TRUE(cpu.IO.SREG.Z);
+}
@@ -0,0 +1,72 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_SBIW)
+{
+	CPU cpuCopy = cpu;
+	cpu.X = 0x0100;
+
+	// sbiw r27:r26, 1
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::SBIW | (1 << 4) | 1, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // SBIW takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.X, 0x00FF);
+
+	EXPECT_EQ(cpu.IO.SREG.I, cpuCopy.IO.SREG.I);
+	EXPECT_EQ(cpu.IO.SREG.T, cpuCopy.IO.SREG.T);
+	EXPECT_EQ(cpu.IO.SREG.H, cpuCopy.IO.SREG.H);
+
+	EXPECT_FALSE(cpu.IO.SREG.S);
+	EXPECT_FALSE(cpu.IO.SREG.V);
+	EXPECT_FALSE(cpu.IO.SREG.N);
+	EXPECT_FALSE(cpu.IO.SREG.Z);
+	EXPECT_FALSE(cpu.IO.SREG.C);
+}
+
+TEST_F(ATMega328, Test_INS_SBIW_Borrow)
+{
+	cpu.R24 = 0x01;
+	cpu.R25 = 0x00;
+
+	// sbiw r25:r24, 2
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::SBIW | 2, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory);
+
+	// Assert
+	EXPECT_EQ(*(Word*)&cpu.R24, 0xFFFF);
+
+	EXPECT_TRUE(cpu.IO.SREG.S);
+	EXPECT_FALSE(cpu.IO.SREG.V);
+	EXPECT_TRUE(cpu.IO.SREG.N);
+	EXPECT_FALSE(cpu.IO.SREG.Z);
+	EXPECT_TRUE(cpu.IO.SREG.C);
+}
+
+TEST_F(ATMega328, Test_INS_SBIW_Overflow)
+{
+	cpu.Z = 0x8000;
+
+	// sbiw r31:r30, 1
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::SBIW | (3 << 4) | 1, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.Z, 0x7FFF);
+
+	EXPECT_TRUE(cpu.IO.SREG.S);
+	EXPECT_TRUE(cpu.IO.SREG.V);
+	EXPECT_FALSE(cpu.IO.SREG.N);
+	EXPECT_FALSE(cpu.IO.SREG.Z);
+	EXPECT_FALSE(cpu.IO.SREG.C);
+}
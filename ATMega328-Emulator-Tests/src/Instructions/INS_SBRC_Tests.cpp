@@ -0,0 +1,88 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_SBRC)
+{
+	cpu.R04 = 0b1111'0111;
+
+	// sbrc r4, 3 ; Bit 3 is clear, so the next instruction is skipped
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::SBRC | (4 << 4) | 3, 0x0, dummyCycles);
+
+	// Act
+	RunResult result = cpu.Run(1, StopConditions(), memory);
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 2);
+	EXPECT_EQ(result.Cycles, 2);
+}
+
+TEST_F(ATMega328, Test_INS_SBRS_NotSkipped)
+{
+	cpu.R04 = 0b1111'0111;
+
+	// sbrs r4, 3
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::SBRS | (4 << 4) | 3, 0x0, dummyCycles);
+
+	// Act
+	RunResult result = cpu.Run(1, StopConditions(), memory);
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 1);
+	EXPECT_EQ(result.Cycles, 1);
+}
+
+TEST_F(ATMega328, Test_INS_SBRS_TwoWord)
+{
+	cpu.R31 = 0x80;
+
+	// sbrs r31, 7
+	// jmp 0x100
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::SBRS | (31 << 4) | 7, 0x0, dummyCycles);
+	memory.WriteWord(Instruction::JMP, 0x2, dummyCycles);
+	memory.WriteWord(0x100, 0x4, dummyCycles);
+
+	// Act
+	RunResult result = cpu.Run(1, StopConditions(), memory);
+
+	// Assert, both words of the JMP were skipped
+	EXPECT_EQ(cpu.PC, 3);
+	EXPECT_EQ(result.Cycles, 3);
+}
+
+TEST_F(ATMega328, Test_INS_SBIC)
+{
+	cpu.WriteData(CPU::IO_START + 0x09, 0b0000'0100); // PIND
+
+	// sbic PIND, 2 ; Set, so nothing is skipped
+	// sbic PIND, 3 ; Clear, so the next instruction is skipped
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::SBIC | (0x09 << 3) | 2, 0x0, dummyCycles);
+	memory.WriteWord(Instruction::SBIC | (0x09 << 3) | 3, 0x2, dummyCycles);
+
+	// Act
+	RunResult result = cpu.Run(2, StopConditions(), memory);
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 3);
+	EXPECT_EQ(result.Cycles, 3);
+}
+
+TEST_F(ATMega328, Test_INS_SBIS)
+{
+	cpu.WriteData(CPU::IO_START + 0x09, 0b0000'0100); // PIND
+
+	// sbis PIND, 2 ; Set, so the next instruction is skipped
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::SBIS | (0x09 << 3) | 2, 0x0, dummyCycles);
+
+	// Act
+	RunResult result = cpu.Run(1, StopConditions(), memory);
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 2);
+	EXPECT_EQ(result.Cycles, 2);
+}
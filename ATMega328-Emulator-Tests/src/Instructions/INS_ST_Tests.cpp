@@ -0,0 +1,73 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_ST_PostIncrement)
+{
+	cpu.X = CPU::SRAM_START + 0x10;
+	cpu.R05 = 0xA5;
+
+	// st X+, r5
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::ST_X_INC | (5 << 4), 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // ST takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.ReadData(CPU::SRAM_START + 0x10), 0xA5);
+	EXPECT_EQ(cpu.X, CPU::SRAM_START + 0x11);
+	EXPECT_EQ(cpu.CycleCount, 2);
+}
+
+TEST_F(ATMega328, Test_INS_ST_PreDecrement)
+{
+	cpu.Y = CPU::SRAM_START + 0x10;
+	cpu.R18 = 0x3C;
+
+	// st -Y, r18
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::ST_Y_DEC | (18 << 4), 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.ReadData(CPU::SRAM_START + 0xF), 0x3C);
+	EXPECT_EQ(cpu.Y, CPU::SRAM_START + 0xF);
+}
+
+TEST_F(ATMega328, Test_INS_STD)
+{
+	cpu.Z = CPU::SRAM_START;
+	cpu.R09 = 0x77;
+
+	// std Z+9, r9
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::STD_Z | (9 << 4) | (0b01 << 10) | 0b001, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // STD takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.ReadData(CPU::SRAM_START + 9), 0x77);
+	EXPECT_EQ(cpu.Z, CPU::SRAM_START);
+}
+
+TEST_F(ATMega328, Test_INS_STS)
+{
+	cpu.R30 = 0x99;
+
+	// sts 0x0200, r30
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::STS | (30 << 4), 0x0, dummyCycles);
+	memory.WriteWord(0x0200, 0x2, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // STS takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.ReadData(0x0200), 0x99);
+	EXPECT_EQ(cpu.PC, 2);
+	EXPECT_EQ(cpu.CycleCount, 2);
+}
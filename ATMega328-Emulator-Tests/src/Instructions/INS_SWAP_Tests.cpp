@@ -0,0 +1,20 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Test_INS_SWAP)
+{
+	CPU cpuCopy = cpu;
+	cpu.R01 = 0x1E;
+
+	// swap r1
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::SWAP | (1 << 4), 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(1, memory); // SWAP takes 1 cycle
+
+	// Assert
+	EXPECT_EQ(cpu.R01, 0xE1);
+	EXPECT_EQ(*(Byte*)&cpu.IO.SREG, *(Byte*)&cpuCopy.IO.SREG);
+}
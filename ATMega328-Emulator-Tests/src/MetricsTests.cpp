@@ -0,0 +1,166 @@
+#include "TestHardware.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+#include "ATMega328Emulator/Assembler.h"
+#include "ATMega328Emulator/Metrics.h"
+
+namespace {
+
+	using namespace asm_;
+
+	// 3 cycles a loop
+	constexpr auto LOOP = Assemble(
+		label("loop"),
+		inc(r16),
+		rjmp("loop"));
+
+}
+
+TEST_F(ATMega328, Metrics_CountRuns)
+{
+	asm_::Load(LOOP, memory);
+
+	Metrics metrics;
+	cpu.AttachedMetrics = metrics.Register("worker0");
+
+	// Act
+	cpu.Run(30, StopConditions(), memory);
+	StopConditions conditions;
+	conditions.StopOnPC = true;
+	conditions.PC = 1;
+	cpu.Run(30, conditions, memory);
+
+	// Assert
+	MetricsSample sample = metrics.Sample(0);
+	EXPECT_EQ(sample.Name, "worker0");
+	EXPECT_EQ(sample.Instructions, 21);
+	EXPECT_EQ(sample.Cycles, 31);
+	EXPECT_EQ(sample.Runs, 2);
+	EXPECT_EQ(sample.Stops[(size_t)StopReason::CycleBudget], 1);
+	EXPECT_EQ(sample.Stops[(size_t)StopReason::PCMatch], 1);
+	EXPECT_GT(sample.ExecuteNanoseconds, 0);
+}
+
+TEST_F(ATMega328, Metrics_CountInterrupts)
+{
+	Metrics metrics;
+	cpu.AttachedMetrics = metrics.Register("worker0");
+
+	// Act, the second one is masked
+	cpu.IO.SREG.I = 1;
+	cpu.EnterInterrupt(1);
+	cpu.EnterInterrupt(2);
+
+	// Assert
+	EXPECT_EQ(metrics.Sample(0).Interrupts, 1);
+}
+
+TEST(Metrics, Metrics_Capacity)
+{
+	Metrics metrics(2);
+
+	// Act
+	MetricsCounters* first = metrics.Register("a");
+	MetricsCounters* second = metrics.Register(std::string(100, 'b'));
+	MetricsCounters* third = metrics.Register("c");
+
+	// Assert
+	EXPECT_NE(first, nullptr);
+	EXPECT_NE(second, nullptr);
+	EXPECT_EQ(third, nullptr);
+	EXPECT_EQ(metrics.GetCount(), 2);
+	EXPECT_EQ(metrics.Sample(1).Name, std::string(MetricsFormat::NAME_SIZE - 1, 'b'));
+
+	// Counter blocks don't share cache lines
+	EXPECT_EQ((uintptr_t)first % MetricsFormat::CACHE_LINE_SIZE, 0);
+	EXPECT_GE((uintptr_t)second - (uintptr_t)first, MetricsFormat::CACHE_LINE_SIZE);
+}
+
+TEST(Metrics, Metrics_Prometheus)
+{
+	Metrics metrics;
+	MetricsCounters* counters = metrics.Register("rig \"7\"");
+	RunResult result;
+	result.Reason = StopReason::Break;
+	result.Cycles = 2'000'000;
+	result.Instructions = 1'500'000;
+
+	// Act
+	counters->OnRun(result, 100'000'000);
+	std::ostringstream out;
+	metrics.WritePrometheus(out);
+
+	// Assert
+	const std::string text = out.str();
+	EXPECT_NE(text.find("# TYPE atmega328_cycles_total counter\n"), std::string::npos);
+	EXPECT_NE(text.find("atmega328_instructions_retired_total{worker=\"rig \\\"7\\\"\"} 1500000\n"), std::string::npos);
+	EXPECT_NE(text.find("atmega328_run_stops_total{worker=\"rig \\\"7\\\"\",reason=\"break\"} 1\n"), std::string::npos);
+	EXPECT_NE(text.find("atmega328_execute_seconds_total{worker=\"rig \\\"7\\\"\"} 0.100000000\n"), std::string::npos);
+	EXPECT_NE(text.find("atmega328_emulated_mhz{worker=\"rig \\\"7\\\"\"} 20.000\n"), std::string::npos);
+}
+
+TEST(Metrics, Metrics_Share)
+{
+	std::string filepath = (std::filesystem::temp_directory_path() / "Metrics_Share.bin").string();
+	Metrics metrics(4);
+	ASSERT_TRUE(metrics.Share(filepath));
+	MetricsCounters* counters = metrics.Register("shared");
+	RunResult result;
+	result.Cycles = 0x1234;
+
+	// Act
+	counters->OnRun(result, 1);
+
+	// Assert, what a scraper reading the file sees
+	std::ifstream file(filepath, std::ios::binary);
+	std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	ASSERT_EQ(data.size(), MetricsFormat::HEADER_SIZE + 4 * sizeof(MetricsCounters));
+	EXPECT_EQ(data.compare(0, 4, "AVRM"), 0);
+	EXPECT_EQ(data[0x0C], 1);
+
+	const char* block = data.data() + MetricsFormat::HEADER_SIZE;
+	EXPECT_EQ((Byte)block[0x08], 0x34);
+	EXPECT_EQ((Byte)block[0x09], 0x12);
+	EXPECT_STREQ(block + 0x78, "shared");
+
+	// Too late once something is registered
+	EXPECT_FALSE(metrics.Share(filepath));
+	std::filesystem::remove(filepath);
+}
+
+TEST_F(ATMega328, Metrics_ReadWhileRunning)
+{
+	asm_::Load(LOOP, memory);
+
+	Metrics metrics;
+	cpu.AttachedMetrics = metrics.Register("worker0");
+	std::atomic<bool> done = false;
+
+	// Act, a reader samples while the CPU runs on another thread
+	std::thread worker([&]() {
+		for (int i = 0; i < 1000; ++i) {
+			cpu.Run(300, StopConditions(), memory);
+		}
+		done = true;
+	});
+
+	uint64_t last = 0;
+	bool monotonic = true;
+	while (!done) {
+		const uint64_t cycles = metrics.Sample(0).Cycles;
+		monotonic &= cycles >= last;
+		last = cycles;
+	}
+	worker.join();
+
+	// Assert
+	EXPECT_TRUE(monotonic);
+	EXPECT_EQ(metrics.Sample(0).Cycles, 300'000);
+	EXPECT_EQ(metrics.Sample(0).Runs, 1000);
+}
@@ -0,0 +1,120 @@
+#include "TestHardware.h"
+
+#include <string>
+#include <string_view>
+
+#include "ATMega328Emulator/Assembler.h"
+#include "ATMega328Emulator/OutputMatcher.h"
+#include "ATMega328Emulator/Scheduler.h"
+#include "ATMega328Emulator/USART.h"
+
+namespace {
+
+	using namespace asm_;
+
+	// Sends '0', '1', '2'... at 1600 cycles a frame, like the USART tests
+	constexpr auto COUNT_OUT = Assemble(
+		ldi(r16, 9),
+		sts(USART::UBRR0_ADDRESS, r16),
+		ldi(r16, USART::TXEN0),
+		sts(USART::UCSR0B_ADDRESS, r16),
+		ldi(r18, '0'),
+		label("wait"),
+		lds(r17, USART::UCSR0A_ADDRESS),
+		sbrs(r17, 5),
+		rjmp("wait"),
+		sts(USART::UDR0_ADDRESS, r18),
+		inc(r18),
+		rjmp("wait"));
+
+	bool Feed(OutputMatcher& matcher, std::string_view text, uint64_t cycle = 0)
+	{
+		return matcher.Feed({ (const Byte*)text.data(), text.size() }, cycle);
+	}
+
+}
+
+TEST(OutputMatcher, OutputMatcher_OverlappingLiterals)
+{
+	OutputMatcher matcher;
+	const int pass = matcher.AddLiteral("PASS");
+	const int ss = matcher.AddLiteral("SS", false);
+	const int as = matcher.AddLiteral("ASSERT", false);
+
+	// Act, split across feeds
+	EXPECT_FALSE(Feed(matcher, "ASSERT ok, PA"));
+	EXPECT_TRUE(Feed(matcher, "SS\n", 42));
+
+	// Assert
+	ASSERT_TRUE(matcher.GetTerminalMatch());
+	EXPECT_EQ(matcher.GetTerminalMatch()->Id, pass);
+	EXPECT_EQ(matcher.GetTerminalMatch()->Cycle, 42);
+	EXPECT_EQ(matcher.GetTerminalMatch()->Offset, 15);
+	EXPECT_EQ(matcher.GetMatchCount(ss), 2);
+	EXPECT_EQ(matcher.GetFirstMatch(ss).Offset, 3);
+	EXPECT_EQ(matcher.GetMatchCount(as), 1);
+}
+
+TEST(OutputMatcher, OutputMatcher_Regex)
+{
+	OutputMatcher matcher;
+	const int fail = matcher.AddRegex("FAIL\\(\\d+\\)");
+	const int test = matcher.AddRegex("[Tt]est [a-z_]+ ?ok", false);
+
+	// Act
+	EXPECT_FALSE(Feed(matcher, "test one ok\nTest two_b ok\nFAIL() FAIL(x"));
+	EXPECT_TRUE(Feed(matcher, "FAIL(12)", 7));
+
+	// Assert
+	EXPECT_EQ(matcher.GetMatchCount(test), 2);
+	ASSERT_TRUE(matcher.GetTerminalMatch());
+	EXPECT_EQ(matcher.GetTerminalMatch()->Id, fail);
+	EXPECT_EQ(matcher.GetTerminalMatch()->Cycle, 7);
+
+	// Starting over keeps the patterns
+	matcher.Reset();
+	EXPECT_FALSE(matcher.GetTerminalMatch());
+	EXPECT_TRUE(Feed(matcher, "FAIL(3)"));
+}
+
+TEST(OutputMatcher, OutputMatcher_BadPatterns)
+{
+	OutputMatcher matcher;
+	EXPECT_EQ(matcher.AddLiteral(""), -1);
+	EXPECT_EQ(matcher.AddRegex(""), -1);
+	EXPECT_EQ(matcher.AddRegex("a*b?"), -1);  // Matches the empty string
+	EXPECT_EQ(matcher.AddRegex("*a"), -1);
+	EXPECT_EQ(matcher.AddRegex("a|b"), -1);
+	EXPECT_EQ(matcher.AddRegex("[abc"), -1);
+	EXPECT_EQ(matcher.AddRegex("[z-a]"), -1);
+	EXPECT_EQ(matcher.AddRegex(std::string(65, 'a')), -1);
+	EXPECT_EQ(matcher.GetPatternCount(), 0);
+}
+
+TEST_F(ATMega328, OutputMatcher_StopsExecute)
+{
+	asm_::Load(COUNT_OUT, memory);
+	RegisterHooks hooks;
+	USART usart;
+	Scheduler scheduler;
+	cpu.AttachedRegisterHooks = &hooks;
+	usart.Attach(hooks);
+	scheduler.Add(&usart);
+	usart.Reset(cpu);
+
+	OutputMatcher matcher;
+	matcher.AddRegex("3\\d5");
+	usart.SetMatcher(&matcher);
+
+	// Act, a timeout of a second
+	const bool finished = scheduler.Execute(cpu, memory, CPU::FREQUENCY);
+
+	// Assert, stopped on the sixth frame's end, a few setup cycles past 6 frames
+	EXPECT_FALSE(finished);
+	ASSERT_TRUE(matcher.GetTerminalMatch());
+	EXPECT_EQ(matcher.GetTerminalMatch()->Offset, 6);
+	EXPECT_GE(matcher.GetTerminalMatch()->Cycle, 6 * 1'600);
+	EXPECT_LT(matcher.GetTerminalMatch()->Cycle, 6 * 1'600 + 50);
+	EXPECT_GE(cpu.CycleCount, matcher.GetTerminalMatch()->Cycle);
+	EXPECT_LE(cpu.CycleCount, matcher.GetTerminalMatch()->Cycle + 4); // The last instruction may overshoot
+}
@@ -0,0 +1,109 @@
+#include "TestHardware.h"
+
+#include <chrono>
+#include <thread>
+
+#include "ATMega328Emulator/Assembler.h"
+#include "ATMega328Emulator/Pacer.h"
+
+namespace {
+
+	using namespace asm_;
+
+	// 3 cycles a loop
+	constexpr auto LOOP = Assemble(
+		label("loop"),
+		inc(r16),
+		rjmp("loop"));
+
+	// An event every Period cycles that takes the host Delay to handle
+	class SlowSource : public EventSource
+	{
+	public:
+		SlowSource(uint64_t period, std::chrono::microseconds delay)
+			: m_Period(period), m_Delay(delay), m_Next(period) {}
+
+		uint64_t GetNextEventCycle() const override { return m_Next; }
+
+		void HandleEvents(CPU& cpu, Memory&) override
+		{
+			std::this_thread::sleep_for(m_Delay);
+			while (m_Next <= cpu.CycleCount) {
+				m_Next += m_Period;
+			}
+		}
+
+	private:
+		uint64_t m_Period;
+		std::chrono::microseconds m_Delay;
+		uint64_t m_Next;
+	};
+
+}
+
+static_assert(Pacer::CyclesToNanoseconds(1) == 50);
+static_assert(Pacer::CyclesToNanoseconds(CPU::FREQUENCY) == 1'000'000'000);
+static_assert(Pacer::CyclesToNanoseconds(3'600ull * CPU::FREQUENCY * 24 * 365) == 3'600ull * 1'000'000'000 * 24 * 365);
+
+TEST_F(ATMega328, Pacer_KeepsWallTime)
+{
+	asm_::Load(LOOP, memory);
+	Pacer pacer;
+
+	// Act, 5ms of emulated time
+	const uint64_t start = Pacer::Now();
+	pacer.Execute(cpu, memory, 100'000);
+	const uint64_t elapsed = Pacer::Now() - start;
+
+	// Assert, never ahead of wall time, and synced more than once
+	EXPECT_GE(cpu.CycleCount, 100'000);
+	EXPECT_GE(elapsed + pacer.GetOptions().JitterBoundNanoseconds, Pacer::CyclesToNanoseconds(cpu.CycleCount));
+	EXPECT_GT(pacer.GetStats().Quanta, 1);
+}
+
+TEST_F(ATMega328, Pacer_QuantumFitsJitterBound)
+{
+	asm_::Load(LOOP, memory);
+	PacingOptions options;
+	options.JitterBoundNanoseconds = 50'000;
+	Pacer pacer(options);
+
+	// Act
+	pacer.Execute(cpu, memory, 40'000);
+
+	// Assert, at least the bound's worth of cycles, a host that runs ahead only runs ahead by part of a quantum
+	EXPECT_GE(pacer.GetStats().QuantumCycles, 1'000);
+	EXPECT_LE(pacer.GetStats().QuantumCycles, options.MaxQuantumCycles);
+}
+
+TEST_F(ATMega328, Pacer_ReportsOverruns)
+{
+	asm_::Load(LOOP, memory);
+	PacingOptions options;
+	options.ResyncNanoseconds = 3'000'000;
+	Pacer pacer(options);
+
+	// 50us of emulated time between events that take the host 1ms
+	SlowSource source(1'000, std::chrono::microseconds(1'000));
+	Scheduler scheduler;
+	scheduler.Add(&source);
+
+	uint64_t overruns = 0;
+	uint64_t lastCycle = 0;
+	pacer.SetOverrunCallback([&](uint64_t cycle, uint64_t lag) {
+		++overruns;
+		lastCycle = cycle;
+		EXPECT_GT(lag, options.JitterBoundNanoseconds);
+	});
+
+	// Act
+	pacer.Execute(scheduler, cpu, memory, 10'000);
+
+	// Assert
+	const PacingStats& stats = pacer.GetStats();
+	EXPECT_GT(stats.Overruns, 0);
+	EXPECT_EQ(overruns, stats.Overruns);
+	EXPECT_LE(lastCycle, cpu.CycleCount);
+	EXPECT_GT(stats.Resyncs, 0);
+	EXPECT_GT(stats.MaxLagNanoseconds, options.ResyncNanoseconds);
+}
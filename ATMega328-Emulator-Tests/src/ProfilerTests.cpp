@@ -0,0 +1,91 @@
+#include "TestHardware.h"
+
+#include <sstream>
+
+#include "ATMega328Emulator/Instructions.h"
+#include "ATMega328Emulator/Profiler.h"
+
+namespace {
+
+	// 0: inc r16
+	// 1: rjmp 0
+	// 3 cycles a loop
+	void LoadLoop(Memory& memory)
+	{
+		int dummyCycles = 0;
+		memory.WriteWord(Instruction::INC | (16 << 4), 0x0 * 2, dummyCycles);
+		memory.WriteWord(Instruction::RJMP | (-2 & 0xFFF), 0x1 * 2, dummyCycles);
+	}
+
+}
+
+TEST_F(ATMega328, Profiler_CountsPerPC)
+{
+	LoadLoop(memory);
+	cpu.R16 = 0;
+
+	Profiler profiler;
+	cpu.AttachedProfiler = &profiler;
+
+	// Act
+	cpu.Run(30, StopConditions(), memory);
+
+	// Assert
+#ifdef ATMEGA328_PROFILING
+	EXPECT_EQ(profiler.Get(0).Executions, 10);
+	EXPECT_EQ(profiler.Get(0).Cycles, 10);
+	EXPECT_EQ(profiler.Get(1).Executions, 10);
+	EXPECT_EQ(profiler.Get(1).Cycles, 20);
+	EXPECT_EQ(profiler.Get(2).Executions, 0);
+
+	EXPECT_EQ(profiler.GetTotalExecutions(), 20);
+	EXPECT_EQ(profiler.GetTotalCycles(), cpu.CycleCount);
+#else
+	EXPECT_EQ(profiler.GetTotalExecutions(), 0);
+#endif
+	EXPECT_EQ(cpu.R16, 10);
+}
+
+TEST_F(ATMega328, Profiler_Detached)
+{
+	LoadLoop(memory);
+
+	Profiler profiler;
+	cpu.AttachedProfiler = &profiler;
+	cpu.Run(30, StopConditions(), memory);
+
+	// Act
+	cpu.AttachedProfiler = nullptr;
+	cpu.Run(30, StopConditions(), memory);
+
+	// Assert, only the first run was counted
+	EXPECT_LE(profiler.GetTotalCycles(), 30);
+}
+
+#ifdef ATMEGA328_PROFILING
+TEST_F(ATMega328, Profiler_Export)
+{
+	LoadLoop(memory);
+
+	Profiler profiler;
+	cpu.AttachedProfiler = &profiler;
+	cpu.Run(30, StopConditions(), memory);
+
+	// Act
+	std::ostringstream callgrind;
+	profiler.WriteCallgrind(callgrind);
+
+	std::ostringstream pprof;
+	profiler.WritePprof(pprof);
+
+	// Assert, byte addresses with executions and cycles
+	EXPECT_NE(callgrind.str().find("events: Executions Cycles\n"), std::string::npos);
+	EXPECT_NE(callgrind.str().find("\n0x0 10 10\n"), std::string::npos);
+	EXPECT_NE(callgrind.str().find("\n0x2 10 20\n"), std::string::npos);
+
+	// Starts with the first sample_type, field 1 length delimited
+	ASSERT_FALSE(pprof.str().empty());
+	EXPECT_EQ((Byte)pprof.str()[0], (1 << 3) | 2);
+	EXPECT_NE(pprof.str().find("0x0002"), std::string::npos);
+}
+#endif
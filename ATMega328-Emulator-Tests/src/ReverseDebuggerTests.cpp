@@ -0,0 +1,355 @@
+#include "TestHardware.h"
+
+#include <span>
+#include <string>
+
+#include "ATMega328Emulator/ReverseDebugger.h"
+#include "ATMega328Emulator/Assembler.h"
+#include "ATMega328Emulator/Instructions.h"
+#include "ATMega328Emulator/SPI.h"
+#include "ATMega328Emulator/USART.h"
+
+static void LoadIncrementProgram(CPU& cpu, Memory& memory)
+{
+	int dummyCycles = 0;
+
+	// inc r16 ; Over and over
+	for (Word i = 0; i < 400; ++i) {
+		memory.WriteWord(Instruction::INC | (16 << 4), i * 2, dummyCycles);
+	}
+
+	// lat Z,r16 ; Toggle (Z) with r16, Z points at the start of the SRAM
+	cpu.Z = CPU::SRAM_START;
+	memory.WriteWord(Instruction::LAT | (16 << 4), 100 * 2, dummyCycles);
+	memory.WriteWord(Instruction::LAT | (16 << 4), 150 * 2, dummyCycles);
+}
+
+TEST_F(ATMega328, ReverseDebugger_StepBack)
+{
+	LoadIncrementProgram(cpu, memory);
+
+	ReverseDebugger::Config config;
+	config.InitialInterval = 16;
+	ReverseDebugger debugger(cpu, memory, config);
+
+	debugger.Execute(200);
+	ASSERT_EQ(cpu.CycleCount, 200);
+	EXPECT_EQ(cpu.PC, 198); // Both LAT take 2 cycles
+
+	// Act
+	EXPECT_TRUE(debugger.StepBack());
+
+	// Assert
+	EXPECT_EQ(cpu.CycleCount, 199);
+	EXPECT_EQ(cpu.PC, 197);
+
+	// Act, step back over a two cycle instruction
+	EXPECT_TRUE(debugger.SeekTo(153));
+	EXPECT_EQ(cpu.PC, 151);
+	EXPECT_TRUE(debugger.StepBack());
+
+	// Assert
+	EXPECT_EQ(cpu.CycleCount, 151);
+	EXPECT_EQ(cpu.PC, 150);
+}
+
+TEST_F(ATMega328, ReverseDebugger_ReplayMatchesForwardExecution)
+{
+	LoadIncrementProgram(cpu, memory);
+
+	CPU reference = cpu;
+	reference.Execute(180, memory);
+
+	ReverseDebugger::Config config;
+	config.InitialInterval = 16;
+	ReverseDebugger debugger(cpu, memory, config);
+
+	debugger.Execute(300);
+
+	// Act
+	EXPECT_TRUE(debugger.SeekTo(180));
+
+	// Assert
+	EXPECT_EQ(cpu.CycleCount, reference.CycleCount);
+	EXPECT_EQ(cpu.PC, reference.PC);
+	EXPECT_EQ(cpu.R16, reference.R16);
+	EXPECT_EQ(cpu.SRAM[0], reference.SRAM[0]);
+	EXPECT_EQ(*(Byte*)&cpu.IO.SREG, *(Byte*)&reference.IO.SREG);
+}
+
+TEST_F(ATMega328, ReverseDebugger_RunBackToWrite)
+{
+	LoadIncrementProgram(cpu, memory);
+
+	ReverseDebugger::Config config;
+	config.InitialInterval = 16;
+	ReverseDebugger debugger(cpu, memory, config);
+
+	debugger.Execute(300);
+
+	// Act
+	EXPECT_TRUE(debugger.RunBackToWrite(CPU::SRAM_START + 0x0));
+
+	// Assert, stopped right before the second LAT
+	EXPECT_EQ(cpu.PC, 150);
+	EXPECT_EQ(cpu.CycleCount, 151);
+
+	// Act
+	EXPECT_TRUE(debugger.RunBackToWrite(CPU::SRAM_START + 0x0));
+
+	// Assert, stopped right before the first LAT
+	EXPECT_EQ(cpu.PC, 100);
+	EXPECT_EQ(cpu.CycleCount, 100);
+
+	// Act, nothing wrote this before
+	EXPECT_FALSE(debugger.RunBackToWrite(CPU::SRAM_START + 0x0));
+
+	// Assert, state is untouched
+	EXPECT_EQ(cpu.PC, 100);
+	EXPECT_EQ(cpu.CycleCount, 100);
+}
+
+TEST_F(ATMega328, ReverseDebugger_StaysWithinMemoryBudget)
+{
+	LoadIncrementProgram(cpu, memory);
+
+	ReverseDebugger::Config config;
+	config.InitialInterval = 1;
+	config.MemoryBudget = 48 * 1024; // The base snapshot alone holds the 32KB flash
+	ReverseDebugger debugger(cpu, memory, config);
+
+	// Act
+	debugger.Execute(400);
+
+	// Assert
+	EXPECT_LE(debugger.GetMemoryUsage(), config.MemoryBudget);
+	EXPECT_GT(debugger.GetInterval(), 1);
+
+	EXPECT_TRUE(debugger.SeekTo(250));
+	EXPECT_EQ(cpu.CycleCount, 250);
+}
+
+TEST_F(ATMega328, ReverseDebugger_ReplayDetachesObservers)
+{
+	LoadIncrementProgram(cpu, memory);
+
+	int writes = 0;
+	Watchpoints watchpoints;
+	watchpoints.Add(WatchSpace::Data, CPU::SRAM_START, 1, WatchAccess::Write);
+	watchpoints.SetCallback([&](const WatchEvent&) { ++writes; return false; });
+	cpu.AttachedWatchpoints = &watchpoints;
+
+	ReverseDebugger::Config config;
+	config.InitialInterval = 16;
+	ReverseDebugger debugger(cpu, memory, config);
+
+	debugger.Execute(300);
+	ASSERT_EQ(writes, 2);
+
+	// Act
+	EXPECT_TRUE(debugger.SeekTo(180));
+	EXPECT_TRUE(debugger.StepBack());
+	EXPECT_TRUE(debugger.RunBackToWrite(CPU::SRAM_START + 0x0));
+
+	// Assert, the replays didn't count and the watchpoints are attached again
+	EXPECT_EQ(writes, 2);
+	EXPECT_EQ(cpu.AttachedWatchpoints, &watchpoints);
+	EXPECT_EQ(cpu.PC, 150);
+}
+
+TEST_F(ATMega328, ReverseDebugger_RunBackToRegisterWrite)
+{
+	LoadIncrementProgram(cpu, memory);
+
+	// ldi r17,1 ; Before everything else
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::LDI | (1 << 4) | 1, 0, dummyCycles);
+
+	ReverseDebugger::Config config;
+	config.InitialInterval = 16;
+	ReverseDebugger debugger(cpu, memory, config);
+
+	debugger.Execute(300);
+
+	// Act, registers are single stepped
+	EXPECT_TRUE(debugger.RunBackToWrite(16));
+
+	// Assert, stopped right before the last INC
+	EXPECT_EQ(cpu.PC, 297);
+	EXPECT_EQ(cpu.CycleCount, 299);
+
+	// Act, the LDI is further back than a checkpoint interval
+	EXPECT_FALSE(debugger.RunBackToWrite(17));
+
+	// Assert, state is untouched
+	EXPECT_EQ(cpu.PC, 297);
+	EXPECT_EQ(cpu.CycleCount, 299);
+
+	// Act, Assert, from close enough it is found
+	EXPECT_TRUE(debugger.SeekTo(10));
+	EXPECT_TRUE(debugger.RunBackToWrite(17));
+	EXPECT_EQ(cpu.PC, 0);
+	EXPECT_EQ(cpu.CycleCount, 0);
+}
+
+TEST_F(ATMega328, ReverseDebugger_CheckpointsUSART)
+{
+	using namespace asm_;
+
+	// Polls RXC0, stores what it receives from the start of the SRAM and sends it back
+	constexpr auto ECHO = Assemble(
+		ldi(r16, 9),
+		sts(USART::UBRR0_ADDRESS, r16),
+		ldi(r16, USART::RXEN0 | USART::TXEN0),
+		sts(USART::UCSR0B_ADDRESS, r16),
+		ldi(r26, CPU::SRAM_START & 0xFF),
+		ldi(r27, CPU::SRAM_START >> 8),
+		label("wait"),
+		lds(r17, USART::UCSR0A_ADDRESS),
+		sbrs(r17, 7),
+		rjmp("wait"),
+		lds(r18, USART::UDR0_ADDRESS),
+		st(X_INC, r18),
+		sts(USART::UDR0_ADDRESS, r18),
+		rjmp("wait"));
+
+	// UBRR0 9 is 1600 cycles an 8N1 frame
+	constexpr uint64_t FRAME_CYCLES = 1'600;
+
+	asm_::Load(ECHO, memory);
+	RegisterHooks hooks;
+	USART usart;
+	cpu.AttachedRegisterHooks = &hooks;
+	usart.Attach(hooks);
+	usart.Reset(cpu);
+	usart.Receive({ (const Byte*)"hello", 5 });
+
+	ReverseDebugger::Config config;
+	config.InitialInterval = 1'000;
+	ReverseDebugger debugger(cpu, memory, config);
+
+	debugger.Execute(FRAME_CYCLES * 7);
+	const CPU forward = cpu;
+	std::string sent(usart.GetTransmitted().GetSize(), '\0');
+	sent.resize(usart.GetTransmitted().Read((Byte*)sent.data(), sent.size()));
+	ASSERT_EQ(sent, "hello");
+
+	// Act, go back to the middle of the third frame and run to the end again
+	EXPECT_TRUE(debugger.SeekTo(FRAME_CYCLES * 5 / 2));
+	EXPECT_EQ(std::string((const char*)cpu.SRAM, 5), std::string("he\0\0\0", 5));
+	debugger.Execute(forward.CycleCount - cpu.CycleCount);
+
+	// Assert, the bytes arrived again at the same cycles and weren't sent to the host twice
+	EXPECT_EQ(cpu.CycleCount, forward.CycleCount);
+	EXPECT_EQ(cpu.PC, forward.PC);
+	EXPECT_EQ(cpu.X, forward.X);
+	EXPECT_EQ(std::string((const char*)cpu.SRAM, 5), "hello");
+	EXPECT_EQ(usart.GetStats().Received, 5);
+	EXPECT_EQ(usart.GetStats().Transmitted, 5);
+	EXPECT_TRUE(usart.GetTransmitted().IsEmpty());
+
+	// Act, Assert, stepping back over the last UDR0 read puts the byte back in the receive buffer
+	EXPECT_TRUE(debugger.RunBackToWrite(CPU::SRAM_START + 4));
+	EXPECT_EQ(cpu.PC, 14); // st X+,r18
+	EXPECT_EQ(cpu.X, forward.X - 1);
+	EXPECT_EQ(usart.GetStats().Received, 5);
+	EXPECT_TRUE(usart.GetTransmitted().IsEmpty());
+}
+
+TEST_F(ATMega328, ReverseDebugger_CheckpointsSPI)
+{
+	using namespace asm_;
+
+	// Sends 1 to 4 and stores what comes back from the start of the SRAM
+	constexpr auto EXCHANGE = Assemble(
+		ldi(r16, SPI::SPE | SPI::MSTR),
+		out(SPI::SPCR_ADDRESS - CPU::IO_START, r16),
+		ldi(r26, CPU::SRAM_START & 0xFF),
+		ldi(r27, CPU::SRAM_START >> 8),
+		ldi(r18, 1),
+		label("next"),
+		out(SPI::SPDR_ADDRESS - CPU::IO_START, r18),
+		label("wait"),
+		in(r17, SPI::SPSR_ADDRESS - CPU::IO_START),
+		sbrs(r17, 7),
+		rjmp("wait"),
+		in(r17, SPI::SPDR_ADDRESS - CPU::IO_START),
+		st(X_INC, r17),
+		inc(r18),
+		cpi(r18, 5),
+		brne("next"),
+		label("done"),
+		rjmp("done"));
+
+	// Answers with each byte times three
+	class Device : public SPIDevice
+	{
+	public:
+		void Select() override { ++Selects; }
+
+		void Transfer(std::span<const Byte> mosi, std::span<Byte> miso) override
+		{
+			for (size_t i = 0; i < mosi.size(); ++i) {
+				miso[i] = mosi[i] * 3;
+			}
+			Bytes += mosi.size();
+		}
+
+	public:
+		size_t Bytes = 0;
+		int Selects = 0;
+	} device;
+
+	asm_::Load(EXCHANGE, memory);
+	RegisterHooks hooks;
+	SPI spi;
+	cpu.AttachedRegisterHooks = &hooks;
+	spi.AddDevice(&device);
+	spi.Attach(hooks, memory);
+	spi.Reset(cpu);
+
+	ReverseDebugger::Config config;
+	config.InitialInterval = 16;
+	ReverseDebugger debugger(cpu, memory, config);
+
+	debugger.Execute(300);
+	const CPU forward = cpu;
+	ASSERT_EQ(std::string((const char*)cpu.SRAM, 4), "\3\6\x9\xC");
+	ASSERT_EQ(device.Bytes, 4);
+
+	// Act
+	EXPECT_TRUE(debugger.SeekTo(60));
+	EXPECT_TRUE(debugger.StepBack());
+	EXPECT_TRUE(debugger.SeekTo(forward.CycleCount));
+
+	// Assert, the answers were read again without the device seeing the bytes twice
+	EXPECT_EQ(cpu.PC, forward.PC);
+	EXPECT_EQ(std::string((const char*)cpu.SRAM, 4), "\3\6\x9\xC");
+	EXPECT_EQ(spi.GetStats().Bytes, 4);
+	EXPECT_EQ(device.Bytes, 4);
+	EXPECT_EQ(device.Selects, 1);
+}
+
+TEST_F(ATMega328, ReverseDebugger_RefusesHooksWithoutState)
+{
+	class Plain : public RegisterHook
+	{
+	public:
+		Byte OnRead(CPU&, Word, Byte value, uint64_t) override { return value; }
+		Byte OnWrite(CPU&, Word, Byte value, uint64_t) override { return value; }
+	} plain;
+
+	RegisterHooks hooks;
+	hooks.Add(CPU::SRAM_START - 1, 1, &plain);
+	cpu.AttachedRegisterHooks = &hooks;
+
+	// Act, Assert
+	EXPECT_THROW(ReverseDebugger(cpu, memory), std::invalid_argument);
+
+	cpu.AttachedRegisterHooks = nullptr;
+	ReverseDebugger debugger(cpu, memory);
+	debugger.Execute(100);
+	cpu.AttachedRegisterHooks = &hooks;
+	EXPECT_THROW(debugger.StepBack(), std::invalid_argument);
+	EXPECT_THROW(debugger.Execute(100), std::invalid_argument);
+}
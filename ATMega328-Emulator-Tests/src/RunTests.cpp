@@ -0,0 +1,159 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Run_CycleBudget)
+{
+	// Act, the program is all NOPs
+	RunResult result = cpu.Run(100, StopConditions(), memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::CycleBudget);
+	EXPECT_EQ(result.Cycles, 100);
+	EXPECT_EQ(result.Instructions, 100);
+	EXPECT_EQ(cpu.CycleCount, 100);
+	EXPECT_EQ(cpu.PC, 100);
+}
+
+TEST_F(ATMega328, Run_CycleTarget)
+{
+	cpu.Execute(10, memory);
+
+	StopConditions conditions;
+	conditions.CycleTarget = 50;
+
+	// Act
+	RunResult result = cpu.Run(1000, conditions, memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::CycleTarget);
+	EXPECT_EQ(result.Cycles, 40);
+	EXPECT_EQ(cpu.CycleCount, 50);
+}
+
+TEST_F(ATMega328, Run_PCMatch)
+{
+	StopConditions conditions;
+	conditions.StopOnPC = true;
+	conditions.PC = 0x20;
+
+	// Act
+	RunResult result = cpu.Run(1000, conditions, memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::PCMatch);
+	EXPECT_EQ(result.Instructions, 0x20);
+	EXPECT_EQ(cpu.PC, 0x20);
+
+	// Act, continuing from the match doesn't stop right away
+	result = cpu.Run(10, conditions, memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::CycleBudget);
+}
+
+TEST_F(ATMega328, Run_Break)
+{
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::BREAK, 0x4 * 2, dummyCycles);
+
+	// Act, not armed it is a NOP
+	RunResult result = cpu.Run(10, StopConditions(), memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::CycleBudget);
+	EXPECT_EQ(cpu.PC, 10);
+
+	// Act
+	cpu.Reset(memory);
+	memory.WriteWord(Instruction::BREAK, 0x4 * 2, dummyCycles);
+
+	StopConditions conditions;
+	conditions.StopOnBreak = true;
+	result = cpu.Run(10, conditions, memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::Break);
+	EXPECT_EQ(result.Cycles, 4);
+	EXPECT_EQ(result.Instructions, 4);
+	EXPECT_EQ(cpu.PC, 0x4);
+	EXPECT_EQ(cpu.CycleCount, 4);
+}
+
+TEST_F(ATMega328, Run_IllegalOpcode)
+{
+	constexpr Word illegal = 0xFFFF;
+
+	int dummyCycles = 0;
+	memory.WriteWord(illegal, 0x2 * 2, dummyCycles);
+
+	StopConditions conditions;
+	conditions.StopOnIllegalOpcode = true;
+
+	// Act
+	RunResult result = cpu.Run(10, conditions, memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::IllegalOpcode);
+	EXPECT_EQ(result.Cycles, 2);
+	EXPECT_EQ(cpu.PC, 0x2);
+}
+
+TEST_F(ATMega328, Run_Sleep)
+{
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::SLEEP, 0x0, dummyCycles);
+	memory.WriteWord(Instruction::SLEEP, 0x2, dummyCycles);
+
+	StopConditions conditions;
+	conditions.StopOnSleep = true;
+
+	// Act, interrupts enabled so it could wake up
+	cpu.IO.SREG.I = 1;
+	RunResult result = cpu.Run(1, conditions, memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::CycleBudget);
+
+	// Act
+	cpu.IO.SREG.I = 0;
+	result = cpu.Run(10, conditions, memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::Sleep);
+	EXPECT_EQ(result.Cycles, 1);
+	EXPECT_EQ(cpu.PC, 0x2);
+}
+
+TEST_F(ATMega328, Run_SelfLoop)
+{
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::SELF_LOOP, 0x3 * 2, dummyCycles);
+
+	StopConditions conditions;
+	conditions.StopOnSelfLoop = true;
+
+	// Act
+	RunResult result = cpu.Run(1'000'000, conditions, memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::SelfLoop);
+	EXPECT_EQ(result.Cycles, 5); // 3 NOPs and an RJMP
+	EXPECT_EQ(cpu.PC, 0x3);
+}
+
+TEST_F(ATMega328, Run_CycleTargetPast32Bits)
+{
+	cpu.CycleCount = 5'000'000'000;
+
+	StopConditions conditions;
+	conditions.CycleTarget = 5'000'000'100;
+
+	// Act
+	RunResult result = cpu.Run(UINT64_MAX, conditions, memory);
+
+	// Assert
+	EXPECT_EQ(result.Reason, StopReason::CycleTarget);
+	EXPECT_EQ(result.Cycles, 100);
+	EXPECT_EQ(cpu.CycleCount, 5'000'000'100);
+}
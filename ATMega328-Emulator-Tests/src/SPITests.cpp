@@ -0,0 +1,328 @@
+#include "TestHardware.h"
+
+#include <array>
+#include <vector>
+
+#include "ATMega328Emulator/Assembler.h"
+#include "ATMega328Emulator/Scheduler.h"
+#include "ATMega328Emulator/SPI.h"
+
+namespace {
+
+	using namespace asm_;
+
+	constexpr int SPCR = SPI::SPCR_ADDRESS - CPU::IO_START;
+	constexpr int SPSR = SPI::SPSR_ADDRESS - CPU::IO_START;
+	constexpr int SPDR = SPI::SPDR_ADDRESS - CPU::IO_START;
+	constexpr int DDRB = SPI::PORTB_ADDRESS - 1 - CPU::IO_START;
+	constexpr int PORTB = SPI::PORTB_ADDRESS - CPU::IO_START;
+
+	// SPE and MSTR at the fastest divisor, 4, is 32 cycles a byte
+	constexpr uint64_t BYTE_CYCLES = 32;
+
+	// Selects the device on PB2, sends 0x10 to 0x2F polling SPIF with IN and deselects it
+	constexpr auto SEND = Assemble(
+		ldi(r16, SPI::SPE | SPI::MSTR),
+		out(SPCR, r16),
+		sbi(DDRB, 2),
+		ldi(r18, 0x10),
+		ldi(r19, 32),
+		label("next"),
+		out(SPDR, r18),
+		label("wait"),
+		in(r17, SPSR),
+		sbrs(r17, 7),
+		rjmp("wait"),
+		inc(r18),
+		dec(r19),
+		brne("next"),
+		sbi(PORTB, 2),
+		label("done"),
+		rjmp("done"));
+
+	// The same at a 128 divisor, polling with LDS and some work between the write and the poll
+	constexpr auto SEND_SLOW = Assemble(
+		ldi(r16, SPI::SPE | SPI::MSTR | SPI::SPR1 | SPI::SPR0),
+		out(SPCR, r16),
+		ldi(r18, 0x10),
+		ldi(r19, 8),
+		label("next"),
+		out(SPDR, r18),
+		inc(r18),
+		nop(),
+		label("wait"),
+		lds(r17, SPI::SPSR_ADDRESS),
+		sbrs(r17, 7),
+		rjmp("wait"),
+		dec(r19),
+		brne("next"),
+		label("done"),
+		rjmp("done"));
+
+	// Sends 1 to 4 and stores what comes back from the start of the SRAM
+	constexpr auto EXCHANGE = Assemble(
+		ldi(r16, SPI::SPE | SPI::MSTR),
+		out(SPCR, r16),
+		ldi(r26, CPU::SRAM_START & 0xFF),
+		ldi(r27, CPU::SRAM_START >> 8),
+		ldi(r18, 1),
+		label("next"),
+		out(SPDR, r18),
+		label("wait"),
+		in(r17, SPSR),
+		sbrs(r17, 7),
+		rjmp("wait"),
+		in(r17, SPDR),
+		st(X_INC, r17),
+		inc(r18),
+		cpi(r18, 5),
+		brne("next"),
+		label("done"),
+		rjmp("done"));
+
+	// Writes SPDR twice in a row, then reads SPSR into r17
+	constexpr auto COLLIDE = Assemble(
+		ldi(r16, SPI::SPE | SPI::MSTR),
+		out(SPCR, r16),
+		ldi(r18, 0x55),
+		out(SPDR, r18),
+		out(SPDR, r18),
+		in(r17, SPSR),
+		label("done"),
+		rjmp("done"));
+
+	// Sends a byte with the interrupt enabled and parks
+	constexpr auto SEND_FROM_INTERRUPT = Assemble(
+		ldi(r16, SPI::SPIE | SPI::SPE | SPI::MSTR),
+		out(SPCR, r16),
+		sei(),
+		out(SPDR, r16),
+		label("park"),
+		rjmp("park"));
+
+	constexpr auto STC_HANDLER = Assemble(
+		inc(r20),
+		reti());
+
+	// Remembers what it was sent and answers with each byte plus one
+	class RecordingDevice : public SPIDevice
+	{
+	public:
+		void Select() override { ++Selects; }
+		void Deselect() override { ++Deselects; }
+
+		void Transfer(std::span<const Byte> mosi, std::span<Byte> miso) override
+		{
+			Runs.push_back(mosi.size());
+			for (size_t i = 0; i < mosi.size(); ++i) {
+				Received.push_back(mosi[i]);
+				miso[i] = mosi[i] + 1;
+			}
+		}
+
+	public:
+		std::vector<size_t> Runs;
+		std::vector<Byte> Received;
+		int Selects = 0;
+		int Deselects = 0;
+	};
+
+	class SPITest : public ATMega328
+	{
+	public:
+		void SetUp() override
+		{
+			ATMega328::SetUp();
+			cpu.AttachedRegisterHooks = &hooks;
+		}
+
+		// Attaches the SPI with the device on PB2, or always selected without a port
+		void Wire(Word port, const Memory& flash)
+		{
+			spi.AddDevice(&device, port, 2);
+			spi.Attach(hooks, flash);
+			scheduler.Add(&spi);
+			spi.Reset(cpu);
+		}
+
+		// Runs in short slices until the program reaches the rjmp to itself at its end
+		template<size_t N>
+		RunResult RunToDone(const std::array<Word, N>&)
+		{
+			StopConditions conditions;
+			conditions.StopOnPC = true;
+			conditions.PC = (Word)(N - 1);
+
+			RunResult total;
+			while (cpu.PC != conditions.PC && total.Cycles < 100'000) {
+				const RunResult result = cpu.Run(37, conditions, memory);
+				total.Cycles += result.Cycles;
+				total.Instructions += result.Instructions;
+			}
+			return total;
+		}
+
+	public:
+		RegisterHooks hooks;
+		SPI spi;
+		RecordingDevice device;
+		Scheduler scheduler;
+	};
+
+}
+
+TEST(SPI, SPI_ByteCycles)
+{
+	CPU cpu;
+	cpu.IO.SPCR = SPI::SPE | SPI::MSTR;
+	cpu.IO.SPSR = 0;
+	EXPECT_EQ(SPI::GetByteCycles(cpu), 8 * 4);
+
+	cpu.IO.SPCR |= SPI::SPR1;
+	EXPECT_EQ(SPI::GetByteCycles(cpu), 8 * 64);
+
+	cpu.IO.SPSR = SPI::SPI2X;
+	EXPECT_EQ(SPI::GetByteCycles(cpu), 8 * 32);
+}
+
+TEST_F(SPITest, SPI_BatchesWriteRuns)
+{
+	asm_::Load(SEND, memory);
+	Wire(SPI::PORTB_ADDRESS, memory);
+
+	// Act
+	RunToDone(SEND);
+
+	// Assert, one call for the whole run when the chip select went up
+	ASSERT_EQ(device.Runs.size(), 1);
+	EXPECT_EQ(device.Runs[0], 32);
+	ASSERT_EQ(device.Received.size(), 32);
+	EXPECT_EQ(device.Received[0], 0x10);
+	EXPECT_EQ(device.Received[31], 0x2F);
+	EXPECT_EQ(device.Selects, 1);
+	EXPECT_EQ(device.Deselects, 1);
+
+	EXPECT_EQ(spi.GetStats().Bytes, 32);
+	EXPECT_EQ(spi.GetStats().Transfers, 1);
+	EXPECT_GT(spi.GetStats().SkippedPolls, 32);
+}
+
+TEST_F(SPITest, SPI_SkippedPollsAreCycleExact)
+{
+	// An empty flash hides the polling loops from the SPI, so every iteration runs
+	Memory blank;
+	blank.Initialize();
+
+	auto send = [&](const Memory& flash, SPIStats& stats) {
+		cpu.Reset(memory);
+		asm_::Load(SEND_SLOW, memory);
+		SPI master;
+		master.AddDevice(&device);
+		master.Attach(hooks, flash);
+		master.Reset(cpu);
+		const RunResult result = RunToDone(SEND_SLOW);
+		stats = master.GetStats();
+		master.Detach();
+		return result;
+	};
+
+	// Act
+	SPIStats executedStats, skippedStats;
+	const RunResult executed = send(blank, executedStats);
+	const RunResult skipped = send(memory, skippedStats);
+
+	// Assert, 8 bytes of 1024 cycles back to back, plus the setup and the polls that see SPIF
+	EXPECT_EQ(skipped.Cycles, executed.Cycles);
+	EXPECT_GE(executed.Cycles, 8 * 1'024);
+	EXPECT_LT(executed.Cycles, 8 * 1'024 + 8 * 12);
+	EXPECT_EQ(cpu.R18, 0x18);
+	EXPECT_EQ(executedStats.SkippedPolls, 0);
+	EXPECT_EQ(skippedStats.Bytes, 8);
+	EXPECT_GT(skippedStats.SkippedPolls, 8 * 150);
+	EXPECT_LT(skipped.Instructions, executed.Instructions / 5); // The short slices cut every skip
+}
+
+TEST_F(SPITest, SPI_StopsInsideSkippedPolls)
+{
+	asm_::Load(SEND_SLOW, memory);
+	Wire(0, memory);
+
+	// The sbrs of the polling loop, after the lds at 7
+	StopConditions conditions;
+	conditions.StopOnPC = true;
+	conditions.PC = 9;
+	cpu.Run(100'000, conditions, memory);
+
+	// Act, once around the loop
+	const RunResult result = cpu.Run(100'000, conditions, memory);
+
+	// Assert, sbrs, rjmp and lds, the poll wasn't skipped past the stop
+	EXPECT_EQ(result.Reason, StopReason::PCMatch);
+	EXPECT_EQ(result.Instructions, 3);
+	EXPECT_EQ(result.Cycles, 5);
+	EXPECT_EQ(spi.GetStats().SkippedPolls, 0);
+}
+
+TEST_F(SPITest, SPI_ExchangesOnRead)
+{
+	asm_::Load(EXCHANGE, memory);
+	Wire(0, memory);
+
+	// Act
+	RunToDone(EXCHANGE);
+	spi.Flush(cpu);
+
+	// Assert, every read needs the answer to the byte before it
+	EXPECT_EQ(cpu.SRAM[0], 2);
+	EXPECT_EQ(cpu.SRAM[1], 3);
+	EXPECT_EQ(cpu.SRAM[2], 4);
+	EXPECT_EQ(cpu.SRAM[3], 5);
+	EXPECT_EQ(device.Runs, std::vector<size_t>({ 1, 1, 1, 1 }));
+	EXPECT_EQ(device.Selects, 1);
+}
+
+TEST_F(SPITest, SPI_NothingSelectedReadsHigh)
+{
+	asm_::Load(EXCHANGE, memory);
+	Wire(SPI::PORTB_ADDRESS, memory); // PB2 stays an input
+
+	// Act
+	RunToDone(EXCHANGE);
+
+	// Assert
+	EXPECT_EQ(cpu.SRAM[0], 0xFF);
+	EXPECT_EQ(cpu.SRAM[3], 0xFF);
+	EXPECT_TRUE(device.Runs.empty());
+	EXPECT_EQ(spi.GetStats().Bytes, 4);
+}
+
+TEST_F(SPITest, SPI_WriteCollision)
+{
+	asm_::Load(COLLIDE, memory);
+	Wire(0, memory);
+
+	// Act
+	RunToDone(COLLIDE);
+	cpu.Run(BYTE_CYCLES, StopConditions(), memory);
+	spi.Flush(cpu);
+
+	// Assert, the second write was lost
+	EXPECT_EQ(cpu.R17, SPI::WCOL);
+	EXPECT_EQ(spi.GetStats().Collisions, 1);
+	EXPECT_EQ(device.Received, std::vector<Byte>({ 0x55 }));
+}
+
+TEST_F(SPITest, SPI_TransferCompleteInterrupt)
+{
+	asm_::Load(SEND_FROM_INTERRUPT, memory);
+	asm_::Load(STC_HANDLER, memory, SPI::STC_VECTOR * 4);
+	Wire(0, memory);
+
+	// Act
+	scheduler.Execute(cpu, memory, BYTE_CYCLES * 4);
+
+	// Assert, entering the handler cleared SPIF
+	EXPECT_EQ(cpu.R20, 1);
+	EXPECT_FALSE(cpu.IO.SPSR & SPI::SPIF);
+	EXPECT_EQ(spi.GetStats().Bytes, 1);
+}
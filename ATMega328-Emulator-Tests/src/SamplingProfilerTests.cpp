@@ -0,0 +1,102 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+#include "ATMega328Emulator/SamplingProfiler.h"
+
+namespace {
+
+	// 0: inc r16
+	// 1: rjmp 0
+	// 3 cycles a loop
+	void LoadLoop(Memory& memory)
+	{
+		int dummyCycles = 0;
+		memory.WriteWord(Instruction::INC | (16 << 4), 0x0 * 2, dummyCycles);
+		memory.WriteWord(Instruction::RJMP | (-2 & 0xFFF), 0x1 * 2, dummyCycles);
+	}
+
+}
+
+TEST_F(ATMega328, SamplingProfiler_Samples)
+{
+	LoadLoop(memory);
+	cpu.R16 = 0;
+
+	SamplingProfiler sampler(100, 16);
+	cpu.AttachedSampler = &sampler;
+
+	// Act
+	RunResult result = cpu.Run(30'000, StopConditions(), memory);
+
+	// Assert, execution is unchanged
+	EXPECT_EQ(result.Cycles, 30'000);
+	EXPECT_EQ(result.Instructions, 20'000);
+	EXPECT_EQ(cpu.R16, (Byte)10'000);
+
+	// Between 50 and 150 cycles apart, plus an instruction's overshoot
+	EXPECT_GE(sampler.GetTotalSamples(), 30'000 / 152);
+	EXPECT_LE(sampler.GetTotalSamples(), 30'000 / 50);
+
+	std::vector<SamplingProfiler::Sample> samples = sampler.GetSamples();
+	ASSERT_EQ(samples.size(), 16);
+
+	bool pcs[2] = {};
+	for (size_t i = 0; i < samples.size(); ++i) {
+		ASSERT_LE(samples[i].PC, 1);
+		pcs[samples[i].PC] = true;
+
+		EXPECT_EQ(samples[i].SP, CPU::RAMEND);
+		EXPECT_EQ(samples[i].InterruptDepth, 0);
+		if (i) {
+			EXPECT_GE(samples[i].Cycle - samples[i - 1].Cycle, 50);
+			EXPECT_LE(samples[i].Cycle - samples[i - 1].Cycle, 152);
+		}
+	}
+
+	// The random interval doesn't lock onto the loop
+	EXPECT_TRUE(pcs[0] && pcs[1]);
+	EXPECT_LE(samples.back().Cycle, cpu.CycleCount);
+}
+
+TEST_F(ATMega328, SamplingProfiler_SpansRuns)
+{
+	LoadLoop(memory);
+
+	SamplingProfiler sampler(1000);
+	cpu.AttachedSampler = &sampler;
+
+	// Act, runs shorter than the interval
+	for (int i = 0; i < 100; ++i) {
+		cpu.Run(30, StopConditions(), memory);
+	}
+
+	// Assert
+	EXPECT_GE(sampler.GetTotalSamples(), 2);
+	EXPECT_LE(sampler.GetTotalSamples(), 6);
+}
+
+TEST_F(ATMega328, SamplingProfiler_InterruptContext)
+{
+	// The handler for vector 3 spins
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::RJMP | 0xFFF, 0x6 * 2, dummyCycles);
+
+	SamplingProfiler sampler(100);
+	cpu.AttachedSampler = &sampler;
+
+	// Act
+	cpu.IO.SREG.I = 1;
+	ASSERT_TRUE(cpu.EnterInterrupt(3));
+	cpu.Run(1000, StopConditions(), memory);
+
+	// Assert
+	std::vector<SamplingProfiler::Sample> samples = sampler.GetSamples();
+	ASSERT_FALSE(samples.empty());
+	for (const SamplingProfiler::Sample& sample : samples) {
+		EXPECT_EQ(sample.PC, 6);
+		EXPECT_EQ(sample.SP, CPU::RAMEND - 2);
+		EXPECT_EQ(sample.InterruptDepth, 1);
+		EXPECT_EQ(sample.InterruptVector, 3);
+		EXPECT_FALSE(sample.InterruptsEnabled);
+	}
+}
@@ -0,0 +1,140 @@
+#include "TestHardware.h"
+
+#include <algorithm>
+
+#include "ATMega328Emulator/Assembler.h"
+#include "ATMega328Emulator/Scheduler.h"
+
+namespace {
+
+	using namespace asm_;
+
+	constexpr Byte GPIOR0_IO = 0x1E;
+
+	// 3 cycles a loop
+	constexpr auto LOOP = Assemble(
+		label("loop"),
+		inc(r16),
+		rjmp("loop"));
+
+	// Waits for GPIOR0 to reach 5, then counts in r20
+	constexpr auto POLL = Assemble(
+		label("poll"),
+		in(r17, GPIOR0_IO),
+		cpi(r17, 5),
+		brcs("poll"),
+		label("after"),
+		inc(r20),
+		rjmp("after"));
+
+	// Counts its events in GPIOR0, one every Period cycles
+	class TickSource : public EventSource
+	{
+	public:
+		TickSource(uint64_t period, bool declareRegisters = true)
+			: m_Period(period), m_Next(period), m_DeclareRegisters(declareRegisters) {}
+
+		uint64_t GetNextEventCycle() const override { return m_Next; }
+
+		void HandleEvents(CPU& cpu, Memory&) override
+		{
+			++Calls;
+			while (m_Next <= cpu.CycleCount) {
+				MaxLateness = std::max(MaxLateness, cpu.CycleCount - m_Next);
+				++Ticks;
+				cpu.IO.GPIOR0 = (Byte)Ticks;
+				m_Next += m_Period;
+			}
+		}
+
+		std::vector<RegisterRange> GetRegisters() const override
+		{
+			if (!m_DeclareRegisters) {
+				return {};
+			}
+			return { { (Word)(CPU::IO_START + GPIOR0_IO), 1 } };
+		}
+
+		uint64_t Ticks = 0;
+		uint64_t Calls = 0;
+		uint64_t MaxLateness = 0;
+
+	private:
+		uint64_t m_Period;
+		uint64_t m_Next;
+		bool m_DeclareRegisters;
+	};
+
+}
+
+TEST_F(ATMega328, Scheduler_ExactEvents)
+{
+	asm_::Load(LOOP, memory);
+	TickSource source(10);
+	Scheduler scheduler;
+	scheduler.Add(&source);
+
+	// Act
+	scheduler.Execute(cpu, memory, 1'000);
+
+	// Assert, every event on the instruction boundary it was due at
+	EXPECT_EQ(source.Ticks, 100);
+	EXPECT_EQ(source.Calls, 100);
+	EXPECT_LE(source.MaxLateness, 1);
+}
+
+TEST_F(ATMega328, Scheduler_QuantumBatchesEvents)
+{
+	asm_::Load(LOOP, memory);
+	TickSource source(10);
+	Scheduler scheduler;
+	scheduler.Add(&source);
+	scheduler.SetQuantum(500);
+
+	// Act
+	scheduler.Execute(cpu, memory, 10'000);
+
+	// Assert, every event, late by up to the quantum, a slice per quantum
+	EXPECT_EQ(source.Ticks, 1'000);
+	EXPECT_LE(source.Calls, 21);
+	EXPECT_LE(source.MaxLateness, 500);
+	EXPECT_EQ(cpu.AttachedWatchpoints, nullptr);
+}
+
+TEST_F(ATMega328, Scheduler_RegisterAccessEndsQuantum)
+{
+	asm_::Load(POLL, memory);
+	cpu.IO.GPIOR0 = 0;
+	cpu.R20 = 0;
+	TickSource source(100);
+	Scheduler scheduler;
+	scheduler.Add(&source);
+	scheduler.SetQuantum(10'000);
+
+	// Act
+	scheduler.Execute(cpu, memory, 1'000);
+
+	// Assert, the loop saw the fifth event on the poll after it, with about 500 cycles left to count in
+	EXPECT_EQ(source.Ticks, 10);
+	EXPECT_GT(cpu.R20, 150);
+	EXPECT_EQ(cpu.AttachedWatchpoints, nullptr);
+}
+
+TEST_F(ATMega328, Scheduler_QuantumWithoutRegisters)
+{
+	asm_::Load(POLL, memory);
+	cpu.IO.GPIOR0 = 0;
+	cpu.R20 = 0;
+	TickSource source(100, false);
+	Scheduler scheduler;
+	scheduler.Add(&source);
+	scheduler.SetQuantum(10'000);
+
+	// Act
+	scheduler.Execute(cpu, memory, 1'000);
+
+	// Assert, nothing ended the quantum, so the loop never saw an event
+	EXPECT_EQ(source.Ticks, 10);
+	EXPECT_EQ(source.Calls, 1);
+	EXPECT_EQ(cpu.R20, 0);
+}
@@ -0,0 +1,144 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Snapshot.h"
+#include "ATMega328Emulator/Instructions.h"
+
+TEST_F(ATMega328, Snapshot_TracksDirtyPages)
+{
+	Snapshot base = Snapshot::Capture(cpu, memory);
+
+	EXPECT_EQ(cpu.DirtyData.GetDirtyCount(), 0);
+	EXPECT_EQ(cpu.DirtyEEPROM.GetDirtyCount(), 0);
+	EXPECT_EQ(memory.Dirty.GetDirtyCount(), 0);
+
+	cpu.WriteData(CPU::SRAM_START + 0x10, 0xAA);
+	cpu.WriteData(CPU::SRAM_START + 0x20, 0xBB); // Same page
+	cpu.WriteEEPROM(0x3FF, 0xCC);
+
+	int dummyCycles = 0;
+	memory.WriteWord(0x1234, 0x100, dummyCycles);
+
+	EXPECT_EQ(cpu.DirtyData.GetDirtyCount(), 1);
+	EXPECT_TRUE(cpu.DirtyData.IsDirty((CPU::SRAM_START + 0x10) / 64));
+	EXPECT_EQ(cpu.DirtyEEPROM.GetDirtyCount(), 1);
+	EXPECT_TRUE(cpu.DirtyEEPROM.IsDirty(0x3FF / 64));
+	EXPECT_EQ(memory.Dirty.GetDirtyCount(), 1);
+	EXPECT_TRUE(memory.Dirty.IsDirty(0x100 / 64));
+}
+
+TEST_F(ATMega328, Snapshot_InstructionStoresAreTracked)
+{
+	Snapshot base = Snapshot::Capture(cpu, memory);
+
+	cpu.Z = CPU::SRAM_START + 0x40;
+	cpu.R05 = 0x0F;
+
+	// las Z,r5 ; Load and set
+	constexpr Word instruction = Instruction::LAS | (5 << 4);
+
+	int dummyCycles = 0;
+	memory.WriteWord(instruction, 0x0, dummyCycles);
+
+	// Act
+	cpu.Execute(2, memory); // LAS takes 2 cycles
+
+	// Assert
+	EXPECT_EQ(cpu.SRAM[0x40], 0x0F);
+	EXPECT_TRUE(cpu.DirtyData.IsDirty((CPU::SRAM_START + 0x40) / 64));
+}
+
+TEST_F(ATMega328, Snapshot_IncrementalRestore)
+{
+	cpu.SRAM[0x100] = 0x11;
+	Snapshot base = Snapshot::Capture(cpu, memory);
+
+	cpu.R10 = 0x42;
+	cpu.WriteData(CPU::SRAM_START + 0x100, 0x22);
+	cpu.WriteEEPROM(0x10, 0x33);
+	int dummyCycles = 0;
+	memory.Write(0x44, 0x200, dummyCycles);
+
+	IncrementalSnapshot incremental = IncrementalSnapshot::Capture(base, cpu, memory);
+
+	EXPECT_EQ(incremental.GetPageCount(), 3);
+	EXPECT_LT(incremental.GetSize(), base.GetSize() / 10);
+
+	// Keep running, writing both the same and new pages
+	cpu.R10 = 0x00;
+	cpu.PC = 0x123;
+	cpu.WriteData(CPU::SRAM_START + 0x100, 0x55);
+	cpu.WriteData(CPU::SRAM_START + 0x700, 0x66);
+	cpu.WriteEEPROM(0x200, 0x77);
+	memory.Write(0x88, 0x400, dummyCycles);
+
+	// Act
+	incremental.Restore(base, cpu, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.R10, 0x42);
+	EXPECT_EQ(cpu.PC, 0x0);
+	EXPECT_EQ(cpu.SRAM[0x100], 0x22);
+	EXPECT_EQ(cpu.SRAM[0x700], 0x00);
+	EXPECT_EQ(cpu.EEPROM[0x10], 0x33);
+	EXPECT_EQ(cpu.EEPROM[0x200], 0x00);
+	EXPECT_EQ(memory[0x200], 0x44);
+	EXPECT_EQ(memory[0x400], 0x00);
+}
+
+TEST_F(ATMega328, Snapshot_FullRestore)
+{
+	cpu.R01 = 0x01;
+	cpu.SRAM[0x10] = 0x10;
+	Snapshot base = Snapshot::Capture(cpu, memory);
+
+	cpu.R01 = 0xFF;
+	cpu.WriteData(CPU::SRAM_START + 0x10, 0xFF);
+	int dummyCycles = 0;
+	memory.Write(0xFF, 0x0, dummyCycles);
+
+	// Act
+	base.Restore(cpu, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.R01, 0x01);
+	EXPECT_EQ(cpu.SRAM[0x10], 0x10);
+	EXPECT_EQ(memory[0x0], 0x00);
+	EXPECT_EQ(memory.Dirty.GetDirtyCount(), 0);
+}
+
+TEST_F(ATMega328, Snapshot_RestoreLeavesAttachmentsAlone)
+{
+	Snapshot base = Snapshot::Capture(cpu, memory);
+	IncrementalSnapshot incremental = IncrementalSnapshot::Capture(base, cpu, memory);
+
+	Watchpoints watchpoints;
+	cpu.AttachedWatchpoints = &watchpoints;
+	cpu.PC = 0x42;
+
+	// Act
+	base.Restore(cpu, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0x0);
+	EXPECT_EQ(cpu.AttachedWatchpoints, &watchpoints);
+
+	// Act
+	cpu.PC = 0x42;
+	incremental.Restore(base, cpu, memory);
+
+	// Assert
+	EXPECT_EQ(cpu.PC, 0x0);
+	EXPECT_EQ(cpu.AttachedWatchpoints, &watchpoints);
+}
+
+TEST_F(ATMega328, Snapshot_EEPROMAddressIsMasked)
+{
+	Snapshot base = Snapshot::Capture(cpu, memory);
+
+	// Act
+	cpu.WriteEEPROM(CPU::EEPROM_SIZE + 0x10, 0x5A);
+
+	// Assert
+	EXPECT_EQ(cpu.EEPROM[0x10], 0x5A);
+	EXPECT_TRUE(cpu.DirtyEEPROM.IsDirty(0x10 / 64));
+}
@@ -0,0 +1,187 @@
+#include "TestHardware.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include "ATMega328Emulator/Stimulus.h"
+#include "ATMega328Emulator/StimulusFile.h"
+#include "ATMega328Emulator/Scheduler.h"
+
+TEST_F(ATMega328, Stimulus_Apply)
+{
+	Stimulus{ 0, StimulusType::PINC, 0xA5 }.Apply(cpu);
+	Stimulus{ 0, StimulusType::UDR0, 'A' }.Apply(cpu);
+	Stimulus{ 0, StimulusType::ADC, 0x3FF }.Apply(cpu);
+
+	EXPECT_EQ(cpu.IO.PINC, 0xA5);
+
+	EXPECT_EQ(cpu.EXIO.UDR0, 'A');
+	EXPECT_TRUE(cpu.EXIO.UCSR0A & 0x80); // RXC0
+
+	EXPECT_EQ(cpu.EXIO.ADC, 0x3FF);
+	EXPECT_TRUE(cpu.EXIO.ADCSRA & 0x10); // ADIF
+}
+
+TEST_F(ATMega328, Stimulus_EncodingRoundTrip)
+{
+	std::vector<Byte> log;
+	uint64_t last = 0;
+	last = StimulusEncoding::Encode(log, { 5, StimulusType::PINB, 0x01 }, last);
+	last = StimulusEncoding::Encode(log, { 5, StimulusType::UDR0, 0x42 }, last);
+	last = StimulusEncoding::Encode(log, { 10'000'000'000, StimulusType::ADC, 0x2AB }, last);
+
+	EXPECT_EQ(log.size(), 3 + 3 + 8);
+
+	Stimulus stimulus = {};
+	const Byte* in = log.data();
+	const Byte* end = in + log.size();
+
+	in = StimulusEncoding::Decode(in, end, stimulus, 0);
+	ASSERT_NE(in, nullptr);
+	EXPECT_EQ(stimulus.Cycle, 5);
+	EXPECT_EQ(stimulus.Type, StimulusType::PINB);
+	EXPECT_EQ(stimulus.Value, 0x01);
+
+	in = StimulusEncoding::Decode(in, end, stimulus, stimulus.Cycle);
+	ASSERT_NE(in, nullptr);
+	EXPECT_EQ(stimulus.Cycle, 5);
+	EXPECT_EQ(stimulus.Type, StimulusType::UDR0);
+
+	in = StimulusEncoding::Decode(in, end, stimulus, stimulus.Cycle);
+	ASSERT_NE(in, nullptr);
+	EXPECT_EQ(stimulus.Cycle, 10'000'000'000);
+	EXPECT_EQ(stimulus.Type, StimulusType::ADC);
+	EXPECT_EQ(stimulus.Value, 0x2AB);
+	EXPECT_EQ(in, end);
+
+	// Truncated
+	EXPECT_EQ(StimulusEncoding::Decode(log.data(), log.data() + 1, stimulus, 0), nullptr);
+}
+
+TEST_F(ATMega328, Stimulus_ReplayAtRecordedCycles)
+{
+	// Record, the program is all NOPs
+	StimulusRecorder recorder;
+
+	cpu.Execute(10, memory);
+	recorder.Inject(cpu, StimulusType::PINB, 0x55);
+	cpu.Execute(15, memory);
+	recorder.Inject(cpu, StimulusType::UDR0, 'Z');
+	recorder.Inject(cpu, StimulusType::PINB, 0xAA);
+	cpu.Execute(100, memory);
+	recorder.Inject(cpu, StimulusType::ADC, 0x155);
+
+	EXPECT_EQ(recorder.GetCount(), 4);
+
+	// Replay on a fresh CPU
+	CPU replayed{};
+	replayed.Reset(memory);
+
+	StimulusReplayer replayer(recorder.GetLog());
+	Scheduler scheduler;
+	scheduler.Add(&replayer);
+
+	scheduler.Execute(replayed, memory, 9);
+	EXPECT_EQ(replayed.IO.PINB, 0x00);
+
+	scheduler.Execute(replayed, memory, 1);
+	EXPECT_EQ(replayed.IO.PINB, 0x55);
+
+	scheduler.Execute(replayed, memory, 14);
+	EXPECT_EQ(replayed.EXIO.UDR0, 0x00);
+
+	scheduler.Execute(replayed, memory, 1);
+	EXPECT_EQ(replayed.EXIO.UDR0, 'Z');
+	EXPECT_EQ(replayed.IO.PINB, 0xAA);
+
+	scheduler.Execute(replayed, memory, 200);
+	EXPECT_EQ(replayed.EXIO.ADC, 0x155);
+
+	EXPECT_TRUE(replayer.IsDone());
+	EXPECT_TRUE(replayer.IsValid());
+}
+
+TEST_F(ATMega328, StimulusFile_StreamsIntoScheduler)
+{
+	std::string filepath = (std::filesystem::temp_directory_path() / "StimulusFile_StreamsIntoScheduler.avrs").string();
+
+	{
+		StimulusFileWriter writer;
+		ASSERT_TRUE(writer.Open(filepath, 100));
+		writer.Write({ 120, StimulusType::PIND, 0x0F });
+		writer.Write({ 130, StimulusType::ADC, 0x200 });
+		writer.Write({ 130, StimulusType::PIND, 0xF0 });
+	}
+
+	StimulusFile file;
+	ASSERT_TRUE(file.Open(filepath));
+	EXPECT_EQ(file.GetStartCycle(), 100);
+	EXPECT_EQ(file.GetNextEventCycle(), 120);
+
+	Scheduler scheduler;
+	scheduler.Add(&file);
+
+	scheduler.Execute(cpu, memory, 119);
+	EXPECT_EQ(cpu.IO.PIND, 0x00);
+
+	scheduler.Execute(cpu, memory, 1);
+	EXPECT_EQ(cpu.IO.PIND, 0x0F);
+
+	scheduler.Execute(cpu, memory, 10);
+	EXPECT_EQ(cpu.IO.PIND, 0xF0);
+	EXPECT_EQ(cpu.EXIO.ADC, 0x200);
+
+	EXPECT_TRUE(file.IsDone());
+	EXPECT_TRUE(file.IsValid());
+
+	file.Close();
+	std::filesystem::remove(filepath);
+}
+
+TEST_F(ATMega328, StimulusFile_RecorderSave)
+{
+	std::string filepath = (std::filesystem::temp_directory_path() / "StimulusFile_RecorderSave.avrs").string();
+
+	StimulusRecorder recorder;
+	cpu.Execute(7, memory);
+	recorder.Inject(cpu, StimulusType::UDR0, 'x');
+	ASSERT_TRUE(recorder.Save(filepath));
+
+	StimulusFile file;
+	ASSERT_TRUE(file.Open(filepath));
+	EXPECT_EQ(file.GetSize(), StimulusFileFormat::HEADER_SIZE + recorder.GetLog().size());
+	EXPECT_EQ(file.GetNextEventCycle(), 7);
+
+	file.Close();
+	std::filesystem::remove(filepath);
+}
+
+TEST_F(ATMega328, StimulusFile_RecorderSaveReportsWriteErrors)
+{
+	// A device that accepts the open and fails every write
+	if (!std::filesystem::exists("/dev/full")) {
+		GTEST_SKIP() << "Needs /dev/full";
+	}
+
+	StimulusRecorder recorder;
+	recorder.Inject(cpu, StimulusType::UDR0, 'x');
+
+	// Act, Assert
+	EXPECT_FALSE(recorder.Save("/dev/full"));
+}
+
+TEST_F(ATMega328, StimulusFile_RejectsUnknownFiles)
+{
+	std::string filepath = (std::filesystem::temp_directory_path() / "StimulusFile_RejectsUnknownFiles.avrs").string();
+
+	{
+		std::ofstream stream(filepath, std::ios::binary);
+		stream << "This is not a stimulus file";
+	}
+
+	StimulusFile file;
+	EXPECT_FALSE(file.Open(filepath));
+	EXPECT_FALSE(file.IsOpen());
+
+	std::filesystem::remove(filepath);
+}
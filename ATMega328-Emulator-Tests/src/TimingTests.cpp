@@ -0,0 +1,314 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+#include "ATMega328Emulator/Timing.h"
+
+namespace {
+
+	struct DatasheetTiming
+	{
+		OpcodeClass Opcode;
+		Word Encoding;     // An encoding that decodes to Opcode
+		Byte Words;
+		Byte Cycles;       // Not taken / nothing skipped
+		Byte TakenCycles;  // Taken / a 1 word instruction skipped
+	};
+
+	// AVR Instruction Set Manual, 16-bit PC column
+	constexpr DatasheetTiming DATASHEET[] = {
+		{ OpcodeClass::ADC,    0x1C00, 1, 1, 1 },
+		{ OpcodeClass::ADD,    0x0C00, 1, 1, 1 },
+		{ OpcodeClass::ADIW,   0x9600, 1, 2, 2 },
+		{ OpcodeClass::AND,    0x2000, 1, 1, 1 },
+		{ OpcodeClass::ANDI,   0x7000, 1, 1, 1 },
+		{ OpcodeClass::ASR,    0x9405, 1, 1, 1 },
+		{ OpcodeClass::BCLR,   0x9488, 1, 1, 1 },
+		{ OpcodeClass::BLD,    0xF800, 1, 1, 1 },
+		{ OpcodeClass::BRBC,   0xF400, 1, 1, 2 },
+		{ OpcodeClass::BRBS,   0xF000, 1, 1, 2 },
+		{ OpcodeClass::BREAK,  0x9598, 1, 1, 1 },
+		{ OpcodeClass::BSET,   0x9408, 1, 1, 1 },
+		{ OpcodeClass::BST,    0xFA00, 1, 1, 1 },
+		{ OpcodeClass::CALL,   0x940E, 2, 4, 4 },
+		{ OpcodeClass::CBI,    0x9800, 1, 2, 2 },
+		{ OpcodeClass::COM,    0x9400, 1, 1, 1 },
+		{ OpcodeClass::CP,     0x1400, 1, 1, 1 },
+		{ OpcodeClass::CPC,    0x0400, 1, 1, 1 },
+		{ OpcodeClass::CPI,    0x3000, 1, 1, 1 },
+		{ OpcodeClass::CPSE,   0x1000, 1, 1, 2 },
+		{ OpcodeClass::DEC,    0x940A, 1, 1, 1 },
+		{ OpcodeClass::EOR,    0x2400, 1, 1, 1 },
+		{ OpcodeClass::FMUL,   0x0308, 1, 2, 2 },
+		{ OpcodeClass::FMULS,  0x0380, 1, 2, 2 },
+		{ OpcodeClass::FMULSU, 0x0388, 1, 2, 2 },
+		{ OpcodeClass::ICALL,  0x9509, 1, 3, 3 },
+		{ OpcodeClass::IJMP,   0x9409, 1, 2, 2 },
+		{ OpcodeClass::IN,     0xB000, 1, 1, 1 },
+		{ OpcodeClass::INC,    0x9403, 1, 1, 1 },
+		{ OpcodeClass::JMP,    0x940C, 2, 3, 3 },
+		{ OpcodeClass::LAC,    0x9206, 1, 2, 2 },
+		{ OpcodeClass::LAS,    0x9205, 1, 2, 2 },
+		{ OpcodeClass::LAT,    0x9207, 1, 2, 2 },
+		{ OpcodeClass::LD,     0x900C, 1, 2, 2 },
+		{ OpcodeClass::LDD,    0x8008, 1, 2, 2 },
+		{ OpcodeClass::LDI,    0xEF2A, 1, 1, 1 },
+		{ OpcodeClass::LDS,    0x9000, 2, 2, 2 },
+		{ OpcodeClass::LPM,    0x95C8, 1, 3, 3 },
+		{ OpcodeClass::LSR,    0x9406, 1, 1, 1 },
+		{ OpcodeClass::MOV,    0x2C00, 1, 1, 1 },
+		{ OpcodeClass::MOVW,   0x0100, 1, 1, 1 },
+		{ OpcodeClass::MUL,    0x9C00, 1, 2, 2 },
+		{ OpcodeClass::MULS,   0x0200, 1, 2, 2 },
+		{ OpcodeClass::MULSU,  0x0300, 1, 2, 2 },
+		{ OpcodeClass::NEG,    0x9401, 1, 1, 1 },
+		{ OpcodeClass::NOP,    0x0000, 1, 1, 1 },
+		{ OpcodeClass::OR,     0x2800, 1, 1, 1 },
+		{ OpcodeClass::ORI,    0x6000, 1, 1, 1 },
+		{ OpcodeClass::OUT,    0xB800, 1, 1, 1 },
+		{ OpcodeClass::POP,    0x900F, 1, 2, 2 },
+		{ OpcodeClass::PUSH,   0x920F, 1, 2, 2 },
+		{ OpcodeClass::RCALL,  0xD000, 1, 3, 3 },
+		{ OpcodeClass::RET,    0x9508, 1, 4, 4 },
+		{ OpcodeClass::RETI,   0x9518, 1, 4, 4 },
+		{ OpcodeClass::RJMP,   0xC000, 1, 2, 2 },
+		{ OpcodeClass::ROR,    0x9407, 1, 1, 1 },
+		{ OpcodeClass::SBC,    0x0800, 1, 1, 1 },
+		{ OpcodeClass::SBCI,   0x4000, 1, 1, 1 },
+		{ OpcodeClass::SBI,    0x9A00, 1, 2, 2 },
+		{ OpcodeClass::SBIC,   0x9900, 1, 1, 2 },
+		{ OpcodeClass::SBIS,   0x9B00, 1, 1, 2 },
+		{ OpcodeClass::SBIW,   0x9700, 1, 2, 2 },
+		{ OpcodeClass::SBRC,   0xFC00, 1, 1, 2 },
+		{ OpcodeClass::SBRS,   0xFE00, 1, 1, 2 },
+		{ OpcodeClass::SLEEP,  0x9588, 1, 1, 1 },
+		{ OpcodeClass::ST,     0x920C, 1, 2, 2 },
+		{ OpcodeClass::STD,    0x8208, 1, 2, 2 },
+		{ OpcodeClass::STS,    0x9200, 2, 2, 2 },
+		{ OpcodeClass::SUB,    0x1800, 1, 1, 1 },
+		{ OpcodeClass::SUBI,   0x5000, 1, 1, 1 },
+		{ OpcodeClass::SWAP,   0x9402, 1, 1, 1 },
+	};
+
+	struct DatasheetEncoding
+	{
+		OpcodeClass Opcode;
+		Word Mask;  // The opcode bits, everything else is an operand
+		Word Match;
+	};
+
+	// AVR Instruction Set Manual, every encoding of the instructions there is a handler for
+	constexpr DatasheetEncoding ENCODINGS[] = {
+		{ OpcodeClass::ADC,    0xFC00, 0x1C00 },
+		{ OpcodeClass::ADD,    0xFC00, 0x0C00 },
+		{ OpcodeClass::ADIW,   0xFF00, 0x9600 },
+		{ OpcodeClass::AND,    0xFC00, 0x2000 },
+		{ OpcodeClass::ANDI,   0xF000, 0x7000 },
+		{ OpcodeClass::ASR,    0xFE0F, 0x9405 },
+		{ OpcodeClass::BCLR,   0xFF8F, 0x9488 },
+		{ OpcodeClass::BLD,    0xFE08, 0xF800 },
+		{ OpcodeClass::BRBC,   0xFC00, 0xF400 },
+		{ OpcodeClass::BRBS,   0xFC00, 0xF000 },
+		{ OpcodeClass::BREAK,  0xFFFF, 0x9598 },
+		{ OpcodeClass::BSET,   0xFF8F, 0x9408 },
+		{ OpcodeClass::BST,    0xFE08, 0xFA00 },
+		{ OpcodeClass::CALL,   0xFE0E, 0x940E },
+		{ OpcodeClass::CBI,    0xFF00, 0x9800 },
+		{ OpcodeClass::COM,    0xFE0F, 0x9400 },
+		{ OpcodeClass::CP,     0xFC00, 0x1400 },
+		{ OpcodeClass::CPC,    0xFC00, 0x0400 },
+		{ OpcodeClass::CPI,    0xF000, 0x3000 },
+		{ OpcodeClass::CPSE,   0xFC00, 0x1000 },
+		{ OpcodeClass::DEC,    0xFE0F, 0x940A },
+		{ OpcodeClass::EOR,    0xFC00, 0x2400 },
+		{ OpcodeClass::FMUL,   0xFF88, 0x0308 },
+		{ OpcodeClass::FMULS,  0xFF88, 0x0380 },
+		{ OpcodeClass::FMULSU, 0xFF88, 0x0388 },
+		{ OpcodeClass::ICALL,  0xFFFF, 0x9509 },
+		{ OpcodeClass::IJMP,   0xFFFF, 0x9409 },
+		{ OpcodeClass::IN,     0xF800, 0xB000 },
+		{ OpcodeClass::INC,    0xFE0F, 0x9403 },
+		{ OpcodeClass::JMP,    0xFE0E, 0x940C },
+		{ OpcodeClass::LAC,    0xFE0F, 0x9206 },
+		{ OpcodeClass::LAS,    0xFE0F, 0x9205 },
+		{ OpcodeClass::LAT,    0xFE0F, 0x9207 },
+		{ OpcodeClass::LD,     0xFE0F, 0x900C }, // X
+		{ OpcodeClass::LD,     0xFE0F, 0x900D }, // X+
+		{ OpcodeClass::LD,     0xFE0F, 0x900E }, // -X
+		{ OpcodeClass::LD,     0xFE0F, 0x9009 }, // Y+
+		{ OpcodeClass::LD,     0xFE0F, 0x900A }, // -Y
+		{ OpcodeClass::LD,     0xFE0F, 0x9001 }, // Z+
+		{ OpcodeClass::LD,     0xFE0F, 0x9002 }, // -Z
+		{ OpcodeClass::LDD,    0xD208, 0x8008 }, // Y+q, LD Rd,Y is q = 0
+		{ OpcodeClass::LDD,    0xD208, 0x8000 }, // Z+q, LD Rd,Z is q = 0
+		{ OpcodeClass::LDI,    0xF000, 0xE000 },
+		{ OpcodeClass::LDS,    0xFE0F, 0x9000 },
+		{ OpcodeClass::LPM,    0xFFFF, 0x95C8 }, // R0 implied
+		{ OpcodeClass::LPM,    0xFE0F, 0x9004 }, // Z
+		{ OpcodeClass::LPM,    0xFE0F, 0x9005 }, // Z+
+		{ OpcodeClass::LSR,    0xFE0F, 0x9406 },
+		{ OpcodeClass::MOV,    0xFC00, 0x2C00 },
+		{ OpcodeClass::MOVW,   0xFF00, 0x0100 },
+		{ OpcodeClass::MUL,    0xFC00, 0x9C00 },
+		{ OpcodeClass::MULS,   0xFF00, 0x0200 },
+		{ OpcodeClass::MULSU,  0xFF88, 0x0300 },
+		{ OpcodeClass::NEG,    0xFE0F, 0x9401 },
+		{ OpcodeClass::NOP,    0xFFFF, 0x0000 },
+		{ OpcodeClass::OR,     0xFC00, 0x2800 },
+		{ OpcodeClass::ORI,    0xF000, 0x6000 },
+		{ OpcodeClass::OUT,    0xF800, 0xB800 },
+		{ OpcodeClass::POP,    0xFE0F, 0x900F },
+		{ OpcodeClass::PUSH,   0xFE0F, 0x920F },
+		{ OpcodeClass::RCALL,  0xF000, 0xD000 },
+		{ OpcodeClass::RET,    0xFFFF, 0x9508 },
+		{ OpcodeClass::RETI,   0xFFFF, 0x9518 },
+		{ OpcodeClass::RJMP,   0xF000, 0xC000 },
+		{ OpcodeClass::ROR,    0xFE0F, 0x9407 },
+		{ OpcodeClass::SBC,    0xFC00, 0x0800 },
+		{ OpcodeClass::SBCI,   0xF000, 0x4000 },
+		{ OpcodeClass::SBI,    0xFF00, 0x9A00 },
+		{ OpcodeClass::SBIC,   0xFF00, 0x9900 },
+		{ OpcodeClass::SBIS,   0xFF00, 0x9B00 },
+		{ OpcodeClass::SBIW,   0xFF00, 0x9700 },
+		{ OpcodeClass::SBRC,   0xFE08, 0xFC00 },
+		{ OpcodeClass::SBRS,   0xFE08, 0xFE00 },
+		{ OpcodeClass::SLEEP,  0xFFFF, 0x9588 },
+		{ OpcodeClass::ST,     0xFE0F, 0x920C }, // X
+		{ OpcodeClass::ST,     0xFE0F, 0x920D }, // X+
+		{ OpcodeClass::ST,     0xFE0F, 0x920E }, // -X
+		{ OpcodeClass::ST,     0xFE0F, 0x9209 }, // Y+
+		{ OpcodeClass::ST,     0xFE0F, 0x920A }, // -Y
+		{ OpcodeClass::ST,     0xFE0F, 0x9201 }, // Z+
+		{ OpcodeClass::ST,     0xFE0F, 0x9202 }, // -Z
+		{ OpcodeClass::STD,    0xD208, 0x8208 }, // Y+q, ST Y,Rr is q = 0
+		{ OpcodeClass::STD,    0xD208, 0x8200 }, // Z+q, ST Z,Rr is q = 0
+		{ OpcodeClass::STS,    0xFE0F, 0x9200 },
+		{ OpcodeClass::SUB,    0xFC00, 0x1800 },
+		{ OpcodeClass::SUBI,   0xF000, 0x5000 },
+		{ OpcodeClass::SWAP,   0xFE0F, 0x9402 },
+	};
+
+}
+
+TEST(Timing, Timing_MatchesDatasheet)
+{
+	// Every implemented opcode class is listed
+	EXPECT_EQ(std::size(DATASHEET), (size_t)OpcodeClass::Count - 1);
+
+	for (const DatasheetTiming& expected : DATASHEET) {
+		const InstructionTiming& timing = Timing::Get(expected.Opcode);
+		SCOPED_TRACE((int)expected.Opcode);
+
+		EXPECT_EQ(Timing::Decode(expected.Encoding), expected.Opcode);
+		EXPECT_EQ(timing.Words, expected.Words);
+		EXPECT_EQ(timing.Cycles, expected.Cycles);
+		EXPECT_EQ(timing.TakenCycles, expected.TakenCycles);
+	}
+}
+
+TEST(Timing, Timing_DecodesEveryImmediate)
+{
+	// The register and immediate fields share the low 12 bits, none of them may change the class
+	constexpr std::pair<OpcodeClass, Word> IMMEDIATES[] = {
+		{ OpcodeClass::ANDI, Instruction::ANDI },
+		{ OpcodeClass::CPI,  Instruction::CPI },
+		{ OpcodeClass::LDI,  Instruction::LDI },
+		{ OpcodeClass::ORI,  Instruction::ORI },
+		{ OpcodeClass::SBCI, Instruction::SBCI },
+		{ OpcodeClass::SUBI, Instruction::SUBI },
+	};
+
+	for (const auto& [opcode, encoding] : IMMEDIATES) {
+		SCOPED_TRACE((int)opcode);
+
+		for (Word operands = 0; operands < 0x1000; ++operands) {
+			ASSERT_EQ(Timing::Decode(encoding | operands), opcode) << std::hex << operands;
+		}
+	}
+}
+
+TEST(Timing, Timing_DecodesEveryOpcode)
+{
+	// Everything without a handler, e.g. WDR, SPM, ELPM and the reserved encodings, has to stay Unknown
+	int mismatches = 0;
+	for (uint32_t instruction = 0; instruction <= 0xFFFF; ++instruction) {
+		OpcodeClass expected = OpcodeClass::Unknown;
+		for (const DatasheetEncoding& encoding : ENCODINGS) {
+			if ((instruction & encoding.Mask) == encoding.Match) {
+				ASSERT_EQ(expected, OpcodeClass::Unknown) << "Overlapping encodings for 0x" << std::hex << instruction;
+				expected = encoding.Opcode;
+			}
+		}
+
+		const OpcodeClass decoded = Timing::Decode((Word)instruction);
+		if (decoded != expected && ++mismatches <= 16) {
+			ADD_FAILURE() << "0x" << std::hex << instruction << " decodes to " << GetOpcodeName(decoded)
+				<< " instead of " << GetOpcodeName(expected);
+		}
+	}
+	EXPECT_EQ(mismatches, 0);
+}
+
+TEST_F(ATMega328, Timing_ExecuteChargesTable)
+{
+	for (const DatasheetTiming& expected : DATASHEET) {
+		SCOPED_TRACE((int)expected.Opcode);
+
+		cpu.Reset(memory);
+		cpu.X = cpu.Y = cpu.Z = 0;
+		cpu.IO.SP = CPU::RAMEND - 2; // Something to return to
+		cpu.WriteData(CPU::IO_START, 0); // SBIC skips, SBIS doesn't
+		*(Byte*)&cpu.IO.SREG = 0xFF; // All branches not taken, BRBS is checked below
+		cpu.R00 = 1;
+		cpu.R01 = 2; // CPSE r0, r0 is equal and SBRS r0, 0 skips, so they are checked below too
+
+		int dummyCycles = 0;
+		memory.WriteWord(expected.Encoding, 0x0, dummyCycles);
+
+		// Act, a budget of 1 runs exactly one instruction
+		RunResult result = cpu.Run(1, StopConditions(), memory);
+
+		// Assert
+		const bool taken = expected.Opcode == OpcodeClass::BRBS || expected.Opcode == OpcodeClass::CPSE
+			|| expected.Opcode == OpcodeClass::SBIC || expected.Opcode == OpcodeClass::SBRS;
+		EXPECT_EQ(result.Cycles, taken ? expected.TakenCycles : expected.Cycles);
+		EXPECT_EQ(result.Instructions, 1);
+	}
+}
+
+TEST_F(ATMega328, Timing_Branch)
+{
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::BRBS | (2 << 3), 0x0, dummyCycles); // brcs .+4
+
+	// Act, not taken
+	cpu.IO.SREG.C = 0;
+	RunResult result = cpu.Run(1, StopConditions(), memory);
+
+	// Assert
+	EXPECT_EQ(result.Cycles, 1);
+	EXPECT_EQ(cpu.PC, 1);
+
+	// Act, taken
+	cpu.PC = 0;
+	cpu.IO.SREG.C = 1;
+	result = cpu.Run(1, StopConditions(), memory);
+
+	// Assert
+	EXPECT_EQ(result.Cycles, 2);
+	EXPECT_EQ(cpu.PC, 3);
+}
+
+TEST_F(ATMega328, Timing_SkipOverTwoWordInstruction)
+{
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::CPSE, 0x0, dummyCycles); // cpse r0, r0
+	memory.WriteWord(Instruction::LDS | (16 << 4), 0x1 * 2, dummyCycles); // lds r16, 0x10
+	memory.WriteWord(0x10, 0x2 * 2, dummyCycles);
+
+	// Act
+	RunResult result = cpu.Run(1, StopConditions(), memory);
+
+	// Assert, both words of the LDS were skipped
+	EXPECT_EQ(result.Cycles, 3);
+	EXPECT_EQ(cpu.PC, 3);
+}
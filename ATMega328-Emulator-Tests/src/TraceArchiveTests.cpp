@@ -0,0 +1,232 @@
+#include "TestHardware.h"
+
+#include <cstring>
+#include <filesystem>
+
+#include "ATMega328Emulator/Instructions.h"
+#include "ATMega328Emulator/TraceArchive.h"
+
+namespace {
+
+	// main: 0: inc r17
+	//       1: rcall f
+	//       2: add r18, r17
+	//       3: rjmp 0
+	// f:    4: movw r2, r16
+	//       5: push r17
+	//       6: pop r20
+	//       7: ret
+	void LoadProgram(Memory& memory)
+	{
+		int dummyCycles = 0;
+		memory.WriteWord(Instruction::INC | (17 << 4), 0x0 * 2, dummyCycles);
+		memory.WriteWord(Instruction::RCALL | 2, 0x1 * 2, dummyCycles);
+		memory.WriteWord(Instruction::ADD | (1 << 9) | (18 << 4) | 1, 0x2 * 2, dummyCycles);
+		memory.WriteWord(Instruction::RJMP | (-4 & 0xFFF), 0x3 * 2, dummyCycles);
+		memory.WriteWord(Instruction::MOVW | (1 << 4) | 8, 0x4 * 2, dummyCycles);
+		memory.WriteWord(Instruction::PUSH | (17 << 4), 0x5 * 2, dummyCycles);
+		memory.WriteWord(Instruction::POP | (20 << 4), 0x6 * 2, dummyCycles);
+		memory.WriteWord(Instruction::RET, 0x7 * 2, dummyCycles);
+	}
+
+}
+
+#ifdef ATMEGA328_PROFILING
+TEST_F(ATMega328, TraceArchive_RebuildMatchesExecution)
+{
+	std::string filepath = (std::filesystem::temp_directory_path() / "TraceArchive_RebuildMatchesExecution.avrx").string();
+
+	LoadProgram(memory);
+	const CPU start = cpu;
+
+	TraceArchiveWriter writer;
+	ASSERT_TRUE(writer.Open(filepath, cpu, 50));
+	cpu.AttachedTraceArchive = &writer;
+
+	RunResult result = cpu.Run(5000, StopConditions(), memory);
+	ASSERT_TRUE(writer.Close());
+
+	TraceArchive archive;
+	ASSERT_TRUE(archive.Open(filepath));
+	EXPECT_EQ(archive.GetRecordCount(), result.Instructions);
+	EXPECT_EQ(archive.GetChunkCount(), (result.Instructions + 49) / 50);
+	EXPECT_EQ(archive.GetLastCycle(), cpu.CycleCount);
+
+	std::vector<uint64_t> cycles;
+	archive.ForEach(0, UINT64_MAX, [&](const TraceEntry& entry) {
+		cycles.push_back(entry.Cycle);
+		return true;
+	});
+	ASSERT_EQ(cycles.size(), result.Instructions);
+
+	for (size_t i = 0; i < cycles.size(); i += 37) {
+		SCOPED_TRACE(cycles[i]);
+
+		// Act
+		CPU rebuilt = start;
+		ASSERT_TRUE(archive.Rebuild(cycles[i], rebuilt));
+
+		// Assert, the same as running there
+		CPU expected = start;
+		StopConditions conditions;
+		conditions.CycleTarget = cycles[i];
+		expected.Run(UINT64_MAX, conditions, memory);
+
+		EXPECT_EQ(std::memcmp(&rebuilt.R00, &expected.R00, 32), 0);
+		EXPECT_EQ(*(Byte*)&rebuilt.IO.SREG, *(Byte*)&expected.IO.SREG);
+		EXPECT_EQ(rebuilt.IO.SP, expected.IO.SP);
+		EXPECT_EQ(rebuilt.PC, expected.PC);
+		EXPECT_EQ(rebuilt.CycleCount, expected.CycleCount);
+	}
+
+	std::filesystem::remove(filepath);
+}
+
+TEST_F(ATMega328, TraceArchive_RebuildAcrossInterrupts)
+{
+	std::string filepath = (std::filesystem::temp_directory_path() / "TraceArchive_RebuildAcrossInterrupts.avrx").string();
+
+	// vector 20: inc r21
+	//            reti
+	LoadProgram(memory);
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::INC | (21 << 4), 40 * 2, dummyCycles);
+	memory.WriteWord(Instruction::RETI, 41 * 2, dummyCycles);
+	cpu.IO.SREG.I = 1;
+
+	TraceArchiveWriter writer;
+	ASSERT_TRUE(writer.Open(filepath, cpu, 50));
+	cpu.AttachedTraceArchive = &writer;
+
+	// One instruction a Run, with interrupts and host writes between some of them
+	std::vector<CPU> expected;
+	int interrupts = 0;
+	for (int i = 0; i < 600; ++i) {
+		cpu.Run(1, StopConditions(), memory);
+		expected.push_back(cpu);
+
+		if (i % 23 == 0 && cpu.EnterInterrupt(20)) {
+			++interrupts;
+		}
+		if (i % 31 == 0) {
+			cpu.R05 = (Byte)i;
+		}
+	}
+	writer.Close();
+	ASSERT_GT(interrupts, 10);
+
+	TraceArchive archive;
+	ASSERT_TRUE(archive.Open(filepath));
+	EXPECT_EQ(archive.GetRecordCount(), expected.size());
+
+	for (const CPU& state : expected) {
+		SCOPED_TRACE(state.CycleCount);
+
+		// Act
+		CPU rebuilt{};
+		ASSERT_TRUE(archive.Rebuild(state.CycleCount, rebuilt));
+
+		// Assert, the state right after the instruction, before the interrupt was entered
+		EXPECT_EQ(std::memcmp(&rebuilt.R00, &state.R00, 32), 0);
+		EXPECT_EQ(*(Byte*)&rebuilt.IO.SREG, *(Byte*)&state.IO.SREG);
+		EXPECT_EQ(rebuilt.IO.SP, state.IO.SP);
+		EXPECT_EQ(rebuilt.PC, state.PC);
+		EXPECT_EQ(rebuilt.CycleCount, state.CycleCount);
+	}
+
+	std::filesystem::remove(filepath);
+}
+
+TEST_F(ATMega328, TraceArchive_FindVisits)
+{
+	std::string filepath = (std::filesystem::temp_directory_path() / "TraceArchive_FindVisits.avrx").string();
+
+	LoadProgram(memory);
+	cpu.R17 = 0;
+
+	TraceArchiveWriter writer;
+	ASSERT_TRUE(writer.Open(filepath, cpu, 64));
+	cpu.AttachedTraceArchive = &writer;
+	cpu.Run(10'000, StopConditions(), memory);
+	writer.Close();
+
+	TraceArchive archive;
+	ASSERT_TRUE(archive.Open(filepath));
+
+	// Act
+	std::vector<TraceEntry> visits = archive.FindVisits(6, 5000);
+	std::vector<TraceEntry> limited = archive.FindVisits(6, 5000, 6000, 3);
+	std::vector<TraceEntry> none = archive.FindVisits(0x100);
+
+	// Assert, every pop r20 after cycle 5000, one every loop of 16 cycles
+	ASSERT_FALSE(visits.empty());
+	EXPECT_NEAR((double)visits.size(), 5000.0 / 16, 1);
+	for (size_t i = 0; i < visits.size(); ++i) {
+		EXPECT_EQ(visits[i].PC, 6);
+		EXPECT_GE(visits[i].Cycle, 5000);
+		EXPECT_EQ(visits[i].Instruction, Instruction::POP | (20 << 4));
+		EXPECT_EQ(visits[i].Register, 20);
+		EXPECT_EQ(visits[i].Value, (Byte)((visits[i].Cycle - 9) / 16 + 1));
+		if (i) {
+			EXPECT_EQ(visits[i].Cycle - visits[i - 1].Cycle, 16);
+		}
+	}
+
+	ASSERT_EQ(limited.size(), 3);
+	EXPECT_EQ(limited[0].Cycle, visits[0].Cycle);
+	EXPECT_TRUE(none.empty());
+
+	std::filesystem::remove(filepath);
+}
+
+TEST_F(ATMega328, TraceArchive_RecordAfterFailedOpen)
+{
+	std::string filepath = (std::filesystem::temp_directory_path() / "TraceArchive_Missing" / "Archive.avrx").string();
+
+	LoadProgram(memory);
+
+	TraceArchiveWriter writer;
+	ASSERT_FALSE(writer.Open(filepath, cpu));
+	cpu.AttachedTraceArchive = &writer;
+
+	// Act
+	RunResult result = cpu.Run(100, StopConditions(), memory);
+
+	// Assert, nothing was recorded and the CPU ran as if nothing was attached
+	EXPECT_GT(result.Instructions, 0);
+	EXPECT_EQ(writer.GetRecordCount(), 0);
+	EXPECT_TRUE(writer.Close());
+}
+
+TEST_F(ATMega328, TraceArchive_CloseReportsWriteErrors)
+{
+	// A device that accepts the open and fails every write
+	if (!std::filesystem::exists("/dev/full")) {
+		GTEST_SKIP() << "Needs /dev/full";
+	}
+
+	LoadProgram(memory);
+
+	TraceArchiveWriter writer;
+	ASSERT_TRUE(writer.Open("/dev/full", cpu));
+	cpu.AttachedTraceArchive = &writer;
+	cpu.Run(100, StopConditions(), memory);
+
+	// Act, Assert
+	EXPECT_FALSE(writer.Close());
+}
+#endif
+
+TEST(TraceArchive, TraceArchive_RejectsUnclosedArchive)
+{
+	std::string filepath = (std::filesystem::temp_directory_path() / "TraceArchive_RejectsUnclosedArchive.avrx").string();
+	{
+		std::ofstream file(filepath, std::ios::binary);
+		file.write("AVRX\x01\0\0\0\0\0\0\0\0\0\0\0", 16);
+	}
+
+	TraceArchive archive;
+	EXPECT_FALSE(archive.Open(filepath));
+
+	std::filesystem::remove(filepath);
+}
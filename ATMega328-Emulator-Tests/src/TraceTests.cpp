@@ -0,0 +1,151 @@
+#include "TestHardware.h"
+
+#include <filesystem>
+
+#include "ATMega328Emulator/Disassembler.h"
+#include "ATMega328Emulator/Instructions.h"
+#include "ATMega328Emulator/Trace.h"
+
+#ifdef ATMEGA328_PROFILING
+TEST_F(ATMega328, Trace_RoundTrip)
+{
+	std::string filepath = (std::filesystem::temp_directory_path() / "Trace_RoundTrip.avrt").string();
+
+	// 0: inc r16
+	// 1: rjmp 0
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::INC | (16 << 4), 0x0 * 2, dummyCycles);
+	memory.WriteWord(Instruction::RJMP | (-2 & 0xFFF), 0x1 * 2, dummyCycles);
+	cpu.R16 = 0;
+
+	// A small ring, so the writer has to keep up and wrap around
+	TraceRecorder tracer(256);
+	ASSERT_TRUE(tracer.Open(filepath, cpu.CycleCount));
+	cpu.AttachedTracer = &tracer;
+
+	// Act, with a gap too long for a record's cycle delta in between
+	cpu.Run(30'000, StopConditions(), memory);
+	cpu.CycleCount += 1000;
+	cpu.Run(3, StopConditions(), memory);
+	ASSERT_TRUE(tracer.Close());
+
+	// Assert
+	TraceReader reader;
+	ASSERT_TRUE(reader.Open(filepath));
+	EXPECT_EQ(reader.GetStartCycle(), 0);
+
+	TraceEntry entry;
+	uint64_t count = 0;
+	while (reader.Next(entry)) {
+		const bool inc = count % 2 == 0;
+		const uint64_t loop = count / 2;
+		SCOPED_TRACE(count);
+
+		EXPECT_EQ(entry.PC, inc ? 0 : 1);
+		EXPECT_EQ(entry.Cycle, loop * 3 + (inc ? 1 : 3) + (loop >= 10'000 ? 1000 : 0));
+		if (inc) {
+			EXPECT_EQ(entry.Register, 16);
+			EXPECT_EQ(entry.Value, (Byte)(loop + 1));
+		}
+		else {
+			EXPECT_EQ(entry.Register, TraceFormat::NO_REGISTER);
+			EXPECT_EQ(entry.SREGDelta, 0);
+		}
+		++count;
+	}
+	EXPECT_EQ(count, 20'002);
+
+	std::filesystem::remove(filepath);
+}
+
+TEST_F(ATMega328, Trace_TwoWordInstruction)
+{
+	std::string filepath = (std::filesystem::temp_directory_path() / "Trace_TwoWordInstruction.avrt").string();
+
+	// 0: lds r17, 0x0110
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::LDS | (17 << 4), 0x0 * 2, dummyCycles);
+	memory.WriteWord(0x0110, 0x1 * 2, dummyCycles);
+	cpu.R17 = 0;
+	cpu.WriteData(0x0110, 0x5A);
+
+	TraceRecorder tracer;
+	ASSERT_TRUE(tracer.Open(filepath));
+	cpu.AttachedTracer = &tracer;
+
+	// Act
+	cpu.Run(1, StopConditions(), memory);
+	tracer.Close();
+
+	// Assert
+	TraceReader reader;
+	ASSERT_TRUE(reader.Open(filepath));
+
+	TraceEntry entry;
+	ASSERT_TRUE(reader.Next(entry));
+	EXPECT_EQ(entry.Cycle, 2);
+	EXPECT_EQ(entry.Operand, 0x0110);
+	EXPECT_EQ(entry.Register, 17);
+	EXPECT_EQ(entry.Value, 0x5A);
+	EXPECT_EQ(Disassembler::Disassemble(entry.Instruction, entry.Operand), "lds r17, 0x0110");
+	EXPECT_FALSE(reader.Next(entry));
+
+	std::filesystem::remove(filepath);
+}
+
+TEST_F(ATMega328, Trace_RecordWhileClosed)
+{
+	// 0: rjmp 0
+	int dummyCycles = 0;
+	memory.WriteWord(Instruction::RJMP | (-1 & 0xFFF), 0x0 * 2, dummyCycles);
+
+	// Never opened, with more instructions than the ring holds
+	TraceRecorder tracer(256);
+	cpu.AttachedTracer = &tracer;
+
+	// Act
+	RunResult result = cpu.Run(2'000, StopConditions(), memory);
+
+	// Assert, the records were dropped instead of waiting for a writer that isn't there
+	EXPECT_EQ(result.Instructions, 1'000);
+	EXPECT_EQ(tracer.GetRecordCount(), 0);
+}
+
+TEST_F(ATMega328, Trace_CloseReportsWriteErrors)
+{
+	// A device that accepts the open and fails every write
+	if (!std::filesystem::exists("/dev/full")) {
+		GTEST_SKIP() << "Needs /dev/full";
+	}
+
+	TraceRecorder tracer;
+	ASSERT_TRUE(tracer.Open("/dev/full"));
+	cpu.AttachedTracer = &tracer;
+	cpu.Run(100, StopConditions(), memory);
+
+	// Act, Assert
+	EXPECT_FALSE(tracer.Close());
+}
+#endif
+
+TEST(Disassembler, Disassembler_Operands)
+{
+	using namespace Instruction;
+
+	EXPECT_EQ(Disassembler::Disassemble(NOP), "nop");
+	EXPECT_EQ(Disassembler::Disassemble(ADD | (1 << 9) | (3 << 4) | 0x1), "add r3, r17");
+	EXPECT_EQ(Disassembler::Disassemble(LDI | 0x0F2A), "ldi r18, 0xFA");
+	EXPECT_EQ(Disassembler::Disassemble(ADIW | (1 << 6) | (3 << 4) | 0x1), "adiw r30, 0x11");
+	EXPECT_EQ(Disassembler::Disassemble(BRBS | (-2 & 0x7F) << 3 | 1), "brbs 1, .-4");
+	EXPECT_EQ(Disassembler::Disassemble(RJMP | 0x010), "rjmp .+32");
+	EXPECT_EQ(Disassembler::Disassemble(CALL, 0x1234), "call 0x2468");
+	EXPECT_EQ(Disassembler::Disassemble(OUT | (0x3F & 0x30) << 5 | (16 << 4) | (0x3F & 0xF)), "out 0x3F, r16");
+	EXPECT_EQ(Disassembler::Disassemble(MOVW | (0x1 << 4) | 0xF), "movw r2, r30");
+	EXPECT_EQ(Disassembler::Disassemble(LD_X_INC | (24 << 4)), "ld r24, X+");
+	EXPECT_EQ(Disassembler::Disassemble(ST_Z_DEC | (3 << 4)), "st -Z, r3");
+	EXPECT_EQ(Disassembler::Disassemble(LDD_Y | (20 << 4) | (1 << 13) | 0x1), "ldd r20, Y+33");
+	EXPECT_EQ(Disassembler::Disassemble(STD_Z | (5 << 4)), "st Z, r5");
+	EXPECT_EQ(Disassembler::Disassemble(LPM_Z_INC | (1 << 4)), "lpm r1, Z+");
+	EXPECT_EQ(Disassembler::Disassemble(STS | (16 << 4), 0x0123), "sts 0x0123, r16");
+	EXPECT_EQ(Disassembler::Disassemble(0xFFFF), ".word 0xFFFF");
+}
@@ -0,0 +1,304 @@
+#include "TestHardware.h"
+
+#include <cstdio>
+#include <string>
+
+#include "ATMega328Emulator/Assembler.h"
+#include "ATMega328Emulator/Scheduler.h"
+#include "ATMega328Emulator/Stimulus.h"
+#include "ATMega328Emulator/USART.h"
+
+namespace {
+
+	using namespace asm_;
+
+	constexpr Word UCSR0A = USART::UCSR0A_ADDRESS;
+	constexpr Word UCSR0B = USART::UCSR0B_ADDRESS;
+	constexpr Word UBRR0L = USART::UBRR0_ADDRESS;
+	constexpr Word UDR0 = USART::UDR0_ADDRESS;
+
+	// UBRR0 9 without U2X0 is 160 cycles a bit, 1600 an 8N1 frame
+	constexpr uint64_t FRAME_CYCLES = 1'600;
+
+	// Polls UDRE0 and sends '0', '1', '2'...
+	constexpr auto SEND = Assemble(
+		ldi(r16, 9),
+		sts(UBRR0L, r16),
+		ldi(r16, USART::TXEN0),
+		sts(UCSR0B, r16),
+		ldi(r18, '0'),
+		label("wait"),
+		lds(r17, UCSR0A),
+		sbrs(r17, 5),
+		rjmp("wait"),
+		sts(UDR0, r18),
+		inc(r18),
+		rjmp("wait"));
+
+	// Polls RXC0 and stores what it receives from the start of the SRAM
+	constexpr auto ECHO = Assemble(
+		ldi(r16, 9),
+		sts(UBRR0L, r16),
+		ldi(r16, USART::RXEN0),
+		sts(UCSR0B, r16),
+		ldi(r26, CPU::SRAM_START & 0xFF),
+		ldi(r27, CPU::SRAM_START >> 8),
+		label("wait"),
+		lds(r17, UCSR0A),
+		sbrs(r17, 7),
+		rjmp("wait"),
+		lds(r18, UDR0),
+		st(X_INC, r18),
+		rjmp("wait"));
+
+	// Enables the data register empty interrupt and parks
+	constexpr auto SEND_FROM_INTERRUPT = Assemble(
+		ldi(r16, 9),
+		sts(UBRR0L, r16),
+		ldi(r16, USART::TXEN0 | USART::UDRIE0),
+		sts(UCSR0B, r16),
+		sei(),
+		label("park"),
+		rjmp("park"));
+
+	// Sends r20 and counts it up, five bytes in all
+	constexpr auto UDRE_HANDLER = Assemble(
+		sts(UDR0, r20),
+		inc(r20),
+		cpi(r20, 0x45),
+		brne("done"),
+		ldi(r21, USART::TXEN0),
+		sts(UCSR0B, r21),
+		label("done"),
+		reti());
+
+	// Enables the receiver and parks without reading anything
+	constexpr auto IGNORE = Assemble(
+		ldi(r16, 9),
+		sts(UBRR0L, r16),
+		ldi(r16, USART::RXEN0),
+		sts(UCSR0B, r16),
+		label("park"),
+		rjmp("park"));
+
+	std::string Drain(RingBuffer& ring)
+	{
+		std::string text(ring.GetSize(), '\0');
+		text.resize(ring.Read((Byte*)text.data(), text.size()));
+		return text;
+	}
+
+	class USARTTest : public ATMega328
+	{
+	public:
+		void SetUp() override
+		{
+			ATMega328::SetUp();
+			cpu.AttachedRegisterHooks = &hooks;
+			usart.Attach(hooks);
+			scheduler.Add(&usart);
+			usart.Reset(cpu);
+		}
+
+	public:
+		RegisterHooks hooks;
+		USART usart;
+		Scheduler scheduler;
+	};
+
+}
+
+TEST(USART, USART_FrameCycles)
+{
+	CPU cpu;
+	cpu.EXIO.UBRR0 = 103; // 9600 baud at 16MHz
+	cpu.EXIO.UCSR0A = 0;
+	cpu.EXIO.UCSR0B = 0;
+	cpu.EXIO.UCSR0C = USART::UCSZ01 | USART::UCSZ00;
+
+	EXPECT_EQ(USART::GetFrameCycles(cpu), 16 * 104 * 10);
+
+	cpu.EXIO.UCSR0A = USART::U2X0;
+	EXPECT_EQ(USART::GetFrameCycles(cpu), 8 * 104 * 10);
+
+	// 9 data bits, even parity, 2 stop bits
+	cpu.EXIO.UCSR0B = USART::UCSZ02;
+	cpu.EXIO.UCSR0C = USART::UCSZ01 | USART::UCSZ00 | USART::UPM01 | USART::USBS0;
+	EXPECT_EQ(USART::GetFrameCycles(cpu), 8 * 104 * 13);
+}
+
+TEST_F(USARTTest, USART_TransmitsAtBaudRate)
+{
+	asm_::Load(SEND, memory);
+
+	// Act, the setup takes a few cycles, then a frame ends every FRAME_CYCLES
+	scheduler.Execute(cpu, memory, FRAME_CYCLES * 10 + 100);
+
+	// Assert
+	EXPECT_EQ(usart.GetStats().Transmitted, 10);
+	EXPECT_EQ(usart.GetStats().Dropped, 0);
+	EXPECT_EQ(Drain(usart.GetTransmitted()), "0123456789");
+
+	// The eleventh is in the shift register and the twelfth waits in the buffer
+	EXPECT_EQ(cpu.R18, '0' + 12);
+	EXPECT_FALSE(cpu.EXIO.UCSR0A & USART::UDRE0);
+}
+
+TEST_F(USARTTest, USART_ReceivesHostBytes)
+{
+	asm_::Load(ECHO, memory);
+	const std::string text = "hello";
+	usart.Receive({ (const Byte*)text.data(), text.size() });
+
+	// Act
+	scheduler.Execute(cpu, memory, FRAME_CYCLES * 4 + 100);
+
+	// Assert, four frames in, the fifth is still on the line
+	EXPECT_EQ(std::string((const char*)cpu.SRAM, 5), std::string("hell\0", 5));
+	EXPECT_EQ(usart.GetStats().Received, 4);
+
+	scheduler.Execute(cpu, memory, FRAME_CYCLES);
+	EXPECT_EQ(std::string((const char*)cpu.SRAM, 5), "hello");
+}
+
+TEST_F(USARTTest, USART_DataRegisterEmptyInterrupt)
+{
+	asm_::Load(SEND_FROM_INTERRUPT, memory);
+	asm_::Load(UDRE_HANDLER, memory, USART::UDRE_VECTOR * 4);
+	cpu.R20 = 0x40;
+
+	// Act
+	scheduler.Execute(cpu, memory, FRAME_CYCLES * 6);
+
+	// Assert, the handler turned the interrupt off after the last one
+	EXPECT_EQ(Drain(usart.GetTransmitted()), "@ABCD");
+	EXPECT_EQ(cpu.EXIO.UCSR0B, USART::TXEN0);
+	EXPECT_TRUE(cpu.EXIO.UCSR0A & USART::TXC0);
+}
+
+TEST_F(USARTTest, USART_ReceiveOverrun)
+{
+	asm_::Load(IGNORE, memory);
+	const Byte bytes[] = { 1, 2, 3, 4 };
+	usart.Receive(bytes);
+
+	// Act
+	scheduler.Execute(cpu, memory, FRAME_CYCLES * 5);
+
+	// Assert, the FIFO holds two, the rest were lost
+	EXPECT_EQ(usart.GetStats().Received, 2);
+	EXPECT_EQ(usart.GetStats().Overruns, 2);
+	EXPECT_EQ(cpu.EXIO.UCSR0A, USART::RXC0 | USART::DOR0 | USART::UDRE0);
+}
+
+TEST_F(USARTTest, USART_HooksOnlyInsideRun)
+{
+	usart.Receive(std::span<const Byte>((const Byte*)"x", 1));
+
+	// Act, a debugger reading UDR0 doesn't pop anything
+	const Byte value = cpu.ReadData(UDR0);
+
+	// Assert
+	EXPECT_EQ(value, 0);
+	EXPECT_EQ(usart.GetStats().Received, 0);
+}
+
+TEST_F(USARTTest, USART_StimulusReplay)
+{
+	asm_::Load(ECHO, memory);
+
+	// Record, the second byte is injected while the first is still on the line
+	StimulusRecorder recorder;
+	scheduler.Execute(cpu, memory, 500);
+	recorder.Inject(cpu, StimulusType::UDR0, 'h');
+	scheduler.Execute(cpu, memory, 300);
+	recorder.Inject(cpu, StimulusType::UDR0, 'i');
+	scheduler.Execute(cpu, memory, FRAME_CYCLES * 3);
+
+	// Replay on a fresh CPU with its own USART, Reset clears the flash
+	CPU replayed{};
+	replayed.Reset(memory);
+	asm_::Load(ECHO, memory);
+
+	RegisterHooks replayedHooks;
+	USART replayedUSART;
+	replayed.AttachedRegisterHooks = &replayedHooks;
+	replayedUSART.Attach(replayedHooks);
+	replayedUSART.Reset(replayed);
+
+	StimulusReplayer replayer(recorder.GetLog());
+	Scheduler replayScheduler;
+	replayScheduler.Add(&replayedUSART);
+	replayScheduler.Add(&replayer);
+
+	// Act
+	replayScheduler.Execute(replayed, memory, cpu.CycleCount);
+
+	// Assert, the USART received both bytes and the firmware read them at the same cycles
+	EXPECT_EQ(std::string((const char*)cpu.SRAM, 2), "hi");
+	EXPECT_EQ(std::string((const char*)replayed.SRAM, 2), "hi");
+	EXPECT_EQ(usart.GetStats().Received, 2);
+	EXPECT_EQ(replayedUSART.GetStats().Received, 2);
+	EXPECT_EQ(replayed.CycleCount, cpu.CycleCount);
+	EXPECT_EQ(replayed.PC, cpu.PC);
+	EXPECT_EQ(replayed.X, cpu.X);
+	EXPECT_TRUE(replayer.IsDone());
+
+	replayedUSART.Detach();
+}
+
+TEST(RingBuffer, RingBuffer_WrapsAround)
+{
+	RingBuffer ring(6);
+	ASSERT_EQ(ring.GetCapacity(), 8);
+
+	const Byte first[] = { 1, 2, 3, 4, 5, 6 };
+	EXPECT_EQ(ring.Write(first, sizeof(first)), 6);
+	Byte out[4];
+	EXPECT_EQ(ring.Read(out, 4), 4);
+
+	// Act, only 6 of these fit, past the end of the storage
+	const Byte second[] = { 7, 8, 9, 10, 11, 12, 13 };
+	EXPECT_EQ(ring.Write(second, sizeof(second)), 6);
+
+	// Assert, peeking stops where the storage wraps
+	std::span<const Byte> available = ring.Peek();
+	ASSERT_EQ(available.size(), 4);
+	EXPECT_EQ(available[0], 5);
+	ring.Consume(available.size());
+
+	available = ring.Peek();
+	ASSERT_EQ(available.size(), 4);
+	EXPECT_EQ(available[3], 12);
+	ring.Consume(available.size());
+
+	EXPECT_TRUE(ring.IsEmpty());
+	EXPECT_TRUE(ring.Push(42));
+	Byte value = 0;
+	EXPECT_TRUE(ring.Pop(value));
+	EXPECT_EQ(value, 42);
+	EXPECT_FALSE(ring.Pop(value));
+}
+
+TEST(RingBuffer, RingBuffer_WriteTo)
+{
+	RingBuffer ring(16);
+	const std::string text = "to a file";
+	ring.Write((const Byte*)text.data(), text.size());
+
+	std::FILE* file = std::tmpfile();
+	ASSERT_NE(file, nullptr);
+
+	// Act
+	const int64_t written = ring.WriteTo(fileno(file));
+
+	// Assert
+	EXPECT_EQ(written, (int64_t)text.size());
+	EXPECT_TRUE(ring.IsEmpty());
+
+	char back[16] = {};
+	std::rewind(file);
+	EXPECT_EQ(std::fread(back, 1, sizeof(back), file), text.size());
+	EXPECT_EQ(std::string(back), text);
+	std::fclose(file);
+}
@@ -0,0 +1,137 @@
+#include "TestHardware.h"
+
+#include "ATMega328Emulator/Instructions.h"
+#include "ATMega328Emulator/Watchpoints.h"
+
+namespace {
+
+	constexpr Word PORTB_ADDRESS = CPU::IO_START + 0x05;
+
+	// 0: push r16
+	// 1: pop r17
+	// 2: out PORTB, r1
+	// 3: rjmp .
+	void LoadStackProgram(Memory& memory)
+	{
+		int dummyCycles = 0;
+		memory.WriteWord(Instruction::PUSH | (16 << 4), 0x0 * 2, dummyCycles);
+		memory.WriteWord(Instruction::POP | (17 << 4), 0x1 * 2, dummyCycles);
+		memory.WriteWord(Instruction::OUT | (1 << 4) | 0x05, 0x2 * 2, dummyCycles);
+		memory.WriteWord(Instruction::SELF_LOOP, 0x3 * 2, dummyCycles);
+	}
+
+}
+
+TEST_F(ATMega328, Watchpoints_ReadAndWrite)
+{
+	LoadStackProgram(memory);
+	cpu.R16 = 0xAB;
+	cpu.WriteData(CPU::RAMEND, 0x11);
+
+	Watchpoints watchpoints;
+	const int id = watchpoints.Add(WatchSpace::Data, CPU::RAMEND, 1, WatchAccess::ReadWrite);
+	std::vector<WatchEvent> events;
+	watchpoints.SetCallback([&](const WatchEvent& event) { events.push_back(event); return false; });
+	cpu.AttachedWatchpoints = &watchpoints;
+
+	// Act
+	RunResult result = cpu.Run(7, StopConditions(), memory);
+
+	// Assert, execution is unchanged
+	EXPECT_EQ(result.Cycles, 7);
+	EXPECT_EQ(cpu.R17, 0xAB);
+
+	ASSERT_EQ(events.size(), 2);
+	EXPECT_EQ(events[0].Id, id);
+	EXPECT_EQ(events[0].Access, WatchAccess::Write);
+	EXPECT_EQ(events[0].Address, CPU::RAMEND);
+	EXPECT_EQ(events[0].OldValue, 0x11);
+	EXPECT_EQ(events[0].NewValue, 0xAB);
+	EXPECT_EQ(events[0].PC, 0);
+	EXPECT_EQ(events[0].Cycle, 0);
+
+	EXPECT_EQ(events[1].Access, WatchAccess::Read);
+	EXPECT_EQ(events[1].OldValue, 0xAB);
+	EXPECT_EQ(events[1].NewValue, 0xAB);
+	EXPECT_EQ(events[1].PC, 1);
+	EXPECT_EQ(events[1].Cycle, 2); // After the 2 cycle PUSH
+}
+
+TEST_F(ATMega328, Watchpoints_ExactRange)
+{
+	LoadStackProgram(memory);
+
+	// The same page as the stack, but not the same address
+	Watchpoints watchpoints;
+	watchpoints.Add(WatchSpace::Data, CPU::RAMEND - 1, 1, WatchAccess::Write);
+	int calls = 0;
+	watchpoints.SetCallback([&](const WatchEvent&) { ++calls; return true; });
+	cpu.AttachedWatchpoints = &watchpoints;
+
+	// Act
+	cpu.Run(7, StopConditions(), memory);
+
+	// Assert
+	EXPECT_TRUE(watchpoints.IsDataPageWatched(CPU::RAMEND));
+	EXPECT_EQ(calls, 0);
+}
+
+TEST_F(ATMega328, Watchpoints_Stop)
+{
+	LoadStackProgram(memory);
+	cpu.R01 = 0x5A;
+
+	Watchpoints watchpoints;
+	watchpoints.Add(WatchSpace::Data, PORTB_ADDRESS, 1, WatchAccess::Write);
+	WatchEvent hit = {};
+	watchpoints.SetCallback([&](const WatchEvent& event) { hit = event; return true; });
+	cpu.AttachedWatchpoints = &watchpoints;
+
+	// Act
+	RunResult result = cpu.Run(1000, StopConditions(), memory);
+
+	// Assert, the OUT retired and the PC is past it
+	EXPECT_EQ(result.Reason, StopReason::Watchpoint);
+	EXPECT_EQ(result.Instructions, 3);
+	EXPECT_EQ(result.Cycles, 5);
+	EXPECT_EQ(cpu.PC, 3);
+	EXPECT_EQ(cpu.IO.PORTB, 0x5A);
+	EXPECT_EQ(hit.Address, PORTB_ADDRESS);
+	EXPECT_EQ(hit.NewValue, 0x5A);
+	EXPECT_EQ(hit.PC, 2);
+	EXPECT_EQ(hit.Cycle, 4);
+}
+
+TEST_F(ATMega328, Watchpoints_EEPROMAndRemove)
+{
+	Watchpoints watchpoints;
+	const int id = watchpoints.Add(WatchSpace::EEPROM, 0x3F0, 0x10, WatchAccess::Write);
+	std::vector<WatchEvent> events;
+	watchpoints.SetCallback([&](const WatchEvent& event) { events.push_back(event); return false; });
+	cpu.AttachedWatchpoints = &watchpoints;
+
+	EXPECT_EQ(watchpoints.Add(WatchSpace::EEPROM, 0x3F0, 0x11, WatchAccess::Write), -1); // Past the end
+	EXPECT_EQ(watchpoints.Add(WatchSpace::Data, 0x100, 0, WatchAccess::Write), -1);
+
+	// Act, outside Run
+	cpu.PC = 0x123;
+	cpu.WriteEEPROM(0x3FF, 7);
+	cpu.WriteData(0x3FF, 7); // The data space isn't watched
+
+	// Assert
+	ASSERT_EQ(events.size(), 1);
+	EXPECT_EQ(events[0].Space, WatchSpace::EEPROM);
+	EXPECT_EQ(events[0].Address, 0x3FF);
+	EXPECT_EQ(events[0].NewValue, 7);
+	EXPECT_EQ(events[0].PC, 0x123);
+	EXPECT_EQ(events[0].Cycle, cpu.CycleCount);
+
+	// Act, removed
+	EXPECT_TRUE(watchpoints.Remove(id));
+	EXPECT_FALSE(watchpoints.Remove(id));
+	cpu.WriteEEPROM(0x3FF, 8);
+
+	// Assert
+	EXPECT_EQ(events.size(), 1);
+	EXPECT_FALSE(watchpoints.IsEEPROMPageWatched(0x3FF));
+}
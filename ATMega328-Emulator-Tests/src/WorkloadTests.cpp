@@ -0,0 +1,78 @@
+#include "TestHardware.h"
+
+#include <initializer_list>
+#include <string>
+
+#include "ATMega328Emulator/HexFile.h"
+
+namespace {
+
+	// Where every workload leaves its result before its BREAK, see workloads/README.md
+	constexpr Word RESULT = CPU::SRAM_START;
+
+	// Enough for the longest pass through any workload
+	constexpr uint64_t MAX_CYCLES = 1'000'000;
+
+	// Runs a workload to its BREAK twice, it starts over after each one, and checks the result both times.
+	// The expected bytes come from workloads/reference.py.
+	void ExpectWorkload(CPU& cpu, Memory& memory, const std::string& name, std::initializer_list<Byte> expected)
+	{
+		ASSERT_TRUE(HexFile::Load(KOM_WORKLOADS_DIR + name + ".hex", memory));
+
+		StopConditions conditions;
+		conditions.StopOnBreak = true;
+		conditions.StopOnIllegalOpcode = true;
+		conditions.TrapFaults = true;
+
+		for (int pass = 0; pass < 2; ++pass) {
+			RunResult result = cpu.Run(MAX_CYCLES, conditions, memory);
+			ASSERT_EQ(result.Reason, StopReason::Break) << name << " pass " << pass;
+
+			Word address = RESULT;
+			for (Byte byte : expected) {
+				EXPECT_EQ(cpu.ReadData(address), byte) << name << " pass " << pass << " at " << address;
+				++address;
+			}
+
+			// Step over the BREAK
+			++cpu.PC;
+		}
+	}
+
+}
+
+TEST_F(ATMega328, Workload_CRC16)
+{
+	ExpectWorkload(cpu, memory, "crc16", { 0x10, 0xEA });
+}
+
+TEST_F(ATMega328, Workload_CRC32)
+{
+	ExpectWorkload(cpu, memory, "crc32", { 0xEC, 0x16, 0x50, 0x09 });
+}
+
+TEST_F(ATMega328, Workload_AES128)
+{
+	ExpectWorkload(cpu, memory, "aes128", {
+		0x24, 0x62, 0x63, 0x5D, 0xFF, 0xDE, 0xE3, 0xCE, 0xE0, 0x4D, 0x82, 0xF4, 0x23, 0x5E, 0x3F, 0xC1 });
+}
+
+TEST_F(ATMega328, Workload_FIR)
+{
+	ExpectWorkload(cpu, memory, "fir", { 0xE9, 0x1B, 0xCA, 0xF9 });
+}
+
+TEST_F(ATMega328, Workload_SoftUART)
+{
+	ExpectWorkload(cpu, memory, "softuart", { 0x14, 0x01, 0x3C, 0x00 });
+}
+
+TEST_F(ATMega328, Workload_Dispatch)
+{
+	ExpectWorkload(cpu, memory, "dispatch", { 0x56, 0x00, 0xA0, 0x90 });
+}
+
+TEST_F(ATMega328, Workload_CoreMark)
+{
+	ExpectWorkload(cpu, memory, "coremark", { 0xFC, 0x82 });
+}
@@ -0,0 +1,41 @@
+project "ATMega328-Emulator-TraceDump"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++20"
+	staticruntime "off"
+
+	targetdir ("%{wks.location}/bin/" .. outputdir .. "/%{prj.name}")
+    objdir ("%{wks.location}/bin-int/" .. outputdir .. "/%{prj.name}")
+
+	files {
+        "src/**.cpp",
+    }
+
+	includedirs {
+		"%{IncludeDir.ATMega328EmulatorCore}",
+    }
+
+	links {
+        "ATMega328-Emulator-Core"
+    }
+
+	filter "system:windows"
+		systemversion "latest"
+
+	filter "system:linux"
+		links { "pthread" }
+
+	filter "configurations:Debug"
+		defines "KOM_DEBUG"
+		runtime "Debug"
+		symbols "on"
+
+	filter "configurations:Release"
+		defines "KOM_RELEASE"
+		runtime "Release"
+		optimize "on"
+
+	filter "configurations:Dist"
+		defines "KOM_DIST"
+		runtime "Release"
+		optimize "on"
@@ -0,0 +1,57 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "ATMega328Emulator/Disassembler.h"
+#include "ATMega328Emulator/Trace.h"
+
+using namespace ATMega328Emulator;
+
+// Turns an execution trace (.avrt, see Trace.h) back into one line per instruction:
+// retire cycle, byte address, disassembly, the register it changed and the SREG flags it toggled.
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		std::fprintf(stderr, "Usage: %s <trace.avrt> [max instructions]\n", argv[0]);
+		return 1;
+	}
+
+	TraceReader reader;
+	if (!reader.Open(argv[1])) {
+		std::fprintf(stderr, "Can't read %s as a trace\n", argv[1]);
+		return 1;
+	}
+
+	const unsigned long long limit = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0;
+
+	// SREG bits, 7 to 0
+	static constexpr char FLAGS[] = "ITHSVNZC";
+
+	TraceEntry entry;
+	for (unsigned long long count = 0; (!limit || count < limit) && reader.Next(entry); ++count) {
+		char changes[32] = {};
+		int length = 0;
+		if (entry.Register != TraceFormat::NO_REGISTER) {
+			length += std::snprintf(changes, sizeof(changes), "r%d=0x%02X", entry.Register, entry.Value);
+		}
+		if (entry.SREGDelta) {
+			length += std::snprintf(changes + length, sizeof(changes) - length, "%sSREG^", length ? " " : "");
+			for (int bit = 7; bit >= 0; --bit) {
+				if (entry.SREGDelta & (1 << bit)) {
+					changes[length++] = FLAGS[7 - bit];
+				}
+			}
+		}
+
+		const std::string text = Disassembler::Disassemble(entry.Instruction, entry.Operand);
+		if (length) {
+			std::printf("%12llu  %5X:  %-24s %s\n", (unsigned long long)entry.Cycle, entry.PC * 2, text.c_str(), changes);
+		}
+		else {
+			std::printf("%12llu  %5X:  %s\n", (unsigned long long)entry.Cycle, entry.PC * 2, text.c_str());
+		}
+	}
+
+	return 0;
+}
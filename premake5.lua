@@ -26,3 +26,6 @@ outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 
 include "ATMega328-Emulator-Core"
 include "ATMega328-Emulator-Tests"
+include "ATMega328-Emulator-Bench"
+include "ATMega328-Emulator-TraceDump"
+include "ATMega328-Emulator-GDBServer"
@@ -0,0 +1,323 @@
+#!/usr/bin/env python3
+"""Assembles the workload sources into Intel HEX, for when there is no AVR toolchain around.
+
+    python3 scripts/avrasm.py workloads/crc16.S [-o workloads/crc16.hex]
+
+Only the subset of avr-as the workloads use: the instructions the emulator implements and
+their aliases, labels, .equ/.set, .org, .balign, .byte/.word/.long, .ascii/.asciz, and
+expressions with lo8(), hi8() and pm(). Like avr-as, labels are byte addresses.
+The sources stay valid for avr-gcc -mmcu=atmega328 -nostartfiles, which gives the same image.
+"""
+
+import argparse
+import re
+import sys
+
+REGISTER = re.compile(r"^r([0-9]|[12][0-9]|3[01])$", re.IGNORECASE)
+SYMBOL = re.compile(r"\b[A-Za-z_][A-Za-z0-9_]*")
+
+
+class AsmError(Exception):
+	pass
+
+
+def strip_comment(line):
+	quoted = False
+	for i, c in enumerate(line):
+		if c == '"':
+			quoted = not quoted
+		elif not quoted and (c == ';' or line.startswith("//", i)):
+			return line[:i]
+	return line
+
+
+def split_operands(text):
+	operands, current, quoted = [], "", False
+	for c in text:
+		if c == '"':
+			quoted = not quoted
+		if c == ',' and not quoted:
+			operands.append(current.strip())
+			current = ""
+		else:
+			current += c
+	if current.strip():
+		operands.append(current.strip())
+	return operands
+
+
+class Assembler:
+	def __init__(self):
+		self.symbols = {}
+		self.image = {}
+		self.address = 0
+
+	# Expressions
+
+	def evaluate(self, text, final):
+		expression = re.sub(r"'(\\?.)'", lambda m: str(ord(m.group(1)[-1])), text)
+		expression = expression.replace("/", "//")
+		# Symbols are substituted rather than handed to eval, so labels like 'pass' work
+		def value(match):
+			name = match.group(0)
+			if name in ("lo8", "hi8", "pm"):
+				return name
+			if name in self.symbols:
+				return str(self.symbols[name])
+			if final:
+				raise AsmError(f"undefined symbol '{name}'")
+			return "0"
+		expression = SYMBOL.sub(value, expression)
+		names = {"lo8": lambda v: v & 0xFF, "hi8": lambda v: (v >> 8) & 0xFF, "pm": lambda v: v >> 1}
+		try:
+			return int(eval(expression, {"__builtins__": {}}, names))
+		except Exception as e:
+			raise AsmError(f"bad expression '{text}': {e}")
+
+	def register(self, text, low=0, high=31, even=False):
+		match = REGISTER.match(text.strip())
+		if not match:
+			raise AsmError(f"expected a register, got '{text}'")
+		r = int(match.group(1))
+		if not low <= r <= high or (even and r % 2):
+			raise AsmError(f"r{r} can't be used here")
+		return r
+
+	# Negative values are allowed, like ldi r16, -1
+	def constant(self, text, bits, final):
+		value = self.evaluate(text, final)
+		if final and not -(1 << (bits - 1)) <= value < (1 << bits):
+			raise AsmError(f"'{text}' = {value} doesn't fit {bits} bits")
+		return value & ((1 << bits) - 1)
+
+	def relative(self, text, bits, final):
+		target = self.evaluate(text, final)
+		offset = (target - (self.address + 2)) // 2
+		if final and not -(1 << (bits - 1)) <= offset < (1 << (bits - 1)):
+			raise AsmError(f"'{text}' is out of reach")
+		return offset & ((1 << bits) - 1)
+
+	# Encodings, see ATMega328-Emulator-Core/include/ATMega328Emulator/Instructions.h
+
+	def encode(self, mnemonic, ops, final):
+		def rd(i=0, low=0): return self.register(ops[i], low)
+		def k8(i): return self.constant(ops[i], 8, final)
+		def rdrr(base, d, r): return base | (d << 4) | (r & 0xF) | ((r & 0x10) << 5)
+		def immediate(base, d, k): return base | ((d - 16) << 4) | (k & 0xF) | ((k & 0xF0) << 4)
+		def single(base, d): return base | (d << 4)
+
+		two = {"add": 0x0C00, "adc": 0x1C00, "sub": 0x1800, "sbc": 0x0800, "and": 0x2000, "or": 0x2800,
+			"eor": 0x2400, "cp": 0x1400, "cpc": 0x0400, "cpse": 0x1000, "mov": 0x2C00, "mul": 0x9C00}
+		if mnemonic in two:
+			return [rdrr(two[mnemonic], rd(0), rd(1))]
+		aliases = {"lsl": "add", "rol": "adc", "tst": "and", "clr": "eor"}
+		if mnemonic in aliases:
+			d = rd(0)
+			return [rdrr(two[aliases[mnemonic]], d, d)]
+
+		imm = {"subi": 0x5000, "sbci": 0x4000, "andi": 0x7000, "ori": 0x6000, "sbr": 0x6000, "cpi": 0x3000, "ldi": 0xE000}
+		if mnemonic in imm:
+			return [immediate(imm[mnemonic], rd(0, 16), k8(1))]
+		if mnemonic == "cbr":
+			return [immediate(0x7000, rd(0, 16), ~k8(1) & 0xFF)]
+		if mnemonic == "ser":
+			return [immediate(0xE000, rd(0, 16), 0xFF)]
+
+		one = {"com": 0x9400, "neg": 0x9401, "swap": 0x9402, "inc": 0x9403, "asr": 0x9405, "lsr": 0x9406,
+			"ror": 0x9407, "dec": 0x940A, "push": 0x920F, "pop": 0x900F}
+		if mnemonic in one:
+			return [single(one[mnemonic], rd(0))]
+
+		if mnemonic in ("adiw", "sbiw"):
+			d = self.register(ops[0], 24, 30, even=True)
+			k = self.constant(ops[1], 6, final)
+			return [(0x9600 if mnemonic == "adiw" else 0x9700) | ((d - 24) // 2 << 4) | (k & 0xF) | ((k & 0x30) << 2)]
+		if mnemonic == "movw":
+			return [0x0100 | (self.register(ops[0], even=True) // 2 << 4) | (self.register(ops[1], even=True) // 2)]
+		if mnemonic == "muls":
+			return [0x0200 | ((rd(0, 16) - 16) << 4) | (rd(1, 16) - 16)]
+		fractional = {"mulsu": 0x0300, "fmul": 0x0308, "fmuls": 0x0380, "fmulsu": 0x0388}
+		if mnemonic in fractional:
+			return [fractional[mnemonic] | ((self.register(ops[0], 16, 23) - 16) << 4) | (self.register(ops[1], 16, 23) - 16)]
+
+		branches = {"brcs": (0xF000, 0), "brlo": (0xF000, 0), "breq": (0xF000, 1), "brmi": (0xF000, 2),
+			"brvs": (0xF000, 3), "brlt": (0xF000, 4), "brhs": (0xF000, 5), "brts": (0xF000, 6), "brie": (0xF000, 7),
+			"brcc": (0xF400, 0), "brsh": (0xF400, 0), "brne": (0xF400, 1), "brpl": (0xF400, 2),
+			"brvc": (0xF400, 3), "brge": (0xF400, 4), "brhc": (0xF400, 5), "brtc": (0xF400, 6), "brid": (0xF400, 7)}
+		if mnemonic in branches:
+			base, s = branches[mnemonic]
+			return [base | (self.relative(ops[0], 7, final) << 3) | s]
+		if mnemonic in ("brbs", "brbc"):
+			return [(0xF000 if mnemonic == "brbs" else 0xF400) | (self.relative(ops[1], 7, final) << 3) | self.constant(ops[0], 3, final)]
+		flags = "cznvshti" # SREG bit order
+		if len(mnemonic) == 3 and mnemonic[:2] in ("se", "cl") and mnemonic[2] in flags:
+			return [(0x9408 if mnemonic[:2] == "se" else 0x9488) | (flags.index(mnemonic[2]) << 4)]
+
+		if mnemonic in ("rjmp", "rcall"):
+			return [(0xC000 if mnemonic == "rjmp" else 0xD000) | self.relative(ops[0], 12, final)]
+		if mnemonic in ("jmp", "call"):
+			k = self.constant(ops[0], 17, final) >> 1
+			return [0x940C if mnemonic == "jmp" else 0x940E, k & 0xFFFF]
+		fixed = {"nop": 0x0000, "ret": 0x9508, "reti": 0x9518, "ijmp": 0x9409, "icall": 0x9509,
+			"break": 0x9598, "sleep": 0x9588, "wdr": 0x95A8}
+		if mnemonic in fixed:
+			return [fixed[mnemonic]]
+
+		if mnemonic in ("sbrc", "sbrs", "bst", "bld"):
+			base = {"sbrc": 0xFC00, "sbrs": 0xFE00, "bst": 0xFA00, "bld": 0xF800}[mnemonic]
+			return [single(base, rd(0)) | self.constant(ops[1], 3, final)]
+		if mnemonic in ("sbic", "sbis", "sbi", "cbi"):
+			base = {"sbic": 0x9900, "sbis": 0x9B00, "sbi": 0x9A00, "cbi": 0x9800}[mnemonic]
+			return [base | (self.constant(ops[0], 5, final) << 3) | self.constant(ops[1], 3, final)]
+		if mnemonic == "in":
+			a = self.constant(ops[1], 6, final)
+			return [0xB000 | (rd(0) << 4) | (a & 0xF) | ((a & 0x30) << 5)]
+		if mnemonic == "out":
+			a = self.constant(ops[0], 6, final)
+			return [0xB800 | (rd(1) << 4) | (a & 0xF) | ((a & 0x30) << 5)]
+
+		if mnemonic in ("lds", "sts"):
+			r, k = (rd(0), ops[1]) if mnemonic == "lds" else (rd(1), ops[0])
+			return [(0x9000 if mnemonic == "lds" else 0x9200) | (r << 4), self.constant(k, 16, final)]
+		if mnemonic in ("ld", "st"):
+			r, pointer = (rd(0), ops[1]) if mnemonic == "ld" else (rd(1), ops[0])
+			pointer = pointer.replace(" ", "").upper()
+			modes = {"X": 0xC, "X+": 0xD, "-X": 0xE, "Y+": 0x9, "-Y": 0xA, "Z+": 0x1, "-Z": 0x2}
+			if pointer in ("Y", "Z"):
+				return [(0x8000 if mnemonic == "ld" else 0x8200) | (r << 4) | (0x8 if pointer == "Y" else 0)]
+			if pointer not in modes:
+				raise AsmError(f"bad pointer '{pointer}'")
+			return [(0x9000 if mnemonic == "ld" else 0x9200) | (r << 4) | modes[pointer]]
+		if mnemonic in ("ldd", "std"):
+			r, pointer = (rd(0), ops[1]) if mnemonic == "ldd" else (rd(1), ops[0])
+			pointer = pointer.replace(" ", "")
+			if pointer[:2].upper() not in ("Y+", "Z+"):
+				raise AsmError(f"bad displacement '{pointer}'")
+			q = self.constant(pointer[2:], 7, final)
+			if final and q > 63:
+				raise AsmError(f"displacement {q} is over 63")
+			return [(0x8000 if mnemonic == "ldd" else 0x8200) | (r << 4) | (0x8 if pointer[0].upper() == "Y" else 0)
+				| (q & 0x7) | ((q & 0x18) << 7) | ((q & 0x20) << 8)]
+		if mnemonic == "lpm":
+			if not ops:
+				return [0x95C8]
+			pointer = ops[1].replace(" ", "").upper()
+			if pointer not in ("Z", "Z+"):
+				raise AsmError(f"bad pointer '{pointer}'")
+			return [0x9004 | (rd(0) << 4) | (1 if pointer == "Z+" else 0)]
+
+		raise AsmError(f"unknown instruction '{mnemonic}'")
+
+	# Passes
+
+	def emit(self, data, final):
+		for byte in data:
+			if final:
+				if self.address in self.image:
+					raise AsmError(f"0x{self.address:04X} is written twice")
+				self.image[self.address] = byte & 0xFF
+			self.address += 1
+
+	def line(self, text, final):
+		text = strip_comment(text).strip()
+		while True:
+			match = re.match(r"^([A-Za-z_.][A-Za-z0-9_.]*)\s*:(.*)$", text)
+			if not match:
+				break
+			label, text = match.group(1), match.group(2).strip()
+			if not final:
+				if label in self.symbols:
+					raise AsmError(f"'{label}' is defined twice")
+				self.symbols[label] = self.address
+			elif self.symbols[label] != self.address:
+				raise AsmError(f"'{label}' moved between passes")
+		if not text:
+			return
+
+		match = re.match(r"^([A-Za-z_][A-Za-z0-9_]*)\s*=\s*(.+)$", text)
+		if match:
+			self.symbols[match.group(1)] = self.evaluate(match.group(2), final)
+			return
+
+		parts = text.split(None, 1)
+		mnemonic = parts[0].lower()
+		ops = split_operands(parts[1]) if len(parts) > 1 else []
+
+		if mnemonic in (".equ", ".set"):
+			self.symbols[ops[0]] = self.evaluate(ops[1], final)
+		elif mnemonic == ".org":
+			self.address = self.evaluate(ops[0], True)
+		elif mnemonic == ".balign":
+			alignment = self.evaluate(ops[0], True)
+			fill = self.evaluate(ops[1], True) if len(ops) > 1 else 0
+			self.emit([fill] * (-self.address % alignment), final)
+		elif mnemonic in (".byte", ".word", ".long"):
+			size = {".byte": 1, ".word": 2, ".long": 4}[mnemonic]
+			for op in ops:
+				value = self.evaluate(op, final)
+				self.emit([(value >> (8 * i)) & 0xFF for i in range(size)], final)
+		elif mnemonic in (".ascii", ".asciz"):
+			for op in ops:
+				string = bytes(op.strip()[1:-1], "latin-1").decode("unicode_escape").encode("latin-1")
+				self.emit(list(string) + ([0] if mnemonic == ".asciz" else []), final)
+		elif mnemonic in (".text", ".section", ".global", ".globl", ".type", ".size", ".end", ".func", ".endfunc"):
+			pass
+		elif mnemonic.startswith("."):
+			raise AsmError(f"unknown directive '{mnemonic}'")
+		else:
+			if self.address % 2:
+				raise AsmError("instructions have to be word aligned")
+			words = self.encode(mnemonic, ops, final)
+			self.emit([b for word in words for b in (word & 0xFF, word >> 8)], final)
+
+	def assemble(self, lines, filename):
+		for final in (False, True):
+			self.address = 0
+			for number, text in enumerate(lines, 1):
+				try:
+					self.line(text, final)
+				except AsmError as e:
+					raise AsmError(f"{filename}:{number}: {e}")
+		return self.image
+
+
+def to_hex(image):
+	"""Intel HEX with 16 byte data records, like avr-objcopy -O ihex writes."""
+	records = []
+	addresses = sorted(image)
+	i = 0
+	while i < len(addresses):
+		start = addresses[i]
+		data = []
+		while i < len(addresses) and addresses[i] == start + len(data) and len(data) < 16:
+			data.append(image[addresses[i]])
+			i += 1
+		record = [len(data), start >> 8, start & 0xFF, 0x00] + data
+		records.append(":" + "".join(f"{b:02X}" for b in record) + f"{-sum(record) & 0xFF:02X}")
+	records.append(":00000001FF")
+	return "\n".join(records) + "\n"
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+	parser.add_argument("source")
+	parser.add_argument("-o", "--output", help="defaults to the source with a .hex extension")
+	args = parser.parse_args()
+
+	with open(args.source, encoding="latin-1") as file:
+		lines = file.read().splitlines()
+	try:
+		image = Assembler().assemble(lines, args.source)
+	except AsmError as e:
+		print(e, file=sys.stderr)
+		return 1
+
+	output = args.output or re.sub(r"\.[Ss]$", "", args.source) + ".hex"
+	with open(output, "w", newline="\n") as file:
+		file.write(to_hex(image))
+	print(f"{output}: {len(image)} bytes")
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
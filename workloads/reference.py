@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""Reference models of the workloads, prints the bytes each one leaves at RESULT.
+
+    python3 workloads/reference.py
+
+The expected values in ATMega328-Emulator-Tests/src/WorkloadTests.cpp come from here.
+"""
+
+
+def crc16():
+	buffer = [(11 + 37 * i) & 0xFF for i in range(256)]
+	crc = 0xFFFF
+	for _ in range(4):
+		for byte in buffer:
+			crc ^= byte << 8
+			for _ in range(8):
+				crc = ((crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1) & 0xFFFF
+	return crc.to_bytes(2, "little")
+
+
+def lfsr(length):
+	x, sequence = 1, []
+	for _ in range(length):
+		sequence.append(x)
+		x = ((x << 1) ^ (0x1D if x & 0x80 else 0)) & 0xFF
+	return sequence
+
+
+def crc32():
+	buffer = lfsr(512)
+	crc = 0xFFFFFFFF
+	for _ in range(8):
+		for byte in buffer:
+			crc ^= byte
+			for _ in range(8):
+				crc = (crc >> 1) ^ 0xEDB88320 if crc & 1 else crc >> 1
+	return (crc ^ 0xFFFFFFFF).to_bytes(4, "little")
+
+
+def xtime(a):
+	return ((a << 1) ^ (0x1B if a & 0x80 else 0)) & 0xFF
+
+
+def sbox():
+	# Multiplicative inverse in GF(2^8) followed by the affine transform
+	def multiply(a, b):
+		p = 0
+		while b:
+			p ^= a if b & 1 else 0
+			a, b = xtime(a), b >> 1
+		return p
+	inverse = [0] + [next(b for b in range(1, 256) if multiply(a, b) == 1) for a in range(1, 256)]
+	table = []
+	for b in inverse:
+		s = b
+		for i in range(1, 5):
+			s ^= ((b << i) | (b >> (8 - i))) & 0xFF
+		table.append(s ^ 0x63)
+	return table
+
+
+def aes128():
+	box = sbox()
+	key = list(range(16))
+	words = [key[i:i + 4] for i in range(0, 16, 4)]
+	rcon = 1
+	for i in range(4, 44):
+		w = list(words[i - 1])
+		if i % 4 == 0:
+			w = [box[b] for b in w[1:] + w[:1]]
+			w[0] ^= rcon
+			rcon = xtime(rcon)
+		words.append([a ^ b for a, b in zip(words[i - 4], w)])
+	round_keys = [sum(words[i:i + 4], []) for i in range(0, 44, 4)]
+
+	state = [0x11 * i for i in range(16)]
+	for _ in range(16):
+		state = [a ^ k for a, k in zip(state, round_keys[0])]
+		for round in range(1, 11):
+			state = [box[b] for b in state]
+			state = [state[(i + 4 * (i % 4)) % 16] for i in range(16)]
+			if round < 10:
+				mixed = []
+				for c in range(0, 16, 4):
+					a = state[c:c + 4]
+					t = a[0] ^ a[1] ^ a[2] ^ a[3]
+					mixed += [a[i] ^ t ^ xtime(a[i] ^ a[(i + 1) % 4]) for i in range(4)]
+				state = mixed
+			state = [a ^ k for a, k in zip(state, round_keys[round])]
+	return bytes(state)
+
+
+def fir():
+	coefficients = [-120, -340, -150, 600, 1800, 3300, 4700, 5600]
+	coefficients += coefficients[::-1]
+	delay = [0] * 16
+	s, position, total, y = 1, 0, 0, 0
+	for _ in range(256):
+		s = (s * 5 + 0x3619) & 0xFFFF
+		delay[position] = (s - 0x10000 if s & 0x8000 else s) >> 2
+		acc = sum(c * delay[(position - k) % 16] for k, c in enumerate(coefficients))
+		position = (position + 1) % 16
+		y = (acc >> 15) & 0xFFFF
+		total = (total + y) & 0xFFFF
+	return total.to_bytes(2, "little") + y.to_bytes(2, "little")
+
+
+def softuart():
+	text = b"Hello, world!\r\n" * 4
+	# The data bits that are 1 and the stop bit are high, the start bit is low
+	high = sum(bin(byte).count("1") + 1 for byte in text)
+	return high.to_bytes(2, "little") + len(text).to_bytes(2, "little")
+
+
+def dispatch():
+	var = [0] * 4
+	for _ in range(2):
+		var[0], var[1] = 0, 200
+		while True:
+			var[0] = (((var[0] << 1) ^ var[1]) + 0x5B) & 0xFF
+			var[2] = (var[2] + 2 * var[0]) & 0xFF
+			var[3] = (var[3] + 1) & 0xFF
+			var[1] -= 1
+			if var[1] == 0:
+				break
+	return bytes(var)
+
+
+def coremark():
+	def signed(b):
+		return b - 0x100 if b & 0x80 else b
+
+	crc = 0
+	for seed in range(16):
+		a = [signed((seed + 13 * k) & 0xFF) for k in range(64)]
+		b = [signed((seed - 7 * k) & 0xFF) for k in range(64)]
+		# Each element is summed in 16 bits before it's added in
+		matrix = 0
+		for i in range(8):
+			for j in range(8):
+				matrix += sum(a[8 * i + k] * b[8 * k + j] for k in range(8)) & 0xFFFF
+		matrix &= 0xFFFF
+
+		values = [(seed + 11 * k) & 0xFF for k in range(32)]
+		checksum = 0
+		for value in reversed(values):
+			checksum = ((checksum << 1) ^ value) & 0xFFFF
+
+		for byte in matrix.to_bytes(2, "little") + checksum.to_bytes(2, "little"):
+			crc ^= byte
+			for _ in range(8):
+				crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+	return crc.to_bytes(2, "little")
+
+
+WORKLOADS = [crc16, crc32, aes128, fir, softuart, dispatch, coremark]
+
+
+def main():
+	for workload in WORKLOADS:
+		result = workload()
+		print(f"{workload.__name__}: {', '.join(f'0x{b:02X}' for b in result)}")
+
+
+if __name__ == "__main__":
+	main()